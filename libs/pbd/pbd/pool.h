@@ -34,6 +34,14 @@ class Pool
 
 	virtual void *alloc ();
 	virtual void release (void *);
+
+	/* like alloc(), but just returns 0 when the pool is empty */
+	virtual void *try_alloc ();
+
+	/* whether ptr is one of this pool's items */
+	bool owns (void *ptr) const {
+		return ptr >= block && ptr < static_cast<char*>(block) + (_item_size * _nitems);
+	}
 	
 	std::string name() const { return _name; }
 
@@ -41,6 +49,8 @@ class Pool
 	RingBuffer<void*>* free_list;
 	std::string _name;
 	void *block;
+	unsigned long _item_size;
+	unsigned long _nitems;
 };
 
 class SingleAllocMultiReleasePool : public Pool
@@ -64,6 +74,7 @@ class MultiAllocSingleReleasePool : public Pool
 	~MultiAllocSingleReleasePool ();
 
 	virtual void *alloc ();
+	virtual void *try_alloc ();
 	virtual void release (void *);
 
   private:
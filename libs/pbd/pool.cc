@@ -33,6 +33,8 @@ using namespace std;
 Pool::Pool (string n, unsigned long item_size, unsigned long nitems)
 {
 	_name = n;
+	_item_size = item_size;
+	_nitems = nitems;
 
 	free_list = new RingBuffer<void*> (nitems);
 
@@ -75,6 +77,17 @@ Pool::alloc ()
 	}
 };
 
+void *
+Pool::try_alloc ()
+{
+	void *ptr;
+
+	if (free_list->read (&ptr, 1) < 1) {
+		return 0;
+	}
+	return ptr;
+}
+
 void		
 Pool::release (void *ptr)
 {
@@ -114,6 +127,16 @@ MultiAllocSingleReleasePool::alloc ()
 	return ptr;
 }
 
+void*
+MultiAllocSingleReleasePool::try_alloc ()
+{
+	void *ptr;
+	pthread_mutex_lock (&lock);
+	ptr = Pool::try_alloc ();
+	pthread_mutex_unlock (&lock);
+	return ptr;
+}
+
 void
 MultiAllocSingleReleasePool::release (void* ptr)
 {
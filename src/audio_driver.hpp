@@ -103,6 +103,9 @@ class AudioDriver
 	virtual nframes_t get_samplerate() { return _samplerate; }
 	virtual nframes_t get_buffersize() { return _buffersize; }
 
+	// SCHED_FIFO priority of the process thread, 0 if it isn't realtime
+	virtual int get_realtime_priority() { return 0; }
+
 	sigc::signal0<void> ConnectionsChanged;
 	
   protected:
@@ -126,6 +126,7 @@ CommandMap::CommandMap()
 	add_input_control("stretch_ratio", Event::StretchRatio, UnitRatio, 0.5f, 4.0f, 1.0f);
 	add_input_control("pitch_shift", Event::PitchShift, UnitSemitones, -12.0f, 12.0f, 0.0f); 
 	add_input_control("tempo_stretch", Event::TempoStretch, UnitBoolean);
+	add_input_control("rate_interpolation", Event::RateInterpolation, UnitIndexed, 0.0f, 2.0f, 1.0f);
 	add_input_control("round_integer_tempo", Event::RoundIntegerTempo, UnitBoolean);
 	add_input_control("jack_timebase_master", Event::JackTimebaseMaster, UnitBoolean);
 
@@ -147,6 +148,8 @@ CommandMap::CommandMap()
 	add_output_control("in_peak_meter", Event::InPeakMeter, UnitGeneric, 0.0f, 4.0f);
 	add_output_control("out_peak_meter", Event::OutPeakMeter, UnitGeneric, 0.0f, 4.0f);
 	add_output_control("is_soloed", Event::IsSoloed, UnitBoolean);
+	add_output_control("loop_cpu_us", Event::LoopCpuTime, UnitGeneric, 0.0f, 1e6);
+	add_output_control("loop_max_cpu_us", Event::LoopMaxCpuTime, UnitGeneric, 0.0f, 1e6);
 
 	_str_ctrl_map.insert (_output_controls.begin(), _output_controls.end());
 
@@ -175,6 +178,16 @@ CommandMap::CommandMap()
 	add_global_control("send_midi_start_on_trigger", Event::SendMidiStartOnTrigger, UnitBoolean, 0.0f, 1.0f, 1.0f);
 	add_global_control("global_cycle_len", Event::GlobalCycleLen, UnitSeconds, 0.0f, 1e6);
 	add_global_control("global_cycle_pos", Event::GlobalCyclePos, UnitSeconds, 0.0f, 1e6);
+	add_global_control("dsp_load", Event::DspLoad, UnitGeneric, 0.0f, 2.0f);
+	add_global_control("max_cycle_us", Event::MaxCycleTime, UnitGeneric, 0.0f, 1e6);
+	add_global_control("p99_cycle_us", Event::P99CycleTime, UnitGeneric, 0.0f, 1e6);
+	add_global_control("manage_cpu_us", Event::LoopManageTime, UnitGeneric, 0.0f, 1e6);
+	add_global_control("sync_cpu_us", Event::SyncTime, UnitGeneric, 0.0f, 1e6);
+	add_global_control("mix_cpu_us", Event::MixTime, UnitGeneric, 0.0f, 1e6);
+	add_global_control("dropped_events", Event::DroppedEvents, UnitInteger, 0.0f, 1e9);
+	add_global_control("dropped_sync_events", Event::DroppedSyncEvents, UnitInteger, 0.0f, 1e9);
+	add_global_control("event_pool_misses", Event::EventPoolMisses, UnitInteger, 0.0f, 1e9);
+	add_global_control("event_pool_peak", Event::EventPoolPeak, UnitInteger, 0.0f, 1e9);
 	_str_ctrl_map.insert (_global_controls.begin(), _global_controls.end());
 
 	// reverse it
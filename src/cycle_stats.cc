@@ -0,0 +1,113 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#include <cstring>
+
+#include "cycle_stats.hpp"
+
+using namespace SooperLooper;
+
+static double cycle_usecs = 0.0;
+
+static double
+now_usecs ()
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+}
+
+void
+SooperLooper::calibrate_cycles ()
+{
+	struct timespec pause = { 0, 20000000 };
+	double start_usecs, took_usecs;
+	cycle_t start, took;
+
+	if (cycle_usecs > 0.0) {
+		return;
+	}
+
+	start_usecs = now_usecs ();
+	start = get_cycles ();
+	nanosleep (&pause, NULL);
+	took = get_cycles () - start;
+	took_usecs = now_usecs () - start_usecs;
+
+	cycle_usecs = (took > 0) ? took_usecs / took : 1e-3;
+}
+
+double
+SooperLooper::usecs_per_cycle ()
+{
+	return cycle_usecs;
+}
+
+CycleStats::CycleStats ()
+	: _bucket_width (1), _total (0), _max (0), _count (0),
+	  _mean_usecs (0.0f), _max_usecs (0.0f), _p99_usecs (0.0f)
+{
+	memset (_hist, 0, sizeof(_hist));
+}
+
+void
+CycleStats::set_range (double usecs)
+{
+	cycle_t width = 1;
+
+	if (cycle_usecs > 0.0) {
+		width = (cycle_t) (usecs / cycle_usecs / Buckets);
+	}
+	_bucket_width = width > 0 ? width : 1;
+}
+
+void
+CycleStats::publish ()
+{
+	uint32_t want, seen = 0;
+	unsigned int bucket;
+
+	if (_count == 0) {
+		return;
+	}
+
+	// the top of the bucket the 99th percentile falls in, but never
+	// more than the longest one seen
+	want = _count - _count / 100;
+	for (bucket = 0; bucket < Buckets - 1; ++bucket) {
+		seen += _hist[bucket];
+		if (seen >= want) {
+			break;
+		}
+	}
+
+	cycle_t p99 = (bucket + 1) * _bucket_width;
+	if (bucket == Buckets - 1 || p99 > _max) {
+		p99 = _max;
+	}
+
+	_mean_usecs = (float) (_total * cycle_usecs / _count);
+	_max_usecs = (float) (_max * cycle_usecs);
+	_p99_usecs = (float) (p99 * cycle_usecs);
+
+	memset (_hist, 0, sizeof(_hist));
+	_total = 0;
+	_max = 0;
+	_count = 0;
+}
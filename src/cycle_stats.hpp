@@ -0,0 +1,107 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#ifndef __sooperlooper_cycle_stats_h__
+#define __sooperlooper_cycle_stats_h__
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace SooperLooper {
+
+typedef uint64_t cycle_t;
+
+// a clock cheap enough to read around every loop of every period: the
+// time stamp counter where the cpu has one that is usable from user space
+static inline cycle_t get_cycles ()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return __rdtsc ();
+#elif defined(__aarch64__)
+	uint64_t cnt;
+	__asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (cnt));
+	return cnt;
+#else
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (cycle_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// measures how long a get_cycles() tick is, which takes a few tens of
+// milliseconds.  call it once before any CycleStats gets used
+void calibrate_cycles ();
+double usecs_per_cycle ();
+
+/*
+ * Times of some bit of the audio thread's work, one sample per period,
+ * summed up every so often into a histogram.  Only the thread doing the
+ * work writes, so nothing is locked; the numbers published from the last
+ * window are plain floats any thread may read.
+ */
+class CycleStats
+{
+  public:
+	enum { Buckets = 64 };
+
+	CycleStats ();
+
+	// the histogram goes from nothing to usecs, longer ones all landing
+	// in the last bucket
+	void set_range (double usecs);
+
+	void add (cycle_t cycles) {
+		// clamped before narrowing, so a wild delta can't wrap into a
+		// low bucket
+		cycle_t bucket = cycles / _bucket_width;
+
+		_total += cycles;
+		_count++;
+		if (cycles > _max) {
+			_max = cycles;
+		}
+		_hist[bucket < (cycle_t) Buckets ? (unsigned int) bucket : Buckets - 1]++;
+	}
+
+	// publishes the window since the last publish and starts a new one
+	void publish ();
+
+	float mean_usecs () const { return _mean_usecs; }
+	float max_usecs () const { return _max_usecs; }
+	float p99_usecs () const { return _p99_usecs; }
+
+  private:
+	cycle_t   _bucket_width;
+	uint32_t  _hist[Buckets];
+	cycle_t   _total;
+	cycle_t   _max;
+	uint32_t  _count;
+
+	volatile float _mean_usecs;
+	volatile float _max_usecs;
+	volatile float _p99_usecs;
+};
+
+};
+
+#endif
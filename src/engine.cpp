@@ -40,6 +40,8 @@
 #include "midi_bind.hpp"
 #include "midi_bridge.hpp"
 #include "utils.hpp"
+#include "worker_pool.hpp"
+#include "stretch_cache.hpp"
 
 using namespace SooperLooper;
 using namespace std;
@@ -65,6 +67,10 @@ Engine::Engine ()
 	_tempo = 110.0;
 	_eighth_cycle = 16.0f;
 	_sync_source = NoSync;
+	_sync_events.events = 0;
+	_sync_events.count = 0;
+	_sync_events.size = 0;
+	_sync_events.valid = false;
 	_tempo_counter = 0;
 	_tempo_frames = 0;
 	_quarter_counter = 0.0;
@@ -86,6 +92,15 @@ Engine::Engine ()
 	_jack_timebase_master = false;
 	_loading = false;
 	_use_temp_input = true; // all the time for now
+	_worker_pool = 0;
+	_stretch_renderer = 0;
+	_unsent_stretch_cache = 0;
+	_driver_services_loops = false;
+	_worker_threads = 0;
+	_worker_nframes = 0;
+	_worker_syncm = -1;
+	_stats_frames = 0;
+	_stats_window = 0;
 	_ignore_quit = false;
 	_selected_loop = -1; // all
 	_output_midi_clock = false;
@@ -140,6 +155,9 @@ bool Engine::initialize(AudioDriver * driver, int buschans, int port, string pin
 
 	_buffersize = _driver->get_buffersize();
 
+	calibrate_cycles ();
+	set_stats_range (_buffersize);
+
 	_common_input_buffers.clear();
 	_common_outputs.clear();
 	_common_inputs.clear();
@@ -174,10 +192,10 @@ bool Engine::initialize(AudioDriver * driver, int buschans, int port, string pin
 
 
 	_event_generator = new EventGenerator(_driver->get_samplerate());
-	_event_queue = new RingBuffer<Event> (MAX_EVENTS);
-	_midi_event_queue = new RingBuffer<Event> (MAX_EVENTS);
-	_sync_queue = new RingBuffer<Event> (MAX_SYNC_EVENTS);
-	_nonrt_update_event_queue = new RingBuffer<Event> (MAX_SYNC_EVENTS);
+	_event_queue = new MPSCRingBuffer<Event> (MAX_EVENTS);
+	_midi_event_queue = new MPSCRingBuffer<Event> (MAX_EVENTS);
+	_sync_queue = new MPSCRingBuffer<Event> (MAX_SYNC_EVENTS);
+	_nonrt_update_event_queue = new MPSCRingBuffer<Event> (MAX_SYNC_EVENTS);
 
 	_nonrt_event_queue = new RingBuffer<EventNonRT *> (MAX_EVENTS);
 
@@ -187,12 +205,28 @@ bool Engine::initialize(AudioDriver * driver, int buschans, int port, string pin
 	// reserve space in instance vectors to try to be RT safe
 	_instances.reserve(128);
 	_rt_instances.reserve(128);
+	_rt_used_frames.reserve(128);
 	
 	_internal_sync_buf = new float[driver->get_buffersize()];
 	memset(_internal_sync_buf, 0, sizeof(float) * driver->get_buffersize());
+	_sync_events.events = new SyncEvent[driver->get_buffersize()];
+	_sync_events.size = driver->get_buffersize();
 
 	_falloff_per_sample = 30.0f / driver->get_samplerate(); // 30db per second falloff
 
+	if (_worker_threads > 0) {
+		_worker_pool = WorkerPool::create (_worker_threads, _driver->get_realtime_priority(), true);
+	}
+	if (_worker_pool) {
+		for (size_t n=0; n < _worker_pool->thread_count() * _common_outputs.size(); ++n) {
+			sample_t * outbuf = new float[driver->get_buffersize()];
+			memset(outbuf, 0, sizeof(float) * driver->get_buffersize());
+			_worker_output_buffers.push_back(outbuf);
+		}
+	}
+
+	_stretch_renderer = new StretchRenderer ();
+
 	_longpress_frames = (nframes_t) lrint (driver->get_samplerate() * 1.0);
 
 	calculate_tempo_frames();
@@ -254,6 +288,30 @@ Engine::cleanup()
 		_internal_sync_buf = 0;
 	}
 
+	if (_sync_events.events) {
+		delete [] _sync_events.events;
+		_sync_events.events = 0;
+		_sync_events.size = 0;
+	}
+
+	if (_worker_pool) {
+		delete _worker_pool;
+		_worker_pool = 0;
+	}
+
+	if (_stretch_renderer) {
+		delete _stretch_renderer;
+		_stretch_renderer = 0;
+	}
+	StretchRenderer::destroy (_unsent_stretch_cache);
+	_unsent_stretch_cache = 0;
+
+	for (vector<sample_t *>::iterator iter = _worker_output_buffers.begin(); iter != _worker_output_buffers.end(); ++iter) 
+	{
+		delete [] *iter;
+	}
+	_worker_output_buffers.clear();
+
 	if (_loop_manage_to_rt_queue) {
 		delete _loop_manage_to_rt_queue;
 		_loop_manage_to_rt_queue = 0;
@@ -369,10 +427,13 @@ Engine::get_common_input_buffer (unsigned int chan)
 }
 
 sample_t *
-Engine::get_common_output_buffer (unsigned int chan)
+Engine::get_common_output_buffer (unsigned int chan, unsigned int worker)
 {
 	if (chan < _common_outputs.size()) {
-		if (_use_temp_input) {
+		if (worker > 0) {
+			return _worker_output_buffers[(worker - 1) * _common_outputs.size() + chan];
+		}
+		else if (_use_temp_input) {
 			return _temp_output_buffers[chan];
 		}
 		else {
@@ -413,10 +474,24 @@ Engine::buffersize_changed (nframes_t nframes)
 			_temp_output_buffers[n] = outbuf;
 		}
 
+		for (size_t n=0; n < _worker_output_buffers.size(); ++n) {
+			delete [] _worker_output_buffers[n];
+			_worker_output_buffers[n] = new float[nframes];
+			memset(_worker_output_buffers[n], 0, sizeof(float) * nframes);
+		}
+
+		set_stats_range (nframes);
+
 		delete [] _internal_sync_buf;
 		_internal_sync_buf = new float[nframes];
 		memset(_internal_sync_buf, 0, sizeof(float) * nframes);
 
+		delete [] _sync_events.events;
+		_sync_events.events = new SyncEvent[nframes];
+		_sync_events.size = nframes;
+		_sync_events.count = 0;
+		_sync_events.valid = false;
+
 		_buffersize = nframes;
 	}
 }
@@ -471,7 +546,7 @@ Engine::fill_common_outs(nframes_t nframes)
 
 			inpeak = f_max (inpeak, fabsf(inbuf[n]));
 
-			real_outbuf[n] = flush_to_zero ((outbuf[n] * currwet) + (inbuf[n] * currdry));
+			real_outbuf[n] = (outbuf[n] * currwet) + (inbuf[n] * currdry);
 
 			// outpeak is taken post dry/wet mix for true output metering
 			outpeak = f_max (outpeak, fabsf(real_outbuf[n]));
@@ -612,6 +687,14 @@ Engine::remove_loop (Looper * looper)
 			_instances.erase(iter);
 		}
 	}
+
+	if (_stretch_renderer) {
+		_stretch_renderer->forget (looper);
+	}
+	if (_unsent_stretch_cache && _unsent_stretch_cache->owner == looper) {
+		StretchRenderer::destroy (_unsent_stretch_cache);
+		_unsent_stretch_cache = 0;
+	}
 	
 	delete looper;
 
@@ -668,8 +751,8 @@ Engine::get_osc_port ()
 }
 
 
-static inline Event * next_rt_event (RingBuffer<Event>::rw_vector & vec, size_t & pos,
-                                     RingBuffer<Event>::rw_vector & midivec, size_t & midipos)
+static inline Event * next_rt_event (MPSCRingBuffer<Event>::rw_vector & vec, size_t & pos,
+                                     MPSCRingBuffer<Event>::rw_vector & midivec, size_t & midipos)
 {
 	Event * e1 = 0;
 	Event * e2 = 0;
@@ -712,6 +795,47 @@ static inline Event * next_rt_event (RingBuffer<Event>::rw_vector & vec, size_t
 	return 0;
 }
 	
+void
+Engine::service_loops ()
+{
+	// in the audio thread, but between cycles of a driver that isn't
+	// realtime, so it can do all of it here and now
+
+	sl_maintain_memory();
+
+	for (Instances::iterator i = _rt_instances.begin(); i != _rt_instances.end(); ++i)
+	{
+		if ((*i)->wants_stretchers()) {
+			(*i)->clear_stretchers_wanted();
+			(*i)->attach_stretchers ((*i)->create_stretchers());
+		}
+
+		if ((*i)->wants_stretch_cache() && _stretch_renderer) {
+			(*i)->clear_stretch_cache_wanted();
+			(*i)->request_stretch_cache (_stretch_renderer);
+		}
+	}
+
+	if (!_stretch_renderer) {
+		return;
+	}
+
+	// the render is done before the next cycle, however long it takes
+	_stretch_renderer->wait_idle();
+
+	StretchCache * cache;
+
+	while ((cache = _stretch_renderer->take_finished()) != 0) {
+		Looper * looper = (Looper *) cache->owner;
+
+		if (find (_rt_instances.begin(), _rt_instances.end(), looper) != _rt_instances.end()) {
+			cache = looper->attach_stretch_cache (cache);
+		}
+
+		StretchRenderer::destroy (cache);
+	}
+}
+
 void Engine::process_rt_loop_manage_events ()
 {
 	// pull off all loop management events from the main thread
@@ -753,9 +877,60 @@ void Engine::process_rt_loop_manage_events ()
 			// signal main loop
 			push_loop_manage_to_main (*lmevt);
 		}
+		else if (lmevt->etype == LoopManageEvent::AttachStretchCache)
+		{
+			// the cache it replaces has to go back
+			if (_loop_manage_to_main_queue->write_space() == 0) {
+				break;
+			}
+
+			if (find (_rt_instances.begin(), _rt_instances.end(), lmevt->looper) != _rt_instances.end()) {
+				lmevt->cache = lmevt->looper->attach_stretch_cache (lmevt->cache);
+			}
+
+			if (lmevt->cache) {
+				lmevt->etype = LoopManageEvent::ReleaseStretchCache;
+				push_loop_manage_to_main (*lmevt);
+			}
+		}
+		else if (lmevt->etype == LoopManageEvent::AttachStretchers)
+		{
+			if (find (_rt_instances.begin(), _rt_instances.end(), lmevt->looper) != _rt_instances.end()) {
+				lmevt->looper->attach_stretchers (lmevt->stretchers);
+			}
+			else {
+				// the loop went away in the meantime
+				lmevt->etype = LoopManageEvent::ReleaseStretchers;
+				push_loop_manage_to_main (*lmevt);
+			}
+		}
 		
 		_loop_manage_to_rt_queue->increment_read_ptr(1);
 	}
+
+	// hand back the stretch caches and stretchers loops have not used for a while
+	for (Instances::iterator i = _rt_instances.begin(); i != _rt_instances.end(); ++i)
+	{
+		if (_loop_manage_to_main_queue->write_space() == 0) {
+			break;
+		}
+
+		StretchCache * cache = (*i)->take_idle_stretch_cache();
+		if (cache) {
+			LoopManageEvent lmev (LoopManageEvent::ReleaseStretchCache, *i, cache);
+			push_loop_manage_to_main (lmev);
+
+			if (_loop_manage_to_main_queue->write_space() == 0) {
+				break;
+			}
+		}
+
+		LoopStretchers * str = (*i)->take_idle_stretchers();
+		if (str) {
+			LoopManageEvent lmev (LoopManageEvent::ReleaseStretchers, *i, str);
+			push_loop_manage_to_main (lmev);
+		}
+	}
 	
 }
 
@@ -768,12 +943,16 @@ Engine::process (nframes_t nframes)
 	//	return 0;
 	//}
 
+	// cheap when already set, and the driver may switch threads on us.
+	// everything the loops feed back then flushes to zero by itself
+	set_denormal_flush_mode ();
+
 	// process events
 	//cerr << "process"  << endl;
 
 	Event * evt;
-	RingBuffer<Event>::rw_vector vec;
-	RingBuffer<Event>::rw_vector midivec;
+	MPSCRingBuffer<Event>::rw_vector vec;
+	MPSCRingBuffer<Event>::rw_vector midivec;
 
 	// get available events
 	_event_queue->get_read_vector (&vec);
@@ -782,12 +961,23 @@ Engine::process (nframes_t nframes)
 	// update event generator
 	_event_generator->updateFragmentTime (nframes);
 
+	cycle_t started = get_cycles();
+	cycle_t stamp = started;
+	cycle_t now;
+
 	// process loop instance rt events
 	process_rt_loop_manage_events();
+
+	now = get_cycles();
+	_manage_stats.add (now - stamp);
+	stamp = now;
 	
 	// update internal sync
 	calculate_tempo_frames ();
 	generate_sync (0, nframes);
+
+	now = get_cycles();
+	_sync_stats.add (now - stamp);
 	
 	// clear common output buffers
 	prepare_buffers (nframes);
@@ -799,6 +989,16 @@ Engine::process (nframes_t nframes)
 	size_t midi_n = 0;
 	int fragpos;
 	int m, syncm;
+	bool global;
+
+	syncm = -1;
+	if ((int)_sync_source > 0 && (int)_sync_source <= (int)_rt_instances.size()) {
+		// the sync source loop always has to be ahead of the others
+		syncm = (int) _sync_source - 1;
+	}
+
+	// every loop only gets split at the events that are for it
+	_rt_used_frames.assign (_rt_instances.size(), 0);
 	
 	if (num > 0) {
 
@@ -820,7 +1020,7 @@ Engine::process (nframes_t nframes)
 			doframes = fragpos - usedframes;
 
 			// handle special global RT events
-			if (evt->Instance == -2 
+			global = (evt->Instance == -2 
 			    || evt->Command == Event::SOLO
 			    || evt->Command == Event::SOLO_NEXT
 			    || evt->Command == Event::SOLO_PREV
@@ -838,7 +1038,9 @@ Engine::process (nframes_t nframes)
 			    || evt->Command == Event::RECORD_OR_OVERDUB_EXCL_PREV
 			    || evt->Command == Event::RECORD_OR_OVERDUB_EXCL
 			    || evt->Command == Event::RECORD_OR_OVERDUB_SOLO_NEXT
-			    || evt->Command == Event::RECORD_OR_OVERDUB_SOLO_PREV )
+			    || evt->Command == Event::RECORD_OR_OVERDUB_SOLO_PREV );
+
+			if (global)
 			{
 				do_global_rt_event (evt, usedframes + doframes, nframes - (usedframes + doframes));
 				
@@ -848,21 +1050,43 @@ Engine::process (nframes_t nframes)
 				}
 			}
 
-			m = 0;
-			syncm = -1;
+			usedframes += doframes;
 
-			
-			if ((int)_sync_source > 0 && (int)_sync_source <= (int)_rt_instances.size()) {
-				// we need to run the sync source loop first
-				syncm = (int) _sync_source - 1;
-				_rt_instances[syncm]->run (usedframes, doframes);
-				
-				if (evt->Instance == -1 || evt->Instance == syncm ||
-				    (evt->Instance == -3 && (_selected_loop == syncm || _selected_loop == -1))) {
-					_rt_instances[syncm]->do_event (evt);
+			if (global || evt->Instance == -1 || (evt->Instance == -3 && _selected_loop == -1)) {
+				// everyone runs up to this one, the sync source first
+				if (syncm >= 0) {
+					run_instance_to (syncm, usedframes, -1);
+				}
+				for (m = 0; m < (int) _rt_instances.size(); ++m) {
+					if (m != syncm) {
+						run_instance_to (m, usedframes, -1);
+					}
+				}
+				m = -1;
+			}
+			else if (evt->Instance == -3) {
+				m = _selected_loop;
+			}
+			else {
+				m = evt->Instance;
+			}
+
+			if (m >= 0 && m < (int) _rt_instances.size()) {
+				// run only the loop that it is for up to here
+				run_instance_to (m, usedframes, syncm);
+			}
+
+			for (int i = 0; i < (int) _rt_instances.size(); ++i)
+			{
+				if (m >= 0 && i != m) continue;
+
+				// process event
+				if (evt->Instance == -1 || evt->Instance == i || 
+				    (evt->Instance == -3 && (_selected_loop == i || _selected_loop == -1))) {
+					_rt_instances[i]->do_event (evt);
 
 					// if event command is trigger and send_midi_start_on_trigger is enabled, do so
-					if (evt->Command == Event::TRIGGER
+					if (i == syncm && evt->Command == Event::TRIGGER
 					    && (evt->Type == Event::type_cmd_down || evt->Type == Event::type_cmd_hit)) 
 					{
 						//cerr << "YES, send now" << endl;
@@ -876,24 +1100,6 @@ Engine::process (nframes_t nframes)
 				}
 			}
 
-			
-			for (Instances::iterator i = _rt_instances.begin(); i != _rt_instances.end(); ++i, ++m)
-			{
-				if (syncm == m) continue; // skip if we already ran it
-				
-				// run for the time before this event
-
-				(*i)->run (usedframes, doframes);
-					
-				// process event
-				if (evt->Instance == -1 || evt->Instance == m || 
-				    (evt->Instance == -3 && (_selected_loop == m || _selected_loop == -1))) {
-					(*i)->do_event (evt);
-				}
-			}
-
-			usedframes += doframes;
-
 			// event is committed, if it is a control event, push it onto the nonrt update queue
 			if (evt->Type == Event::type_control_change || evt->Type == Event::type_global_control_change) {
 				do_push_control_event (_nonrt_update_event_queue, 
@@ -909,49 +1115,135 @@ Engine::process (nframes_t nframes)
 		_midi_event_queue->increment_read_ptr (midivec.len[0] + midivec.len[1]);
 
 
-		m = 0;
-		syncm = -1;
+	}
 
-		if ((int)_sync_source > 0 && (int)_sync_source <= (int) _rt_instances.size()) {
-			// we need to run the sync source loop first
-			syncm = (int) _sync_source - 1;
-			_rt_instances[syncm]->run (usedframes, nframes - usedframes);
-		}
-		
-		
-		// run the rest of the frames
-		for (Instances::iterator i = _rt_instances.begin(); i != _rt_instances.end(); ++i ,++m) {
-			if (syncm == m) continue;
+	// run the rest of the frames
+	run_instances_to_end (nframes, syncm);
 
-			(*i)->run (usedframes, nframes - usedframes);
-		}
+	for (Instances::iterator i = _rt_instances.begin(); i != _rt_instances.end(); ++i) {
+		(*i)->end_cpu_cycle();
+	}
+
+	stamp = get_cycles();
+
+	// scales output and mixes common dry
+	fill_common_outs (nframes);
 
+	now = get_cycles();
+	_mix_stats.add (now - stamp);
+	_process_stats.add (now - started);
+
+	_stats_frames += nframes;
+	if (_stats_frames >= _stats_window) {
+		publish_stats ();
 	}
-	else {
-		// no events
 
-		int m = 0;
-		int syncm = -1;
-		
-		if ((int)_sync_source > 0 && (int) _sync_source <= (int)_rt_instances.size()) {
-			// we need to run the sync source loop first
-			syncm = (int) _sync_source - 1;
-			_rt_instances[syncm]->run (0, nframes);
-		}
+	_running_frames += nframes;
+	
+	return 0;
+}
+
+void
+Engine::set_stats_range (nframes_t nframes)
+{
+	double period = 1e6 * nframes / _driver->get_samplerate();
+
+	// the histograms go to two periods, far enough to see an xrun coming
+	_process_stats.set_range (2.0 * period);
+	_manage_stats.set_range (2.0 * period);
+	_sync_stats.set_range (2.0 * period);
+	_mix_stats.set_range (2.0 * period);
+
+	_stats_window = _driver->get_samplerate() / 2;
+}
+
+// audio thread
+void
+Engine::publish_stats ()
+{
+	_process_stats.publish ();
+	_manage_stats.publish ();
+	_sync_stats.publish ();
+	_mix_stats.publish ();
+
+	for (Instances::iterator i = _rt_instances.begin(); i != _rt_instances.end(); ++i) {
+		(*i)->publish_cpu_stats();
+	}
+
+	_stats_frames = 0;
+}
+
+// runs loop m on to frame of this period, but the sync source loop
+// syncm (if not -1) up to there first since m may be following it.
+// m is run even when it is already there, so that the event before
+// gets in ahead of the next one
+void
+Engine::run_instance_to (int m, nframes_t frame, int syncm)
+{
+	if (syncm >= 0 && syncm != m && _rt_used_frames[syncm] < frame) {
+		_rt_instances[syncm]->run (_rt_used_frames[syncm], frame - _rt_used_frames[syncm]);
+		_rt_used_frames[syncm] = frame;
+	}
+
+	_rt_instances[m]->run (_rt_used_frames[m], frame - _rt_used_frames[m]);
+	_rt_used_frames[m] = frame;
+}
+
+// runs every loop from where it got to until the end of the period, the
+// sync source loop first and then the others spread over the workers
+void
+Engine::run_instances_to_end (nframes_t nframes, int syncm)
+{
+	size_t outs = _common_outputs.size();
+	unsigned int workers;
 
-		for (Instances::iterator i = _rt_instances.begin(); i != _rt_instances.end(); ++i, ++m) {
+	if (syncm >= 0) {
+		_rt_instances[syncm]->run (_rt_used_frames[syncm], nframes - _rt_used_frames[syncm]);
+	}
+
+	// not worth waking anyone for a single loop
+	if (!_worker_pool || _rt_instances.size() < (syncm >= 0 ? 3 : 2)) {
+		for (int m = 0; m < (int) _rt_instances.size(); ++m) {
 			if (syncm == m) continue;
-			(*i)->run (0, nframes);
+
+			_rt_instances[m]->run (_rt_used_frames[m], nframes - _rt_used_frames[m]);
 		}
+		return;
+	}
+
+	workers = _worker_pool->thread_count();
 
+	for (size_t n = 0; n < workers * outs; ++n) {
+		memset (_worker_output_buffers[n], 0, nframes * sizeof(sample_t));
 	}
 
-	// scales output and mixes common dry
-	fill_common_outs (nframes);
+	_worker_nframes = nframes;
+	_worker_syncm = syncm;
+	_worker_pool->run (&Engine::run_instance_job, this, _rt_instances.size());
 
-	_running_frames += nframes;
-	
-	return 0;
+	// add up what the workers mixed into the common outputs
+	for (size_t i = 0; i < outs; ++i) {
+		sample_t * outbuf = get_common_output_buffer (i);
+
+		for (unsigned int w = 1; w <= workers; ++w) {
+			sample_t * wbuf = get_common_output_buffer (i, w);
+
+			for (nframes_t pos = 0; pos < nframes; ++pos) {
+				outbuf[pos] += wbuf[pos];
+			}
+		}
+	}
+}
+
+void
+Engine::run_instance_job (void * arg, unsigned int index, unsigned int worker)
+{
+	Engine * engine = (Engine *) arg;
+	nframes_t used = engine->_rt_used_frames[index];
+
+	if ((int) index != engine->_worker_syncm) {
+		engine->_rt_instances[index]->run (used, engine->_worker_nframes - used, worker);
+	}
 }
 
 void
@@ -1281,63 +1573,47 @@ Engine::push_midi_command_event (Event::type_t type, Event::command_t cmd, int8_
 
 
 bool
-Engine::do_push_command_event (RingBuffer<Event> * evqueue, Event::type_t type, Event::command_t cmd, int8_t instance, long framepos)
+Engine::do_push_command_event (MPSCRingBuffer<Event> * evqueue, Event::type_t type, Event::command_t cmd, int8_t instance, long framepos)
 {
     if (!is_ok()) return false;
     
-    // todo support more than one simulataneous pusher safely
-	RingBuffer<Event>::rw_vector vec;
+	Event evt = get_event_generator().createEvent(framepos);
 
-	evqueue->get_write_vector (&vec);
+	evt.Type = type;
+	evt.Command = cmd;
+	evt.Instance = instance;
 
-	if (vec.len[0] == 0) {
+	if (!evqueue->push (evt)) {
 #ifdef DEBUG
 		cerr << "cmd event queue full, dropping event" << endl;
 #endif
 		return false;
 	}
-	
-	Event * evt = vec.buf[0];
-	*evt = get_event_generator().createEvent(framepos);
-
-	evt->Type = type;
-	evt->Command = cmd;
-	evt->Instance = instance;
-
-	evqueue->increment_write_ptr (1);
 
 	return true;
 }
 
 
 bool
-Engine::do_push_control_event (RingBuffer<Event> * evqueue, Event::type_t type, Event::control_t ctrl, float val, int8_t instance, long framepos, int src)
+Engine::do_push_control_event (MPSCRingBuffer<Event> * evqueue, Event::type_t type, Event::control_t ctrl, float val, int8_t instance, long framepos, int src)
 {
-	// todo support more than one simulataneous pusher safely
     if (!is_ok()) return false;
 
-	RingBuffer<Event>::rw_vector vec;
+	Event evt = get_event_generator().createEvent(framepos);
 
-	evqueue->get_write_vector (&vec);
+	evt.Type = type;
+	evt.Control = ctrl;
+	evt.Value = val;
+	evt.Instance = instance;
+	evt.source = src;
 
-	if (vec.len[0] == 0) {
+	if (!evqueue->push (evt)) {
 #ifdef DEBUG
 		cerr << "ctrl event queue full, dropping event" << endl;
 #endif
 		return false;
 	}
 	
-	Event * evt = vec.buf[0];
-	*evt = get_event_generator().createEvent(framepos);
-
-	evt->Type = type;
-	evt->Control = ctrl;
-	evt->Value = val;
-	evt->Instance = instance;
-	evt->source = src;
-
-	evqueue->increment_write_ptr (1);
-	
 	return true;
 }
 
@@ -1379,38 +1655,30 @@ Engine::push_sync_event (Event::control_t ctrl, long framepos, MIDI::timestamp_t
 {
     if (!is_ok()) return;
 
-	// todo support more than one simulataneous pusher safely
-
 	if (_sync_source != MidiClockSync 
 	    && (!_use_sync_stop || ctrl != Event::MidiStop)
 	    && (!_use_sync_start || ctrl != Event::MidiStart)) {
 		return;
 	}
 	
-	RingBuffer<Event>::rw_vector vec;
-
-	_sync_queue->get_write_vector (&vec);
+	Event evt;
 
-	if (vec.len[0] == 0) {
-#ifdef DEBUG
-		cerr << "sync event queue full, dropping event" << endl;
-#endif
-		return;
-	}
-	
-	Event * evt = vec.buf[0];
 	if (timestamp == 0) {
 		//fprintf(stderr, "creating sync event at frame %ld\n", framepos);
-		*evt = get_event_generator().createEvent(framepos);
+		evt = get_event_generator().createEvent(framepos);
 	} else {
 		//fprintf(stderr, "creating sync event at time %.14g\n", timestamp);
-		*evt = get_event_generator().createTimestampedEvent(timestamp);
+		evt = get_event_generator().createTimestampedEvent(timestamp);
 	}
 
-	evt->Type = Event::type_sync;
-	evt->Control = ctrl;
+	evt.Type = Event::type_sync;
+	evt.Control = ctrl;
 
-	_sync_queue->increment_write_ptr (1);
+	if (!_sync_queue->push (evt)) {
+#ifdef DEBUG
+		cerr << "sync event queue full, dropping event" << endl;
+#endif
+	}
 	
 	return;
 }
@@ -1548,6 +1816,38 @@ Engine::get_control_value (Event::control_t ctrl, int8_t instance)
 		else if (ctrl == Event::GlobalCyclePos) {
 			return _tempo_counter / _driver->get_samplerate();
 		}
+		else if (ctrl == Event::DspLoad) {
+			// of the time one period lasts
+			return _process_stats.mean_usecs() * _driver->get_samplerate() / (1e6 * _buffersize);
+		}
+		else if (ctrl == Event::MaxCycleTime) {
+			return _process_stats.max_usecs();
+		}
+		else if (ctrl == Event::P99CycleTime) {
+			return _process_stats.p99_usecs();
+		}
+		else if (ctrl == Event::LoopManageTime) {
+			return _manage_stats.mean_usecs();
+		}
+		else if (ctrl == Event::SyncTime) {
+			return _sync_stats.mean_usecs();
+		}
+		else if (ctrl == Event::MixTime) {
+			return _mix_stats.mean_usecs();
+		}
+		else if (ctrl == Event::DroppedEvents) {
+			// commands and controls that found their queue full
+			return (float) (_event_queue->dropped_count() + _midi_event_queue->dropped_count());
+		}
+		else if (ctrl == Event::DroppedSyncEvents) {
+			return (float) _sync_queue->dropped_count();
+		}
+		else if (ctrl == Event::EventPoolMisses) {
+			return (float) EventNonRT::pool_misses();
+		}
+		else if (ctrl == Event::EventPoolPeak) {
+			return (float) EventNonRT::pool_peak();
+		}
 
 	}
 
@@ -1590,6 +1890,10 @@ Engine::push_nonrt_event (EventNonRT * event)
         }
         else {
                 //cerr << "UGH, couldn't push event, no writespace" << endl;
+                // it holds a pool slot, but only the main loop may give
+                // that back
+                LockMonitor mon(_rejected_nonrt_lock,  __LINE__, __FILE__);
+                _rejected_nonrt_events.push_back (event);
                 return false;
         }
 }
@@ -1656,6 +1960,14 @@ Engine::mainloop()
 			{
 				handle_load_session_event();
 			}
+			else if (lmevt->etype == LoopManageEvent::ReleaseStretchers)
+			{
+				Looper::destroy_stretchers (lmevt->stretchers);
+			}
+			else if (lmevt->etype == LoopManageEvent::ReleaseStretchCache)
+			{
+				StretchRenderer::destroy (lmevt->cache);
+			}
 			
 			_loop_manage_to_main_queue->increment_read_ptr(1);
 		}
@@ -1667,10 +1979,22 @@ Engine::mainloop()
 			delete event;
 		}
 
+		// and get rid of the ones there was no room for
+		{
+			vector<EventNonRT *> rejected;
+			{
+				LockMonitor mon(_rejected_nonrt_lock,  __LINE__, __FILE__);
+				rejected.swap (_rejected_nonrt_events);
+			}
+			for (vector<EventNonRT *>::iterator i = rejected.begin(); i != rejected.end(); ++i) {
+				delete *i;
+			}
+		}
+
 		// now pull off special update events
 		while (is_ok() && _nonrt_update_event_queue->read_space() > 0)
 		{
-			RingBuffer<Event>::rw_vector vec;
+			MPSCRingBuffer<Event>::rw_vector vec;
 			_nonrt_update_event_queue->get_read_vector(&vec);
 			evt = vec.buf[0];
 
@@ -1771,6 +2095,47 @@ Engine::mainloop()
 			_received_done = false;
 		}
 
+		if (!_driver_services_loops) {
+			// keep some loop memory ready for the loopers to record into
+			sl_maintain_memory();
+
+			// make the stretchers loops have asked for, outside the audio thread
+			for (unsigned int n=0; n < _instances.size(); ++n) {
+				if (_instances[n]->wants_stretchers()) {
+					LoopManageEvent lmev (LoopManageEvent::AttachStretchers, _instances[n], _instances[n]->create_stretchers());
+					if (push_loop_manage_to_rt (lmev)) {
+						_instances[n]->clear_stretchers_wanted();
+					}
+					else {
+						// try again next time around
+						Looper::destroy_stretchers (lmev.stretchers);
+					}
+				}
+
+				if (_instances[n]->wants_stretch_cache() && _stretch_renderer) {
+					_instances[n]->clear_stretch_cache_wanted();
+					_instances[n]->request_stretch_cache (_stretch_renderer);
+				}
+			}
+
+			// and send them the stretch caches that are done rendering
+			while (_stretch_renderer) {
+				StretchCache * cache = _unsent_stretch_cache;
+
+				if (!cache && (cache = _stretch_renderer->take_finished()) == 0) {
+					break;
+				}
+
+				LoopManageEvent lmev (LoopManageEvent::AttachStretchCache, (Looper *) cache->owner, cache);
+				if (!push_loop_manage_to_rt (lmev)) {
+					// try again next time around
+					_unsent_stretch_cache = cache;
+					break;
+				}
+				_unsent_stretch_cache = 0;
+			}
+		}
+
 		gettimeofday(&now, NULL);
 
 		// if now is >= then the last timeout target, we should update
@@ -1898,6 +2263,10 @@ Engine::process_nonrt_event (EventNonRT * event)
 		else if (gg_event->param == "eighth_per_cycle") {
 			gg_event->ret_value = _eighth_cycle;
 		}
+		else if (cmdmap.is_global_control (gg_event->param)) {
+			// the read only ones, like dsp_load
+			gg_event->ret_value = get_control_value (cmdmap.to_control_t (gg_event->param), -2);
+		}
 		
 		_osc->finish_global_get_event (*gg_event);
 	}
@@ -2140,6 +2509,7 @@ Engine::process_nonrt_event (EventNonRT * event)
 void Engine::update_sync_source ()
 {
 	sample_t * sync_buf = _internal_sync_buf;
+	SyncEventList * sync_events = &_sync_events;
 
 	// if sync_source > 0, then get the source from instance
 	if (_sync_source == JackSync) {
@@ -2156,12 +2526,13 @@ void Engine::update_sync_source ()
 	}
 	else if (_sync_source > 0 && (int)_sync_source <= (int) _instances.size()) {
 		sync_buf = _instances[(int)_sync_source - 1]->get_sync_out_buf();
+		sync_events = 0;
 		// cerr << "using sync from " << _sync_source -1 << endl;
 	}
 	
 	for (Instances::iterator i = _instances.begin(); i != _instances.end(); ++i)
 	{
-		(*i)->use_sync_buf (sync_buf);
+		(*i)->use_sync_buf (sync_buf, sync_events);
 	}
 
 	_quarter_counter = 0;
@@ -2357,6 +2728,42 @@ Engine::calculate_midi_tick (bool rt)
 }
 
 
+// forgets the sync events from frame from on, the buffer is rewritten
+// there.  valid is false when every frame from there on is a sync point
+void
+Engine::reset_sync_events (nframes_t from, bool valid)
+{
+	unsigned long count = _sync_events.count;
+
+	while (count > 0 && _sync_events.events[count-1].frame >= from) {
+		--count;
+	}
+
+	_sync_events.count = count;
+	_sync_events.valid = valid && (from == 0 || _sync_events.valid);
+}
+
+void
+Engine::add_sync_event (nframes_t frame, float value)
+{
+	if (frame >= _sync_events.size) {
+		// outside of the buffer, nobody will look at it
+		return;
+	}
+
+	// out of order or too many, consumers fall back to the buffer
+	if (_sync_events.count == _sync_events.size
+	    || (_sync_events.count > 0 && _sync_events.events[_sync_events.count-1].frame >= frame))
+	{
+		_sync_events.valid = false;
+		return;
+	}
+
+	_sync_events.events[_sync_events.count].frame = frame;
+	_sync_events.events[_sync_events.count].value = value;
+	_sync_events.count++;
+}
+
 int
 Engine::generate_sync (nframes_t offset, nframes_t nframes)
 {
@@ -2382,11 +2789,14 @@ Engine::generate_sync (nframes_t offset, nframes_t nframes)
 			for (nframes_t n=offset; n < nframes; ++n) {
 				_internal_sync_buf[n]  = 1.0;
 			}
+			reset_sync_events (offset, false);
 
 		}
 		else {
 			double curr = _tempo_counter;
 			double qcurr = _quarter_counter;
+
+			reset_sync_events (offset, true);
 			
 			while (npos < nframes) {
 				
@@ -2403,6 +2813,7 @@ Engine::generate_sync (nframes_t offset, nframes_t nframes)
 				
 				if (curr >= _tempo_frames) {
 					// cerr << "tempo hit" << endl;
+					add_sync_event (npos, 2.0f);
 					_internal_sync_buf[npos++] = 2.0f;
 					// reset curr counter
 					curr = ((curr - _tempo_frames) - truncf(curr - _tempo_frames)) + 1.0;
@@ -2416,7 +2827,7 @@ Engine::generate_sync (nframes_t offset, nframes_t nframes)
 	}
 	else if (_sync_source == MidiClockSync) {
 
-		RingBuffer<Event>::rw_vector vec;
+		MPSCRingBuffer<Event>::rw_vector vec;
 		Event *evt;
 
 		// get available events
@@ -2430,6 +2841,7 @@ Engine::generate_sync (nframes_t offset, nframes_t nframes)
 		nframes_t fragpos;
 		MIDI::timestamp_t timestamp = 0;
 
+		reset_sync_events (0, true);
 		
 		if (num > 0) {
 			
@@ -2521,6 +2933,7 @@ Engine::generate_sync (nframes_t offset, nframes_t nframes)
 
 					// mark it high
 					_internal_sync_buf[fragpos] = 2.0f;
+					add_sync_event (fragpos, 2.0f);
 
 					doframes += 1;
 					
@@ -2549,6 +2962,7 @@ Engine::generate_sync (nframes_t offset, nframes_t nframes)
 		for (nframes_t n=offset; n < nframes; ++n) {
 			_internal_sync_buf[n]  = 1.0;
 		}
+		reset_sync_events (offset, false);
 		//memset (_internal_sync_buf, 0, nframes * sizeof(float));
 
 	}
@@ -2557,6 +2971,7 @@ Engine::generate_sync (nframes_t offset, nframes_t nframes)
 		for (nframes_t n=offset; n < nframes; ++n) {
 			_internal_sync_buf[n]  = 0.0;
 		}
+		reset_sync_events (offset, true);
 				
 		TransportInfo info;
 		if (_driver->get_transport_info(info)) {
@@ -2589,6 +3004,7 @@ Engine::generate_sync (nframes_t offset, nframes_t nframes)
 				if ((thisval == 0 || nextval <= thisval) && diff < nframes) {
 					//cerr << "got tempo frame in this cycle: diff: " << diff << endl;
 					_internal_sync_buf[offset + diff]  = 2.0;
+					add_sync_event (offset + diff, 2.0f);
 				}
 			}
 
@@ -2612,6 +3028,7 @@ Engine::generate_sync (nframes_t offset, nframes_t nframes)
 		for (nframes_t n=offset; n < nframes; ++n) {
 			_internal_sync_buf[n]  = 1.0;
 		}
+		reset_sync_events (offset, false);
 
 		if (_rt_instances[_sync_source-1]->get_control_value(Event::State) != LooperStateRecording) {
 			// calc new tempo
@@ -2659,7 +3076,7 @@ Engine::generate_sync (nframes_t offset, nframes_t nframes)
 	// handle (midi) sync start and stop events when enabled, even when syncing to something else
 	if ((_use_sync_stop || _use_sync_start) && _sync_source != MidiClockSync)
 	{
-		RingBuffer<Event>::rw_vector vec;
+		MPSCRingBuffer<Event>::rw_vector vec;
 		Event *evt;
 		// get available events
 		_sync_queue->get_read_vector (&vec);
@@ -27,15 +27,22 @@
 
 #include "lockmonitor.hpp"
 #include "ringbuffer.hpp"
+#include "mpsc_ringbuffer.hpp"
 #include "event.hpp"
 #include "event_nonrt.hpp"
 #include "audio_driver.hpp"
 #include "midi_bind.hpp"
 #include "command_map.hpp"
+#include "plugin.hpp"
+#include "cycle_stats.hpp"
 
 namespace SooperLooper {
 
 class Looper;
+struct LoopStretchers;
+struct StretchCache;
+class StretchRenderer;
+class WorkerPool;
 class ControlOSC;
 class MidiBridge;
 	
@@ -58,6 +65,8 @@ class Engine
 
 	void set_default_loop_secs (float secs) { _def_loop_secs = secs; }
 	void set_default_channels (int chan) { _def_channel_cnt = chan; }
+	// extra threads that run loops in parallel, set before initialize
+	void set_worker_threads (unsigned int count) { _worker_threads = count; }
 	
 	void set_midi_bridge (MidiBridge * bridge);
 	MidiBridge * get_midi_bridge() { return _midi_bridge; }
@@ -82,6 +91,14 @@ class Engine
 	
 	int process (nframes_t);
 
+	// for drivers that run the audio thread faster than realtime.  once
+	// set, before the main loop starts, the main loop leaves the loop
+	// memory and the stretchers to the driver, which calls
+	// service_loops between cycles from its audio thread, so that what
+	// is rendered doesn't depend on the wall clock
+	void set_driver_services_loops (bool yes) { _driver_services_loops = yes; }
+	void service_loops ();
+
 	void buffersize_changed (nframes_t);
 	
 	//RingBuffer<Event> & get_event_queue() { return *_event_queue; }
@@ -89,7 +106,9 @@ class Engine
 	bool get_common_input (unsigned int chan, port_id_t & port);
 	bool get_common_output (unsigned int chan, port_id_t & port);
 	sample_t * get_common_input_buffer (unsigned int chan);
-	sample_t * get_common_output_buffer (unsigned int chan);
+	// each worker thread mixes into its own buffers, which are added
+	// to those of worker 0 once all loops have run
+	sample_t * get_common_output_buffer (unsigned int chan, unsigned int worker = 0);
 
 	size_t  get_common_output_count () { return _common_outputs.size(); }
 	size_t  get_common_input_count () { return _common_outputs.size(); }
@@ -122,6 +141,8 @@ class Engine
 	// the main non-rt event processing loop
 	void mainloop();
 	
+	// takes over event.  if the queue is full it is dropped, and left
+	// for the main loop to delete
 	bool push_nonrt_event (EventNonRT * event);
 	
 	void binding_learned(MidiBindInfo info);
@@ -143,14 +164,22 @@ class Engine
 		enum EventType {
 			AddLoop = 0,
 			RemoveLoop,
-			LoadSession
+			LoadSession,
+			// to rt: give the looper these, to main: delete these
+			AttachStretchers,
+			ReleaseStretchers,
+			AttachStretchCache,
+			ReleaseStretchCache
 		};
 
 		LoopManageEvent () {}
-		LoopManageEvent (EventType et, Looper *loop) : etype(et), looper(loop) {}
+		LoopManageEvent (EventType et, Looper *loop, LoopStretchers * str = 0) : etype(et), looper(loop), stretchers(str), cache(0) {}
+		LoopManageEvent (EventType et, Looper *loop, StretchCache * sc) : etype(et), looper(loop), stretchers(0), cache(sc) {}
 
 		EventType etype;
 		Looper * looper;
+		LoopStretchers * stretchers;
+		StretchCache * cache;
 	};
 	
 
@@ -159,15 +188,20 @@ class Engine
 	
 	// returns >= 0 offset position on tempo beats
 	int generate_sync (nframes_t offset, nframes_t nframes);
+	void reset_sync_events (nframes_t from, bool valid);
+	void add_sync_event (nframes_t frame, float value);
 	
 	void update_sync_source ();
 	void calculate_tempo_frames ();
 	void calculate_midi_tick (bool rt=true);
 
 	void do_global_rt_event (Event * ev, nframes_t offset, nframes_t nframes);
+	void run_instance_to (int m, nframes_t frame, int syncm);
+	void run_instances_to_end (nframes_t nframes, int syncm);
+	static void run_instance_job (void * arg, unsigned int index, unsigned int worker);
 
-	bool do_push_command_event (RingBuffer<Event> * rb, Event::type_t type, Event::command_t cmd, int8_t instance, long framepos=-1);
-	bool do_push_control_event (RingBuffer<Event> * rb, Event::type_t type, Event::control_t ctrl, float val, int8_t instance, long framepos=-1, int src=0);
+	bool do_push_command_event (MPSCRingBuffer<Event> * rb, Event::type_t type, Event::command_t cmd, int8_t instance, long framepos=-1);
+	bool do_push_control_event (MPSCRingBuffer<Event> * rb, Event::type_t type, Event::control_t ctrl, float val, int8_t instance, long framepos=-1, int src=0);
 
 	bool push_loop_manage_to_rt (LoopManageEvent & lme);
 	bool push_loop_manage_to_main (LoopManageEvent & lme);
@@ -178,6 +212,8 @@ class Engine
 	inline void reset_avg_tempo(double tempo=0.0);
 
 	void fill_common_outs(nframes_t nframes);
+	void set_stats_range (nframes_t nframes);
+	void publish_stats ();
 	void prepare_buffers(nframes_t nframes);
 
 	void connections_changed();
@@ -194,6 +230,8 @@ class Engine
 	typedef std::vector<Looper*> Instances;
 	// the rt thread keeps this one
 	Instances _rt_instances;
+	// how far into the period each of those has run, only in process()
+	std::vector<nframes_t> _rt_used_frames;
 
 	// the non-rt keeps this copy
 	Instances _instances;
@@ -211,17 +249,21 @@ class Engine
 	MidiBindInfo  _learninfo;
 	MidiBindingEvent _learn_event;
 	
-	// RT event queue
-	RingBuffer<Event> * _event_queue;
-	RingBuffer<Event> * _midi_event_queue;
-	RingBuffer<Event> * _sync_queue;
-	RingBuffer<Event> * _nonrt_update_event_queue;
+	// RT event queues, pushed to from the osc, midi and gui threads all at once
+	MPSCRingBuffer<Event> * _event_queue;
+	MPSCRingBuffer<Event> * _midi_event_queue;
+	MPSCRingBuffer<Event> * _sync_queue;
+	MPSCRingBuffer<Event> * _nonrt_update_event_queue;
 
 	EventGenerator * _event_generator;
 
 	// non-rt event stuff
 
 	RingBuffer<EventNonRT *> * _nonrt_event_queue;
+
+	// events the queue had no room for, only the main loop deletes them
+	std::vector<EventNonRT *> _rejected_nonrt_events;
+	PBD::NonBlockingLock _rejected_nonrt_lock;
 	
 	PBD::NonBlockingLock _event_loop_lock;
 	pthread_cond_t  _event_cond;
@@ -242,6 +284,8 @@ class Engine
 	};
 
 	float  *       _internal_sync_buf;
+	// the non zero samples of _internal_sync_buf
+	SyncEventList  _sync_events;
 	int _sync_source;
 
 	volatile double    _tempo;        // bpm
@@ -261,6 +305,27 @@ class Engine
 	std::vector<sample_t *>    _temp_input_buffers;              
 	std::vector<sample_t *>    _temp_output_buffers;              
 	bool                    _use_temp_input;
+
+	WorkerPool *               _worker_pool;
+	// renders the stretch caches loops ask for, and one that could
+	// not be sent to the audio thread yet
+	StretchRenderer *          _stretch_renderer;
+	StretchCache *             _unsent_stretch_cache;
+	bool                       _driver_services_loops;
+	unsigned int               _worker_threads;
+	// the common outputs of worker n start at (n-1) * outputs
+	std::vector<sample_t *>    _worker_output_buffers;
+	nframes_t                  _worker_nframes;
+	int                        _worker_syncm;
+
+	// what process and its parts cost, summed up every _stats_window
+	// frames for the dsp load controls
+	CycleStats                 _process_stats;
+	CycleStats                 _manage_stats;
+	CycleStats                 _sync_stats;
+	CycleStats                 _mix_stats;
+	nframes_t                  _stats_frames;
+	nframes_t                  _stats_window;
 	
 	float              _curr_common_dry;
 	float              _target_common_dry;
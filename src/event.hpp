@@ -222,7 +222,20 @@ namespace SooperLooper {
 		    SendMidiStartOnTrigger,
 		    DiscretePreFader,
 		    GlobalCycleLen,
-		    GlobalCyclePos
+		    GlobalCyclePos,
+		    RateInterpolation,
+		    DspLoad,
+		    MaxCycleTime,
+		    P99CycleTime,
+		    LoopManageTime,
+		    SyncTime,
+		    MixTime,
+		    LoopCpuTime,
+		    LoopMaxCpuTime,
+		    DroppedEvents,
+		    DroppedSyncEvents,
+		    EventPoolMisses,
+		    EventPoolPeak
 	    } Control;
 	    
 	    int8_t  Instance;
@@ -0,0 +1,92 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#include <new>
+
+#include <pbd/pool.h>
+
+#include "event_nonrt.hpp"
+
+using namespace SooperLooper;
+
+// every EventNonRT fits in a slot, anything bigger would just use the heap
+#define EVENT_SLOT_SIZE 256
+// as many as the queue to the main loop holds
+#define EVENT_POOL_SIZE 1023
+
+static volatile unsigned long events_out = 0;
+static volatile unsigned long events_peak = 0;
+static volatile unsigned long events_missed = 0;
+
+static MultiAllocSingleReleasePool &
+event_pool ()
+{
+	// never destroyed, so events deleted late in shutdown still find it
+	static MultiAllocSingleReleasePool * pool = new MultiAllocSingleReleasePool ("nonrt events", EVENT_SLOT_SIZE, EVENT_POOL_SIZE);
+	return *pool;
+}
+
+void *
+EventNonRT::operator new (size_t size)
+{
+	void * ptr;
+
+	if (size <= EVENT_SLOT_SIZE) {
+		if ((ptr = event_pool().try_alloc ()) != 0) {
+			unsigned long out = __sync_add_and_fetch (&events_out, 1);
+			unsigned long peak;
+
+			while (out > (peak = events_peak) && !__sync_bool_compare_and_swap (&events_peak, peak, out)) {
+			}
+			return ptr;
+		}
+
+		__sync_fetch_and_add (&events_missed, 1);
+	}
+
+	return ::operator new (size);
+}
+
+void
+EventNonRT::operator delete (void * ptr)
+{
+	if (!ptr) {
+		return;
+	}
+
+	if (event_pool().owns (ptr)) {
+		event_pool().release (ptr);
+		__sync_fetch_and_sub (&events_out, 1);
+	}
+	else {
+		::operator delete (ptr);
+	}
+}
+
+unsigned long
+EventNonRT::pool_misses ()
+{
+	return events_missed;
+}
+
+unsigned long
+EventNonRT::pool_peak ()
+{
+	return events_peak;
+}
@@ -22,6 +22,7 @@
 #define __sooperlooper_event_nonrt__
 
 #include <stdint.h>
+#include <cstddef>
 #include <string>
 
 #include "event.hpp"
@@ -31,6 +32,17 @@ namespace SooperLooper {
 	class EventNonRT {
 	public:
 		virtual ~EventNonRT() {}
+
+		// events come out of a pool instead of the heap.  any thread
+		// may make one, but only the main loop that handles them may
+		// delete them
+		static void * operator new (size_t size);
+		static void operator delete (void * ptr);
+
+		// events the pool had no room for since startup, and the most
+		// that were out of it at once
+		static unsigned long pool_misses ();
+		static unsigned long pool_peak ();
 	protected:
 		EventNonRT() {};
 		
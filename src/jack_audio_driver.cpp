@@ -386,6 +386,20 @@ JackAudioDriver::set_timebase_master(bool flag)
 	return ret;
 }
 
+int
+JackAudioDriver::get_realtime_priority ()
+{
+	int prio;
+
+	if (!_jack || !jack_is_realtime (_jack)) {
+		return 0;
+	}
+
+	prio = jack_client_real_time_priority (_jack);
+
+	return prio > 0 ? prio : 0;
+}
+
 bool
 JackAudioDriver::get_transport_info (TransportInfo &info)
 {
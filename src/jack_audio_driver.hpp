@@ -65,6 +65,8 @@ class JackAudioDriver
 	bool get_timebase_master() { return _timebase_master; }
 
 	void reposition_transport(nframes_t framepos);
+
+	int get_realtime_priority();
 	
   protected:
 
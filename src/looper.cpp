@@ -45,6 +45,7 @@
 #include "utils.hpp"
 #include "panner.hpp"
 #include "command_map.hpp"
+#include "stretch_cache.hpp"
 
 
 
@@ -62,6 +63,22 @@ static const double MinResamplingRate = 0.25f;
 static const double MaxResamplingRate = 8.0f;
 static const int SrcAudioQuality = SRC_LINEAR;
 
+float Looper::_stretch_idle_secs = 30.0f;
+
+// scales buf by a gain ramping from one value to another, for the audio
+// we play past the plugin, which would have applied the wet level itself
+static inline void
+apply_gain_ramp (sample_t * buf, nframes_t nframes, float from, float to)
+{
+	float delta = flush_to_zero (to - from) / max((nframes_t) 1, (nframes - 1));
+	float gain = from;
+
+	for (nframes_t n=0; n < nframes; ++n) {
+		gain += delta;
+		buf[n] *= gain;
+	}
+}
+
 
 Looper::Looper (AudioDriver * driver, unsigned int index, unsigned int chan_count, float loopsecs, bool discrete)
 	: _driver (driver), _index(index), _chan_count(chan_count), _loopsecs(loopsecs)
@@ -94,19 +111,19 @@ Looper::initialize (unsigned int index, unsigned int chan_count, float loopsecs,
 	_chan_count = chan_count;
 	
 	_ok = false;
-	requested_cmd = -1;
-	last_requested_cmd = -1;
-	request_pending = false;
+	_cmd_queue_head = 0;
+	_cmd_queue_count = 0;
 	_input_ports = 0;
 	_output_ports = 0;
-	_instances = 0;
+	_instance = 0;
 	_buffersize = 0;
 	_use_sync_buf = 0;
+	_use_sync_events = 0;
 	_our_syncin_buf = 0;
 	_our_syncout_buf = 0;
-	_dummy_buf = 0;
 	_tmp_io_bufs = 0;
 	_running_frames = 0;
+	_cpu_cycles = 0;
 	_use_common_ins = true;
 	_use_common_outs = true;
 	_auto_latency = true;  // default for now
@@ -131,6 +148,22 @@ Looper::initialize (unsigned int index, unsigned int chan_count, float loopsecs,
 	_stretch_ratio = 1.0;
 	_pitch_shift = 0.0;
 	_stretch_buffer = 0;
+	_stretchers = 0;
+	_want_stretchers = false;
+	_stretchers_waiting = false;
+	_stretch_idle_frames = 0;
+	_stretch_cache = 0;
+	_want_stretch_cache = false;
+	_static_key = 0;
+	_cache_asked_key = 0;
+	_cache_asked_ratio = 1.0;
+	_cache_asked_pitch = 0.0;
+	_playing_cache = false;
+	_cache_pos = 0;
+	_cache_src_frames = 0.0;
+	_direct_wet = 1.0f;
+	_rate_interp = LoopInterpCubic;
+	_native_rate = false;
 	_tempo_stretch = false;
 	_pending_stretch = false;
 	_pending_stretch_ratio = 0.0;
@@ -141,7 +174,6 @@ Looper::initialize (unsigned int index, unsigned int chan_count, float loopsecs,
 	}
 
 
-	_instances = new LADSPA_Handle[_chan_count];
 	_input_ports = new port_id_t[_chan_count];
 	_output_ports = new port_id_t[_chan_count];
 	
@@ -169,14 +201,6 @@ Looper::initialize (unsigned int index, unsigned int chan_count, float loopsecs,
 
 	nframes_t srate = _driver->get_samplerate();
 	
-	// rubberband stretch stuff
-	_in_stretcher = new RubberBandStretcher(srate, _chan_count, 
-					     RubberBandStretcher::OptionProcessRealTime | RubberBandStretcher::OptionTransientsCrisp);
-	_out_stretcher = new RubberBandStretcher(srate, _chan_count, 
-					     RubberBandStretcher::OptionProcessRealTime | RubberBandStretcher::OptionTransientsCrisp);
-
-	
-	memset (_instances, 0, sizeof(LADSPA_Handle) * _chan_count);
 	memset (_input_ports, 0, sizeof(port_id_t) * _chan_count);
 	memset (_output_ports, 0, sizeof(port_id_t) * _chan_count);
 	memset (ports, 0, sizeof(float) * LASTPORT);
@@ -216,24 +240,29 @@ Looper::initialize (unsigned int index, unsigned int chan_count, float loopsecs,
 	
 	ports[RoundIntegerTempo] = 0;
 
-	_slave_sync_port = (_relative_sync && ports[Sync]) ? 2.0f : 1.0f;
-
 	// TODO: fix hack to specify loop length
 	char looptimestr[20];
 	snprintf(looptimestr, sizeof(looptimestr), "%f", loopsecs);
 	setenv("SL_SAMPLE_TIME", looptimestr, 1);
 
+	// one state machine for all channels
+	if ((_instance = sl_instantiate (descriptor, srate, _chan_count)) == 0) {
+		return false;
+	}
+
+	sl_set_loop_index(_instance, (int)_index, 0);
+
+	/* connect all scalar ports to data values */
+	for (unsigned long n = 0; n < LASTPORT; ++n) {
+		descriptor->connect_port (_instance, n, &ports[n]);
+	}
+
+	descriptor->activate (_instance);
 	
 	for (unsigned int i=0; i < _chan_count; ++i)
 	{
 		_tmp_io_bufs[i] = new float[_buffersize];
 
-		if ((_instances[i] = descriptor->instantiate (descriptor, srate)) == 0) {
-			return false;
-		}
-
-		sl_set_loop_index(_instances[i], (int)_index, i);
-		
 		if (_have_discrete_io) 
 		{
 			snprintf(tmpstr, sizeof(tmpstr), "loop%d_in_%d", _index, i+1);
@@ -253,28 +282,6 @@ Looper::initialize (unsigned int index, unsigned int chan_count, float loopsecs,
 			}
 		}
 
-		/* connect all scalar ports to data values */
-		
-		for (unsigned long n = 0; n < LASTPORT; ++n) {
-			descriptor->connect_port (_instances[i], n, &ports[n]);
-		}
-
-		// connect dedicated Sync port to all other channels
-		if (i > 0) {
-			descriptor->connect_port (_instances[i], Sync, &_slave_sync_port);
-
-			descriptor->connect_port (_instances[i], State, &_slave_dummy_port);
-			descriptor->connect_port (_instances[i], LoopLength, &_slave_dummy_port);
-			descriptor->connect_port (_instances[i], LoopPosition, &_slave_dummy_port);
-			descriptor->connect_port (_instances[i], CycleLength, &_slave_dummy_port);
-			descriptor->connect_port (_instances[i], LoopFreeMemory, &_slave_dummy_port);
-			descriptor->connect_port (_instances[i], LoopMemory, &_slave_dummy_port);
-			descriptor->connect_port (_instances[i], Waiting, &_slave_dummy_port);
-			descriptor->connect_port (_instances[i], TrueRate, &_slave_dummy_port);
-		}
-		
-		descriptor->activate (_instances[i]);
-
 		_lp_filter[i] = new OnePoleFilter(srate);
 		
 		// SRC stuff
@@ -324,18 +331,18 @@ Looper::~Looper ()
 void
 Looper::destroy()
 {
-	for (unsigned int i=0; i < _chan_count; ++i)
-	{
-		if (_instances[i]) {
-			if (descriptor->deactivate) {
-				descriptor->deactivate (_instances[i]);
-			}
-			if (descriptor->cleanup) {
-				descriptor->cleanup (_instances[i]);
-			}
-			_instances[i] = 0;
+	if (_instance) {
+		if (descriptor->deactivate) {
+			descriptor->deactivate (_instance);
+		}
+		if (descriptor->cleanup) {
+			descriptor->cleanup (_instance);
 		}
+		_instance = 0;
+	}
 
+	for (unsigned int i=0; i < _chan_count; ++i)
+	{
 		if (_input_ports[i]) {
 			_driver->destroy_input_port (_input_ports[i]);
 			_input_ports[i] = 0;
@@ -364,7 +371,6 @@ Looper::destroy()
 		}
 	}
 
-	delete [] _instances;
 	delete [] _input_ports;
 	delete [] _output_ports;
 
@@ -374,9 +380,6 @@ Looper::destroy()
 	if (_our_syncout_buf)
 		delete [] _our_syncout_buf;
 	
-	if (_dummy_buf)
-		delete [] _dummy_buf;
-
 	if (_tmp_io_bufs)
 		delete [] _tmp_io_bufs;
 
@@ -401,8 +404,11 @@ Looper::destroy()
 		delete [] _src_in_buffer;
 
 	// rubberband
-	delete _in_stretcher;
-	delete _out_stretcher;
+	destroy_stretchers (_stretchers);
+	_stretchers = 0;
+
+	StretchRenderer::destroy (_stretch_cache);
+	_stretch_cache = 0;
 
 	if (_stretch_buffer) {
 		delete [] _stretch_buffer;
@@ -436,13 +442,15 @@ Looper::set_discrete_outs_prefader (bool val)
 }
 
 void
-Looper::use_sync_buf(sample_t * buf)
+Looper::use_sync_buf(sample_t * buf, const SyncEventList * events)
 {
 	if (buf) {
 		_use_sync_buf = buf;
+		_use_sync_events = events;
 	}
 	else {
 		_use_sync_buf = _our_syncin_buf;
+		_use_sync_events = 0;
 	}
 }
 
@@ -450,20 +458,14 @@ void
 Looper::set_samples_since_sync(nframes_t ssync)
 {
 	// this is a bit of a hack
-	for (unsigned int i=0; i < _chan_count; ++i)
-	{
-		sl_set_samples_since_sync(_instances[i], ssync);
-	}
+	sl_set_samples_since_sync(_instance, ssync);
 }
 
 void 
 Looper::set_replace_quantized(bool flag)
 {
 	// this is a bit of a hack
-	for (unsigned int i=0; i < _chan_count; ++i)
-	{
-		sl_set_replace_quantized(_instances[i], flag);
-	}
+	sl_set_replace_quantized(_instance, flag);
 }
 
 void 
@@ -539,11 +541,8 @@ Looper::finish_state()
 	if (ev.Command != Event::UNKNOWN) {
 		do_event(&ev);
 		/*
-		for (unsigned int i=0; i < _chan_count; ++i)
-		{
-			// run it for 0 frames just to change state
-			descriptor->run (_instances[i], 0);
-		}
+		// run it for 0 frames just to change state
+		descriptor->run (_instance, 0);
 		*/
 		return true;
 	}
@@ -557,6 +556,8 @@ Looper::set_buffer_size (nframes_t bufsize)
 		//cerr << "setting buffer size to " << bufsize << endl;
 		_buffersize = bufsize;
 
+		_cpu_stats.set_range (2e6 * _buffersize / _driver->get_samplerate());
+
 		if (_use_sync_buf == _our_syncin_buf) {
 			_use_sync_buf = 0;
 		}
@@ -568,9 +569,6 @@ Looper::set_buffer_size (nframes_t bufsize)
 		if (_our_syncout_buf)
 			delete [] _our_syncout_buf;
 
-		if (_dummy_buf)
-			delete [] _dummy_buf;
-	
 		for (size_t i=0; i < _chan_count; ++i) {
 			if (_tmp_io_bufs[i]) {
 				delete [] _tmp_io_bufs[i];
@@ -581,8 +579,6 @@ Looper::set_buffer_size (nframes_t bufsize)
 		
 		_our_syncin_buf = new float[_buffersize];
 		_our_syncout_buf = new float[_buffersize];
-		// big enough for use with resampling too
-		_dummy_buf = new float[(nframes_t) ceil (_buffersize * MaxResamplingRate)];
 		
 		if (_use_sync_buf == 0) {
 			_use_sync_buf = _our_syncin_buf;
@@ -595,7 +591,8 @@ Looper::set_buffer_size (nframes_t bufsize)
 			delete [] _src_in_buffer;
 		_src_buffer_len = (nframes_t) ceil (_buffersize * MaxResamplingRate);
 		_src_sync_buffer = new float[_src_buffer_len];
-		_src_in_buffer = new float[_src_buffer_len];
+		// one planar segment of _src_buffer_len per channel
+		_src_in_buffer = new float[_src_buffer_len * _chan_count];
 
 		_stretch_buffer = new float[_src_buffer_len * _chan_count];
 
@@ -656,9 +653,9 @@ Looper::recompute_latencies()
 	}
 
 	// add any latency due to timestretch
-	if (_stretch_ratio != 1.0) {
-		//ports[OutputLatency] += _out_stretcher->getLatency();
-		ports[SyncOffsetSamples] = _out_stretcher->getLatency();
+	if (_stretch_ratio != 1.0 && _stretchers) {
+		//ports[OutputLatency] += _stretchers->out->getLatency();
+		ports[SyncOffsetSamples] = _stretchers->out->getLatency();
 	}
 		
 
@@ -668,7 +665,7 @@ Looper::recompute_latencies()
 
 bool Looper::has_loop() const
 {
-	return (_instances && _instances[0] && sl_has_loop(_instances[0]));
+	return (_instance && sl_has_loop(_instance));
 }
 
 float
@@ -699,7 +696,7 @@ Looper::get_control_value (Event::control_t ctrl)
 		return _curr_input_gain;
 	}
 	else if (ctrl == Event::ReplaceQuantized) {
-		return sl_get_replace_quantized(_instances[0]) ? 1.0f : 0.0f;
+		return sl_get_replace_quantized(_instance) ? 1.0f : 0.0f;
 	}
 	else if (ctrl == Event::RelativeSync) {
 		return _relative_sync;
@@ -731,6 +728,15 @@ Looper::get_control_value (Event::control_t ctrl)
 	else if (ctrl == Event::TempoStretch) {
 		return _tempo_stretch ? 1.0f: 0.0f;
 	}
+	else if (ctrl == Event::RateInterpolation) {
+		return (float) _rate_interp;
+	}
+	else if (ctrl == Event::LoopCpuTime) {
+		return _cpu_stats.mean_usecs();
+	}
+	else if (ctrl == Event::LoopMaxCpuTime) {
+		return _cpu_stats.max_usecs();
+	}
 	// i wish i could do something better for this
 	else if (ctrl == Event::PanChannel1) {
 		if (_panner && _panner->size() > 0) {
@@ -819,8 +825,7 @@ Looper::do_event (Event *ev)
 {
 	if (ev->Type == Event::type_cmd_hit) {
 		Event::command_t cmd = ev->Command;
-		requested_cmd = cmd;
-		request_pending = true;
+		int requested_cmd = cmd;
 		//fprintf(stderr, "Got HIT cmd: %d\n", cmd);
 
 		// a few special commands have double-tap logic
@@ -832,13 +837,14 @@ Looper::do_event (Event *ev)
 			}
 			_down_stamps[cmd] = _running_frames;
 		}
+
+		queue_command (requested_cmd);
 	}
 	else if (ev->Type == Event::type_cmd_down)
 	{
 		Event::command_t cmd = ev->Command;
 		if ((int) cmd >= 0 && (int) cmd < (int) Event::LAST_COMMAND) {
-			requested_cmd = cmd;
-			request_pending = true;
+			int requested_cmd = cmd;
 
 			// fprintf(stderr, "Got DOWN cmd: %d\n", cmd);
 
@@ -852,6 +858,8 @@ Looper::do_event (Event *ev)
 			}
 			
 			_down_stamps[cmd] = _running_frames;
+
+			queue_command (requested_cmd);
 		}
 	}
 	else if (ev->Type == Event::type_cmd_up || ev->Type == Event::type_cmd_upforce)
@@ -880,15 +888,13 @@ Looper::do_event (Event *ev)
 
 					//cerr << "force up" << endl;
 
-					requested_cmd = cmd;
-					request_pending = true;
+					queue_command (cmd);
 
 				}
 				else if (_down_stamps[cmd] > 0 && _running_frames > (_down_stamps[cmd] + _longpress_frames))
 				{
 					//cerr << "long up" << endl;
-					requested_cmd = cmd;
-					request_pending = true;
+					int requested_cmd = cmd;
 
 					// long press undo and redo become their -all versions
 					if (cmd == Event::UNDO) {
@@ -901,9 +907,11 @@ Looper::do_event (Event *ev)
 						// longpress of this turns into undo all for one-button goodness
 						requested_cmd = Event::UNDO_ALL;
 					}
+
+					queue_command (requested_cmd);
 				}
 			}
-			//fprintf(stderr, "Got UP cmd: %d  req: %d\n", cmd, requested_cmd);
+			//fprintf(stderr, "Got UP cmd: %d\n", cmd);
 
 
 			_down_stamps[cmd] = 0;
@@ -1005,12 +1013,18 @@ Looper::do_event (Event *ev)
 		}
 		else if (ev->Control == Event::PitchShift) {
 			_pitch_shift = ev->Value; // in semitones
-			_out_stretcher->setPitchScale(pow(2.0, _pitch_shift / 12.0));
+			if (_stretchers) {
+				_stretchers->out->setPitchScale(pow(2.0, _pitch_shift / 12.0));
+			}
 		}
 		else if (ev->Control == Event::StretchRatio) {
 			_pending_stretch_ratio = min(4.0, max(0.25, (double) ev->Value)); 
 			_pending_stretch = true;
 		}
+		else if (ev->Control == Event::RateInterpolation) {
+			// linear, cubic or windowed sinc
+			_rate_interp = (int) f_clamp (ev->Value, (float) LoopInterpLinear, (float) LoopInterpSinc);
+		}
 		else if (ev->Control == Event::TempoStretch) {
 			_tempo_stretch = ev->Value > 0.0; 
 			if (_tempo_stretch && ports[CycleLength] != 0.0f) {
@@ -1030,8 +1044,203 @@ Looper::do_event (Event *ev)
 }
 
 
+LoopStretchers *
+Looper::create_stretchers ()
+{
+	// not in the audio thread
+	LoopStretchers * str = new LoopStretchers;
+	nframes_t srate = _driver->get_samplerate();
+
+	str->in = new RubberBandStretcher(srate, _chan_count, 
+					  RubberBandStretcher::OptionProcessRealTime | RubberBandStretcher::OptionTransientsCrisp);
+	str->out = new RubberBandStretcher(srate, _chan_count, 
+					   RubberBandStretcher::OptionProcessRealTime | RubberBandStretcher::OptionTransientsCrisp);
+
+	return str;
+}
+
+void
+Looper::destroy_stretchers (LoopStretchers * str)
+{
+	if (str) {
+		delete str->in;
+		delete str->out;
+		delete str;
+	}
+}
+
+void
+Looper::attach_stretchers (LoopStretchers * str)
+{
+	str->in->setTimeRatio(1.0/_stretch_ratio);
+	str->out->setTimeRatio(_stretch_ratio);
+	str->out->setPitchScale(pow(2.0, _pitch_shift / 12.0));
+
+	_stretchers = str;
+	_stretchers_waiting = false;
+	_stretch_idle_frames = 0;
+
+	recompute_latencies();
+}
+
+LoopStretchers *
+Looper::take_idle_stretchers ()
+{
+	LoopStretchers * str = _stretchers;
+
+	// a timeout of 0 keeps them for good
+	if (!str || _stretch_idle_secs <= 0.0f || _stretch_idle_frames < _stretch_idle_secs * _driver->get_samplerate()) {
+		return 0;
+	}
+
+	_stretchers = 0;
+	_stretch_idle_frames = 0;
+
+	return str;
+}
+
+void
+Looper::request_stretch_cache (StretchRenderer * renderer)
+{
+	// not in the audio thread
+	unsigned long key = _cache_asked_key;
+	double ratio = _cache_asked_ratio;
+	double pitch = _cache_asked_pitch;
+	nframes_t frames;
+	float * audio;
+	bool gone;
+
+	// the audio thread holds the loop still for us at the end of its
+	// next cycle
+	if ((frames = (nframes_t) sl_pin_static_loop (_instance, key, &gone)) == 0) {
+		if (!gone) {
+			_want_stretch_cache = true;
+		}
+		// otherwise the loop has already moved on, it will ask again
+		return;
+	}
+
+	audio = new float[frames * _chan_count];
+
+	for (unsigned int i=0; i < _chan_count; ++i) {
+		if (sl_read_static_loop (_instance, key, i, audio + i * frames, frames) != frames) {
+			sl_unpin_static_loop (_instance);
+			delete [] audio;
+			return;
+		}
+	}
+
+	sl_unpin_static_loop (_instance);
+
+	renderer->render (this, key, ratio, pitch, _driver->get_samplerate(), _chan_count, audio, frames);
+}
+
+StretchCache *
+Looper::attach_stretch_cache (StretchCache * cache)
+{
+	StretchCache * old = _stretch_cache;
+
+	_stretch_cache = cache;
+
+	return old;
+}
+
+StretchCache *
+Looper::take_idle_stretch_cache ()
+{
+	StretchCache * cache = _stretch_cache;
+
+	if (!cache) {
+		return 0;
+	}
+
+	// one for an older version of the loop is no use anymore, nor is one
+	// that has not been played for the idle timeout
+	if (cache->key == _static_key
+	    && (_stretch_idle_secs <= 0.0f || _stretch_idle_frames < _stretch_idle_secs * _driver->get_samplerate()))
+	{
+		return 0;
+	}
+
+	_stretch_cache = 0;
+	_playing_cache = false;
+
+	return cache;
+}
+
+void
+Looper::queue_command (int cmd)
+{
+	unsigned int pos;
+
+	if (_cmd_queue_count < CommandQueueSize) {
+		pos = (_cmd_queue_head + _cmd_queue_count++) % CommandQueueSize;
+	}
+	else {
+		// full, the newest wins like it always did
+		pos = (_cmd_queue_head + CommandQueueSize - 1) % CommandQueueSize;
+	}
+
+	// the loops have run up to here
+	_cmd_queue[pos].frame = _running_frames;
+	_cmd_queue[pos].cmd = cmd;
+}
+
+// frames from start until the next queued command, ~0 if there is none
+nframes_t
+Looper::next_command_offset (nframes_t start) const
+{
+	nframes_t frame;
+
+	if (_cmd_queue_count == 0) {
+		return (nframes_t) -1;
+	}
+
+	frame = _cmd_queue[_cmd_queue_head].frame;
+
+	// works across wraps of the frame count
+	return ((int) (frame - start) > 0) ? frame - start : 0;
+}
+
+// hands every command due by now to the plugin, the last one is left
+// in the Multi port for the run that follows
+void
+Looper::take_commands (nframes_t now)
+{
+	while (_cmd_queue_count > 0 && (int) (_cmd_queue[_cmd_queue_head].frame - now) <= 0) {
+		int cmd = _cmd_queue[_cmd_queue_head].cmd;
+
+		_cmd_queue_head = (_cmd_queue_head + 1) % CommandQueueSize;
+		--_cmd_queue_count;
+
+		// the plugin only takes one command per run and only when
+		// the port changes, so let the previous one in first
+		if (ports[Multi] >= 0) {
+			descriptor->run (_instance, 0);
+
+			if (ports[Multi] == cmd) {
+				ports[Multi] = -1;
+				descriptor->run (_instance, 0);
+			}
+		}
+
+		ports[Multi] = cmd;
+		//fprintf(stderr,"Requested mode: %d\n", cmd);
+
+		if (cmd == Event::RECORD && ports[State] != LooperStateRecording) {
+			// record cmd, lets reset stretch and pitch ratios to 1 always
+			_pending_stretch_ratio = _stretch_ratio = 1.0;
+			_pending_stretch = true;
+			_pitch_shift = 0.0;
+			if (_stretchers) {
+				_stretchers->out->setPitchScale(pow(2.0, _pitch_shift / 12.0));
+			}
+		}
+	}
+}
+
 void
-Looper::run (nframes_t offset, nframes_t nframes)
+Looper::run (nframes_t offset, nframes_t nframes, unsigned int worker)
 {
 	// this is the audio thread
 	
@@ -1047,7 +1256,7 @@ Looper::run (nframes_t offset, nframes_t nframes)
 				sample_t * outbuf = _driver->get_output_port_buffer (_output_ports[i], _buffersize);
 				if (inbuf && outbuf) {
 					for (nframes_t n=0; n < nframes; ++n) {
-						outbuf[n] = flush_to_zero (inbuf[n] * _curr_dry * _curr_input_gain);
+						outbuf[n] = inbuf[n] * _curr_dry * _curr_input_gain;
 					}
 				}
 			}
@@ -1056,71 +1265,64 @@ Looper::run (nframes_t offset, nframes_t nframes)
 		return;
 	}
 
-	_running_frames += nframes;
-	
-	if (request_pending) {
-		
-		if (ports[Multi] == requested_cmd) {
-			/* defer till next call */
-			ports[Multi] = -1;
-                        //fprintf(stderr,"Deferred to next run\n");
-		} else {
-			ports[Multi] = requested_cmd;
-			request_pending = false;
-                        //fprintf(stderr,"Requested mode: %d\n", requested_cmd);
-                         
-			if (requested_cmd == Event::RECORD && ports[State] != LooperStateRecording) {
-				// record cmd, lets reset stretch and pitch ratios to 1 always
-				_pending_stretch_ratio = _stretch_ratio = 1.0;
-				_pending_stretch = true;
-				_pitch_shift = 0.0;
-				_out_stretcher->setPitchScale(pow(2.0, _pitch_shift / 12.0));
-			}
-		}
-
-	} else if (ports[Multi] >= 0) {
-		ports[Multi] = -1;
-                //fprintf(stderr,"Reset to -1\n");
-		//cerr << "reset to -1\n";
-	}
+	cycle_t started = get_cycles();
+	nframes_t start = _running_frames;
+	nframes_t done = 0;
+	nframes_t span;
+	nframes_t due;
 
-	// deal with any pending stretch ratio change from non-rt context
-	if (_pending_stretch) {
-		double newratio = _pending_stretch_ratio;
-		if (_stretch_ratio == 1.0 && newratio != 1.0)
-		{
-			_in_stretcher->reset();
-			_out_stretcher->reset();
-		}
-		_stretch_ratio = newratio;
-		_in_stretcher->setTimeRatio(1.0/_stretch_ratio);
-		_out_stretcher->setTimeRatio(_stretch_ratio);
-		_pending_stretch = false;
-		recompute_latencies();
-	}
+	_running_frames += nframes;
 
 	LADSPA_Data oldsync = ports[Sync];
 	// ignore sync if we are using our own syncin/outbuf
 	if (_use_sync_buf == _our_syncin_buf || _use_sync_buf == _our_syncout_buf) {
 		ports[Sync] = 0.0f;
-		_slave_sync_port = 1.0f;
 	}
 	else if (_relative_sync && ports[Sync] > 0.0f) {
 		// used for recSync relative mode
 		ports[Sync] = 2.0f;
-		_slave_sync_port = 2.0;
-	}
-	else {
-		_slave_sync_port = 1.0;
 	}
 
 	// do fixed peak meter falloff
 	_input_peak = flush_to_zero (f_clamp (DB_CO (CO_DB(_input_peak) - nframes * _falloff_per_sample), 0.0f, 20.0f));
 	_output_peak = flush_to_zero (f_clamp (DB_CO (CO_DB(_output_peak) - nframes * _falloff_per_sample), 0.0f, 20.0f));
-	
-	
-	
-	run_loops (offset, nframes);
+
+	// the loops are run up to each queued command, which then goes in
+	// at exactly its frame
+	do {
+		if (next_command_offset (start) <= done) {
+			take_commands (start + done);
+		}
+		else if (ports[Multi] >= 0) {
+			ports[Multi] = -1;
+			//cerr << "reset to -1\n";
+		}
+
+		due = next_command_offset (start);
+		span = min (due, nframes) - done;
+
+		// deal with any pending stretch ratio change from non-rt context
+		if (_pending_stretch) {
+			double newratio = _pending_stretch_ratio;
+			if (_stretchers) {
+				if (_stretch_ratio == 1.0 && newratio != 1.0)
+				{
+					_stretchers->in->reset();
+					_stretchers->out->reset();
+				}
+				_stretchers->in->setTimeRatio(1.0/newratio);
+				_stretchers->out->setTimeRatio(newratio);
+			}
+			_stretch_ratio = newratio;
+			_pending_stretch = false;
+			recompute_latencies();
+		}
+
+		run_loops (offset + done, span, worker);
+
+		done += span;
+
+	} while (done < nframes);
 /*
 	if (ports[Rate] == 1.0f) {
 		run_loops (offset, nframes);
@@ -1134,11 +1336,13 @@ Looper::run (nframes_t offset, nframes_t nframes)
 	}
 */	
 	ports[Sync] = oldsync;
+
+	_cpu_cycles += get_cycles() - started;
 }
 
 
 void
-Looper::run_loops (nframes_t offset, nframes_t nframes)
+Looper::run_loops (nframes_t offset, nframes_t nframes, unsigned int worker)
 {
 	//LADSPA_Data * inbuf = 0 , *outbuf = 0, *real_inbuf = 0;
 	nframes_t alt_frames = nframes;
@@ -1151,6 +1355,40 @@ Looper::run_loops (nframes_t offset, nframes_t nframes)
 	bool  resampled = ports[Rate] != 1.0f;
 	bool  stretched = _stretch_ratio != 1.0;
 	bool  pitched = _pitch_shift != 0.0;
+	bool  cached = false;
+
+	if (stretched || pitched || resampled || _stretch_cache) {
+		_static_key = sl_get_static_loop_key (_instance);
+	}
+
+	if (stretched || pitched) {
+		// the cache only plays forward
+		unsigned long fwdkey = (sl_get_play_rate (_instance) == 1.0) ? _static_key : 0;
+
+		_stretch_idle_frames = 0;
+
+		if (!_stretchers && !_stretchers_waiting) {
+			// the main thread makes them, until then we play unstretched
+			_stretchers_waiting = true;
+			_want_stretchers = true;
+		}
+
+		cached = !resampled && fwdkey && _stretch_cache && fwdkey == _stretch_cache->key && _chan_count == _stretch_cache->channels
+			&& _stretch_ratio == _stretch_cache->ratio && _pitch_shift == _stretch_cache->pitch;
+
+		if (fwdkey && !cached
+		    && (fwdkey != _cache_asked_key || _stretch_ratio != _cache_asked_ratio || _pitch_shift != _cache_asked_pitch))
+		{
+			// the loop stays the way it is, have it rendered ahead of time
+			_cache_asked_key = fwdkey;
+			_cache_asked_ratio = _stretch_ratio;
+			_cache_asked_pitch = _pitch_shift;
+			_want_stretch_cache = true;
+		}
+	}
+	else if (_stretchers || _stretch_cache) {
+		_stretch_idle_frames += nframes;
+	}
 
 	if (resampled) {
 		_src_data.end_of_input = 0;
@@ -1173,7 +1411,7 @@ Looper::run_loops (nframes_t offset, nframes_t nframes)
 	sample_t* com_obufs[comnouts];
 	for (size_t n=0; n < comnouts; ++n) {
 		
-		com_obufs[n] = _driver->get_engine()->get_common_output_buffer (n);
+		com_obufs[n] = _driver->get_engine()->get_common_output_buffer (n, worker);
 		if (com_obufs[n]) {
 			com_obufs[n] += offset;
 		}
@@ -1259,33 +1497,75 @@ Looper::run_loops (nframes_t offset, nframes_t nframes)
 	}
 
 	if (resampled) {
+		// a loop that is only being played is read at the rate straight
+		// out of loop memory, instead of going through the resamplers.
+		// the input is only still needed when latency compensation has
+		// to have it at hand for a later overdub
+		bool native = _static_key && ports[Multi] < 0;
+		bool feed = !native || ports[InputLatency] > 0.0f;
+		double startpos = sl_get_loop_position (_instance);
+		double playrate = sl_get_play_rate (_instance);
+
+		if (native != _native_rate) {
+			// whatever they hold is from before
+			for (unsigned int i=0; i < _chan_count; ++i) {
+				src_reset (_in_src_states[i]);
+				src_reset (_out_src_states[i]);
+			}
+			_direct_wet = ports[WetLevel];
+			_native_rate = native;
+		}
+
 		for (unsigned int i=0; i < _chan_count; ++i)
 		{
+			sample_t * src_in_buf = _src_in_buffer + i * _src_buffer_len;
 
+			if (!feed) {
+				// the sync was resampled to alt_frames already
+				memset (src_in_buf, 0, alt_frames * sizeof(sample_t));
+
+				sl_connect_audio_port (_instance, AudioInputPort, i, (LADSPA_Data*) src_in_buf);
+				sl_connect_audio_port (_instance, AudioOutputPort, i, (LADSPA_Data*) src_in_buf);
+				continue;
+			}
+			
 			// resample input
 			_src_data.src_ratio = _src_in_ratio;
 			_src_data.input_frames = nframes;
 			_src_data.output_frames = (long) ceil (nframes * _src_in_ratio);
 			_src_data.data_in = (sample_t *) inbufs[i];
-			_src_data.data_out = _src_in_buffer;
+			_src_data.data_out = src_in_buf;
 			src_process (_in_src_states[i], &_src_data);
-			
-			alt_frames = _src_data.output_frames_gen;
 
-			descriptor->connect_port (_instances[i], AudioInputPort, (LADSPA_Data*) _src_in_buffer);
-			descriptor->connect_port (_instances[i], AudioOutputPort, (LADSPA_Data*) _src_in_buffer);
+			// every channel sees the same ratio and frame counts
+			alt_frames = (i == 0) ? _src_data.output_frames_gen : min (alt_frames, (nframes_t) _src_data.output_frames_gen);
 
-			if (i == 0) {
-				descriptor->connect_port (_instances[i], SyncInputPort, (LADSPA_Data*) _src_sync_buffer);
-				descriptor->connect_port (_instances[i], SyncOutputPort, (LADSPA_Data*) _src_sync_buffer);
-			} else {
-				// all others get the first channel's sync-out as input
-				descriptor->connect_port (_instances[i], SyncInputPort, (LADSPA_Data*) _src_sync_buffer);
-				descriptor->connect_port (_instances[i], SyncOutputPort, (LADSPA_Data*) _dummy_buf);
-			}
-			
-			/* do it */
-			descriptor->run (_instances[i], alt_frames);
+			sl_connect_audio_port (_instance, AudioInputPort, i, (LADSPA_Data*) src_in_buf);
+			sl_connect_audio_port (_instance, AudioOutputPort, i, (LADSPA_Data*) src_in_buf);
+		}
+
+		descriptor->connect_port (_instance, SyncInputPort, (LADSPA_Data*) _src_sync_buffer);
+		descriptor->connect_port (_instance, SyncOutputPort, (LADSPA_Data*) _src_sync_buffer);
+
+		/* do it */
+		descriptor->run (_instance, alt_frames);
+
+		for (unsigned int i=0; native && i < _chan_count; ++i)
+		{
+			// the same stretch of the loop the looper just went over
+			sl_read_loop_interpolated (_instance, i, outbufs[i], nframes, startpos,
+						   playrate * alt_frames / (double) nframes, _rate_interp);
+
+			apply_gain_ramp (outbufs[i], nframes, _direct_wet, ports[WetLevel]);
+		}
+
+		if (native) {
+			_direct_wet = ports[WetLevel];
+		}
+
+		for (unsigned int i=0; !native && i < _chan_count; ++i)
+		{
+			sample_t * src_in_buf = _src_in_buffer + i * _src_buffer_len;
 			
 			// resample output
 			_src_data.src_ratio = _src_out_ratio;
@@ -1297,7 +1577,7 @@ Looper::run_loops (nframes_t offset, nframes_t nframes)
 				//_src_data.output_frames = (long) ceil (ceil(nframes * _src_in_ratio) * _src_out_ratio);
 				_src_data.output_frames = nframes ;
 			}
-			_src_data.data_in = _src_in_buffer;
+			_src_data.data_in = src_in_buf;
 			_src_data.data_out = (sample_t *) outbufs[i];
 			src_process (_out_src_states[i], &_src_data);
 			
@@ -1333,17 +1613,89 @@ Looper::run_loops (nframes_t offset, nframes_t nframes)
 			
 		}
 	}
-	else if (stretched || pitched) 
+	else if (cached)
+	{
+		nframes_t cachelen = _stretch_cache->length;
+		nframes_t expect = (nframes_t) fmod (sl_get_loop_position (_instance) * _stretch_ratio, (double) cachelen);
+		nframes_t srcframes, span, done, dist;
+
+		if (!_playing_cache) {
+			_cache_pos = expect;
+			_cache_src_frames = 0.0;
+			_direct_wet = ports[WetLevel];
+		}
+		else {
+			// follow the loop when it jumps, on a retrigger or sync
+			dist = (expect > _cache_pos) ? expect - _cache_pos : _cache_pos - expect;
+			if (min (dist, cachelen - dist) > nframes) {
+				_cache_pos = expect;
+			}
+		}
+
+		// resample sync using Rate
+		_src_data.end_of_input = 0;
+		_src_data.src_ratio = _src_in_ratio;
+		_src_data.input_frames = nframes;
+		_src_data.output_frames = (long) ceil (nframes * _stretch_ratio);
+		_src_data.data_in = _use_sync_buf + offset;
+		_src_data.data_out = _src_sync_buffer;
+		src_process (_insync_src_state, &_src_data);
+
+		// the looper still runs over the frames the stretched period
+		// stands for, to keep its position and sync.  what it plays
+		// is thrown away
+		_cache_src_frames += nframes / _stretch_ratio;
+		srcframes = (nframes_t) _cache_src_frames;
+		_cache_src_frames -= srcframes;
+
+		for (done = 0; done < srcframes; done += span) {
+			span = min (srcframes - done, nframes);
+
+			for (unsigned int i=0; i < _chan_count; ++i) {
+				memset(outbufs[i], 0, span * sizeof(float));
+
+				sl_connect_audio_port (_instance, AudioInputPort, i, (LADSPA_Data*) outbufs[i]);
+				sl_connect_audio_port (_instance, AudioOutputPort, i, (LADSPA_Data*) outbufs[i]);
+			}
+
+			descriptor->connect_port (_instance, SyncInputPort, (LADSPA_Data*) _src_sync_buffer);
+			descriptor->connect_port (_instance, SyncOutputPort, (LADSPA_Data*) _src_sync_buffer);
+			descriptor->run (_instance, span);
+		}
+
+		// and the period comes from the cache instead
+		for (unsigned int i=0; i < _chan_count; ++i) {
+			const float * cachebuf = _stretch_cache->data + i * cachelen;
+			nframes_t pos = _cache_pos;
+
+			for (nframes_t n=0; n < nframes; ++n) {
+				outbufs[i][n] = cachebuf[pos];
+				if (++pos == cachelen) {
+					pos = 0;
+				}
+			}
+
+			apply_gain_ramp (outbufs[i], nframes, _direct_wet, ports[WetLevel]);
+		}
+
+		_cache_pos = (nframes_t) ((_cache_pos + (unsigned long) nframes) % cachelen);
+		_direct_wet = ports[WetLevel];
+	}
+	else if ((stretched || pitched) && _stretchers) 
 	{
+		if (_playing_cache) {
+			// whatever it held is from before the cache took over
+			_stretchers->out->reset();
+		}
 #if 0
 		nframes_t needSamples = (nframes_t) floor(nframes / _stretch_ratio);
 		//cerr << "in samps req: " << sampsReq << "  need: " << needSamples << endl;
 		alt_frames = needSamples;
 		
 		// stretch input
-		_in_stretcher->process(inbufs, (size_t) nframes, false);
-		size_t avail_samps = _in_stretcher->available();			
-		size_t got_samps = _in_stretcher->retrieve(&_src_in_buffer, avail_samps);
+		_stretchers->in->process(inbufs, (size_t) nframes, false);
+		size_t avail_samps = _stretchers->in->available();			
+		size_t got_samps = _stretchers->in->retrieve(&_src_in_buffer, avail_samps);
 		if (got_samps < alt_frames) {
 			// clear the remaining
 			cerr << "clearing in " << alt_frames - got_samps << "  avail: " << avail_samps << "  got samps: " << got_samps << endl;
@@ -1365,40 +1717,34 @@ Looper::run_loops (nframes_t offset, nframes_t nframes)
 
                 
 		// stretch output by running the looper as much as we need
-		size_t avail_samps = _out_stretcher->available();
+		size_t avail_samps = _stretchers->out->available();
 		//nframes_t needSamples = (nframes_t) ceil(nframes * _stretch_ratio);
 
 		while (avail_samps < nframes) {
-			size_t sampsReq = _out_stretcher->getSamplesRequired();
+			size_t sampsReq = _stretchers->out->getSamplesRequired();
 			size_t sampsUse = min(sampsReq, (size_t) nframes);
 
-			// run the looper(s)
+			// run the looper
 			for (unsigned int i=0; i < _chan_count; ++i) {
 				// zero any input, we're not allowing input while stretching for now
 				memset(outbufs[i], 0, sampsUse * sizeof(float));			
-				// todo sync buf
-				if (i == 0) {
-					descriptor->connect_port (_instances[i], SyncInputPort, (LADSPA_Data*) _src_sync_buffer);
-					descriptor->connect_port (_instances[i], SyncOutputPort, (LADSPA_Data*) _src_sync_buffer);
-				} else {
-					// all others get the first channel's sync-out as input
-					descriptor->connect_port (_instances[i], SyncInputPort, (LADSPA_Data*) _src_sync_buffer);
-					descriptor->connect_port (_instances[i], SyncOutputPort, (LADSPA_Data*) _dummy_buf);
-				}
-				
-				descriptor->connect_port (_instances[i], AudioInputPort, (LADSPA_Data*) outbufs[i]);
-				descriptor->connect_port (_instances[i], AudioOutputPort, (LADSPA_Data*) outbufs[i]);
-				descriptor->run (_instances[i], sampsUse);
 				
+				sl_connect_audio_port (_instance, AudioInputPort, i, (LADSPA_Data*) outbufs[i]);
+				sl_connect_audio_port (_instance, AudioOutputPort, i, (LADSPA_Data*) outbufs[i]);
 			}
 
+			// todo sync buf
+			descriptor->connect_port (_instance, SyncInputPort, (LADSPA_Data*) _src_sync_buffer);
+			descriptor->connect_port (_instance, SyncOutputPort, (LADSPA_Data*) _src_sync_buffer);
+			descriptor->run (_instance, sampsUse);
+
 			// stretch
-			_out_stretcher->process(outbufs, sampsUse, false);
+			_stretchers->out->process(outbufs, sampsUse, false);
 				
-			avail_samps = _out_stretcher->available();
+			avail_samps = _stretchers->out->available();
 		}
 		
-		_out_stretcher->retrieve(outbufs, nframes);			
+		_stretchers->out->retrieve(outbufs, nframes);			
 		
 	}
 	else 
@@ -1407,24 +1753,24 @@ Looper::run_loops (nframes_t offset, nframes_t nframes)
 
 		for (unsigned int i=0; i < _chan_count; ++i)
 		{
+			sl_connect_audio_port (_instance, AudioInputPort, i, inbufs[i]);
+			sl_connect_audio_port (_instance, AudioOutputPort, i, outbufs[i]);
+		}
 				
-			descriptor->connect_port (_instances[i], AudioInputPort, inbufs[i]);
-			descriptor->connect_port (_instances[i], AudioOutputPort, outbufs[i]);
-				
-			if (i == 0) {
-				descriptor->connect_port (_instances[i], SyncInputPort, (LADSPA_Data*) _use_sync_buf + offset);
-				descriptor->connect_port (_instances[i], SyncOutputPort, (LADSPA_Data*) _our_syncout_buf + offset);
-			} else {
-				// all others get the first channel's sync-out as input
-				descriptor->connect_port (_instances[i], SyncInputPort, (LADSPA_Data*) _our_syncout_buf + offset);
-				descriptor->connect_port (_instances[i], SyncOutputPort, (LADSPA_Data*) _dummy_buf + offset);
-			}
-				
-			/* do it */
-			descriptor->run (_instances[i], alt_frames);
+		descriptor->connect_port (_instance, SyncInputPort, (LADSPA_Data*) _use_sync_buf + offset);
+		descriptor->connect_port (_instance, SyncOutputPort, (LADSPA_Data*) _our_syncout_buf + offset);
+
+		// spares the plugin from scanning the sync input
+		if (_use_sync_events) {
+			sl_set_sync_events (_instance, _use_sync_events, offset);
 		}
+				
+		/* do it */
+		descriptor->run (_instance, alt_frames);
 	}
 
+	_playing_cache = cached;
+
 		
 	for (unsigned int i=0; i < _chan_count; ++i)
 	{
@@ -1512,17 +1858,21 @@ Looper::load_loop (string fname)
 		cerr << "opened " << fname << endl;
 	}
 
-	// verify that we have enough free loop space to load it
+	// verify that it fits in the loop, older history gets dropped to
+	// make room for it if needed
 
 	
-        nframes_t freesamps = (nframes_t) (ports[LoopFreeMemory] * _driver->get_samplerate());
+        nframes_t maxsamps = (nframes_t) (ports[LoopMemory] * _driver->get_samplerate());
 
-	if (sinfo.frames > freesamps) {
-		cerr << "file is too long for available space: file: " << sinfo.frames << "  free: " << freesamps << endl;
+	if (sinfo.frames > maxsamps) {
+		cerr << "file is too long for available space: file: " << sinfo.frames << "  max: " << maxsamps << endl;
 		sf_close (sfile);
 		return false;
 	}
 
+	// we're feeding it in much faster than the memory would grow otherwise
+	sl_reserve_memory (_instance, sinfo.frames);
+
 
 	// make some temporary input buffers
 	nframes_t bufsize = 65536;
@@ -1536,11 +1886,11 @@ Looper::load_loop (string fname)
 	for (unsigned int i=0; i < _chan_count; ++i)
 	{
 		/* connect audio ports */
-		descriptor->connect_port (_instances[i], AudioInputPort, (LADSPA_Data*) inbufs[i]);
-		descriptor->connect_port (_instances[i], AudioOutputPort, (LADSPA_Data*) dummyout);
-		descriptor->connect_port (_instances[i], SyncInputPort, (LADSPA_Data*) dummyout);
-		descriptor->connect_port (_instances[i], SyncOutputPort, (LADSPA_Data*) dummyout);
+		sl_connect_audio_port (_instance, AudioInputPort, i, (LADSPA_Data*) inbufs[i]);
+		sl_connect_audio_port (_instance, AudioOutputPort, i, (LADSPA_Data*) dummyout);
 	}
+	descriptor->connect_port (_instance, SyncInputPort, (LADSPA_Data*) dummyout);
+	descriptor->connect_port (_instance, SyncOutputPort, (LADSPA_Data*) dummyout);
 	
 	// ok, first we need to store some current values
 	float old_recthresh = ports[TriggerThreshold];
@@ -1561,17 +1911,13 @@ Looper::load_loop (string fname)
 	ports[TriggerLatency] = 0.0f;
 	ports[RoundIntegerTempo] = 0.0f;
 	ports[Quantize] = (float) QUANT_OFF;
-	_slave_sync_port = 0.0f;
 	
 	// now set it to mute just to make sure we weren't already recording
-	for (unsigned int i=0; i < _chan_count; ++i)
-	{
-		// run it for 0 frames just to change state
-		ports[Multi] = Event::MUTE_ON;
-		descriptor->run (_instances[i], 0);
-		ports[Multi] = Event::RECORD;
-		descriptor->run (_instances[i], 0);
-	}
+	// run it for 0 frames just to change state
+	ports[Multi] = Event::MUTE_ON;
+	descriptor->run (_instance, 0);
+	ports[Multi] = Event::RECORD;
+	descriptor->run (_instance, 0);
 
 	// now start recording and run for sinfo.frames total
 	nframes_t nframes = bufsize;
@@ -1610,11 +1956,8 @@ Looper::load_loop (string fname)
 		}
 		
 		
-		for (unsigned int i=0; i < _chan_count; ++i)
-		{
-			// run it for nframes
-			descriptor->run (_instances[i], nframes);
-		}
+		// run it for nframes
+		descriptor->run (_instance, nframes);
 
 		
 
@@ -1622,17 +1965,14 @@ Looper::load_loop (string fname)
 	}
 	
 	// change state to unknown, then the end record (with mute optionally)
-	for (unsigned int i=0; i < _chan_count; ++i)
-	{
+	if (sinfo.frames == 0) {
 		// in the case of an empty file, run undo_all
-		if (sinfo.frames == 0) {
-			ports[Multi] = Event::UNDO_ALL;
-			descriptor->run (_instances[i], 0);
-			continue;
-		}
-
+		ports[Multi] = Event::UNDO_ALL;
+		descriptor->run (_instance, 0);
+	}
+	else {
 		ports[Multi] = Event::UNKNOWN;
-		descriptor->run (_instances[i], 0);
+		descriptor->run (_instance, 0);
 
 		if ((int)old_state == LooperStateMuted) {
 			ports[Multi] = Event::MUTE_ON;
@@ -1643,8 +1983,7 @@ Looper::load_loop (string fname)
 		else {
 			ports[Multi] = Event::RECORD;
 		}
-		descriptor->run (_instances[i], 0);
-
+		descriptor->run (_instance, 0);
 	}
 
 	ports[TriggerThreshold] = old_recthresh;
@@ -1655,7 +1994,6 @@ Looper::load_loop (string fname)
 	ports[TriggerLatency] = old_trig_latency;
 	ports[RoundIntegerTempo] = old_round_tempo;
 	ports[Quantize] = old_quantize;
-	_slave_sync_port = _relative_sync ? 2.0f: 1.0f;
 	
 	ret = true;
 
@@ -1756,7 +2094,7 @@ Looper::save_loop (string fname, LoopFileEvent::FileFormat format)
 		for (unsigned int i=0; i < _chan_count; ++i)
 		{
 			// run it for nframes
-			nframes = sl_read_current_loop_audio (_instances[i], outbufs[i], nframes, looppos);
+			nframes = sl_read_current_loop_audio (_instance, i, outbufs[i], nframes, looppos);
 		}
 
 		if (nframes == 0) {
@@ -1848,6 +2186,9 @@ Looper::get_state () const
 	snprintf(buf, sizeof(buf), "%.10g", _pitch_shift);
 	node->add_property ("pitch_shift", buf);
 
+	snprintf(buf, sizeof(buf), "%d", _rate_interp);
+	node->add_property ("rate_interpolation", buf);
+
 	// panner
 	if (_panner) {
 		node->add_child_nocopy (_panner->state (true));
@@ -1955,13 +2296,20 @@ Looper::set_state (const XMLNode& node)
 
 	if ((prop = node.property ("pitch_shift")) != 0) {
 		sscanf (prop->value().c_str(), "%lg", &_pitch_shift);
-		_out_stretcher->setPitchScale(pow(2.0, _pitch_shift / 12.0));
+		if (_stretchers) {
+			_stretchers->out->setPitchScale(pow(2.0, _pitch_shift / 12.0));
+		}
 	}
 
 	if ((prop = node.property ("tempo_stretch")) != 0) {
 		_tempo_stretch = (prop->value() == "yes");
 	}
 
+	if ((prop = node.property ("rate_interpolation")) != 0) {
+		sscanf (prop->value().c_str(), "%d", &_rate_interp);
+		_rate_interp = max ((int) LoopInterpLinear, min (_rate_interp, (int) LoopInterpSinc));
+	}
+
 
 	for (iter = node.children().begin(); iter != node.children().end(); ++iter) {
 		if ((*iter)->name() == "Panner") {
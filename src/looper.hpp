@@ -38,6 +38,7 @@
 #include "event.hpp"
 #include "event_nonrt.hpp"
 #include "utils.hpp"
+#include "cycle_stats.hpp"
 
 #include <pbd/xml++.h>
 
@@ -50,6 +51,16 @@ namespace SooperLooper {
 
 class OnePoleFilter;	
 class Panner;
+class StretchRenderer;
+struct StretchCache;
+
+// the rubberband stretchers of a looper, made only once it stretches
+// or shifts pitch and dropped again after it has not for a while
+struct LoopStretchers
+{
+	RubberBand::RubberBandStretcher * in;
+	RubberBand::RubberBandStretcher * out;
+};
 
 	
 class Looper 
@@ -63,7 +74,9 @@ class Looper
 	void destroy();
 	
 	bool operator() () const { return _ok; }
-	void run (nframes_t offset, nframes_t nframes);
+	// worker says which set of common output buffers to mix into,
+	// see Engine::get_common_output_buffer
+	void run (nframes_t offset, nframes_t nframes, unsigned int worker = 0);
 
 	void do_event (Event *ev);
 
@@ -79,7 +92,8 @@ class Looper
 	sample_t * get_sync_in_buf() { return _our_syncin_buf; }
 	sample_t * get_sync_out_buf() { return _our_syncout_buf; }
 
-	void use_sync_buf(sample_t * buf);
+	// events, if not 0, lists the non zero samples of buf each period
+	void use_sync_buf(sample_t * buf, const SyncEventList * events = 0);
 
 	unsigned int get_index() const { return _index; }
 	unsigned int get_channel_count() const { return _chan_count; }
@@ -123,10 +137,42 @@ class Looper
 	int set_state (const XMLNode&);
 
 	void recompute_latencies();
+
+	// stretchers are made by the main thread when it sees a looper
+	// wants them, and handed to the audio thread with attach_stretchers
+	bool wants_stretchers () const { return _want_stretchers; }
+	void clear_stretchers_wanted () { _want_stretchers = false; }
+	LoopStretchers * create_stretchers ();
+	static void destroy_stretchers (LoopStretchers * str);
+
+	// audio thread only.  take_idle_stretchers gives them up once they
+	// have not been used for the idle timeout, 0 otherwise
+	void attach_stretchers (LoopStretchers * str);
+	LoopStretchers * take_idle_stretchers ();
+
+	static void set_stretch_idle_timeout (float secs) { _stretch_idle_secs = secs; }
+
+	// a static loop that is stretched is played from a copy rendered
+	// ahead of time.  request_stretch_cache reads the loop for the
+	// renderer, from the main thread
+	bool wants_stretch_cache () const { return _want_stretch_cache; }
+	void clear_stretch_cache_wanted () { _want_stretch_cache = false; }
+	void request_stretch_cache (StretchRenderer * renderer);
+
+	// audio thread only.  attach_stretch_cache returns the cache it
+	// replaces, take_idle_stretch_cache gives it up once the loop has
+	// changed or is not stretched anymore for the idle timeout
+	StretchCache * attach_stretch_cache (StretchCache * cache);
+	StretchCache * take_idle_stretch_cache ();
+
+	// audio thread.  end_cpu_cycle adds what run took this period to
+	// the loop_cpu_us stats, publish_cpu_stats ends their window
+	void end_cpu_cycle () { _cpu_stats.add (_cpu_cycles); _cpu_cycles = 0; }
+	void publish_cpu_stats () { _cpu_stats.publish (); }
 	
   protected:
 
-	void run_loops (nframes_t offset, nframes_t nframes);
+	void run_loops (nframes_t offset, nframes_t nframes, unsigned int worker = 0);
 	void run_loops_resampled (nframes_t offset, nframes_t nframes);
 
 	static void compute_peak (sample_t *buf, nframes_t nsamples, float& peak) {
@@ -140,8 +186,23 @@ class Looper
 	}	
 	
 		
-	int requested_cmd;
-	int last_requested_cmd;
+	// commands from do_event waiting for run, oldest first.  both only
+	// ever run in the audio thread
+	struct QueuedCommand {
+		// in _running_frames
+		nframes_t frame;
+		int       cmd;
+	};
+
+	enum { CommandQueueSize = 16 };
+
+	void queue_command (int cmd);
+	nframes_t next_command_offset (nframes_t start) const;
+	void take_commands (nframes_t now);
+
+	QueuedCommand _cmd_queue[CommandQueueSize];
+	unsigned int  _cmd_queue_head;
+	unsigned int  _cmd_queue_count;
 	
 	AudioDriver *      _driver;
 
@@ -150,7 +211,8 @@ class Looper
 
 	unsigned int _index;
 	unsigned int _chan_count;
-	LADSPA_Handle *      _instances;
+	// a single state machine drives all the channels
+	LADSPA_Handle        _instance;
 	float _loopsecs;
 	
 	LADSPA_Descriptor* descriptor;
@@ -175,12 +237,16 @@ class Looper
 	nframes_t          _longpress_frames;
 	nframes_t          _doubletap_frames;
 	nframes_t          _running_frames;
+
+	// what run took so far this period, and over the last few
+	cycle_t            _cpu_cycles;
+	CycleStats         _cpu_stats;
 	
 	nframes_t          _buffersize;
 	LADSPA_Data        * _our_syncin_buf;
 	LADSPA_Data        * _our_syncout_buf;
 	LADSPA_Data        * _use_sync_buf;
-	LADSPA_Data        * _dummy_buf;
+	const SyncEventList * _use_sync_events;
 
 	LADSPA_Data        ** _tmp_io_bufs;
 
@@ -190,9 +256,6 @@ class Looper
 	float              _output_peak;
 	float              _falloff_per_sample;
 	
-	LADSPA_Data         _slave_sync_port;
-	LADSPA_Data         _slave_dummy_port;
-
 	bool                _use_common_ins;
 	bool                _use_common_outs;
 	bool                _have_discrete_io;
@@ -224,8 +287,25 @@ class Looper
 	OnePoleFilter  **     _lp_filter;
 
 	// rubberband stuff
-	RubberBand::RubberBandStretcher * _in_stretcher;
-	RubberBand::RubberBandStretcher * _out_stretcher;
+	LoopStretchers *                   _stretchers;
+	volatile bool                      _want_stretchers;
+	bool                               _stretchers_waiting;
+	nframes_t                          _stretch_idle_frames;
+	static float                       _stretch_idle_secs;
+	StretchCache *                     _stretch_cache;
+	volatile bool                      _want_stretch_cache;
+	unsigned long                      _static_key;
+	unsigned long                      _cache_asked_key;
+	double                             _cache_asked_ratio;
+	double                             _cache_asked_pitch;
+	bool                               _playing_cache;
+	nframes_t                          _cache_pos;
+	double                             _cache_src_frames;
+	// the wet level of audio played past the plugin, by the cache or
+	// by reading the loop at the rate
+	float                              _direct_wet;
+	int                                _rate_interp;
+	bool                               _native_rate;
 	double                             _stretch_ratio;
 	double                             _pitch_shift; // in semitones
 	float *                            _stretch_buffer;
@@ -235,7 +315,6 @@ class Looper
 	volatile double                    _pending_stretch_ratio;
 
 	bool _ok;
-	volatile bool request_pending;
 
 	PBD::NonBlockingLock _loop_lock;
 };
@@ -0,0 +1,229 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#include "mix_kernels.hpp"
+
+// the x86 vector kernels are compiled with per-function target
+// attributes, so no special compiler flags are needed for them
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SL_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+using namespace SooperLooper;
+
+/*****************************************************************************/
+// scalar reference
+
+static void overdub_scalar (float * out, const float * play, float * rec, const float * in, unsigned long nframes,
+			    float fPlay, float fDry, float fFeed, float fIn)
+{
+	for (unsigned long n = 0; n < nframes; ++n) {
+		float fInput = in[n];
+		out[n] = fPlay * play[n] + fDry * fInput;
+		rec[n] = fFeed * rec[n] + fIn * fInput;
+	}
+}
+
+static void feedback_scalar (float * buf, const float * in, unsigned long nframes, float fFeed, float fIn)
+{
+	for (unsigned long n = 0; n < nframes; ++n) {
+		buf[n] = fFeed * buf[n] + fIn * in[n];
+	}
+}
+
+#ifdef SL_X86_KERNELS
+
+/*****************************************************************************/
+// SSE2
+
+// the loads for a block always come before its stores, which keeps the
+// overlapping rec/play case identical to the scalar order
+
+__attribute__((target("sse2")))
+static void overdub_sse2 (float * out, const float * play, float * rec, const float * in, unsigned long nframes,
+			  float fPlay, float fDry, float fFeed, float fIn)
+{
+	__m128 vPlay = _mm_set1_ps (fPlay);
+	__m128 vDry = _mm_set1_ps (fDry);
+	__m128 vFeed = _mm_set1_ps (fFeed);
+	__m128 vIn = _mm_set1_ps (fIn);
+	unsigned long n = 0;
+
+	for (; n + 4 <= nframes; n += 4) {
+		__m128 vInput = _mm_loadu_ps (in + n);
+		__m128 vLoop = _mm_loadu_ps (play + n);
+		__m128 vRec = _mm_loadu_ps (rec + n);
+		_mm_storeu_ps (out + n, _mm_add_ps (_mm_mul_ps (vPlay, vLoop), _mm_mul_ps (vDry, vInput)));
+		_mm_storeu_ps (rec + n, _mm_add_ps (_mm_mul_ps (vFeed, vRec), _mm_mul_ps (vIn, vInput)));
+	}
+
+	overdub_scalar (out + n, play + n, rec + n, in + n, nframes - n, fPlay, fDry, fFeed, fIn);
+}
+
+__attribute__((target("sse2")))
+static void feedback_sse2 (float * buf, const float * in, unsigned long nframes, float fFeed, float fIn)
+{
+	__m128 vFeed = _mm_set1_ps (fFeed);
+	__m128 vIn = _mm_set1_ps (fIn);
+	unsigned long n = 0;
+
+	for (; n + 4 <= nframes; n += 4) {
+		_mm_storeu_ps (buf + n, _mm_add_ps (_mm_mul_ps (vFeed, _mm_loadu_ps (buf + n)), _mm_mul_ps (vIn, _mm_loadu_ps (in + n))));
+	}
+
+	feedback_scalar (buf + n, in + n, nframes - n, fFeed, fIn);
+}
+
+/*****************************************************************************/
+// AVX2
+
+// fma is deliberately not enabled here, a fused multiply-add would
+// round differently than the scalar reference
+
+__attribute__((target("avx2")))
+static void overdub_avx2 (float * out, const float * play, float * rec, const float * in, unsigned long nframes,
+			  float fPlay, float fDry, float fFeed, float fIn)
+{
+	__m256 vPlay = _mm256_set1_ps (fPlay);
+	__m256 vDry = _mm256_set1_ps (fDry);
+	__m256 vFeed = _mm256_set1_ps (fFeed);
+	__m256 vIn = _mm256_set1_ps (fIn);
+	unsigned long n = 0;
+
+	for (; n + 8 <= nframes; n += 8) {
+		__m256 vInput = _mm256_loadu_ps (in + n);
+		__m256 vLoop = _mm256_loadu_ps (play + n);
+		__m256 vRec = _mm256_loadu_ps (rec + n);
+		_mm256_storeu_ps (out + n, _mm256_add_ps (_mm256_mul_ps (vPlay, vLoop), _mm256_mul_ps (vDry, vInput)));
+		_mm256_storeu_ps (rec + n, _mm256_add_ps (_mm256_mul_ps (vFeed, vRec), _mm256_mul_ps (vIn, vInput)));
+	}
+
+	overdub_sse2 (out + n, play + n, rec + n, in + n, nframes - n, fPlay, fDry, fFeed, fIn);
+}
+
+__attribute__((target("avx2")))
+static void feedback_avx2 (float * buf, const float * in, unsigned long nframes, float fFeed, float fIn)
+{
+	__m256 vFeed = _mm256_set1_ps (fFeed);
+	__m256 vIn = _mm256_set1_ps (fIn);
+	unsigned long n = 0;
+
+	for (; n + 8 <= nframes; n += 8) {
+		_mm256_storeu_ps (buf + n, _mm256_add_ps (_mm256_mul_ps (vFeed, _mm256_loadu_ps (buf + n)),
+							  _mm256_mul_ps (vIn, _mm256_loadu_ps (in + n))));
+	}
+
+	feedback_sse2 (buf + n, in + n, nframes - n, fFeed, fIn);
+}
+
+/*****************************************************************************/
+// AVX-512
+
+__attribute__((target("avx512f")))
+static void overdub_avx512 (float * out, const float * play, float * rec, const float * in, unsigned long nframes,
+			    float fPlay, float fDry, float fFeed, float fIn)
+{
+	__m512 vPlay = _mm512_set1_ps (fPlay);
+	__m512 vDry = _mm512_set1_ps (fDry);
+	__m512 vFeed = _mm512_set1_ps (fFeed);
+	__m512 vIn = _mm512_set1_ps (fIn);
+	unsigned long n = 0;
+
+	for (; n + 16 <= nframes; n += 16) {
+		__m512 vInput = _mm512_loadu_ps (in + n);
+		__m512 vLoop = _mm512_loadu_ps (play + n);
+		__m512 vRec = _mm512_loadu_ps (rec + n);
+		_mm512_storeu_ps (out + n, _mm512_add_ps (_mm512_mul_ps (vPlay, vLoop), _mm512_mul_ps (vDry, vInput)));
+		_mm512_storeu_ps (rec + n, _mm512_add_ps (_mm512_mul_ps (vFeed, vRec), _mm512_mul_ps (vIn, vInput)));
+	}
+
+	overdub_avx2 (out + n, play + n, rec + n, in + n, nframes - n, fPlay, fDry, fFeed, fIn);
+}
+
+__attribute__((target("avx512f")))
+static void feedback_avx512 (float * buf, const float * in, unsigned long nframes, float fFeed, float fIn)
+{
+	__m512 vFeed = _mm512_set1_ps (fFeed);
+	__m512 vIn = _mm512_set1_ps (fIn);
+	unsigned long n = 0;
+
+	for (; n + 16 <= nframes; n += 16) {
+		_mm512_storeu_ps (buf + n, _mm512_add_ps (_mm512_mul_ps (vFeed, _mm512_loadu_ps (buf + n)),
+							  _mm512_mul_ps (vIn, _mm512_loadu_ps (in + n))));
+	}
+
+	feedback_avx2 (buf + n, in + n, nframes - n, fFeed, fIn);
+}
+
+#endif
+
+/*****************************************************************************/
+
+static const MixKernels kernel_table[] = {
+	{ overdub_scalar, feedback_scalar, MixKernelScalar, "scalar" },
+#ifdef SL_X86_KERNELS
+	{ overdub_sse2, feedback_sse2, MixKernelSSE2, "sse2" },
+	{ overdub_avx2, feedback_avx2, MixKernelAVX2, "avx2" },
+	{ overdub_avx512, feedback_avx512, MixKernelAVX512, "avx512" },
+#endif
+};
+
+static MixKernelLevel
+detect_level ()
+{
+#ifdef SL_X86_KERNELS
+	__builtin_cpu_init ();
+
+	if (__builtin_cpu_supports ("avx512f")) {
+		return MixKernelAVX512;
+	}
+	if (__builtin_cpu_supports ("avx2")) {
+		return MixKernelAVX2;
+	}
+	if (__builtin_cpu_supports ("sse2")) {
+		return MixKernelSSE2;
+	}
+#endif
+	return MixKernelScalar;
+}
+
+static const MixKernels * current_kernels = 0;
+
+const MixKernels &
+SooperLooper::mix_kernels ()
+{
+	if (!current_kernels) {
+		current_kernels = &kernel_table[detect_level()];
+	}
+	return *current_kernels;
+}
+
+MixKernelLevel
+SooperLooper::mix_kernels_select (MixKernelLevel level)
+{
+	MixKernelLevel best = detect_level();
+
+	if (level > best) {
+		level = best;
+	}
+	current_kernels = &kernel_table[level];
+
+	return level;
+}
@@ -0,0 +1,67 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#ifndef __sooperlooper_mix_kernels_h__
+#define __sooperlooper_mix_kernels_h__
+
+namespace SooperLooper {
+
+/*
+ * Mixing kernels for the overdub family of states, used on spans where
+ * every gain is constant.  The scalar versions are the reference, the
+ * vector versions do the same multiplies and adds in the same order, so
+ * the results are bit-identical.
+ *
+ * rec may overlap play when they are the same loop memory, as long as
+ * rec trails play (every element of play is read before it is written).
+ */
+
+// out[n] = fPlay * play[n] + fDry * in[n]
+// rec[n] = fFeed * rec[n] + fIn * in[n]
+typedef void (*OverdubMixFunc) (float * out, const float * play, float * rec, const float * in, unsigned long nframes,
+				float fPlay, float fDry, float fFeed, float fIn);
+
+// buf[n] = fFeed * buf[n] + fIn * in[n]
+typedef void (*FeedbackMixFunc) (float * buf, const float * in, unsigned long nframes, float fFeed, float fIn);
+
+enum MixKernelLevel {
+	MixKernelScalar = 0,
+	MixKernelSSE2,
+	MixKernelAVX2,
+	MixKernelAVX512
+};
+
+struct MixKernels
+{
+	OverdubMixFunc   overdub;
+	FeedbackMixFunc  feedback;
+	MixKernelLevel   level;
+	const char *     name;
+};
+
+// the best kernels this cpu supports, chosen on first use
+const MixKernels & mix_kernels ();
+
+// force a lower level (clamped to what the cpu supports), mainly for
+// testing and benchmarking.  returns the level now in use
+MixKernelLevel mix_kernels_select (MixKernelLevel level);
+
+};
+
+#endif
@@ -0,0 +1,175 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#ifndef __sooperlooper_mpsc_ringbuffer_h__
+#define __sooperlooper_mpsc_ringbuffer_h__
+
+#include <cstddef>
+
+namespace SooperLooper {
+
+/*
+ * A ringbuffer any number of threads may push to at once while a single
+ * thread reads it, with no locks.  Every slot has a sequence number
+ * saying whether it is free for the writer at some position or filled
+ * for the reader, and writers claim their position with a compare and
+ * swap.  The reader side looks like RingBuffer's, so the audio thread
+ * goes through the events in place.  Pushes that find it full are
+ * dropped and counted.
+ */
+template<class T>
+class MPSCRingBuffer
+{
+  public:
+	MPSCRingBuffer (size_t sz) {
+		size_t power_of_two;
+
+		for (power_of_two = 1; 1U<<power_of_two < sz; power_of_two++);
+
+		size = 1<<power_of_two;
+		size_mask = size - 1;
+		buf = new T[size];
+		seq = new volatile size_t[size];
+		reset ();
+	}
+
+	~MPSCRingBuffer() {
+		delete [] buf;
+		delete [] seq;
+	}
+
+	void reset () {
+		/* !!! NOT THREAD SAFE !!! */
+		for (size_t n = 0; n < size; ++n) {
+			seq[n] = n;
+		}
+		write_pos = 0;
+		read_pos = 0;
+		dropped = 0;
+	}
+
+	// from any thread
+	bool push (const T & item);
+
+	struct rw_vector {
+	    T *buf[2];
+	    size_t len[2];
+	};
+
+	// the reader only.  the items pushed so far in order, stopping at
+	// the first one that is still being written
+	void get_read_vector (rw_vector *);
+	size_t read_space ();
+	void increment_read_ptr (size_t cnt);
+
+	unsigned long dropped_count () const { return dropped; }
+	size_t bufsize () const { return size; }
+
+  protected:
+	size_t ready_count () const {
+		size_t pos = read_pos;
+		size_t n = 0;
+
+		while (n < size && seq[(pos + n) & size_mask] == pos + n + 1) {
+			++n;
+		}
+		return n;
+	}
+
+	T *buf;
+	volatile size_t *seq;
+	size_t size;
+	size_t size_mask;
+	volatile size_t write_pos;
+	// only the reader touches this
+	size_t read_pos;
+	volatile unsigned long dropped;
+};
+
+template<class T> bool
+MPSCRingBuffer<T>::push (const T & item)
+{
+	size_t pos = write_pos;
+
+	while (true) {
+		size_t s = seq[pos & size_mask];
+		long diff = (long) (s - pos);
+
+		if (diff == 0) {
+			if (__sync_bool_compare_and_swap (&write_pos, pos, pos + 1)) {
+				break;
+			}
+		}
+		else if (diff < 0) {
+			// the reader hasn't got to this slot from the last time round
+			__sync_fetch_and_add (&dropped, 1);
+			return false;
+		}
+
+		pos = write_pos;
+	}
+
+	buf[pos & size_mask] = item;
+
+	// the item has to be in before the reader can see the slot filled
+	__sync_synchronize ();
+	seq[pos & size_mask] = pos + 1;
+
+	return true;
+}
+
+template<class T> void
+MPSCRingBuffer<T>::get_read_vector (rw_vector * vec)
+{
+	size_t n = ready_count ();
+	size_t start = read_pos & size_mask;
+	size_t first = (n < size - start) ? n : size - start;
+
+	// and the items are read only after their slots were seen filled
+	__sync_synchronize ();
+
+	vec->buf[0] = &buf[start];
+	vec->len[0] = first;
+	vec->buf[1] = buf;
+	vec->len[1] = n - first;
+}
+
+template<class T> size_t
+MPSCRingBuffer<T>::read_space ()
+{
+	return ready_count ();
+}
+
+template<class T> void
+MPSCRingBuffer<T>::increment_read_ptr (size_t cnt)
+{
+	size_t pos = read_pos;
+
+	// done with the items before anyone may write over them
+	__sync_synchronize ();
+
+	for (size_t n = 0; n < cnt; ++n) {
+		seq[(pos + n) & size_mask] = pos + n + size;
+	}
+	read_pos = pos + cnt;
+}
+
+};
+
+#endif
@@ -0,0 +1,536 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <sys/time.h>
+
+#include "offline_audio_driver.hpp"
+#include "engine.hpp"
+#include "command_map.hpp"
+
+using namespace SooperLooper;
+using namespace std;
+
+OfflineAudioDriver::OfflineAudioDriver(string client_name, nframes_t samplerate, nframes_t buffersize)
+	: AudioDriver(client_name, "")
+{
+	_samplerate = samplerate;
+	_buffersize = buffersize;
+	_length_secs = 0.0f;
+	_infile = 0;
+	_infile_channels = 0;
+	_inframes = 0;
+	_timeline_pos = 0;
+	_frame = 0;
+	_length = 0;
+	_running = false;
+	_quit = false;
+
+	pthread_mutex_init (&_port_lock, NULL);
+}
+
+OfflineAudioDriver::~OfflineAudioDriver()
+{
+	deactivate();
+
+	for (size_t n = 0; n < _input_ports.size(); ++n) {
+		free_port (_input_ports[n]);
+	}
+	for (size_t n = 0; n < _output_ports.size(); ++n) {
+		free_port (_output_ports[n]);
+	}
+
+	if (_infile) {
+		sf_close (_infile);
+	}
+	delete [] _inframes;
+
+	pthread_mutex_destroy (&_port_lock);
+}
+
+
+bool
+OfflineAudioDriver::initialize(string client_name)
+{
+	nframes_t inlength = 0;
+
+	if (!client_name.empty()) {
+		_client_name = client_name;
+	}
+
+	if (_samplerate == 0 || _buffersize == 0) {
+		cerr << "OfflineAudioDriver: bad samplerate or buffersize" << endl;
+		return false;
+	}
+
+	if (!_input_path.empty()) {
+		SF_INFO info;
+
+		memset (&info, 0, sizeof(info));
+
+		if ((_infile = sf_open (_input_path.c_str(), SFM_READ, &info)) == 0) {
+			cerr << "OfflineAudioDriver: cannot open " << _input_path << ": " << sf_strerror (0) << endl;
+			return false;
+		}
+
+		if ((nframes_t) info.samplerate != _samplerate) {
+			cerr << "OfflineAudioDriver: " << _input_path << " is at " << info.samplerate
+			     << " Hz, using it as " << _samplerate << " Hz" << endl;
+		}
+
+		_infile_channels = info.channels;
+		_inframes = new sample_t[_buffersize * _infile_channels];
+		inlength = (nframes_t) info.frames;
+	}
+
+	if (!load_timeline ()) {
+		return false;
+	}
+
+	if (_length_secs > 0.0f) {
+		_length = (nframes_t) (_length_secs * _samplerate);
+	}
+	else {
+		// to the end of the input, or a period past the last event
+		_length = inlength;
+		if (!_timeline.empty() && _timeline.back().frame + _buffersize > _length) {
+			_length = _timeline.back().frame + _buffersize;
+		}
+	}
+
+	if (_length == 0) {
+		cerr << "OfflineAudioDriver: nothing to render, give an input, a timeline or a length" << endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool
+OfflineAudioDriver::load_timeline ()
+{
+	string line;
+	TimelineEvent tev;
+	int lineno = 0;
+
+	if (_timeline_path.empty()) {
+		return true;
+	}
+
+	ifstream timeline (_timeline_path.c_str());
+
+	if (!timeline) {
+		cerr << "OfflineAudioDriver: cannot open timeline " << _timeline_path << endl;
+		return false;
+	}
+
+	while (getline (timeline, line)) {
+		++lineno;
+
+		size_t start = line.find_first_not_of (" \t\r");
+		if (start == string::npos || line[start] == '#') {
+			continue;
+		}
+
+		if (!parse_timeline_line (line, tev)) {
+			cerr << "OfflineAudioDriver: " << _timeline_path << ":" << lineno << ": cannot parse: " << line << endl;
+			return false;
+		}
+
+		// keep them in order, the ones at the same frame as written
+		vector<TimelineEvent>::iterator pos = _timeline.end();
+		while (pos != _timeline.begin() && (pos - 1)->frame > tev.frame) {
+			--pos;
+		}
+		_timeline.insert (pos, tev);
+	}
+
+	return true;
+}
+
+bool
+OfflineAudioDriver::parse_timeline_line (const string & line, TimelineEvent & tev)
+{
+	CommandMap & cmdmap = CommandMap::instance();
+	istringstream words (line);
+	string when, path, what, kind;
+	int instance;
+	char * end;
+
+	if (!(words >> when >> path >> what)) {
+		return false;
+	}
+
+	// the time
+	if (when[when.size() - 1] == 'f') {
+		tev.frame = (nframes_t) strtoul (when.c_str(), &end, 10);
+		if (*end != 'f') {
+			return false;
+		}
+	}
+	else {
+		double secs = strtod (when.c_str(), &end);
+		if (*end != '\0' || secs < 0.0) {
+			return false;
+		}
+		tev.frame = (nframes_t) (secs * _samplerate + 0.5);
+	}
+
+	// the same paths as the osc server takes
+	char kindbuf[20];
+	if (sscanf (path.c_str(), "/sl/%d/%19s", &instance, kindbuf) != 2) {
+		return false;
+	}
+	kind = kindbuf;
+	tev.instance = (int8_t) instance;
+	tev.cmd = Event::UNKNOWN;
+	tev.ctrl = Event::Unknown;
+	tev.value = 0.0f;
+
+	if (kind == "set") {
+		if (!(words >> tev.value)) {
+			return false;
+		}
+		tev.type = (instance == -2) ? Event::type_global_control_change : Event::type_control_change;
+		tev.ctrl = cmdmap.to_control_t (what);
+		return tev.ctrl != Event::Unknown;
+	}
+
+	if (kind == "hit") {
+		tev.type = Event::type_cmd_hit;
+	}
+	else if (kind == "down") {
+		tev.type = Event::type_cmd_down;
+	}
+	else if (kind == "up") {
+		tev.type = Event::type_cmd_up;
+	}
+	else if (kind == "upforce") {
+		tev.type = Event::type_cmd_upforce;
+	}
+	else {
+		return false;
+	}
+
+	tev.cmd = cmdmap.to_command_t (what);
+	return tev.cmd != Event::UNKNOWN;
+}
+
+
+bool
+OfflineAudioDriver::activate()
+{
+	if (_running) {
+		return true;
+	}
+
+	_quit = false;
+
+	// nothing may happen in its own time, or no two renders would be alike
+	if (_engine) {
+		_engine->set_driver_services_loops (true);
+	}
+
+	if (pthread_create (&_thread, NULL, &OfflineAudioDriver::_freewheel_thread, this) != 0) {
+		cerr << "OfflineAudioDriver: cannot start the freewheel thread" << endl;
+		return false;
+	}
+
+	_running = true;
+	return true;
+}
+
+bool
+OfflineAudioDriver::deactivate()
+{
+	if (_running) {
+		_quit = true;
+		pthread_join (_thread, NULL);
+		_running = false;
+	}
+	return true;
+}
+
+void *
+OfflineAudioDriver::_freewheel_thread (void * arg)
+{
+	static_cast<OfflineAudioDriver*> (arg)->freewheel ();
+	return 0;
+}
+
+void
+OfflineAudioDriver::freewheel ()
+{
+	struct timeval start, now;
+	double took;
+
+	gettimeofday (&start, NULL);
+
+	while (!_quit && _frame < _length) {
+		nframes_t nframes = _buffersize;
+
+		pthread_mutex_lock (&_port_lock);
+
+		read_input (nframes);
+		push_timeline_events (nframes);
+
+		if (_engine) {
+			_engine->process (nframes);
+		}
+
+		write_outputs (nframes);
+
+		// faster than realtime the main loop could never keep up with
+		// the loop memory, so what it would do is done right here
+		if (_engine) {
+			_engine->service_loops ();
+		}
+
+		pthread_mutex_unlock (&_port_lock);
+
+		_frame += nframes;
+	}
+
+	gettimeofday (&now, NULL);
+	took = (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) * 1e-6;
+
+	cerr << "OfflineAudioDriver: rendered " << (double) _frame / _samplerate << " secs in " << took << " secs";
+	if (took > 0.0) {
+		cerr << " (" << ((double) _frame / _samplerate) / took << "x realtime)";
+	}
+	cerr << endl;
+
+	if (!_quit && _engine) {
+		_engine->quit (true);
+	}
+}
+
+void
+OfflineAudioDriver::read_input (nframes_t nframes)
+{
+	sf_count_t got = 0;
+
+	if (_infile) {
+		got = sf_readf_float (_infile, _inframes, nframes);
+		if (got < 0) {
+			got = 0;
+		}
+	}
+
+	for (size_t n = 0; n < _input_ports.size(); ++n) {
+		Port * port = _input_ports[n];
+
+		if (!port) {
+			continue;
+		}
+
+		if (port->channel >= 0 && port->channel < _infile_channels) {
+			sample_t * src = _inframes + port->channel;
+
+			for (sf_count_t i = 0; i < got; ++i) {
+				port->buffer[i] = src[i * _infile_channels];
+			}
+			memset (port->buffer + got, 0, (nframes - got) * sizeof(sample_t));
+		}
+		else {
+			memset (port->buffer, 0, nframes * sizeof(sample_t));
+		}
+	}
+}
+
+void
+OfflineAudioDriver::push_timeline_events (nframes_t nframes)
+{
+	if (!_engine) {
+		return;
+	}
+
+	while (_timeline_pos < _timeline.size() && _timeline[_timeline_pos].frame < _frame + nframes) {
+		TimelineEvent & tev = _timeline[_timeline_pos];
+		long framepos = (tev.frame > _frame) ? (long) (tev.frame - _frame) : 0;
+
+		// these are the ones that carry a position within the period
+		if (tev.type == Event::type_control_change || tev.type == Event::type_global_control_change) {
+			_engine->push_midi_control_event (tev.type, tev.ctrl, tev.value, tev.instance, framepos);
+		}
+		else {
+			_engine->push_midi_command_event (tev.type, tev.cmd, tev.instance, framepos);
+		}
+
+		++_timeline_pos;
+	}
+}
+
+void
+OfflineAudioDriver::write_outputs (nframes_t nframes)
+{
+	for (size_t n = 0; n < _output_ports.size(); ++n) {
+		Port * port = _output_ports[n];
+
+		if (port && port->file) {
+			sf_writef_float (port->file, port->buffer, nframes);
+		}
+	}
+}
+
+
+bool
+OfflineAudioDriver::create_input_port (std::string name, port_id_t & portid)
+{
+	Port * port = new Port;
+	int channel = 0;
+
+	port->name = name;
+	port->buffer = new sample_t[_buffersize];
+	memset (port->buffer, 0, _buffersize * sizeof(sample_t));
+
+	pthread_mutex_lock (&_port_lock);
+
+	// the next channel of the input file nobody has had yet
+	for (size_t n = 0; n < _input_ports.size(); ++n) {
+		if (_input_ports[n] && _input_ports[n]->channel >= channel) {
+			channel = _input_ports[n]->channel + 1;
+		}
+	}
+	port->channel = channel;
+
+	_input_ports.push_back (port);
+	portid = _input_ports.size();
+
+	pthread_mutex_unlock (&_port_lock);
+
+	return true;
+}
+
+bool
+OfflineAudioDriver::create_output_port (std::string name, port_id_t & portid)
+{
+	Port * port = new Port;
+
+	port->name = name;
+	port->buffer = new sample_t[_buffersize];
+	memset (port->buffer, 0, _buffersize * sizeof(sample_t));
+
+	if (!_output_dir.empty()) {
+		string path = _output_dir + "/" + name + ".wav";
+		SF_INFO info;
+
+		memset (&info, 0, sizeof(info));
+		info.samplerate = _samplerate;
+		info.channels = 1;
+		info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+
+		if ((port->file = sf_open (path.c_str(), SFM_WRITE, &info)) == 0) {
+			cerr << "OfflineAudioDriver: cannot open " << path << ": " << sf_strerror (0) << endl;
+			free_port (port);
+			return false;
+		}
+	}
+
+	pthread_mutex_lock (&_port_lock);
+
+	_output_ports.push_back (port);
+	portid = _output_ports.size();
+
+	pthread_mutex_unlock (&_port_lock);
+
+	return true;
+}
+
+bool
+OfflineAudioDriver::destroy_output_port (port_id_t portid)
+{
+	Port * port = 0;
+
+	pthread_mutex_lock (&_port_lock);
+
+	if (portid <= _output_ports.size() && portid > 0) {
+		port = _output_ports[portid-1];
+		_output_ports[portid-1] = 0;
+	}
+
+	pthread_mutex_unlock (&_port_lock);
+
+	if (!port) {
+		return false;
+	}
+
+	free_port (port);
+	return true;
+}
+
+bool
+OfflineAudioDriver::destroy_input_port (port_id_t portid)
+{
+	Port * port = 0;
+
+	pthread_mutex_lock (&_port_lock);
+
+	if (portid <= _input_ports.size() && portid > 0) {
+		port = _input_ports[portid-1];
+		_input_ports[portid-1] = 0;
+	}
+
+	pthread_mutex_unlock (&_port_lock);
+
+	if (!port) {
+		return false;
+	}
+
+	free_port (port);
+	return true;
+}
+
+void
+OfflineAudioDriver::free_port (Port * port)
+{
+	if (!port) {
+		return;
+	}
+
+	if (port->file) {
+		sf_close (port->file);
+	}
+	delete [] port->buffer;
+	delete port;
+}
+
+
+sample_t *
+OfflineAudioDriver::get_input_port_buffer (port_id_t port, nframes_t nframes)
+{
+	// only called from within process, with the ports locked
+	if (port > _input_ports.size() || port == 0 || !_input_ports[port-1] || nframes > _buffersize) return 0;
+
+	return _input_ports[port-1]->buffer;
+}
+
+sample_t *
+OfflineAudioDriver::get_output_port_buffer (port_id_t port, nframes_t nframes)
+{
+	// only called from within process, with the ports locked
+	if (port > _output_ports.size() || port == 0 || !_output_ports[port-1] || nframes > _buffersize) return 0;
+
+	return _output_ports[port-1]->buffer;
+}
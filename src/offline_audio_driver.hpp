@@ -0,0 +1,145 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#ifndef __sooperlooper_offline_audio_driver__
+#define __sooperlooper_offline_audio_driver__
+
+#include <vector>
+#include <string>
+#include <pthread.h>
+
+#include <sndfile.h>
+
+#include "audio_driver.hpp"
+#include "event.hpp"
+
+namespace SooperLooper {
+
+/*
+ * Runs the engine without jack, as fast as the cpu allows.  The input
+ * ports are fed in the order they are made from the channels of one
+ * sound file, the common inputs getting the first ones, and every output
+ * port is written to a file of its own named after it.  A timeline of
+ * osc style commands, one per line, is played into the engine at the
+ * frames they are for:
+ *
+ *   # seconds, or frames with an f after them
+ *   0.5     /sl/0/hit record
+ *   96000f  /sl/0/hit record
+ *   3.0     /sl/-1/set rate 0.5
+ *   4.0     /sl/-2/set tempo 120
+ *
+ * Between cycles it does what the main loop would otherwise do for the
+ * loops in its own time, keeping loop memory topped up and waiting for
+ * any stretching they asked for, so the same timeline always renders
+ * the same.  When it has run for the length asked for, or to the end of
+ * the input and timeline if none was, it tells the engine to quit.
+ */
+class OfflineAudioDriver
+	: public AudioDriver
+{
+  public:
+	OfflineAudioDriver(std::string client_name="", nframes_t samplerate=48000, nframes_t buffersize=256);
+	virtual ~OfflineAudioDriver();
+
+	// all of these have to be set before initialize
+	void set_input_file (std::string path) { _input_path = path; }
+	void set_output_dir (std::string path) { _output_dir = path; }
+	void set_timeline_file (std::string path) { _timeline_path = path; }
+	// seconds to run for, 0 runs to the end of the input and timeline
+	void set_length (float secs) { _length_secs = secs; }
+
+	bool initialize(std::string client_name="");
+	bool activate();
+	bool deactivate();
+
+	bool  create_input_port (std::string name, port_id_t & portid);
+	bool  create_output_port (std::string name, port_id_t & portid);
+
+	bool destroy_input_port (port_id_t portid);
+	bool destroy_output_port (port_id_t portid);
+
+	sample_t * get_input_port_buffer (port_id_t port, nframes_t nframes);
+	sample_t * get_output_port_buffer (port_id_t port, nframes_t nframes);
+
+	unsigned int get_input_port_count () { return _input_ports.size(); }
+	unsigned int get_output_port_count () { return _output_ports.size(); }
+
+	nframes_t get_input_port_latency (port_id_t portid) { return 0; }
+	nframes_t get_output_port_latency (port_id_t portid) { return 0; }
+
+  protected:
+
+	struct Port {
+		Port() : buffer(0), file(0), channel(-1) {}
+
+		std::string  name;
+		sample_t *   buffer;
+		SNDFILE *    file;    // outputs only
+		int          channel; // inputs only, of the input file
+	};
+
+	struct TimelineEvent {
+		nframes_t       frame;
+		Event::type_t   type;
+		Event::command_t cmd;
+		Event::control_t ctrl;
+		float           value;
+		int8_t          instance;
+	};
+
+	bool load_timeline ();
+	bool parse_timeline_line (const std::string & line, TimelineEvent & tev);
+
+	static void * _freewheel_thread (void * arg);
+	void freewheel ();
+	void read_input (nframes_t nframes);
+	void push_timeline_events (nframes_t nframes);
+	void write_outputs (nframes_t nframes);
+
+	void free_port (Port * port);
+
+	std::string _input_path;
+	std::string _output_dir;
+	std::string _timeline_path;
+	float       _length_secs;
+
+	SNDFILE *   _infile;
+	int         _infile_channels;
+	sample_t *  _inframes;
+
+	std::vector<Port *> _input_ports;
+	std::vector<Port *> _output_ports;
+	// held by the freewheel thread for a cycle, and when the ports change
+	pthread_mutex_t _port_lock;
+
+	std::vector<TimelineEvent> _timeline;
+	size_t      _timeline_pos;
+
+	nframes_t   _frame;
+	nframes_t   _length;
+
+	pthread_t     _thread;
+	bool          _running;
+	volatile bool _quit;
+};
+
+};
+
+#endif
@@ -0,0 +1,392 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+
+#include "page_pool.hpp"
+
+using namespace SooperLooper;
+
+// guards the list of pools and their growth, never taken by the audio thread
+static pthread_mutex_t pool_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static PagePool * pool_list = 0;
+
+PagePool::PagePool (unsigned int chans)
+	: _chans (chans), _page_floats ((unsigned long) PageFrames * chans), _users (0), _next (0),
+	  _extent_count (0), _page_count (0), _max_pages (FirstPage),
+	  _free_pages (0), _free_count (0), _feeds (0), _lock (0)
+{
+	memset (_extents, 0, sizeof(_extents));
+	memset (_refs, 0, sizeof(_refs));
+}
+
+PagePool::~PagePool ()
+{
+	for (unsigned long n = 0; n < _extent_count; ++n) {
+		free (_extents[n]);
+		free (_refs[n]);
+	}
+	free (_free_pages);
+}
+
+PagePool *
+PagePool::acquire (unsigned int chans, unsigned long quota)
+{
+	PagePool * pool;
+
+	pthread_mutex_lock (&pool_list_lock);
+
+	for (pool = pool_list; pool; pool = pool->_next) {
+		if (pool->_chans == chans) {
+			break;
+		}
+	}
+
+	if (!pool) {
+		pool = new PagePool (chans);
+		pool->_free_pages = (unsigned int *) calloc ((unsigned long) MaxExtents * ExtentPages, sizeof(unsigned int));
+
+		// the first extent holds the silent and scratch pages
+		if (!pool->_free_pages || !pool->add_extent ()) {
+			delete pool;
+			pthread_mutex_unlock (&pool_list_lock);
+			return 0;
+		}
+		pool->_next = pool_list;
+		pool_list = pool;
+	}
+
+	pool->_users++;
+	pool->_max_pages += quota;
+
+	pthread_mutex_unlock (&pool_list_lock);
+
+	pool->reserve (ReservePages);
+
+	return pool;
+}
+
+void
+PagePool::release (PagePool * pool, unsigned long quota)
+{
+	PagePool ** prev;
+
+	if (!pool) return;
+
+	pthread_mutex_lock (&pool_list_lock);
+
+	pool->_max_pages -= quota;
+
+	if (--pool->_users == 0) {
+		for (prev = &pool_list; *prev; prev = &(*prev)->_next) {
+			if (*prev == pool) {
+				*prev = pool->_next;
+				break;
+			}
+		}
+		delete pool;
+	}
+
+	pthread_mutex_unlock (&pool_list_lock);
+}
+
+void
+PagePool::maintain ()
+{
+	pthread_mutex_lock (&pool_list_lock);
+
+	for (PagePool * pool = pool_list; pool; pool = pool->_next) {
+		while (pool->_free_count < ReservePages && pool->add_extent ()) {
+		}
+		for (PageFeed * feed = pool->_feeds; feed; feed = feed->_next) {
+			pool->fill_feed (feed);
+		}
+		while (pool->_free_count < ReservePages && pool->add_extent ()) {
+		}
+	}
+
+	pthread_mutex_unlock (&pool_list_lock);
+}
+
+PageFeed *
+PagePool::add_feed (unsigned long quota)
+{
+	PageFeed * feed = new PageFeed (quota);
+
+	pthread_mutex_lock (&pool_list_lock);
+	feed->_next = _feeds;
+	_feeds = feed;
+	pthread_mutex_unlock (&pool_list_lock);
+
+	return feed;
+}
+
+void
+PagePool::remove_feed (PageFeed * feed)
+{
+	PageFeed ** prev;
+
+	if (!feed) return;
+
+	pthread_mutex_lock (&pool_list_lock);
+
+	for (prev = &_feeds; *prev; prev = &(*prev)->_next) {
+		if (*prev == feed) {
+			*prev = feed->_next;
+			break;
+		}
+	}
+
+	lock ();
+	for (; feed->_took != feed->_put; ++feed->_took) {
+		_free_pages[_free_count++] = feed->_pages[feed->_took % PageFeed::Size];
+	}
+	for (; feed->_reclaimed != feed->_gave; ++feed->_reclaimed) {
+		_free_pages[_free_count++] = feed->_returned[feed->_reclaimed % PageFeed::Size];
+	}
+	unlock ();
+
+	pthread_mutex_unlock (&pool_list_lock);
+
+	delete feed;
+}
+
+// called with the pool list lock held.  takes back the pages the user
+// returned and tops the feed up as far as the pool and its quota allow
+void
+PagePool::fill_feed (PageFeed * feed)
+{
+	unsigned long gave = feed->_gave;
+	unsigned long reclaimed = feed->_reclaimed;
+	// the user counts a page as held before it is gone from the feed,
+	// so reading them in this order never misses one
+	unsigned long took = feed->_took;
+	__sync_synchronize ();
+	unsigned long held = feed->_held;
+	unsigned long put = feed->_put;
+	unsigned long want = PageFeed::Size - (put - took);
+
+	if (held + (put - took) >= feed->_quota) {
+		want = 0;
+	}
+	else if (want > feed->_quota - held - (put - took)) {
+		want = feed->_quota - held - (put - took);
+	}
+
+	lock ();
+	for (; reclaimed != gave; ++reclaimed) {
+		_free_pages[_free_count++] = feed->_returned[reclaimed % PageFeed::Size];
+	}
+	for (; want > 0 && _free_count > 0; --want, ++put) {
+		feed->_pages[put % PageFeed::Size] = _free_pages[--_free_count];
+	}
+	unlock ();
+
+	// the pages are in place before the user can see them, and the
+	// returned ones are read before their places can be used again
+	__sync_synchronize ();
+	feed->_put = put;
+	feed->_reclaimed = reclaimed;
+	feed->_maintained = true;
+}
+
+void
+PagePool::reserve (unsigned long pages)
+{
+	pthread_mutex_lock (&pool_list_lock);
+
+	while (_free_count < pages && add_extent ()) {
+	}
+
+	pthread_mutex_unlock (&pool_list_lock);
+}
+
+// called with the pool list lock held
+bool
+PagePool::add_extent ()
+{
+	LADSPA_Data * data;
+	unsigned short * refs;
+	unsigned int first;
+
+	if (_extent_count >= MaxExtents || (_extent_count > 0 && _page_count >= _max_pages)) {
+		return false;
+	}
+
+	// calloc touches nothing, but the first write of a page happens in
+	// the audio thread, so fault the whole extent in here
+	data = (LADSPA_Data *) malloc (ExtentPages * _page_floats * sizeof(LADSPA_Data));
+	refs = (unsigned short *) calloc (ExtentPages, sizeof(unsigned short));
+	if (!data || !refs) {
+		free (data);
+		free (refs);
+		return false;
+	}
+	memset (data, 0, ExtentPages * _page_floats * sizeof(LADSPA_Data));
+
+	// published before any of its pages can be taken
+	_extents[_extent_count] = data;
+	_refs[_extent_count] = refs;
+	first = _extent_count << ExtentShift;
+	if (_extent_count == 0) {
+		first = FirstPage;
+	}
+
+	lock ();
+	// lowest pages on top
+	for (unsigned int page = ((_extent_count + 1) << ExtentShift) - 1; page >= first; --page) {
+		_free_pages[_free_count++] = page;
+	}
+	_extent_count++;
+	_page_count = _extent_count << ExtentShift;
+	unlock ();
+
+	return true;
+}
+
+unsigned long
+PagePool::take_pages (unsigned int * pages, unsigned long count)
+{
+	unsigned long n = 0;
+
+	if (!try_lock ()) {
+		return 0;
+	}
+
+	for (; n < count && _free_count > 0; ++n) {
+		pages[n] = _free_pages[--_free_count];
+	}
+
+	unlock ();
+
+	return n;
+}
+
+unsigned long
+PagePool::give_pages (const unsigned int * pages, unsigned long count)
+{
+	if (!try_lock ()) {
+		return 0;
+	}
+
+	for (unsigned long n = 0; n < count; ++n) {
+		_free_pages[_free_count++] = pages[n];
+	}
+
+	unlock ();
+
+	return count;
+}
+
+void
+PagePool::return_pages (const unsigned int * pages, unsigned long count)
+{
+	lock ();
+
+	for (unsigned long n = 0; n < count; ++n) {
+		_free_pages[_free_count++] = pages[n];
+	}
+
+	unlock ();
+}
+
+PageFeed::PageFeed (unsigned long quota)
+	: _quota (quota), _put (0), _took (0), _held (0),
+	  _gave (0), _reclaimed (0), _maintained (false), _next (0)
+{
+}
+
+unsigned long
+PageFeed::take_pages (unsigned int * pages, unsigned long count, unsigned long held)
+{
+	unsigned long took = _took;
+	unsigned long n = _put - took;
+
+	if (n > count) {
+		n = count;
+	}
+	// see PagePool::fill_feed
+	__sync_synchronize ();
+
+	for (unsigned long k = 0; k < n; ++k) {
+		pages[k] = _pages[(took + k) % Size];
+	}
+
+	_held = held + n;
+	__sync_synchronize ();
+	_took = took + n;
+
+	return n;
+}
+
+unsigned long
+PageFeed::give_pages (const unsigned int * pages, unsigned long count, unsigned long held)
+{
+	unsigned long gave = _gave;
+	unsigned long n = Size - (gave - _reclaimed);
+
+	if (n > count) {
+		n = count;
+	}
+	// see PagePool::fill_feed
+	__sync_synchronize ();
+
+	for (unsigned long k = 0; k < n; ++k) {
+		_returned[(gave + k) % Size] = pages[count - n + k];
+	}
+
+	_held = held - n;
+	__sync_synchronize ();
+	_gave = gave + n;
+
+	return n;
+}
+
+unsigned long
+PagePool::available_pages () const
+{
+	unsigned long grow = (_max_pages > _page_count) ? _max_pages - _page_count : 0;
+
+	return _free_count + grow;
+}
+
+// the lock is only ever held for a few list operations
+
+void
+PagePool::lock ()
+{
+	while (!try_lock ()) {
+		sched_yield ();
+	}
+}
+
+bool
+PagePool::try_lock ()
+{
+	return __sync_lock_test_and_set (&_lock, 1) == 0;
+}
+
+void
+PagePool::unlock ()
+{
+	__sync_lock_release (&_lock);
+}
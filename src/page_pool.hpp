@@ -0,0 +1,178 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#ifndef __sooperlooper_page_pool_h__
+#define __sooperlooper_page_pool_h__
+
+#include "ladspa.h"
+
+namespace SooperLooper {
+
+/*
+ * Pages put aside by PagePool::maintain() for one user of a pool, so that
+ * its audio thread can take them without the pool lock, and the pages it
+ * lets go of on their way back.  Only maintain() puts pages in and takes
+ * the returned ones out, and only the user does the opposite, so users
+ * running on different threads never wait for each other.
+ */
+class PageFeed
+{
+  public:
+	enum {
+		Size = 64
+	};
+
+	// takes up to count pages.  held is how many the user holds
+	// without these, which maintain() keeps the feed and it within quota
+	unsigned long take_pages (unsigned int * pages, unsigned long count, unsigned long held);
+
+	// gives back up to count pages from the end of pages, held is as
+	// for take_pages
+	unsigned long give_pages (const unsigned int * pages, unsigned long count, unsigned long held);
+
+	// after pages were taken from or given back to the pool directly
+	void set_held (unsigned long held) { _held = held; }
+
+	unsigned long count () const { return _put - _took; }
+
+	// once maintain() looks after the feed the user need not go to the
+	// pool itself at all
+	bool maintained () const { return _maintained; }
+
+  private:
+	friend class PagePool;
+
+	PageFeed (unsigned long quota);
+
+	unsigned long    _quota;
+	unsigned int     _pages[Size];
+	volatile unsigned long _put;
+	volatile unsigned long _took;
+	volatile unsigned long _held;
+	unsigned int     _returned[Size];
+	volatile unsigned long _gave;
+	volatile unsigned long _reclaimed;
+	volatile bool    _maintained;
+	PageFeed *       _next;
+};
+
+/*
+ * Loop memory shared by every looper with the same channel count.  The
+ * memory is handed out in pages of PageFrames frames, all channels of a
+ * page planar within it, and grows in extents of ExtentPages pages as
+ * the loopers use it up, never beyond the sum of their quotas.
+ *
+ * Page ZeroPage is always silent and ScratchPage takes writes that no
+ * page could be found for, neither is ever handed out.
+ *
+ * Memory is only allocated by reserve() and maintain(), which are not
+ * realtime safe.  take_pages() and give_pages() are, they never wait
+ * for the lock and may do nothing if another thread holds it.  A user
+ * that records mostly takes its pages from its PageFeed instead, which
+ * maintain() tops up.
+ */
+class PagePool
+{
+  public:
+	enum {
+		PageShift = 12,
+		PageFrames = 1 << PageShift,
+		ExtentShift = 6,
+		ExtentPages = 1 << ExtentShift,
+		MaxExtents = 4096,
+		// free pages maintain() tries to keep around
+		ReservePages = 2 * ExtentPages,
+
+		ZeroPage = 0,
+		ScratchPage = 1,
+		FirstPage = 2
+	};
+
+	// the pool for loopers of chans channels, made on first use.  quota
+	// is the most pages the new user can hold at once
+	static PagePool * acquire (unsigned int chans, unsigned long quota);
+	// every page taken must have been given back first
+	static void release (PagePool * pool, unsigned long quota);
+
+	// grows any pool that is running low and tops up the feeds of its
+	// users.  call it regularly from a thread other than the audio thread
+	static void maintain ();
+
+	// a feed for a user with the given quota, and letting go of it with
+	// the pages still in it.  not realtime safe
+	PageFeed * add_feed (unsigned long quota);
+	void remove_feed (PageFeed * feed);
+
+	// grows the pool until at least pages pages are free, or it is full
+	void reserve (unsigned long pages);
+
+	unsigned long take_pages (unsigned int * pages, unsigned long count);
+	unsigned long give_pages (const unsigned int * pages, unsigned long count);
+
+	// like give_pages, but waits for the lock.  not realtime safe
+	void return_pages (const unsigned int * pages, unsigned long count);
+
+	LADSPA_Data * page_data (unsigned int page) const {
+		return _extents[page >> ExtentShift] + (unsigned long) (page & (ExtentPages - 1)) * _page_floats;
+	}
+
+	// the pages are reference counted by the looper using them
+	unsigned short & page_refs (unsigned int page) {
+		return _refs[page >> ExtentShift][page & (ExtentPages - 1)];
+	}
+
+	// pages that are free or could still be allocated, not exact
+	unsigned long available_pages () const;
+
+	unsigned int channel_count () const { return _chans; }
+
+  private:
+	PagePool (unsigned int chans);
+	~PagePool ();
+
+	bool add_extent ();
+	void fill_feed (PageFeed * feed);
+	void lock ();
+	bool try_lock ();
+	void unlock ();
+
+	unsigned int     _chans;
+	unsigned long    _page_floats;
+	unsigned int     _users;
+	PagePool *       _next;
+
+	LADSPA_Data *    _extents[MaxExtents];
+	unsigned short * _refs[MaxExtents];
+	unsigned long    _extent_count;
+
+	// pages allocated, and the most that may be
+	unsigned long    _page_count;
+	unsigned long    _max_pages;
+
+	unsigned int *   _free_pages;
+	unsigned long    _free_count;
+
+	PageFeed *       _feeds;
+
+	volatile int     _lock;
+};
+
+};
+
+#endif
@@ -41,6 +41,9 @@ using namespace std;
 #include "utils.hpp"
 
 #include "event.hpp"
+#include "mix_kernels.hpp"
+#include "page_pool.hpp"
+#include "undo_spill.hpp"
 
 using namespace SooperLooper;
 
@@ -69,9 +72,48 @@ using namespace SooperLooper;
 //#define TRIG_SETTLE  4410
 #define TRIG_SETTLE  2205  
 
+// below this playback rate the play segment planner
+// leaves everything to the per-sample path
+#define MIN_SEGMENT_RATE 0.001f
+
 // another thing that shouldn't be hardcoded
 #define MAX_LOOPS 512
 
+// frontfill and backfill copy this many samples ahead at a time
+#define FILL_BLOCK 4096
+
+// loop memory is handed out in pages of this many frames.  page 0 is
+// always silent and stands in for anything not yet written, writes that
+// can't get a page of their own end up in page 1
+#define LOOP_PAGE_SHIFT  PagePool::PageShift
+#define LOOP_PAGE_FRAMES (1UL << LOOP_PAGE_SHIFT)
+#define LOOP_PAGE_MASK   (LOOP_PAGE_FRAMES - 1)
+#define ZERO_PAGE        ((unsigned int) PagePool::ZeroPage)
+#define SCRATCH_PAGE     ((unsigned int) PagePool::ScratchPage)
+#define FIRST_LOOP_PAGE  ((unsigned int) PagePool::FirstPage)
+
+// pages move between the stash and the shared pool this many at a time,
+// and the stash is topped up while it holds fewer than PAGE_STASH_LOW
+#define PAGE_BATCH       16
+#define PAGE_STASH_LOW   4
+
+// a page table entry for a page moved out to the undo file holds its
+// slot there with SPILLED_PAGE set, and LOADING_PAGE too while it is
+// being read back in
+#define SPILLED_PAGE     0x80000000U
+#define LOADING_PAGE     0x40000000U
+#define SPILL_SLOT_MASK  (LOADING_PAGE - 1)
+
+// history is only moved out once a looper holds more than half its
+// quota, at most SPILL_BATCH pages at a time, looking at no more than
+// SPILL_SCAN_PAGES page table entries per run
+#define SPILL_BATCH      32
+#define SPILL_SCAN_PAGES 512
+// most loops kept in memory around the head, see warmLoops()
+#define SPILL_WARM_MAX   16
+// size of lHeldMultiCtrl
+#define SPILL_HOLD_MAX   32
+
 
 #define SAFETY_FEEDBACK 0.96f
 
@@ -158,536 +200,1863 @@ using namespace SooperLooper;
 #define MAX(x,y) \
 	f_max (x, y)
 
+// the fade envelopes, see FadeEnvelope
 
-
-// reads loop audio into buffer, up to frames length, starting from loop_offset.  if fewer frames are
-// available returns amount read.  if 0 is returned loop is done.
-unsigned long
-sl_read_current_loop_audio (LADSPA_Handle instance, float * buf, unsigned long frames, unsigned long loop_offset)
+static inline void fadeStart (FadeEnvelope *fade, LADSPA_Data delta)
 {
-	SooperLooperI * pLS = (SooperLooperI *)instance;
+	fade->delta = delta;
+	fade->constant = 0;
+}
 
-	if (!pLS || !buf) return 0;
+static inline void fadeSet (FadeEnvelope *fade, LADSPA_Data atten)
+{
+	fade->atten = atten;
+	fade->constant = 0;
+}
 
-	LoopChunk * loop = pLS->headLoopChunk;
-	if (!loop) return 0;
-	if (loop_offset > loop->lLoopLength) return 0;
-	
-	// adjust for sync pos, so that a loop_offset of 0 actually means start from the syncpos
-	unsigned long adj_offset  = (loop_offset + (loop->lLoopLength - loop->lSyncPos)) % loop->lLoopLength;
-	unsigned long frames_left = loop->lLoopLength - loop_offset;
-	unsigned long startpos = (loop->lLoopStart + adj_offset) & pLS->lBufferSizeMask;
-	unsigned long first_chunk;
-	unsigned long second_chunk=0;
+// one sample of the ramp, nothing at all once it has come to rest
+static inline void fadeStep (FadeEnvelope *fade)
+{
+	LADSPA_Data atten;
 
-	if (adj_offset > (loop->lLoopLength - loop->lSyncPos)) {
-		// between sync and end of loop mem, clamp frames
-		frames = std::min(loop->lLoopLength-adj_offset, frames);
+	if (fade->constant) {
+		return;
 	}
 
-	if (frames > frames_left) {
-		frames = frames_left;
-	}
-	
-	if ( startpos > ((startpos + frames) & pLS->lBufferSizeMask)) {
-		// crosses buffer boundary, 2 chunks needed
-		first_chunk = pLS->lBufferSize - startpos;
-		second_chunk = frames - first_chunk;
-	}
-	else {
-		first_chunk = frames;
-		second_chunk = 0;
+	atten = LIMIT_BETWEEN_0_AND_1 (fade->atten + fade->delta);
+	fade->constant = (atten == fade->atten);
+	fade->atten = atten;
+}
+
+// true if the fade envelope will not change when stepped
+static inline bool fadeSettled (const FadeEnvelope *fade)
+{
+	return (fade->constant || fade->delta == 0.0f
+		|| (fade->atten == 0.0f && fade->delta < 0.0f) || (fade->atten == 1.0f && fade->delta > 0.0f));
+}
+
+// iterate over the planar channels of an instance.  off is the offset of
+// the channel in a loop memory page, inoff in the input latency memory
+#define FOR_EACH_CHANNEL(pLS, chan, off, inoff) \
+	for (chan = 0, off = 0, inoff = 0; chan < (pLS)->lChannelCount; \
+	     ++chan, off += LOOP_PAGE_FRAMES, inoff += (pLS)->lInputBufSize)
+
+// number of samples, at most lMax, that can be walked from lPos in a
+// ring of lSize samples before it wraps around
+static inline unsigned long ringSpan (unsigned long lPos, unsigned long lMax, unsigned long lSize)
+{
+	unsigned long lRoom = lSize - lPos;
+	return (lRoom < lMax) ? lRoom : lMax;
+}
+
+// position within a loop of lLength samples, same as fmod() but without
+// the call in the usual case where the position has not wrapped
+static inline double loopWrap (double dPos, unsigned long lLength)
+{
+	if (dPos >= 0.0 && dPos < lLength) {
+		return dPos;
 	}
+	return fmod (dPos, lLength);
+}
 
+// see sl_set_block_paths
+static unsigned int g_blockPaths = PathAll;
 
-	// read first chunk
-	memcpy ((char *)buf, (char *) &pLS->pSampleBuf[startpos], first_chunk * sizeof(LADSPA_Data));
+// the record position, fBehind samples of playback before dPos
+static inline double trailingPos (double dPos, LADSPA_Data fBehind, unsigned long lLength)
+{
+	double dRec = loopWrap (dPos - fBehind, lLength);
 
-	if (second_chunk) {
-		memcpy ((char *) (buf + first_chunk), (char *) pLS->pSampleBuf, second_chunk * sizeof(LADSPA_Data));
+	if (dRec < 0) {
+		dRec += lLength;
 	}
+	return dRec;
+}
 
-	return frames;
+// true if writing b over a leaves the same bits, unlike a == b this
+// tells -0.0f and 0.0f apart
+static inline bool sameSample (LADSPA_Data a, LADSPA_Data b)
+{
+	return memcmp (&a, &b, sizeof(LADSPA_Data)) == 0;
 }
 
-void
-sl_set_samples_since_sync (LADSPA_Handle instance, unsigned long frames)
+
+// true if lPos is a multiple of lLength, see QuantBoundary
+static inline bool onQuantBoundary (QuantBoundary *qb, long lPos, unsigned long lLength)
 {
-	SooperLooperI * pLS = (SooperLooperI *)instance;
+	long lLen = (long) lLength;
+	long lRem;
 
-	if (!pLS) return;
+	if (lLength == 0) {
+		return false;
+	}
 
-	pLS->lSamplesSinceSync = frames;
+	if (lLength != qb->lLength || lPos < qb->lLow || lPos > qb->lLow + lLen) {
+		lRem = lPos % lLen;
+		if (lRem < 0) {
+			lRem += lLen;
+		}
+		qb->lLength = lLength;
+		qb->lLow = lPos - lRem;
+	}
+
+	return lPos == qb->lLow || lPos == qb->lLow + lLen;
 }
 
-void
-sl_set_replace_quantized (LADSPA_Handle instance, bool value)
+// true if the loop position lPos is a quantize point in fQuantizeMode
+static inline bool onQuantPoint (SooperLooperI *pLS, LoopChunk *loop, long lPos,
+				 LADSPA_Data fQuantizeMode, unsigned int eighthSamples)
 {
-	SooperLooperI * pLS = (SooperLooperI *)instance;
+	lPos += loop->lSyncPos;
 
-	if (!pLS) return;
-	pLS->bReplaceQuantized = value;
+	if (fQuantizeMode == QUANT_OFF) {
+		return true;
+	}
+	else if (fQuantizeMode == QUANT_CYCLE) {
+		return onQuantBoundary (&pLS->quantBound, lPos, loop->lCycleLength);
+	}
+	else if (fQuantizeMode == QUANT_LOOP) {
+		return onQuantBoundary (&pLS->quantBound, lPos, loop->lLoopLength);
+	}
+	else if (fQuantizeMode == QUANT_8TH) {
+		return onQuantBoundary (&pLS->quantBound, lPos, eighthSamples);
+	}
+
+	return false;
 }
 
-void
-sl_set_loop_index (LADSPA_Handle instance, unsigned int value, unsigned int chan)
+
+/*****************************************************************************/
+// loop memory pages
+
+// number of samples, at most lMax, from lPos to the end of its page
+static inline unsigned long pageSpan (unsigned long lPos, unsigned long lMax)
 {
-	SooperLooperI * pLS = (SooperLooperI *)instance;
-	
-	if (!pLS) return;
-	pLS->lLoopIndex = value;
-	pLS->lChannelIndex = chan;
-	DBG(fprintf(stderr, "set loop: %u  chan: %u\n", pLS->lLoopIndex, pLS->lChannelIndex));
+	return ringSpan (lPos & LOOP_PAGE_MASK, lMax, LOOP_PAGE_FRAMES);
 }
 
-bool
-sl_get_replace_quantized (LADSPA_Handle instance)
+static inline LADSPA_Data * pageData (SooperLooperI *pLS, unsigned int page)
 {
-	SooperLooperI * pLS = (SooperLooperI *)instance;
-	if (!pLS) return false;
-	return pLS->bReplaceQuantized;
+	return pLS->pPagePool->page_data (page);
 }
 
+// the sample at lPos in the loop, for reading only.  memory that has
+// never been written reads as silence, as does memory that is out in
+// the undo file (only if a held command gave up waiting for it)
+static inline LADSPA_Data * loopReadPtr (SooperLooperI *pLS, LoopChunk *loop, unsigned long lPos)
+{
+	unsigned long lPage = lPos >> LOOP_PAGE_SHIFT;
+	unsigned int page = (lPage < loop->lPageCount) ? loop->pPages[lPage] : ZERO_PAGE;
+
+	if (page & SPILLED_PAGE) {
+		page = ZERO_PAGE;
+	}
 
-bool sl_has_loop (const LADSPA_Handle instance)
+	return pageData (pLS, page) + (lPos & LOOP_PAGE_MASK);
+}
+
+// true if loop position lPos is the very same memory as srcloop position
+// lSrcPos, as after shareLoopPages, so copying one to the other would
+// leave both as they are
+static inline bool sameFrame (LoopChunk *loop, unsigned long lPos, LoopChunk *srcloop, unsigned long lSrcPos)
 {
-	const SooperLooperI * pLS = (const SooperLooperI *)instance;
-	if (!pLS) return false;
-        return pLS->headLoopChunk != 0;
+	unsigned long lPage = lPos >> LOOP_PAGE_SHIFT;
+	unsigned long lSrcPage = lSrcPos >> LOOP_PAGE_SHIFT;
+	unsigned int page = (lPage < loop->lPageCount) ? loop->pPages[lPage] : ZERO_PAGE;
+	unsigned int srcpage = (lSrcPage < srcloop->lPageCount) ? srcloop->pPages[lSrcPage] : ZERO_PAGE;
+
+	return (page == srcpage && !(page & SPILLED_PAGE)
+		&& (lPos & LOOP_PAGE_MASK) == (lSrcPos & LOOP_PAGE_MASK));
 }
 
-static bool invalidateTails (SooperLooperI * pLS, unsigned long bufstart, unsigned long buflen, LoopChunk * currloop)
+// a free page from the stash, topping it up when it runs low.  returns
+// ZERO_PAGE if there is none, with *pbExhausted set only if that is
+// because we are at our quota and not just because the feed has yet to
+// be topped up or the pool is busy
+static unsigned int takePage (SooperLooperI *pLS, bool *pbExhausted)
 {
-	LoopChunk * tailLoop = pLS->tailLoopChunk;
-	LoopChunk * tmploop;
-	
-	if (!tailLoop) {
-		return false;
+	unsigned long lHeld = pLS->lPagesInUse + pLS->lStashCount;
+	unsigned long lWant, lGot;
+	unsigned int page;
+
+	*pbExhausted = false;
+
+	if (pLS->lStashCount < PAGE_STASH_LOW && lHeld < pLS->lMaxLoopPages) {
+		lWant = min ((unsigned long) PAGE_BATCH, pLS->lMaxLoopPages - lHeld);
+		lGot = pLS->pPageFeed->take_pages (pLS->pPageStash + pLS->lStashCount, lWant, lHeld);
+
+		if (lGot == 0 && !pLS->bPoolBusy && !pLS->pPageFeed->maintained()) {
+			// nothing tops up the feed in a plain LADSPA host
+			lGot = pLS->pPagePool->take_pages (pLS->pPageStash + pLS->lStashCount, lWant);
+			pLS->bPoolBusy = (lGot == 0);
+			pLS->pPageFeed->set_held (lHeld + lGot);
+		}
+		pLS->lStashCount += lGot;
 	}
-	
-	while (tailLoop  && tailLoop != currloop && 
-	       (((bufstart + buflen) < pLS->lBufferSize &&
-		 (tailLoop->lLoopStart >= bufstart && tailLoop->lLoopStart < (bufstart + buflen)))
-		||
-		((bufstart + buflen) >= pLS->lBufferSize &&
-		 (tailLoop->lLoopStart < ((bufstart + buflen) & pLS->lBufferSizeMask)
-		  || tailLoop->lLoopStart >= bufstart))))
-	{
-		
-		// this invalidates a loop
-		if (tailLoop->valid) {
-			DBG(fprintf(stderr, "%u:%u  invalidating %08x\n", pLS->lLoopIndex, pLS->lChannelIndex, (unsigned) tailLoop));
-			tailLoop->valid = 0;
-			if (tailLoop->next) {
-				tailLoop->next->prev = 0;
-			}
-			tmploop = tailLoop->next;
-			//tailLoop->next = 0;
-			tailLoop = tmploop;
+
+	if (pLS->lStashCount == 0) {
+		// the stash only runs dry under the quota when no other looper
+		// holds more than its own, so then more will come
+		*pbExhausted = (pLS->lPagesInUse >= pLS->lMaxLoopPages);
+		return ZERO_PAGE;
+	}
+
+	page = pLS->pPageStash[--pLS->lStashCount];
+	pLS->pPagePool->page_refs (page) = 1;
+	pLS->lPagesInUse++;
+
+	return page;
+}
+
+static inline void releasePage (SooperLooperI *pLS, unsigned int page)
+{
+	unsigned long lHeld;
+
+	if (page < FIRST_LOOP_PAGE || --pLS->pPagePool->page_refs (page) != 0) {
+		return;
+	}
+
+	pLS->pPageStash[pLS->lStashCount++] = page;
+	pLS->lPagesInUse--;
+
+	if (pLS->lStashCount >= 2 * PAGE_BATCH) {
+		// if the feed is full or the pool busy they just stay with us a
+		// little longer
+		lHeld = pLS->lPagesInUse + pLS->lStashCount;
+		if (pLS->pPageFeed->maintained()) {
+			pLS->lStashCount -= pLS->pPageFeed->give_pages (pLS->pPageStash + pLS->lStashCount - PAGE_BATCH, PAGE_BATCH, lHeld);
 		}
 		else {
-			// this really shouldn't happen
-			DBG(fprintf(stderr, "%u:%u  we've hit the last tail this shoudlnt happen\n",pLS->lLoopIndex, pLS->lChannelIndex));
-			tailLoop = 0;
+			pLS->lStashCount -= pLS->pPagePool->give_pages (pLS->pPageStash + pLS->lStashCount - PAGE_BATCH, PAGE_BATCH);
+			pLS->pPageFeed->set_held (pLS->lPagesInUse + pLS->lStashCount);
 		}
+	}
+}
 
-		// tailLoop = (tailLoop == pLS->lastLoopChunk) ? pLS->pLoopChunks: tailLoop + 1;
-		pLS->tailLoopChunk = tailLoop;
+static bool sendSpill (SooperLooperI *pLS, int op, LoopChunk *loop, unsigned long lPage, unsigned int page, unsigned int slot)
+{
+	UndoSpill::Request req;
+
+	if (!pLS->pUndoSpill) {
+		return false;
 	}
 
-// 	if (!tailLoop || tailLoop == currloop) {
-// 		DBG(fprintf(stderr, "we've hit nothing or ourselves, returning false\n"));
-// 		return false;
-// 	}
-	if (pLS->tailLoopChunk == NULL) {
-		// we invalidated the last loop
-		pLS->tailLoopChunk = currloop;
+	req.op = op;
+	req.owner = loop;
+	req.serial = loop ? loop->lSerial : 0;
+	req.index = lPage;
+	req.page = page;
+	req.slot = slot;
+	req.ok = false;
+
+	return pLS->pUndoSpill->send (req);
+}
+
+// drop page lPage of the loop that is out in the undo file
+static void forgetSpilledPage (SooperLooperI *pLS, LoopChunk *loop, unsigned long lPage)
+{
+	unsigned int entry = loop->pPages[lPage];
+
+	if (entry & LOADING_PAGE) {
+		// the answer to the restore finds the entry changed and lets go of the slot
+		loop->lLoadingPages--;
 	}
-	
-	return true;
+	else if (!sendSpill (pLS, UndoSpill::Forget, 0, 0, 0, entry & SPILL_SLOT_MASK)) {
+		DBG(fprintf(stderr, "%u:%u  undo file slot %u lost\n", pLS->lLoopIndex, pLS->lChannelIndex, entry & SPILL_SLOT_MASK));
+	}
+
+	loop->lSpilledPages--;
+	loop->pPages[lPage] = ZERO_PAGE;
 }
 
-static LoopChunk * ensureLoopSpace(SooperLooperI* pLS, LoopChunk *loop, unsigned long morelength, LoopChunk * pendsrc)
+static void releaseLoopPages (SooperLooperI *pLS, LoopChunk *loop)
 {
-	// TODO: check to see if we'll require more space than the buffer allows
-	
-	if (!loop) {
-		loop = (pLS->headLoopChunk == pLS->lastLoopChunk) ? pLS->pLoopChunks: pLS->headLoopChunk + 1;
-		loop->lLoopStart = (pLS->headLoopChunk->lLoopStart + pLS->headLoopChunk->lLoopLength) & pLS->lBufferSizeMask;
-		loop->lLoopLength = 0;
-		loop->lCycleLength = 0;
-		loop->lCycles = 0;
-		loop->dCurrPos = 0;
-		loop->frontfill = 0;
-		loop->backfill = 0;
-		loop->valid = 1;
-		loop->mult_out = 0;
-		loop->lSyncOffset = 0;
-		loop->lSyncPos = 0;
-		loop->lOrigSyncPos = 0;
-		
-		loop->next = NULL;
-		loop->prev = pLS->headLoopChunk;
-		if (loop->prev) {
-			loop->prev->next = loop;
-			// do this to help out the overdub fail case
-			loop->lCycles = loop->prev->lCycles;
-			loop->lCycleLength = loop->prev->lCycleLength;
-			loop->lLoopLength = loop->prev->lLoopLength;
-			loop->dCurrPos = loop->prev->dCurrPos;
+	for (unsigned long n = 0; n < loop->lPageCount; ++n) {
+		if (loop->pPages[n] & SPILLED_PAGE) {
+			forgetSpilledPage (pLS, loop, n);
 		}
-		loop->srcloop = pendsrc;
+		else {
+			releasePage (pLS, loop->pPages[n]);
+		}
+		loop->pPages[n] = ZERO_PAGE;
+	}
+	loop->lPageCount = 0;
+}
 
-		pLS->headLoopChunk = loop;
+// make loop use the same pages as srcloop, the first write to any of
+// them will copy it
+static void shareLoopPages (SooperLooperI *pLS, LoopChunk *loop, LoopChunk *srcloop)
+{
+	releaseLoopPages (pLS, loop);
+
+	for (unsigned long n = 0; n < srcloop->lPageCount; ++n) {
+		unsigned int page = srcloop->pPages[n];
+		if (page & SPILLED_PAGE) {
+			// a source is always brought back in first, but just in case
+			page = ZERO_PAGE;
+		}
+		else if (page >= FIRST_LOOP_PAGE) {
+			++pLS->pPagePool->page_refs (page);
+		}
+		loop->pPages[n] = page;
 	}
-	else {
+	loop->lPageCount = srcloop->lPageCount;
+}
 
-		// check to see if we'll require more space than the buffer allows
-		if (loop->lLoopLength + morelength > pLS->lBufferSize) {
-			DBG(fprintf(stderr, "%u:%u  requesting more space than exists in buffer!\n",pLS->lLoopIndex, pLS->lChannelIndex));
-			return NULL;
+// true if loop is the head, currloop or one of the sources currloop
+// still reads from, directly or through pending fills
+static bool loopInUse (SooperLooperI *pLS, LoopChunk *loop, LoopChunk *currloop)
+{
+	LoopChunk *chain = currloop;
+
+	if (loop == pLS->headLoopChunk) {
+		return true;
+	}
+
+	for (int n = 0; chain && n < MAX_LOOPS; ++n) {
+		if (chain == loop) {
+			return true;
+		}
+		if (n > 0 && (!chain->valid || (!chain->frontfill && !chain->backfill))) {
+			break;
 		}
+		if (chain->srcloop == chain) {
+			break;
+		}
+		chain = chain->srcloop;
 	}
-	
-	// invalidate any tails in this area
-	invalidateTails (pLS, loop->lLoopStart, loop->lLoopLength + morelength, loop);
 
-	return loop;
+	return false;
 }
 
+// drop the oldest loop in the undo history to get its pages back.
+// returns false if that loop is still in use
+static bool dropOldestLoop (SooperLooperI *pLS, LoopChunk *currloop)
+{
+	LoopChunk *tailLoop = pLS->tailLoopChunk;
 
-// creates a new loop chunk and puts it on the head of the list
-// returns the new chunk
-static LoopChunk * pushNewLoopChunk(SooperLooperI* pLS, unsigned long initLength, LoopChunk * pendsrc)
+	if (!tailLoop || !tailLoop->valid || loopInUse (pLS, tailLoop, currloop)) {
+		return false;
+	}
+
+	DBG(fprintf(stderr, "%u:%u  invalidating %08x\n", pLS->lLoopIndex, pLS->lChannelIndex, (unsigned) tailLoop));
+	tailLoop->valid = 0;
+	if (tailLoop->next) {
+		tailLoop->next->prev = 0;
+	}
+	pLS->tailLoopChunk = tailLoop->next ? tailLoop->next : pLS->headLoopChunk;
+	pLS->lTailLoopChunk++;
+
+	releaseLoopPages (pLS, tailLoop);
+
+	return true;
+}
+
+// give page lPage of the loop memory of its own, copied from whatever it
+// was sharing.  if there is no memory left the write goes to the scratch page
+static unsigned int makePageWritable (SooperLooperI *pLS, LoopChunk *loop, unsigned long lPage)
 {
-   LoopChunk * loop;   
+	unsigned int oldpage, page;
+	bool bExhausted;
 
-   if (pLS->headLoopChunk) {
-      // use the next spot in memory
+	if (lPage >= pLS->lMaxLoopPages) {
+		return SCRATCH_PAGE;
+	}
 
-      loop = ensureLoopSpace (pLS, NULL, initLength, pendsrc);
+	oldpage = (lPage < loop->lPageCount) ? loop->pPages[lPage] : ZERO_PAGE;
 
-      if (!loop) {
-	      return NULL;
-      }
-      
+	if (oldpage & SPILLED_PAGE) {
+		// written over before it made it back in
+		forgetSpilledPage (pLS, loop, lPage);
+		oldpage = ZERO_PAGE;
+	}
 
-      // we are the new head
-      pLS->headLoopChunk = loop;
-      
-   }
-   else {
-      // first loop on the list!
-      loop = pLS->pLoopChunks;
-      loop->next = loop->prev = NULL;
-      pLS->headLoopChunk = pLS->tailLoopChunk = loop;
-      loop->lLoopStart = 0;
-      loop->valid = 1;
-   }
-   
+	// at the quota, make room from our own history
+	while ((page = takePage (pLS, &bExhausted)) == ZERO_PAGE) {
+		if (!bExhausted) {
+			// more pages are on their way, this write is lost but
+			// the history stays
+			DBG(fprintf(stderr, "%u:%u  waiting for loop memory\n", pLS->lLoopIndex, pLS->lChannelIndex));
+			return SCRATCH_PAGE;
+		}
+		if (!dropOldestLoop (pLS, loop)) {
+			DBG(fprintf(stderr, "%u:%u  out of loop memory!\n", pLS->lLoopIndex, pLS->lChannelIndex));
+			return SCRATCH_PAGE;
+		}
+		if (oldpage >= FIRST_LOOP_PAGE && pLS->pPagePool->page_refs (oldpage) == 1) {
+			// that dropped the last other user
+			return oldpage;
+		}
+	}
 
-   DBG(fprintf(stderr, "%u:%u  New head is %08x   start: %lu\n",pLS->lLoopIndex, pLS->lChannelIndex, (unsigned)loop, loop->lLoopStart);)
+	if (oldpage == ZERO_PAGE) {
+		memset (pageData (pLS, page), 0, LOOP_PAGE_FRAMES * pLS->lChannelCount * sizeof(LADSPA_Data));
+	}
+	else {
+		memcpy (pageData (pLS, page), pageData (pLS, oldpage), LOOP_PAGE_FRAMES * pLS->lChannelCount * sizeof(LADSPA_Data));
+		releasePage (pLS, oldpage);
+	}
 
-   
-   return loop;
-}
+	loop->pPages[lPage] = page;
+	if (lPage >= loop->lPageCount) {
+		loop->lPageCount = lPage + 1;
+	}
 
+	return page;
+}
 
-// pop the head off and free it
-static void popHeadLoop(SooperLooperI *pLS, bool forceClear)
+// seconds of new material we could record without dropping any history
+static LADSPA_Data freeLoopSecs (SooperLooperI *pLS)
 {
-   LoopChunk *dead;
-   dead = pLS->headLoopChunk;
+	unsigned long lFree = pLS->lMaxLoopPages - pLS->lPagesInUse;
+	unsigned long lAvail = pLS->lStashCount + pLS->pPageFeed->count() + pLS->pPagePool->available_pages();
 
-   if (dead && dead->prev) {
-      // leave the next where is is for redo
-      //dead->prev->next = NULL;
-	   pLS->headLoopChunk = dead->prev;
-	   if (!pLS->headLoopChunk->prev) {
-		   pLS->tailLoopChunk = pLS->headLoopChunk; 
-	   }
-   }
-   else if (dead && (!dead->next || forceClear)) {
-	   // only clear the loop if this was the only loop in history
-	   pLS->headLoopChunk = NULL;
-	   // pLS->tailLoopChunk is still valid to support redo
-	   // from nothing
-   }
+	return (LADSPA_Data) (min (lFree, lAvail) << LOOP_PAGE_SHIFT) / pLS->fSampleRate;
 }
 
-// clear all LoopChunks (undoAll , can still redo them back)
-static void clearLoopChunks(SooperLooperI *pLS)
+// the sample at lPos in the loop, for reading and writing
+static inline LADSPA_Data * loopWritePtr (SooperLooperI *pLS, LoopChunk *loop, unsigned long lPos)
 {
-   
-   pLS->headLoopChunk = NULL;
+	unsigned long lPage = lPos >> LOOP_PAGE_SHIFT;
+	unsigned int page = (lPage < loop->lPageCount) ? loop->pPages[lPage] : ZERO_PAGE;
+
+	if (page < FIRST_LOOP_PAGE || (page & SPILLED_PAGE) || pLS->pPagePool->page_refs (page) != 1) {
+		page = makePageWritable (pLS, loop, lPage);
+	}
+
+	return pageData (pLS, page) + (lPos & LOOP_PAGE_MASK);
 }
 
-static void undoLoop(SooperLooperI *pLS, bool forceClear)
+// fade the input at lInputPos of the latency buffer into the source at
+// the record position.  once the fade is over that still turns a
+// negative zero positive, and anything into a NaN if the input is not
+// finite, so the source is only written where it changes
+static inline void fadeIntoSource (SooperLooperI *pLS, LoopChunk *srcloop, unsigned long lPos,
+				   const LADSPA_Data *pfInputLatencyBuf, unsigned long lInputPos)
 {
-   LoopChunk *loop = pLS->headLoopChunk;
-   LoopChunk *prevloop;
-   
-   if (!loop) return;
-	
-   prevloop = loop->prev;
+	LADSPA_Data *pSrc = loopReadPtr (pLS, srcloop, lPos);
+	LADSPA_Data fSample;
+	unsigned int chan;
+	unsigned long off, inoff;
+
+	FOR_EACH_CHANNEL(pLS, chan, off, inoff) {
+		fSample = (pSrc[off] * pLS->feedSrcFade.atten) + pLS->loopSrcFade.atten * pfInputLatencyBuf[inoff + lInputPos];
+		if (!sameSample (fSample, pSrc[off])) {
+			pSrc = loopWritePtr (pLS, srcloop, lPos);
+			pSrc[off] = fSample;
+		}
+	}
+}
 
-   //if (prevloop && prevloop == loop->srcloop) {
-      // if the previous was the source of the one we're undoing
-      // pass the dCurrPos along, otherwise leave it be.
-   // nevermind, ALWAYS pass it along, what the hell
-   if (prevloop) {
-	   prevloop->dCurrPos = fmod(loop->dCurrPos+loop->lStartAdj, prevloop->lLoopLength);
-   }
-   
-   popHeadLoop(pLS, forceClear);
-   DBG(fprintf(stderr, "%u:%u  Undoing last loop %08x: new head is %08x\n" , pLS->lLoopIndex, pLS->lChannelIndex, (unsigned)loop,
-	       (unsigned)pLS->headLoopChunk);)
-}
 
+/*****************************************************************************/
+// moving cold undo history out to the undo file and back
 
-static void redoLoop(SooperLooperI *pLS)
+// adds loop, and the sources it still fills from, to the warm loops.
+// false if they don't all fit
+static bool addWarmLoop (LoopChunk **warm, int &count, LoopChunk *loop)
 {
-   LoopChunk *loop = NULL;
-   LoopChunk *nextloop = NULL;
+	for (int n = 0; loop && n < MAX_LOOPS; ++n) {
+		int i;
 
-   if (pLS->headLoopChunk) {
-      loop = pLS->headLoopChunk;
-      nextloop = loop->next;
-   }
-   else if (pLS->tailLoopChunk) {
-      // we've undone everything, use the tail
-      loop = NULL;
-      nextloop = pLS->tailLoopChunk;
-   }
+		for (i = 0; i < count && warm[i] != loop; ++i) {
+		}
+		if (i == count) {
+			if (count >= SPILL_WARM_MAX) {
+				return false;
+			}
+			warm[count++] = loop;
+		}
 
-   if (nextloop) {
-      
-	   //if (loop && loop == nextloop->srcloop) {
-	   // if the next is using us as a source
-	   // pass the dCurrPos along, otherwise leave it be.
-	   // nevermind, ALWAYS pass it along
-	   if (loop) {
-		   nextloop->dCurrPos = fmod(loop->dCurrPos+loop->lStartAdj, nextloop->lLoopLength);
-	   }
-	   else {
-		   // start at loop beginning
-		   nextloop->dCurrPos = nextloop->lLoopLength - nextloop->lSyncPos;
-	   }
-	   
-	   pLS->headLoopChunk = nextloop;
-	   
-	   DBG(fprintf(stderr, "%u:%u  Redoing last loop %08x: new head is %08x\n", pLS->lLoopIndex, pLS->lChannelIndex, (unsigned)loop,
-		       (unsigned)pLS->headLoopChunk);)
+		// the same walk as loopInUse()
+		if (n > 0 && (!loop->valid || (!loop->frontfill && !loop->backfill))) {
+			break;
+		}
+		if (loop->srcloop == loop) {
+			break;
+		}
+		loop = loop->srcloop;
+	}
 
-   }
+	return true;
 }
 
+static inline LoopChunk * loopOfGeneration (SooperLooperI *pLS, unsigned int gen)
+{
+	return pLS->pLoopChunks + gen % pLS->lLoopChunkCount;
+}
 
+// makes loop the only one in the history
+static void resetLoopHistory (SooperLooperI *pLS, LoopChunk *loop)
+{
+	pLS->headLoopChunk = pLS->tailLoopChunk = loop;
+	loop->next = NULL;
+	loop->prev = NULL;
 
-/*****************************************************************************/
+	pLS->lHeadLoopChunk = pLS->lTailLoopChunk = loop - pLS->pLoopChunks;
+	pLS->lEndLoopChunk = pLS->lHeadLoopChunk + 1;
+}
 
-/* Construct a new plugin instance. */
-LADSPA_Handle 
-instantiateSooperLooper(const LADSPA_Descriptor * Descriptor,
-			unsigned long             SampleRate)
+// the loop that redo all would end up at
+static LoopChunk * lastRedoLoop (SooperLooperI *pLS)
 {
+	if (pLS->headLoopChunk) {
+		if (pLS->lEndLoopChunk - pLS->lHeadLoopChunk <= 1) {
+			return NULL;
+		}
+	}
+	else if (!pLS->tailLoopChunk || pLS->lEndLoopChunk == pLS->lTailLoopChunk) {
+		return NULL;
+	}
 
-   SooperLooperI * pLS;
-   char * sampmem;
-   
-   // important note: using calloc to zero all data
-   pLS = (SooperLooperI *) calloc(1, sizeof(SooperLooperI));
-   
-   if (pLS == NULL) 
-      return NULL;
+	return loopOfGeneration (pLS, pLS->lEndLoopChunk - 1);
+}
 
-   pLS->pSampleBuf = NULL;
-   pLS->pLoopChunks = NULL;
-   pLS->pInputBuf = NULL;
-   
-   pLS->fSampleRate = (LADSPA_Data)SampleRate;
+// the loops that are kept in memory: the head, the loops that an undo,
+// redo or redo all would go to and whatever those fill from.  false if
+// there are more than SPILL_WARM_MAX, then nothing counts as cold
+static bool warmLoops (SooperLooperI *pLS, LoopChunk **warm, int &count)
+{
+	LoopChunk *head = pLS->headLoopChunk;
 
-   pLS->fTotalSecs = SAMPLE_MEMORY;
-   
-   // HACK for the moment!
-   sampmem = getenv("SL_SAMPLE_TIME");
-   if (sampmem != NULL) {
-	   if (sscanf(sampmem, "%f", &pLS->fTotalSecs) != 1) {
-		   pLS->fTotalSecs = SAMPLE_MEMORY;
-	   }
-	   // printf ("Got sample mem: %f\n", pLS->fTotalSecs);
-   }
-   
-   // we do include the LoopChunk structures in the Buf, so we really
-   // get a little less the SAMPLE_MEMORY seconds
-   //pLS->lBufferSize = (unsigned long)((LADSPA_Data)SampleRate * pLS->fTotalSecs * sizeof(LADSPA_Data));
-   pLS->lBufferSize = (unsigned long) pow (2.0, ceil (log2 ((LADSPA_Data)SampleRate * pLS->fTotalSecs)));
-   pLS->fTotalSecs = pLS->lBufferSize / (float) SampleRate;
-   pLS->lBufferSizeMask = pLS->lBufferSize - 1;
-   
-   // not using calloc to force touching all memory ahead of time 
-   // this could be bad if you try to allocate too much for your system
-   // well, we are using calloc again... so sad
-   pLS->pSampleBuf = (LADSPA_Data *) calloc(pLS->lBufferSize,  sizeof(LADSPA_Data));
-   if (pLS->pSampleBuf == NULL) {
-	   goto cleanup;
-   }
-   // we'll warm up up to 50 secs worth of the loop mem as a tradeoff to the low-mem mac people
-	// Removed because this causes heavy cpu load on first record!!!
-   //memset (pLS->pSampleBuf, 0, min(pLS->lBufferSize, (unsigned long) (SampleRate * 50) ) * sizeof(LADSPA_Data));
+	count = 0;
 
-   pLS->lLoopChunkCount = MAX_LOOPS;
+	if (head) {
+		return addWarmLoop (warm, count, head)
+			&& addWarmLoop (warm, count, head->prev)
+			&& addWarmLoop (warm, count, head->next)
+			&& addWarmLoop (warm, count, lastRedoLoop (pLS));
+	}
 
-   // not using calloc to force touching all memory ahead of time -- PSYCHE!
-   pLS->pLoopChunks = (LoopChunk *) calloc(pLS->lLoopChunkCount,  sizeof(LoopChunk));
-   if (pLS->pLoopChunks == NULL) {
-	   goto cleanup;
-   }
-   memset (pLS->pLoopChunks, 0, pLS->lLoopChunkCount * sizeof(LoopChunk));
+	return addWarmLoop (warm, count, pLS->tailLoopChunk)
+		&& addWarmLoop (warm, count, lastRedoLoop (pLS));
+}
 
-   pLS->lastLoopChunk = pLS->pLoopChunks + pLS->lLoopChunkCount - 1;
+static inline bool isWarm (LoopChunk **warm, int count, LoopChunk *loop)
+{
+	for (int n = 0; n < count; ++n) {
+		if (warm[n] == loop) {
+			return true;
+		}
+	}
+	return false;
+}
 
-   // this is the input buffer to handle input latency.  32k max samples of input latency
-   pLS->lInputBufSize = 32768;
-   pLS->lInputBufMask = pLS->lInputBufSize - 1;
-   pLS->pInputBuf = (LADSPA_Data *) calloc(pLS->lInputBufSize, sizeof(LADSPA_Data));
-   pLS->lInputBufWritePos = 0;
-   pLS->lInputBufReadPos = 0;
-   
-   /* just one for now */
-   //pLS->lLoopStart = 0;
-   //pLS->lLoopStop = 0;   
-   //pLS->lCurrPos = 0;
+// true if none of loop and its sources have pages out in the undo file
+static bool loopResident (LoopChunk *loop)
+{
+	LoopChunk *warm[SPILL_WARM_MAX];
+	int count = 0;
 
-   pLS->state = STATE_OFF;
-   pLS->wasMuted = false;
-   pLS->recSyncEnded = false;
-   
-   DBG(fprintf(stderr,"%u:%u  instantiated with buffersize: %lu\n", pLS->lLoopIndex, pLS->lChannelIndex, pLS->lBufferSize));
+	addWarmLoop (warm, count, loop);
 
-   
-   pLS->pfQuantMode = &pLS->fQuantizeMode;
-   pLS->pfRoundMode = &pLS->fRoundMode;
-   pLS->pfRedoTapMode = &pLS->fRedoTapMode;
-   
-   //cerr << "INSTANTIATE: " << pLS << endl;
-   
-   return pLS;
+	for (int n = 0; n < count; ++n) {
+		if (warm[n]->lSpilledPages > 0) {
+			return false;
+		}
+	}
+	return true;
+}
 
-cleanup:
+// handles the answers from the undo file, brings the warm loops back in
+// and, when we hold more than half our quota, sends out some more of
+// the cold ones.  only pages no other loop shares are sent out
+static void serviceUndoSpill (SooperLooperI *pLS)
+{
+	UndoSpill *spill = pLS->pUndoSpill;
+	UndoSpill::Request req;
+	LoopChunk *warm[SPILL_WARM_MAX];
+	LoopChunk *loop;
+	int lWarmCount;
+	bool bAllWarm, bExhausted;
+	unsigned long lPage;
+	unsigned int page;
+
+	bAllWarm = !warmLoops (pLS, warm, lWarmCount);
+
+	while (spill->receive (req)) {
+		loop = (LoopChunk *) req.owner;
+		bool bSame = (loop->lSerial == req.serial && req.index < loop->lPageCount);
+
+		if (req.op == UndoSpill::Evict) {
+			pLS->lSpillsPending--;
+
+			if (!req.ok) {
+				continue;
+			}
 
-   if (pLS->pSampleBuf) {
-	   free (pLS->pSampleBuf);
-   }
-   if (pLS->pLoopChunks) {
-	   free (pLS->pLoopChunks);
-   }
-   return NULL;
-   
-}
+			if (bSame && loop->valid && loop->pPages[req.index] == req.page
+			    && pLS->pPagePool->page_refs (req.page) == 1 && !bAllWarm && !isWarm (warm, lWarmCount, loop))
+			{
+				loop->pPages[req.index] = SPILLED_PAGE | req.slot;
+				loop->lSpilledPages++;
+				releasePage (pLS, req.page);
+			}
+			else {
+				// it changed or warmed up while being written out
+				sendSpill (pLS, UndoSpill::Forget, 0, 0, 0, req.slot);
+			}
+		}
+		else if (req.op == UndoSpill::Restore) {
+			if (bSame && loop->pPages[req.index] == (SPILLED_PAGE | LOADING_PAGE | req.slot)) {
+				loop->lLoadingPages--;
+
+				if (req.ok) {
+					loop->pPages[req.index] = req.page;
+					loop->lSpilledPages--;
+					sendSpill (pLS, UndoSpill::Forget, 0, 0, 0, req.slot);
+				}
+				else {
+					// try again next time
+					loop->pPages[req.index] = SPILLED_PAGE | req.slot;
+					releasePage (pLS, req.page);
+				}
+			}
+			else {
+				// the loop let go of it in the meantime
+				releasePage (pLS, req.page);
+				sendSpill (pLS, UndoSpill::Forget, 0, 0, 0, req.slot);
+			}
+		}
+	}
 
-/*****************************************************************************/
+	for (int n = 0; n < lWarmCount; ++n) {
+		loop = warm[n];
 
-/* Throw away a simple delay line. */
-void 
-cleanupSooperLooper(LADSPA_Handle Instance) {
-	
-	SooperLooperI * pLS;
-	
-	pLS = (SooperLooperI *)Instance;
-	
-	if (pLS->pLoopChunks) {
-		free (pLS->pLoopChunks);
+		for (lPage = 0; loop->lSpilledPages > loop->lLoadingPages && lPage < loop->lPageCount; ++lPage) {
+			unsigned int entry = loop->pPages[lPage];
+
+			if (!(entry & SPILLED_PAGE) || (entry & LOADING_PAGE)) {
+				continue;
+			}
+			// leave room in the queue for the forgets
+			if (spill->send_space() <= SPILL_BATCH || (page = takePage (pLS, &bExhausted)) == ZERO_PAGE) {
+				return;
+			}
+			if (!sendSpill (pLS, UndoSpill::Restore, loop, lPage, page, entry & SPILL_SLOT_MASK)) {
+				releasePage (pLS, page);
+				return;
+			}
+			loop->pPages[lPage] = entry | LOADING_PAGE;
+			loop->lLoadingPages++;
+		}
 	}
-	
-	if (pLS->pSampleBuf) {
-		free (pLS->pSampleBuf);
+
+	if (bAllWarm || pLS->lSpillsPending > 0 || pLS->lPagesInUse <= pLS->lMaxLoopPages / 2) {
+		return;
 	}
-	
-	//cerr << "******* cleanup SL instance" << endl;
-	
-	
-	free(pLS);
+
+	// carry on from the last batch, or start over from the oldest loop
+	loop = pLS->pSpillCursor;
+	lPage = pLS->lSpillCursorPage;
+	if (!loop || !loop->valid || loop->lSerial != pLS->lSpillCursorSerial) {
+		loop = pLS->tailLoopChunk;
+		lPage = 0;
+	}
+
+	for (int n = 0; loop && n < SPILL_SCAN_PAGES && pLS->lSpillsPending < SPILL_BATCH; ++n) {
+		if (!loop->valid || lPage >= loop->lPageCount || isWarm (warm, lWarmCount, loop)) {
+			loop = loop->next;
+			lPage = 0;
+			continue;
+		}
+
+		page = loop->pPages[lPage];
+		if (page >= FIRST_LOOP_PAGE && !(page & SPILLED_PAGE) && pLS->pPagePool->page_refs (page) == 1) {
+			if (spill->send_space() <= SPILL_BATCH || !sendSpill (pLS, UndoSpill::Evict, loop, lPage, page, 0)) {
+				break;
+			}
+			pLS->lSpillsPending++;
+		}
+		++lPage;
+	}
+
+	pLS->pSpillCursor = loop;
+	pLS->lSpillCursorSerial = loop ? loop->lSerial : 0;
+	pLS->lSpillCursorPage = lPage;
 }
 
+// the loop a command would make the head, 0 if it isn't an undo or redo
+static LoopChunk * multiCtrlTarget (SooperLooperI *pLS, int lMultiCtrl)
+{
+	LoopChunk *head = pLS->headLoopChunk;
 
-/*****************************************************************************/
+	switch (lMultiCtrl) {
+	case MULTI_UNDO:
+	case MULTI_UNDO_TWICE:
+		return head ? head->prev : 0;
+	case MULTI_REDO:
+		return head ? head->next : pLS->tailLoopChunk;
+	case MULTI_REDO_ALL:
+		return lastRedoLoop (pLS);
+	}
 
-/* Initialise and activate a plugin instance. */
-void
-activateSooperLooper(LADSPA_Handle Instance) {
+	return 0;
+}
 
-  SooperLooperI * pLS;
-  pLS = (SooperLooperI *)Instance;
+// undo and redo to a loop that is partly out in the undo file wait here
+// until it is all back, which is normally the next run or so, but never
+// longer than a crossfade.  anything arriving meanwhile queues up behind
+// them, and when the queue is full the oldest command stops waiting to
+// make room.  returns the command to carry out now, or -1
+static int holdMultiCtrl (SooperLooperI *pLS, int lMultiCtrl, unsigned long SampleCount)
+{
+	LoopChunk *target;
+	int xfadeSamples = (int) (*pLS->pfXfadeSamples);
+	int held;
 
-  //cerr << "Activate: " << pLS << endl;
-	 
-  pLS->lLastMultiCtrl = -1;
+	if (lMultiCtrl >= 0) {
+		if (pLS->lHeldCount == 0) {
+			target = multiCtrlTarget (pLS, lMultiCtrl);
+			if (!target || loopResident (target)) {
+				return lMultiCtrl;
+			}
+			DBG(fprintf(stderr, "%u:%u  holding command %d for the undo file\n", pLS->lLoopIndex, pLS->lChannelIndex, lMultiCtrl));
+			pLS->lHeldSamples = 0;
+		}
 
-  pLS->lScratchSamples = 0;
-  pLS->lTapTrigSamples = 0;
-  pLS->lRampSamples = 0;
-  pLS->bPreTap = 1; // first tap init
-  pLS->fLastScratchVal = 0.0f;
-  pLS->fLastTapCtrl = -1;
-  pLS->fCurrRate = 1.0f;
-  pLS->fNextCurrRate = 0.0f;
-  pLS->fQuantizeMode = 0;
-  pLS->fRoundMode = 0;  
-  pLS->bHoldMode = 0;
-  pLS->fSyncMode = 0;
-  pLS->fMuteQuantized = 0;
-  pLS->fOverdubQuantized = 0;
-  pLS->bReplaceQuantized = true;
-  pLS->fRedoTapMode = 1;
-  pLS->bRateCtrlActive = (int) *pLS->pfRateCtrlActive;
+		if (pLS->lHeldCount == SPILL_HOLD_MAX) {
+			DBG(fprintf(stderr, "%u:%u  too many held commands, not waiting for %d\n", pLS->lLoopIndex, pLS->lChannelIndex, pLS->lHeldMultiCtrl[0]));
+			held = pLS->lHeldMultiCtrl[0];
+			memmove (pLS->lHeldMultiCtrl, pLS->lHeldMultiCtrl + 1, (SPILL_HOLD_MAX - 1) * sizeof(int));
+			pLS->lHeldMultiCtrl[SPILL_HOLD_MAX - 1] = lMultiCtrl;
+			pLS->lHeldSamples = 0;
+			return held;
+		}
 
-  pLS->waitingForSync = 0;
-  pLS->donePlaySync = false;
-  pLS->rounding = false;
-  pLS->safetyFeedback = true;
-  
-  pLS->fWetCurr = pLS->fWetTarget = *pLS->pfWet;
-  pLS->fDryCurr = pLS->fDryTarget = *pLS->pfDry;
-  pLS->fFeedbackCurr = pLS->fFeedbackTarget = *pLS->pfFeedback;
-  pLS->fRateCurr = pLS->fRateTarget = *pLS->pfRate;
-  pLS->fScratchPosCurr = pLS->fScratchPosTarget = *pLS->pfScratchPos;
+		pLS->lHeldMultiCtrl[pLS->lHeldCount++] = lMultiCtrl;
+	}
 
-  pLS->fLoopFadeDelta = 0.0f;
-  pLS->fLoopFadeAtten = 0.0f;
-  pLS->fLoopSrcFadeDelta = 0.0f;
-  pLS->fLoopSrcFadeAtten = 0.0f;
-  pLS->fFeedSrcFadeDelta = 0.0f;
-  pLS->fFeedSrcFadeAtten = 1.0f;
-  pLS->fPlayFadeDelta = 0.0f;
-  pLS->fPlayFadeAtten = 0.0f;
-  pLS->fFeedFadeDelta = 0.0f;
-  pLS->fFeedFadeAtten = 1.0f;
+	if (pLS->lHeldCount == 0) {
+		return -1;
+	}
 
-  // todo make this a port, for now 2ms
-  //pLS->fLoopXfadeSamples = 0.002 * pLS->fSampleRate;
-  
-  pLS->state = STATE_OFF;
-  pLS->nextState = -1;
-  pLS->wasMuted = false;
-  pLS->recSyncEnded = false;
+	target = multiCtrlTarget (pLS, pLS->lHeldMultiCtrl[0]);
+	if (target && !loopResident (target) && (long) pLS->lHeldSamples < xfadeSamples) {
+		pLS->lHeldSamples += SampleCount;
+		return -1;
+	}
 
-  pLS->lSamplesSinceSync = 0;
+	lMultiCtrl = pLS->lHeldMultiCtrl[0];
+	pLS->lHeldCount--;
+	memmove (pLS->lHeldMultiCtrl, pLS->lHeldMultiCtrl + 1, pLS->lHeldCount * sizeof(int));
+	pLS->lHeldSamples = 0;
 
-  pLS->lInputBufWritePos = 0;
-  pLS->lFramesUntilInput = 0;
-  pLS->lFramesUntilFilled = 0;
-  memset (pLS->pInputBuf, 0, pLS->lInputBufSize * sizeof(LADSPA_Data));
-  
-  clearLoopChunks(pLS);
+	return lMultiCtrl;
+}
 
 
-  if (pLS->pfSecsTotal) {
-     *pLS->pfSecsTotal = (LADSPA_Data) pLS->fTotalSecs;
-  }
+
+// reads loop audio into buffer, up to frames length, starting from loop_offset.  if fewer frames are
+// available returns amount read.  if 0 is returned loop is done.
+unsigned long
+sl_read_current_loop_audio (LADSPA_Handle instance, unsigned int chan, float * buf, unsigned long frames, unsigned long loop_offset)
+{
+	SooperLooperI * pLS = (SooperLooperI *)instance;
+
+	if (!pLS || !buf || chan >= pLS->lChannelCount) return 0;
+
+	LoopChunk * loop = pLS->headLoopChunk;
+	if (!loop) return 0;
+	if (loop_offset > loop->lLoopLength) return 0;
+	
+	// adjust for sync pos, so that a loop_offset of 0 actually means start from the syncpos
+	unsigned long adj_offset  = (loop_offset + (loop->lLoopLength - loop->lSyncPos)) % loop->lLoopLength;
+	unsigned long frames_left = loop->lLoopLength - loop_offset;
+	unsigned long pos, span, done;
+
+	if (adj_offset > (loop->lLoopLength - loop->lSyncPos)) {
+		// between sync and end of loop mem, clamp frames
+		frames = std::min(loop->lLoopLength-adj_offset, frames);
+	}
+
+	if (frames > frames_left) {
+		frames = frames_left;
+	}
+	
+	// read a page at a time
+	for (pos = adj_offset, done = 0; done < frames; pos += span, done += span) {
+		span = pageSpan (pos, frames - done);
+		memcpy ((char *) (buf + done), (char *) (loopReadPtr (pLS, loop, pos) + chan * LOOP_PAGE_FRAMES), span * sizeof(LADSPA_Data));
+	}
+
+	return frames;
+}
+
+void
+sl_set_samples_since_sync (LADSPA_Handle instance, unsigned long frames)
+{
+	SooperLooperI * pLS = (SooperLooperI *)instance;
+
+	if (!pLS) return;
+
+	pLS->lSamplesSinceSync = frames;
+}
+
+void
+sl_set_sync_events (LADSPA_Handle instance, const SyncEventList * list, unsigned long offset)
+{
+	SooperLooperI * pLS = (SooperLooperI *)instance;
+
+	if (!pLS) return;
+
+	if (list && list->valid) {
+		pLS->pSyncEvents = list->events;
+		pLS->lSyncEventCount = (long) list->count;
+	}
+	else {
+		pLS->pSyncEvents = 0;
+		pLS->lSyncEventCount = -1;
+	}
+	pLS->lSyncEventOffset = offset;
+	pLS->lSyncEventPos = 0;
+}
+
+void
+sl_set_replace_quantized (LADSPA_Handle instance, bool value)
+{
+	SooperLooperI * pLS = (SooperLooperI *)instance;
+
+	if (!pLS) return;
+	pLS->bReplaceQuantized = value;
+}
+
+void
+sl_set_loop_index (LADSPA_Handle instance, unsigned int value, unsigned int chan)
+{
+	SooperLooperI * pLS = (SooperLooperI *)instance;
+	
+	if (!pLS) return;
+	pLS->lLoopIndex = value;
+	pLS->lChannelIndex = chan;
+	DBG(fprintf(stderr, "set loop: %u  chan: %u\n", pLS->lLoopIndex, pLS->lChannelIndex));
+}
+
+bool
+sl_get_replace_quantized (LADSPA_Handle instance)
+{
+	SooperLooperI * pLS = (SooperLooperI *)instance;
+	if (!pLS) return false;
+	return pLS->bReplaceQuantized;
+}
+
+
+bool sl_has_loop (const LADSPA_Handle instance)
+{
+	const SooperLooperI * pLS = (const SooperLooperI *)instance;
+	if (!pLS) return false;
+        return pLS->headLoopChunk != 0;
+}
+
+// just playing with nothing fed back, nor fading in or out, filling or
+// waiting to change state.  it may be playing in reverse
+static bool
+loopIsStatic (const SooperLooperI *pLS)
+{
+	const LoopChunk *loop = pLS->headLoopChunk;
+
+	if (!loop || pLS->state != STATE_PLAY || pLS->waitingForSync) {
+		return false;
+	}
+
+	if (pLS->playFade.atten != 1.0f || !fadeSettled (&pLS->playFade)
+	    || !fadeSettled (&pLS->loopFade) || !fadeSettled (&pLS->feedFade)) {
+		return false;
+	}
+
+	// the fill still copies into it from its source, see fillLoops
+	if (loop->frontfill || loop->backfill || pLS->lFramesUntilFilled > 0) {
+		return false;
+	}
+
+	if (*pLS->pfUseFeedbackPlay != 0.0f && (*pLS->pfFeedback < 1.0f || pLS->feedFade.atten != 1.0f)) {
+		return false;
+	}
+
+	return true;
+}
+
+// who may touch the snapshot of the static loop, see sl_pin_static_loop
+enum {
+	SnapshotFree = 0,
+	SnapshotReady,
+	SnapshotReading,
+	SnapshotDone
+};
+
+// unpins the snapshot once the main thread is done with it or before it
+// starts on one that is out of date, and pins the static loop for it if
+// it asked for that one
+static void
+serviceStaticSnapshot (SooperLooperI *pLS)
+{
+	LoopChunk *loop = pLS->headLoopChunk;
+	unsigned long key = pLS->lStaticKey;
+	int state = pLS->iSnapshotState;
+	unsigned long n;
+
+	if (state == SnapshotDone || (state == SnapshotReady && pLS->lSnapshotKey != key)) {
+		if (!__sync_bool_compare_and_swap (&pLS->iSnapshotState, state, SnapshotFree)) {
+			// the main thread just started reading it
+			return;
+		}
+		for (n = 0; n < pLS->lSnapshotPageCount; ++n) {
+			releasePage (pLS, pLS->pSnapshotPages[n]);
+		}
+		pLS->lSnapshotPageCount = 0;
+		state = SnapshotFree;
+	}
+
+	if (state != SnapshotFree || key == 0 || pLS->lSnapshotWanted != key || loop->lLoopLength == 0) {
+		return;
+	}
+
+	for (n = 0; n < loop->lPageCount; ++n) {
+		if (loop->pPages[n] & SPILLED_PAGE) {
+			// still on its way back in
+			return;
+		}
+	}
+
+	for (n = 0; n < loop->lPageCount; ++n) {
+		if (loop->pPages[n] >= FIRST_LOOP_PAGE) {
+			++pLS->pPagePool->page_refs (loop->pPages[n]);
+		}
+		pLS->pSnapshotPages[n] = loop->pPages[n];
+	}
+	pLS->lSnapshotPageCount = loop->lPageCount;
+	pLS->lSnapshotLength = loop->lLoopLength;
+	pLS->lSnapshotKey = key;
+
+	__sync_synchronize ();
+	pLS->iSnapshotState = SnapshotReady;
+}
+
+// called at the end of every run with whether the loop was static when it started
+static void
+noteStaticLoop (SooperLooperI *pLS, bool bWasStatic)
+{
+	LoopChunk *loop = pLS->headLoopChunk;
+	bool bStatic = loopIsStatic (pLS);
+
+	if (!(bWasStatic && bStatic && pLS->pStaticLoop == loop && pLS->lStaticSerial == loop->lSerial)) {
+		if (++pLS->lStaticEpoch == 0) {
+			pLS->lStaticEpoch = 1;
+		}
+		pLS->pStaticLoop = loop;
+		pLS->lStaticSerial = loop ? loop->lSerial : 0;
+	}
+
+	pLS->lStaticKey = bStatic ? pLS->lStaticEpoch : 0;
+	serviceStaticSnapshot (pLS);
+}
+
+unsigned long
+sl_get_static_loop_key (const LADSPA_Handle instance)
+{
+	const SooperLooperI * pLS = (const SooperLooperI *)instance;
+
+	if (!pLS || !loopIsStatic (pLS) || pLS->pStaticLoop != pLS->headLoopChunk) {
+		return 0;
+	}
+
+	return pLS->lStaticEpoch;
+}
+
+unsigned long
+sl_get_loop_length (const LADSPA_Handle instance)
+{
+	const SooperLooperI * pLS = (const SooperLooperI *)instance;
+
+	if (!pLS || !pLS->headLoopChunk) return 0;
+
+	return pLS->headLoopChunk->lLoopLength;
+}
+
+double
+sl_get_loop_position (const LADSPA_Handle instance)
+{
+	const SooperLooperI * pLS = (const SooperLooperI *)instance;
+
+	if (!pLS || !pLS->headLoopChunk) return 0.0;
+
+	return pLS->headLoopChunk->dCurrPos;
+}
+
+unsigned long
+sl_pin_static_loop (LADSPA_Handle instance, unsigned long key, bool * gone)
+{
+	SooperLooperI * pLS = (SooperLooperI *)instance;
+
+	*gone = false;
+
+	if (!pLS || key == 0) {
+		*gone = true;
+		return 0;
+	}
+
+	if (__sync_bool_compare_and_swap (&pLS->iSnapshotState, SnapshotReady, SnapshotReading)) {
+		if (pLS->lSnapshotKey == key) {
+			return pLS->lSnapshotLength;
+		}
+		pLS->iSnapshotState = SnapshotDone;
+	}
+
+	if (pLS->lStaticKey != key) {
+		*gone = true;
+		return 0;
+	}
+
+	pLS->lSnapshotWanted = key;
+	return 0;
+}
+
+void
+sl_unpin_static_loop (LADSPA_Handle instance)
+{
+	SooperLooperI * pLS = (SooperLooperI *)instance;
+
+	if (pLS && pLS->iSnapshotState == SnapshotReading) {
+		__sync_synchronize ();
+		pLS->iSnapshotState = SnapshotDone;
+	}
+}
+
+unsigned long
+sl_read_static_loop (LADSPA_Handle instance, unsigned long key, unsigned int chan, float * buf, unsigned long frames)
+{
+	SooperLooperI * pLS = (SooperLooperI *)instance;
+	unsigned long pos, span, lPage;
+	unsigned int page;
+
+	if (!pLS || !buf || chan >= pLS->lChannelCount || key == 0
+	    || pLS->iSnapshotState != SnapshotReading || pLS->lSnapshotKey != key) {
+		return 0;
+	}
+
+	frames = std::min (frames, pLS->lSnapshotLength);
+
+	// read a page at a time
+	for (pos = 0; pos < frames; pos += span) {
+		span = pageSpan (pos, frames - pos);
+		lPage = pos >> LOOP_PAGE_SHIFT;
+		page = (lPage < pLS->lSnapshotPageCount) ? pLS->pSnapshotPages[lPage] : ZERO_PAGE;
+		memcpy ((char *) (buf + pos), (char *) (pageData (pLS, page) + (pos & LOOP_PAGE_MASK) + chan * LOOP_PAGE_FRAMES),
+			span * sizeof(LADSPA_Data));
+	}
+
+	return frames;
+}
+
+double
+sl_get_play_rate (const LADSPA_Handle instance)
+{
+	const SooperLooperI * pLS = (const SooperLooperI *)instance;
+
+	if (!pLS) return 0.0;
+
+	return pLS->fCurrRate;
+}
+
+
+/*****************************************************************************/
+// reading the loop in between its samples, to play it at another rate
+
+// zero crossings of the windowed sinc on either side, and table points
+// per zero crossing
+#define SINC_ZEROS 8
+#define SINC_RES   64
+// the most the sinc is widened by to filter when reading faster
+#define SINC_MAX_WIDEN 8
+
+static LADSPA_Data sincTable[SINC_ZEROS * SINC_RES + 2];
+
+// fills the sinc table, from sl_instantiate so never in the audio thread
+static void makeSincTable ()
+{
+	static bool bMade = false;
+
+	if (bMade) return;
+
+	for (int n = 0; n < SINC_ZEROS * SINC_RES + 2; ++n) {
+		double x = M_PI * n / SINC_RES;
+
+		if (n == 0) {
+			sincTable[n] = 1.0f;
+		}
+		else if (n >= SINC_ZEROS * SINC_RES) {
+			sincTable[n] = 0.0f;
+		}
+		else {
+			// lanczos window
+			sincTable[n] = (LADSPA_Data) (sin (x) / x * sin (x / SINC_ZEROS) / (x / SINC_ZEROS));
+		}
+	}
+
+	bMade = true;
+}
+
+// taps of one channel out of a single page, lOrigin is the frame pData is at
+struct PageTaps
+{
+	const LADSPA_Data * pData;
+	long lOrigin;
+
+	inline LADSPA_Data operator() (long k) const { return pData[k - lOrigin]; }
+};
+
+// taps of one channel from anywhere, wrapping around the loop
+struct LoopTaps
+{
+	SooperLooperI * pLS;
+	LoopChunk * loop;
+	unsigned int lChan;
+
+	inline LADSPA_Data operator() (long k) const {
+		long lLen = (long) loop->lLoopLength;
+
+		k %= lLen;
+		if (k < 0) k += lLen;
+
+		return loopReadPtr (pLS, loop, (unsigned long) k)[lChan * LOOP_PAGE_FRAMES];
+	}
+};
+
+// the loop at dPos.  the sinc reads lRadius taps on either side
+template <int INTERP, class TAPS>
+static inline LADSPA_Data interpAt (const TAPS & taps, double dPos, LADSPA_Data fCutoff, long lRadius)
+{
+	long k = (long) floor (dPos);
+	LADSPA_Data f = (LADSPA_Data) (dPos - k);
+
+	if (INTERP == LoopInterpLinear) {
+		LADSPA_Data x0 = taps (k);
+		LADSPA_Data x1 = taps (k + 1);
+
+		return x0 + f * (x1 - x0);
+	}
+	else if (INTERP == LoopInterpCubic) {
+		// 4 point, 3rd order hermite
+		LADSPA_Data xm1 = taps (k - 1);
+		LADSPA_Data x0 = taps (k);
+		LADSPA_Data x1 = taps (k + 1);
+		LADSPA_Data x2 = taps (k + 2);
+		LADSPA_Data c1 = 0.5f * (x1 - xm1);
+		LADSPA_Data c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+		LADSPA_Data c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+
+		return ((c3 * f + c2) * f + c1) * f + x0;
+	}
+	else {
+		LADSPA_Data fSum = 0.0f;
+
+		for (long n = 1 - lRadius; n <= lRadius; ++n) {
+			LADSPA_Data x = fabsf ((n - f) * fCutoff) * SINC_RES;
+			long i = (long) x;
+
+			if (i < SINC_ZEROS * SINC_RES) {
+				fSum += taps (k + n) * (sincTable[i] + (x - i) * (sincTable[i + 1] - sincTable[i]));
+			}
+		}
+
+		return fSum * fCutoff;
+	}
+}
+
+// frames of the loop from dPos on, dStep apart.  the frames whose taps all
+// lie in one page are read straight out of it, only those around page
+// edges and the loop end go through the wrapping reader
+template <int INTERP>
+static void readInterpolated (SooperLooperI *pLS, LoopChunk *loop, unsigned int lChan, LADSPA_Data *pfBuf,
+			      unsigned long lFrames, double dPos, double dStep)
+{
+	long lLen = (long) loop->lLoopLength;
+	LADSPA_Data fCutoff = 1.0f;
+	long lRadius = 0, lLeft, lRight;
+	LoopTaps wrapTaps = { pLS, loop, lChan };
+	unsigned long lDone = 0, lCount, n;
+
+	if (INTERP == LoopInterpLinear) {
+		lLeft = 0;
+		lRight = 1;
+	}
+	else if (INTERP == LoopInterpCubic) {
+		lLeft = 1;
+		lRight = 2;
+	}
+	else {
+		// lower the cutoff when reading faster than the loop was recorded
+		if (fabs (dStep) > 1.0) {
+			fCutoff = (LADSPA_Data) (1.0 / std::min (fabs (dStep), (double) SINC_MAX_WIDEN));
+		}
+		lRadius = (long) ceil (SINC_ZEROS / fCutoff);
+		lLeft = lRadius - 1;
+		lRight = lRadius;
+	}
+
+	dPos = fmod (dPos, (double) lLen);
+	if (dPos < 0.0) dPos += lLen;
+
+	while (lDone < lFrames) {
+		long k = (long) floor (dPos);
+		long lLo = k - lLeft;
+		long lHi = k + lRight;
+
+		lCount = 0;
+
+		if (lLo >= 0 && lHi < lLen && (lLo >> LOOP_PAGE_SHIFT) == (lHi >> LOOP_PAGE_SHIFT)) {
+			long lPageStart = lLo & ~((long) LOOP_PAGE_MASK);
+			long lPageEnd = std::min (lPageStart + (long) LOOP_PAGE_FRAMES, lLen);
+			double dRoom;
+
+			if (dStep > 0.0) {
+				dRoom = (double) (lPageEnd - lRight) - dPos - 1e-6;
+				lCount = (dRoom > 0.0) ? 1 + (unsigned long) (dRoom / dStep) : 1;
+			}
+			else if (dStep < 0.0) {
+				dRoom = dPos - (double) (lPageStart + lLeft) - 1e-6;
+				lCount = (dRoom > 0.0) ? 1 + (unsigned long) (dRoom / -dStep) : 1;
+			}
+			else {
+				lCount = lFrames - lDone;
+			}
+			lCount = std::min (lCount, lFrames - lDone);
+
+			if (lCount > 0) {
+				PageTaps taps = { loopReadPtr (pLS, loop, (unsigned long) lPageStart) + lChan * LOOP_PAGE_FRAMES, lPageStart };
+
+				for (n = 0; n < lCount; ++n) {
+					pfBuf[lDone + n] = interpAt<INTERP> (taps, dPos + n * dStep, fCutoff, lRadius);
+				}
+			}
+		}
+
+		if (lCount == 0) {
+			lCount = 1;
+			pfBuf[lDone] = interpAt<INTERP> (wrapTaps, dPos, fCutoff, lRadius);
+		}
+
+		lDone += lCount;
+		dPos += lCount * dStep;
+
+		if (dPos >= lLen) dPos -= lLen;
+		else if (dPos < 0.0) dPos += lLen;
+	}
+}
+
+void
+sl_read_loop_interpolated (LADSPA_Handle instance, unsigned int chan, float * buf, unsigned long frames,
+			   double pos, double step, int interp)
+{
+	SooperLooperI * pLS = (SooperLooperI *)instance;
+	LoopChunk * loop;
+
+	if (!pLS || !buf || chan >= pLS->lChannelCount) return;
+
+	loop = pLS->headLoopChunk;
+	if (!loop || loop->lLoopLength == 0) {
+		memset (buf, 0, frames * sizeof(float));
+		return;
+	}
+
+	switch (interp) {
+	case LoopInterpLinear:
+		readInterpolated<LoopInterpLinear> (pLS, loop, chan, buf, frames, pos, step);
+		break;
+	case LoopInterpSinc:
+		readInterpolated<LoopInterpSinc> (pLS, loop, chan, buf, frames, pos, step);
+		break;
+	default:
+		readInterpolated<LoopInterpCubic> (pLS, loop, chan, buf, frames, pos, step);
+		break;
+	}
+}
+
+void
+sl_maintain_memory ()
+{
+	PagePool::maintain ();
+	UndoSpill::maintain ();
+}
+
+void
+sl_set_undo_spill_dir (const char * dir)
+{
+	UndoSpill::set_directory (dir);
+}
+
+void
+sl_set_block_paths (unsigned int paths)
+{
+	g_blockPaths = paths;
+}
+
+void
+sl_reserve_memory (LADSPA_Handle instance, unsigned long frames)
+{
+	SooperLooperI * pLS = (SooperLooperI *)instance;
+	if (!pLS) return;
+
+	pLS->pPagePool->reserve ((frames + LOOP_PAGE_MASK) >> LOOP_PAGE_SHIFT);
+}
+
+unsigned int
+sl_get_channel_count (const LADSPA_Handle instance)
+{
+	const SooperLooperI * pLS = (const SooperLooperI *)instance;
+	if (!pLS) return 0;
+	return pLS->lChannelCount;
+}
+
+void
+sl_connect_audio_port (LADSPA_Handle instance, unsigned long port, unsigned int chan, LADSPA_Data * data)
+{
+	SooperLooperI * pLS = (SooperLooperI *)instance;
+
+	if (!pLS || chan >= pLS->lChannelCount) return;
+
+	if (port == AudioInputPort) {
+		pLS->pfInput[chan] = data;
+	}
+	else if (port == AudioOutputPort) {
+		pLS->pfOutput[chan] = data;
+	}
+}
+
+// forget any block copying done for the front or back fill range,
+// needed whenever the marks are set up anew
+static inline void clearFillAhead(LoopChunk *loop)
+{
+	loop->lFillAheadL = loop->lFillAheadH = LONG_MAX;
+}
+
+static inline void clearEndFillAhead(LoopChunk *loop)
+{
+	loop->lEndFillAheadL = loop->lEndFillAheadH = LONG_MAX;
+}
+
+static LoopChunk * ensureLoopSpace(SooperLooperI* pLS, LoopChunk *loop, unsigned long morelength, LoopChunk * pendsrc)
+{
+	// TODO: check to see if we'll require more space than the buffer allows
+	
+	if (!loop) {
+		loop = (pLS->headLoopChunk == pLS->lastLoopChunk) ? pLS->pLoopChunks: pLS->headLoopChunk + 1;
+
+		if (loop == pLS->tailLoopChunk) {
+			// the history has used up every chunk, drop the oldest
+			loop->valid = 0;
+			if (loop->next) {
+				loop->next->prev = 0;
+			}
+			pLS->tailLoopChunk = loop->next;
+			pLS->lTailLoopChunk++;
+		}
+		
+		// anything we could have redone is gone now
+		for (unsigned int gen = pLS->lHeadLoopChunk + 1; gen != pLS->lEndLoopChunk; ++gen) {
+			LoopChunk *redo = loopOfGeneration (pLS, gen);
+			redo->valid = 0;
+			releaseLoopPages (pLS, redo);
+		}
+		releaseLoopPages (pLS, loop);
+		loop->lSerial++;
+		
+		loop->lLoopLength = 0;
+		loop->lCycleLength = 0;
+		loop->lCycles = 0;
+		loop->dCurrPos = 0;
+		loop->frontfill = 0;
+		loop->backfill = 0;
+		clearFillAhead(loop);
+		clearEndFillAhead(loop);
+		loop->valid = 1;
+		loop->mult_out = 0;
+		loop->lSyncOffset = 0;
+		loop->lSyncPos = 0;
+		loop->lOrigSyncPos = 0;
+		
+		loop->next = NULL;
+		loop->prev = pLS->headLoopChunk;
+		if (loop->prev) {
+			loop->prev->next = loop;
+			// do this to help out the overdub fail case
+			loop->lCycles = loop->prev->lCycles;
+			loop->lCycleLength = loop->prev->lCycleLength;
+			loop->lLoopLength = loop->prev->lLoopLength;
+			loop->dCurrPos = loop->prev->dCurrPos;
+		}
+		loop->srcloop = pendsrc;
+
+		pLS->headLoopChunk = loop;
+		pLS->lHeadLoopChunk++;
+		pLS->lEndLoopChunk = pLS->lHeadLoopChunk + 1;
+	}
+	else {
+
+		// check to see if we'll require more space than the buffer allows
+		if (loop->lLoopLength + morelength > pLS->lBufferSize) {
+			DBG(fprintf(stderr, "%u:%u  requesting more space than exists in buffer!\n",pLS->lLoopIndex, pLS->lChannelIndex));
+			return NULL;
+		}
+	}
+	
+	// pages are taken as they get written, the oldest history is
+	// dropped then if memory runs out
+
+	return loop;
+}
+
+
+// creates a new loop chunk and puts it on the head of the list
+// returns the new chunk
+static LoopChunk * pushNewLoopChunk(SooperLooperI* pLS, unsigned long initLength, LoopChunk * pendsrc)
+{
+   LoopChunk * loop;   
+
+   if (pLS->headLoopChunk) {
+      // use the next spot in memory
+
+      loop = ensureLoopSpace (pLS, NULL, initLength, pendsrc);
+
+      if (!loop) {
+	      return NULL;
+      }
+      
+
+      // we are the new head
+      pLS->headLoopChunk = loop;
+      
+   }
+   else {
+      // first loop on the list!  nothing older can be redone anymore
+      for (loop = pLS->pLoopChunks; loop <= pLS->lastLoopChunk; ++loop) {
+	      releaseLoopPages (pLS, loop);
+      }
+      loop = pLS->pLoopChunks;
+      loop->lSerial++;
+      resetLoopHistory (pLS, loop);
+      loop->valid = 1;
+   }
+   
+
+   DBG(fprintf(stderr, "%u:%u  New head is %08x   pages in use: %lu\n",pLS->lLoopIndex, pLS->lChannelIndex, (unsigned)loop, pLS->lPagesInUse);)
+
+   
+   return loop;
+}
+
+
+// pop the head off and free it
+static void popHeadLoop(SooperLooperI *pLS, bool forceClear)
+{
+   LoopChunk *dead;
+   dead = pLS->headLoopChunk;
+
+   if (dead && dead->prev) {
+      // leave the next where is is for redo
+      //dead->prev->next = NULL;
+	   pLS->headLoopChunk = dead->prev;
+	   pLS->lHeadLoopChunk--;
+	   if (!pLS->headLoopChunk->prev) {
+		   pLS->tailLoopChunk = pLS->headLoopChunk; 
+	   }
+   }
+   else if (dead && (!dead->next || forceClear)) {
+	   // only clear the loop if this was the only loop in history
+	   pLS->headLoopChunk = NULL;
+	   // pLS->tailLoopChunk is still valid to support redo
+	   // from nothing
+   }
+}
+
+// clear all LoopChunks (undoAll , can still redo them back)
+static void clearLoopChunks(SooperLooperI *pLS)
+{
+   
+   pLS->headLoopChunk = NULL;
+   pLS->pSharedFill = NULL;
+}
+
+static void undoLoop(SooperLooperI *pLS, bool forceClear)
+{
+   LoopChunk *loop = pLS->headLoopChunk;
+   LoopChunk *prevloop;
+   
+   if (!loop) return;
+	
+   prevloop = loop->prev;
+
+   //if (prevloop && prevloop == loop->srcloop) {
+      // if the previous was the source of the one we're undoing
+      // pass the dCurrPos along, otherwise leave it be.
+   // nevermind, ALWAYS pass it along, what the hell
+   if (prevloop) {
+	   prevloop->dCurrPos = fmod(loop->dCurrPos+loop->lStartAdj, prevloop->lLoopLength);
+   }
+   
+   popHeadLoop(pLS, forceClear);
+   DBG(fprintf(stderr, "%u:%u  Undoing last loop %08x: new head is %08x\n" , pLS->lLoopIndex, pLS->lChannelIndex, (unsigned)loop,
+	       (unsigned)pLS->headLoopChunk);)
+}
+
+
+static void redoLoop(SooperLooperI *pLS)
+{
+   LoopChunk *loop = NULL;
+   LoopChunk *nextloop = NULL;
+
+   if (pLS->headLoopChunk) {
+      loop = pLS->headLoopChunk;
+      nextloop = loop->next;
+   }
+   else if (pLS->tailLoopChunk) {
+      // we've undone everything, use the tail
+      loop = NULL;
+      nextloop = pLS->tailLoopChunk;
+   }
+
+   if (nextloop) {
+      
+	   //if (loop && loop == nextloop->srcloop) {
+	   // if the next is using us as a source
+	   // pass the dCurrPos along, otherwise leave it be.
+	   // nevermind, ALWAYS pass it along
+	   if (loop) {
+		   nextloop->dCurrPos = fmod(loop->dCurrPos+loop->lStartAdj, nextloop->lLoopLength);
+	   }
+	   else {
+		   // start at loop beginning
+		   nextloop->dCurrPos = nextloop->lLoopLength - nextloop->lSyncPos;
+	   }
+	   
+	   pLS->headLoopChunk = nextloop;
+	   pLS->lHeadLoopChunk = loop ? pLS->lHeadLoopChunk + 1 : pLS->lTailLoopChunk;
+	   
+	   DBG(fprintf(stderr, "%u:%u  Redoing last loop %08x: new head is %08x\n", pLS->lLoopIndex, pLS->lChannelIndex, (unsigned)loop,
+		       (unsigned)pLS->headLoopChunk);)
+
+   }
+}
+
+
+
+/*****************************************************************************/
+
+/* Construct a new plugin instance. */
+LADSPA_Handle 
+instantiateSooperLooper(const LADSPA_Descriptor * Descriptor,
+			unsigned long             SampleRate)
+{
+   SooperLooperI * pLS = (SooperLooperI *) sl_instantiate (Descriptor, SampleRate, 1);
+
+   // a plain LADSPA host won't be calling sl_maintain_memory, so get
+   // all of it up front
+   if (pLS) {
+	   pLS->pPagePool->reserve (pLS->lMaxLoopPages);
+   }
+
+   return pLS;
+}
+
+LADSPA_Handle 
+sl_instantiate (const LADSPA_Descriptor *, unsigned long SampleRate, unsigned int ChannelCount)
+{
+
+   SooperLooperI * pLS;
+   char * sampmem;
+
+   if (ChannelCount < 1) {
+	   return NULL;
+   }
+
+   // pick the mix kernels for this cpu now, not in the audio thread
+   mix_kernels();
+   makeSincTable();
+   
+   // important note: using calloc to zero all data
+   pLS = (SooperLooperI *) calloc(1, sizeof(SooperLooperI));
+   
+   if (pLS == NULL) 
+      return NULL;
+
+   pLS->pPagePool = NULL;
+   pLS->pLoopChunks = NULL;
+   pLS->pInputBuf = NULL;
+   
+   pLS->fSampleRate = (LADSPA_Data)SampleRate;
+   pLS->lChannelCount = ChannelCount;
+   pLS->lSyncEventCount = -1;
+
+   pLS->pfInput = (LADSPA_Data **) calloc(ChannelCount, sizeof(LADSPA_Data *));
+   pLS->pfOutput = (LADSPA_Data **) calloc(ChannelCount, sizeof(LADSPA_Data *));
+   if (pLS->pfInput == NULL || pLS->pfOutput == NULL) {
+	   goto cleanup;
+   }
+
+   pLS->fTotalSecs = SAMPLE_MEMORY;
+   
+   // HACK for the moment!
+   sampmem = getenv("SL_SAMPLE_TIME");
+   if (sampmem != NULL) {
+	   if (sscanf(sampmem, "%f", &pLS->fTotalSecs) != 1) {
+		   pLS->fTotalSecs = SAMPLE_MEMORY;
+	   }
+	   // printf ("Got sample mem: %f\n", pLS->fTotalSecs);
+   }
+   
+   // the loop length is only rounded up to whole pages, the memory
+   // itself comes from the shared pool as it gets recorded into
+   pLS->lMaxLoopPages = (unsigned long) ceil ((double) SampleRate * pLS->fTotalSecs / LOOP_PAGE_FRAMES);
+   if (pLS->lMaxLoopPages < 1) {
+	   pLS->lMaxLoopPages = 1;
+   }
+   pLS->lBufferSize = pLS->lMaxLoopPages << LOOP_PAGE_SHIFT;
+   pLS->fTotalSecs = pLS->lBufferSize / (float) SampleRate;
+
+   pLS->pPageStash = (unsigned int *) calloc(pLS->lMaxLoopPages, sizeof(unsigned int));
+   if (pLS->pPageStash == NULL) {
+	   goto cleanup;
+   }
+
+   pLS->pSnapshotPages = (unsigned int *) calloc(pLS->lMaxLoopPages, sizeof(unsigned int));
+   if (pLS->pSnapshotPages == NULL) {
+	   goto cleanup;
+   }
+
+   pLS->pPagePool = PagePool::acquire (ChannelCount, pLS->lMaxLoopPages);
+   if (pLS->pPagePool == NULL) {
+	   goto cleanup;
+   }
+   pLS->pPageFeed = pLS->pPagePool->add_feed (pLS->lMaxLoopPages);
+
+   // without it all the history just stays in memory
+   pLS->pUndoSpill = UndoSpill::create (pLS->pPagePool);
+
+   pLS->lLoopChunkCount = MAX_LOOPS;
+
+   // not using calloc to force touching all memory ahead of time -- PSYCHE!
+   pLS->pLoopChunks = (LoopChunk *) calloc(pLS->lLoopChunkCount,  sizeof(LoopChunk));
+   if (pLS->pLoopChunks == NULL) {
+	   goto cleanup;
+   }
+   memset (pLS->pLoopChunks, 0, pLS->lLoopChunkCount * sizeof(LoopChunk));
+
+   pLS->lastLoopChunk = pLS->pLoopChunks + pLS->lLoopChunkCount - 1;
+
+   // all page table entries start out as the silent page 0
+   pLS->pPageTables = (unsigned int *) calloc(pLS->lLoopChunkCount * pLS->lMaxLoopPages, sizeof(unsigned int));
+   if (pLS->pPageTables == NULL) {
+	   goto cleanup;
+   }
+   for (unsigned long n = 0; n < pLS->lLoopChunkCount; ++n) {
+	   pLS->pLoopChunks[n].pPages = pLS->pPageTables + n * pLS->lMaxLoopPages;
+   }
+
+   // this is the input buffer to handle input latency.  32k max samples of input latency
+   pLS->lInputBufSize = 32768;
+   pLS->lInputBufMask = pLS->lInputBufSize - 1;
+   pLS->pInputBuf = (LADSPA_Data *) calloc(pLS->lInputBufSize * ChannelCount, sizeof(LADSPA_Data));
+   if (pLS->pInputBuf == NULL) {
+	   goto cleanup;
+   }
+   pLS->lInputBufWritePos = 0;
+   pLS->lInputBufReadPos = 0;
+   
+   /* just one for now */
+   //pLS->lLoopStart = 0;
+   //pLS->lLoopStop = 0;   
+   //pLS->lCurrPos = 0;
+
+   pLS->state = STATE_OFF;
+   pLS->wasMuted = false;
+   pLS->recSyncEnded = false;
+   
+   DBG(fprintf(stderr,"%u:%u  instantiated with buffersize: %lu\n", pLS->lLoopIndex, pLS->lChannelIndex, pLS->lBufferSize));
+
+   
+   pLS->pfQuantMode = &pLS->fQuantizeMode;
+   pLS->pfRoundMode = &pLS->fRoundMode;
+   pLS->pfRedoTapMode = &pLS->fRedoTapMode;
+   
+   //cerr << "INSTANTIATE: " << pLS << endl;
+   
+   return pLS;
+
+cleanup:
+
+   if (pLS->pUndoSpill) {
+	   UndoSpill::destroy (pLS->pUndoSpill);
+   }
+   if (pLS->pPagePool) {
+	   pLS->pPagePool->remove_feed (pLS->pPageFeed);
+	   PagePool::release (pLS->pPagePool, pLS->lMaxLoopPages);
+   }
+   if (pLS->pPageStash) {
+	   free (pLS->pPageStash);
+   }
+   if (pLS->pSnapshotPages) {
+	   free (pLS->pSnapshotPages);
+   }
+   if (pLS->pPageTables) {
+	   free (pLS->pPageTables);
+   }
+   if (pLS->pLoopChunks) {
+	   free (pLS->pLoopChunks);
+   }
+   if (pLS->pInputBuf) {
+	   free (pLS->pInputBuf);
+   }
+   if (pLS->pfInput) {
+	   free (pLS->pfInput);
+   }
+   if (pLS->pfOutput) {
+	   free (pLS->pfOutput);
+   }
+   free (pLS);
+   return NULL;
+   
+}
+
+/*****************************************************************************/
+
+/* Throw away a simple delay line. */
+void 
+cleanupSooperLooper(LADSPA_Handle Instance) {
+	
+	SooperLooperI * pLS;
+	
+	pLS = (SooperLooperI *)Instance;
+
+	if (pLS->pUndoSpill) {
+		UndoSpill::Request req;
+		int lCount;
+
+		// pages on their way back in aren't in any loop yet
+		do {
+			pLS->pUndoSpill->finish ();
+			for (lCount = 0; pLS->pUndoSpill->receive (req); ++lCount) {
+				if (req.op == UndoSpill::Restore) {
+					releasePage (pLS, req.page);
+				}
+			}
+		} while (lCount > 0);
+
+		UndoSpill::destroy (pLS->pUndoSpill);
+		pLS->pUndoSpill = 0;
+	}
+	
+	// hand all our pages back to the pool
+	for (unsigned long n = 0; n < pLS->lSnapshotPageCount; ++n) {
+		releasePage (pLS, pLS->pSnapshotPages[n]);
+	}
+	for (LoopChunk * loop = pLS->pLoopChunks; loop <= pLS->lastLoopChunk; ++loop) {
+		releaseLoopPages (pLS, loop);
+	}
+	pLS->pPagePool->return_pages (pLS->pPageStash, pLS->lStashCount);
+	pLS->pPagePool->remove_feed (pLS->pPageFeed);
+	PagePool::release (pLS->pPagePool, pLS->lMaxLoopPages);
+
+	if (pLS->pLoopChunks) {
+		free (pLS->pLoopChunks);
+	}
+	
+	free (pLS->pPageStash);
+	free (pLS->pSnapshotPages);
+	free (pLS->pPageTables);
+
+	if (pLS->pInputBuf) {
+		free (pLS->pInputBuf);
+	}
+
+	free (pLS->pfInput);
+	free (pLS->pfOutput);
+	
+	//cerr << "******* cleanup SL instance" << endl;
+	
+	
+	free(pLS);
+}
+
+
+/*****************************************************************************/
+
+/* Initialise and activate a plugin instance. */
+void
+activateSooperLooper(LADSPA_Handle Instance) {
+
+  SooperLooperI * pLS;
+  pLS = (SooperLooperI *)Instance;
+
+  //cerr << "Activate: " << pLS << endl;
+	 
+  pLS->lLastMultiCtrl = -1;
+  pLS->lHeldCount = 0;
+
+  pLS->lScratchSamples = 0;
+  pLS->lTapTrigSamples = 0;
+  pLS->lRampSamples = 0;
+  pLS->bPreTap = 1; // first tap init
+  pLS->fLastScratchVal = 0.0f;
+  pLS->fLastTapCtrl = -1;
+  pLS->fCurrRate = 1.0f;
+  pLS->fNextCurrRate = 0.0f;
+  pLS->fQuantizeMode = 0;
+  pLS->fRoundMode = 0;  
+  pLS->bHoldMode = 0;
+  pLS->fSyncMode = 0;
+  pLS->fMuteQuantized = 0;
+  pLS->fOverdubQuantized = 0;
+  pLS->bReplaceQuantized = true;
+  pLS->fRedoTapMode = 1;
+  pLS->bRateCtrlActive = (int) *pLS->pfRateCtrlActive;
+
+  pLS->waitingForSync = 0;
+  pLS->donePlaySync = false;
+  pLS->rounding = false;
+  pLS->safetyFeedback = true;
+  
+  pLS->fWetCurr = pLS->fWetTarget = *pLS->pfWet;
+  pLS->fDryCurr = pLS->fDryTarget = *pLS->pfDry;
+  pLS->fFeedbackCurr = pLS->fFeedbackTarget = *pLS->pfFeedback;
+  pLS->fRateCurr = pLS->fRateTarget = *pLS->pfRate;
+  pLS->fScratchPosCurr = pLS->fScratchPosTarget = *pLS->pfScratchPos;
+
+  fadeStart (&pLS->loopFade, 0.0f);
+  fadeSet (&pLS->loopFade, 0.0f);
+  fadeStart (&pLS->loopSrcFade, 0.0f);
+  fadeSet (&pLS->loopSrcFade, 0.0f);
+  fadeStart (&pLS->feedSrcFade, 0.0f);
+  fadeSet (&pLS->feedSrcFade, 1.0f);
+  fadeStart (&pLS->playFade, 0.0f);
+  fadeSet (&pLS->playFade, 0.0f);
+  fadeStart (&pLS->feedFade, 0.0f);
+  fadeSet (&pLS->feedFade, 1.0f);
+
+  // todo make this a port, for now 2ms
+  //pLS->fLoopXfadeSamples = 0.002 * pLS->fSampleRate;
+  
+  pLS->state = STATE_OFF;
+  pLS->nextState = -1;
+  pLS->wasMuted = false;
+  pLS->recSyncEnded = false;
+
+  pLS->lSamplesSinceSync = 0;
+
+  pLS->lInputBufWritePos = 0;
+  pLS->lFramesUntilInput = 0;
+  pLS->lFramesUntilFilled = 0;
+  pLS->pSharedFill = NULL;
+  memset (pLS->pInputBuf, 0, pLS->lInputBufSize * pLS->lChannelCount * sizeof(LADSPA_Data));
+  
+  clearLoopChunks(pLS);
+
+
+  if (pLS->pfSecsTotal) {
+     *pLS->pfSecsTotal = (LADSPA_Data) pLS->fTotalSecs;
+  }
 
   if (pLS->pfSecsFree) {
-	  *pLS->pfSecsFree = pLS->lBufferSize / pLS->fSampleRate;
+	  *pLS->pfSecsFree = freeLoopSecs (pLS);
   }
   
   //fprintf(stderr,"activated\n");  
@@ -790,10 +2159,10 @@ connectPortToSooperLooper(LADSPA_Handle Instance,
 	 break;
 	 
       case AudioInputPort:
-	 pLS->pfInput = DataLocation;
+	 pLS->pfInput[0] = DataLocation;
 	 break;
       case AudioOutputPort:
-	 pLS->pfOutput = DataLocation;
+	 pLS->pfOutput[0] = DataLocation;
 	 break;
       case SyncInputPort:
 	 pLS->pfSyncInput = DataLocation;
@@ -802,42 +2171,282 @@ connectPortToSooperLooper(LADSPA_Handle Instance,
 	 pLS->pfSyncOutput = DataLocation;
 	 break;
 
-      case State:
-	 pLS->pfStateOut = DataLocation;
-	 break;
-      case LoopLength:
-	 pLS->pfLoopLength = DataLocation;
-	 break;
-      case LoopPosition:
-	 pLS->pfLoopPos = DataLocation;
-	 break;
-      case CycleLength:
-	 pLS->pfCycleLength = DataLocation;
-	 break;
-      case LoopFreeMemory:
-	 pLS->pfSecsFree = DataLocation;
-	 break;
-      case LoopMemory:
-	 pLS->pfSecsTotal= DataLocation;
-	 break;
-      case Waiting:
-	 pLS->pfWaiting= DataLocation;
-	 break;
-      case TrueRate:
-	 pLS->pfRateOutput= DataLocation;
-	 break;
-      case NextState:
-	 pLS->pfNextStateOut = DataLocation;
-	 break;
+      case State:
+	 pLS->pfStateOut = DataLocation;
+	 break;
+      case LoopLength:
+	 pLS->pfLoopLength = DataLocation;
+	 break;
+      case LoopPosition:
+	 pLS->pfLoopPos = DataLocation;
+	 break;
+      case CycleLength:
+	 pLS->pfCycleLength = DataLocation;
+	 break;
+      case LoopFreeMemory:
+	 pLS->pfSecsFree = DataLocation;
+	 break;
+      case LoopMemory:
+	 pLS->pfSecsTotal= DataLocation;
+	 break;
+      case Waiting:
+	 pLS->pfWaiting= DataLocation;
+	 break;
+      case TrueRate:
+	 pLS->pfRateOutput= DataLocation;
+	 break;
+      case NextState:
+	 pLS->pfNextStateOut = DataLocation;
+	 break;
+
+   }
+}
+
+
+
+// copy lCount samples into loop starting at lPos, from srcloop starting
+// at ((lPos + lStartAdj - lEndAdj) % srcloop length), the same mapping
+// the per-sample fill uses.  an invalid source fills with silence.
+static void copyFillSpan(SooperLooperI *pLS, LoopChunk *loop, unsigned long lPos, unsigned long lCount,
+			 LoopChunk *srcloop, unsigned long lStartAdj, unsigned long lEndAdj)
+{
+   LADSPA_Data *pDst, *pSrc;
+   unsigned int chan;
+   unsigned long off, inoff;
+   unsigned long lSpan, lSrcPos, lSrcSum;
+
+   while (lCount > 0)
+   {
+      lSpan = pageSpan (lPos, lCount);
+
+      if (!srcloop->valid) {
+	      pDst = loopWritePtr (pLS, loop, lPos);
+	      FOR_EACH_CHANNEL(pLS, chan, off, inoff) {
+		      memset (pDst + off, 0, lSpan * sizeof(LADSPA_Data));
+	      }
+      }
+      else {
+	      lSrcSum = lPos + lStartAdj - lEndAdj;
+	      // keep the unsigned sum from wrapping inside a span
+	      if (lSrcSum + (lSpan - 1) < lSrcSum) {
+		      lSpan = (ULONG_MAX - lSrcSum) + 1;
+	      }
+	      lSrcPos = lSrcSum % srcloop->lLoopLength;
+	      lSpan = ringSpan (lSrcPos, lSpan, srcloop->lLoopLength);
+	      lSpan = pageSpan (lSrcPos, lSpan);
+
+	      // a page still shared with the source needs no copy
+	      if (!sameFrame (loop, lPos, srcloop, lSrcPos)) {
+		      pDst = loopWritePtr (pLS, loop, lPos);
+		      pSrc = loopReadPtr (pLS, srcloop, lSrcPos);
+
+		      FOR_EACH_CHANNEL(pLS, chan, off, inoff) {
+			      memcpy (pDst + off, pSrc + off, lSpan * sizeof(LADSPA_Data));
+		      }
+	      }
+      }
+
+      lPos += lSpan;
+      lCount -= lSpan;
+   }
+}
+
+// silence lCount samples of loop starting at lPos, letting go of the
+// pages that are covered whole
+static void zeroLoopSpan(SooperLooperI *pLS, LoopChunk *loop, unsigned long lPos, unsigned long lCount)
+{
+   LADSPA_Data *pDst;
+   unsigned long lSpan, lPage;
+   unsigned int chan;
+   unsigned long off, inoff;
+
+   while (lCount > 0)
+   {
+      lSpan = pageSpan (lPos, lCount);
+      lPage = lPos >> LOOP_PAGE_SHIFT;
+
+      if (lPage >= loop->lPageCount || loop->pPages[lPage] == ZERO_PAGE) {
+	      // already silent
+      }
+      else if (lSpan == LOOP_PAGE_FRAMES) {
+	      if (loop->pPages[lPage] & SPILLED_PAGE) {
+		      forgetSpilledPage (pLS, loop, lPage);
+	      }
+	      else {
+		      releasePage (pLS, loop->pPages[lPage]);
+	      }
+	      loop->pPages[lPage] = ZERO_PAGE;
+      }
+      else {
+	      pDst = loopWritePtr (pLS, loop, lPos);
+	      FOR_EACH_CHANNEL(pLS, chan, off, inoff) {
+		      memset (pDst + off, 0, lSpan * sizeof(LADSPA_Data));
+	      }
+      }
+
+      lPos += lSpan;
+      lCount -= lSpan;
+   }
+}
+
+// How far the fill may copy ahead of playback, which only gives the
+// same loop as the sample by sample fill when playback is certain to
+// step through every one of those samples, one at a time and in the
+// direction it is going now, before anything else touches them.
+typedef struct {
+	// samples left in this run, 0 to fill sample by sample
+	unsigned long lCount;
+	// the record position in the head loop, in the direction of
+	// playback the block stops short of it
+	unsigned long lRecPos;
+	// the record position also writes into the head's source
+	bool bRecSource;
+} FillReach;
+
+// the reach for filling at lSampleIndex while playing at fRate.  a rate
+// change, a sync transition, playback sync or the trailing fill from
+// the record position may all move or stop playback within the run
+static inline void fillReach(SooperLooperI *pLS, FillReach *pReach, unsigned long lSampleIndex, unsigned long SampleCount,
+			     LADSPA_Data fRate, double dRecPos, bool bPlaySync)
+{
+	pReach->lCount = 0;
+	pReach->lRecPos = (unsigned long) dRecPos;
+	pReach->bRecSource = (pLS->state == STATE_OVERDUB || pLS->state == STATE_REPLACE || pLS->state == STATE_SUBSTITUTE);
 
+	if (!(g_blockPaths & PathFillAhead)) {
+		return;
+	}
+
+	switch (pLS->state) {
+	case STATE_PLAY:
+	case STATE_MUTE:
+	case STATE_ONESHOT:
+	case STATE_OVERDUB:
+	case STATE_REPLACE:
+	case STATE_SUBSTITUTE:
+		break;
+	default:
+		return;
+	}
+
+	if ((fRate != 1.0f && fRate != -1.0f) || fRate != pLS->fCurrRate
+	    || pLS->waitingForSync || pLS->fNextCurrRate != 0.0f
+	    || pLS->lFramesUntilFilled > 0 || bPlaySync)
+	{
+		return;
+	}
+
+	pReach->lCount = SampleCount - lSampleIndex;
+}
+
+// Copy a block of up to FILL_BLOCK samples of the unfilled range
+// [lMarkL, lMarkH] starting at lCurrPos, in the direction of playback
+// and no further than pReach allows.  pAheadL/pAheadH track how far the
+// range has already been copied from either end, so the marks
+// themselves still advance one sample at a time and keep their meaning
+// for the rest of the state machine.
+static void fillAhead(SooperLooperI *pLS, LoopChunk *loop, unsigned long lCurrPos,
+		      unsigned long lMarkL, unsigned long lMarkH,
+		      unsigned long *pAheadL, unsigned long *pAheadH,
+		      unsigned long lStartAdj, unsigned long lEndAdj, const FillReach *pReach,
+		      bool bRecFirst)
+{
+   unsigned long lFirst, lLast;
+   // the record position goes into the source before the fill reads it
+   // at the same sample, so then the block may not cover it either
+   bool bRecHere = (bRecFirst && pReach->lRecPos == lCurrPos);
+
+   if ((*pAheadL != LONG_MAX && lCurrPos <= *pAheadL)
+       || (*pAheadH != LONG_MAX && lCurrPos >= *pAheadH)) {
+	   // already done, except that the sample at the mark is copied
+	   // again each time it comes around, as it always has been
+	   if (lCurrPos == lMarkL || lCurrPos == lMarkH) {
+		   copyFillSpan (pLS, loop, lCurrPos, 1, loop->srcloop, lStartAdj, lEndAdj);
+	   }
+	   return;
+   }
+
+   if (pLS->fCurrRate > 0) {
+	   lFirst = lCurrPos;
+	   lLast = (lMarkH - lCurrPos >= FILL_BLOCK) ? lCurrPos + FILL_BLOCK - 1 : lMarkH;
+	   if (lLast - lCurrPos >= pReach->lCount) {
+		   lLast = lCurrPos + pReach->lCount - 1;
+	   }
+	   if (bRecHere) {
+		   lLast = lCurrPos;
+	   }
+	   else if (pReach->lRecPos > lCurrPos && pReach->lRecPos - 1 < lLast) {
+		   lLast = pReach->lRecPos - 1;
+	   }
+	   if (*pAheadH != LONG_MAX && *pAheadH > lCurrPos && *pAheadH - 1 < lLast) {
+		   lLast = *pAheadH - 1;
+	   }
+	   *pAheadL = lLast;
    }
+   else {
+	   lLast = lCurrPos;
+	   lFirst = (lCurrPos - lMarkL >= FILL_BLOCK) ? lCurrPos - FILL_BLOCK + 1 : lMarkL;
+	   if (lCurrPos - lFirst >= pReach->lCount) {
+		   lFirst = lCurrPos - pReach->lCount + 1;
+	   }
+	   if (bRecHere) {
+		   lFirst = lCurrPos;
+	   }
+	   else if (pReach->lRecPos < lCurrPos && pReach->lRecPos + 1 > lFirst) {
+		   lFirst = pReach->lRecPos + 1;
+	   }
+	   if (*pAheadL != LONG_MAX && *pAheadL < lCurrPos && *pAheadL + 1 > lFirst) {
+		   lFirst = *pAheadL + 1;
+	   }
+	   *pAheadH = lFirst;
+   }
+
+   copyFillSpan (pLS, loop, lFirst, lLast - lFirst + 1, loop->srcloop, lStartAdj, lEndAdj);
 }
 
+// block copies are only used when the source is complete and will not
+// be modified before we would have gotten to the data.  multiply and
+// insert write into their source at a different length, and right after
+// a record the late input is still being faded into the source, so those
+// keep the sample by sample fill.  the record position is in the head
+// loop, so a loop it writes into, or whose source it writes into, must
+// line up with the head for the block to stop short of it
+static inline bool canFillAhead(SooperLooperI *pLS, LoopChunk *mloop, LoopChunk *loop, const FillReach *pReach,
+				unsigned long lStartAdj, unsigned long lEndAdj)
+{
+   LoopChunk *srcloop = loop->srcloop;
 
+   if (pReach->lCount == 0) {
+	   return false;
+   }
+   if (pLS->state == STATE_MULTIPLY || pLS->state == STATE_INSERT) {
+	   return false;
+   }
+   if (pLS->loopSrcFade.atten != 0.0f || pLS->loopSrcFade.delta > 0.0f) {
+	   return false;
+   }
+   if (!srcloop || (srcloop->valid && (!srcloop->lLoopLength || srcloop->frontfill || srcloop->backfill))) {
+	   return false;
+   }
+   if ((loop == mloop || (pReach->bRecSource && loop == mloop->srcloop))
+       && loop->lLoopLength != mloop->lLoopLength) {
+	   return false;
+   }
+   if (loop == mloop && pReach->bRecSource && srcloop->valid
+       && (srcloop->lLoopLength != mloop->lLoopLength || lStartAdj != lEndAdj)) {
+	   return false;
+   }
+   return true;
+}
 
-static inline void fillLoops(SooperLooperI *pLS, LoopChunk *mloop, unsigned long lCurrPos, bool leavemarks)
+static inline void fillLoops(SooperLooperI *pLS, LoopChunk *mloop, unsigned long lCurrPos, bool leavemarks,
+			     const FillReach *pReach)
 {
    LoopChunk *loop=NULL, *nloop, *srcloop;
+   LADSPA_Data *pDst, *pSrc;
+   unsigned int chan;
+   unsigned long off, inoff;
+   bool bRecFirst;
    
    // descend to the oldest valid unfilled loop
    for (nloop=mloop; nloop; nloop = nloop->srcloop)
@@ -850,85 +2459,603 @@ static inline void fillLoops(SooperLooperI *pLS, LoopChunk *mloop, unsigned long
       break;
    }
 
-   // everything is filled!
-   if (!loop) return;
+   // everything is filled!
+   if (!loop) return;
+
+   // do filling from earliest to latest
+   for (; loop; loop=loop->next)
+   {
+      srcloop = loop->srcloop;
+      // in overdub the input fades into the source of the head at the
+      // record position before this, see FillReach
+      bRecFirst = (pReach->bRecSource && (loop == mloop || loop == mloop->srcloop));
+
+      // leavemarks is a special hack
+      if (leavemarks || (loop->frontfill && lCurrPos<=loop->lMarkH && lCurrPos>=loop->lMarkL))
+      {
+	      if (!leavemarks && canFillAhead(pLS, mloop, loop, pReach, 0, 0)) {
+		      fillAhead (pLS, loop, lCurrPos, loop->lMarkL, loop->lMarkH,
+				 &loop->lFillAheadL, &loop->lFillAheadH, 0, 0, pReach, bRecFirst);
+	      }
+	      else {
+		      if (!srcloop->valid) {
+			      // if src is not valid, fill with silence
+			      pDst = loopWritePtr (pLS, loop, lCurrPos);
+			      FOR_EACH_CHANNEL(pLS, chan, off, inoff) {
+				      pDst[off] = 0.0f;
+			      }
+			      //DBG(fprintf(stderr, "srcloop invalid\n"));
+		      }
+		      else if (srcloop->lLoopLength
+			       && !sameFrame (loop, lCurrPos, srcloop, lCurrPos % srcloop->lLoopLength)) {
+			      // we need to finish off a previous
+			      pDst = loopWritePtr (pLS, loop, lCurrPos);
+			      pSrc = loopReadPtr (pLS, srcloop, lCurrPos % srcloop->lLoopLength);
+			      FOR_EACH_CHANNEL(pLS, chan, off, inoff) {
+				      pDst[off] = pSrc[off];
+			      }
+		      }
+	      }
+
+	      if (!leavemarks) {
+		      if (loop == pLS->pSharedFill) {
+			      pLS->bSharedFrontFilled = true;
+		      }
+		      // move the right mark according to rate
+		      if (pLS->fCurrRate > 0) {
+			      loop->lMarkL = lCurrPos;
+		      }
+		      else {
+			      loop->lMarkH = lCurrPos;
+		      }
+		      
+		      // ASSUMPTION: our overdub rate is +/- 1 only
+		      if (loop->lMarkL == loop->lMarkH) {
+			      // now we take the input from ourself
+			      DBG(fprintf(stderr,"%u:%u  front segment filled for %08x for %08x in at %lu\n", pLS->lLoopIndex, pLS->lChannelIndex,
+					  (unsigned)loop, (unsigned) srcloop, loop->lMarkL););
+			      loop->frontfill = 0;
+			      loop->lMarkL = loop->lMarkH = LONG_MAX;
+			      clearFillAhead(loop);
+		      }
+	      }
+      }
+      else if (loop->backfill && lCurrPos<=loop->lMarkEndH && lCurrPos>=loop->lMarkEndL)		
+      {
+	      if (!leavemarks && canFillAhead(pLS, mloop, loop, pReach, loop->lStartAdj, loop->lEndAdj)) {
+		      fillAhead (pLS, loop, lCurrPos, loop->lMarkEndL, loop->lMarkEndH,
+				 &loop->lEndFillAheadL, &loop->lEndFillAheadH, loop->lStartAdj, loop->lEndAdj, pReach, bRecFirst);
+	      }
+	      else {
+		      if (srcloop && !srcloop->valid) {
+			      // if src is not valid, fill with silence
+			      pDst = loopWritePtr (pLS, loop, lCurrPos);
+			      FOR_EACH_CHANNEL(pLS, chan, off, inoff) {
+				      pDst[off] = 0.0f;
+			      }
+			      //DBG(fprintf(stderr, "srcloop invalid\n"));
+		      }
+		      else if (srcloop && srcloop->lLoopLength
+			       && !sameFrame (loop, lCurrPos, srcloop, (lCurrPos  + loop->lStartAdj - loop->lEndAdj) % srcloop->lLoopLength)) {
+			      // we need to finish off a previous
+			      pDst = loopWritePtr (pLS, loop, lCurrPos);
+			      pSrc = loopReadPtr (pLS, srcloop, (lCurrPos  + loop->lStartAdj - loop->lEndAdj) % srcloop->lLoopLength);
+			      FOR_EACH_CHANNEL(pLS, chan, off, inoff) {
+				      pDst[off] = pSrc[off];
+			      }
+		      }
+	      }
+
+	      if (!leavemarks) {
+		      if (loop == pLS->pSharedFill) {
+			      pLS->bSharedBackFilled = true;
+		      }
+		      // move the right mark according to rate
+		      if (pLS->fCurrRate > 0) {
+			      loop->lMarkEndL = lCurrPos;
+		      }
+		      else {
+			      loop->lMarkEndH = lCurrPos;
+			      
+		      }
+		      // ASSUMPTION: our overdub rate is +/- 1 only
+		      if (loop->lMarkEndL == loop->lMarkEndH) {
+			      // now we take the input from ourself
+			      DBG(fprintf(stderr,"%u:%u  back segment filled in for %08x from %08x at %lu\n", pLS->lLoopIndex, pLS->lChannelIndex,
+					  (unsigned)loop, (unsigned)srcloop, loop->lMarkEndL););
+			      loop->backfill = 0;
+			      loop->lMarkEndL = loop->lMarkEndH = LONG_MAX;
+			      clearEndFillAhead(loop);
+		      }
+	      }
+      }
+      
+      if (mloop == loop) break;
+   }
+
+}
+
+// An overdub that shares the pages of its source holds the source where
+// the fill has not been yet, where the copy would still be silent.  As
+// long as its first pass steps forward one sample at a time the fill
+// gets there before anything reads it, but once that is no longer
+// certain the rest is silenced here, so the loop is what the fill would
+// have left.  Forward from lSharedFillPos the unfilled samples are those
+// after lMarkEndL, after lMarkL, and the ones the record position has
+// yet to fill behind lSharedFillPos.
+static void settleSharedFill(SooperLooperI *pLS)
+{
+   LoopChunk *loop = pLS->pSharedFill;
+   unsigned long lFrom;
+
+   if (!loop) return;
+   pLS->pSharedFill = NULL;
+
+   if (loop->frontfill) {
+	   lFrom = loop->lMarkL + (pLS->bSharedFrontFilled ? 1 : 0);
+	   if (lFrom <= loop->lMarkH) {
+		   zeroLoopSpan (pLS, loop, lFrom, loop->lMarkH - lFrom + 1);
+	   }
+   }
+   if (loop->backfill) {
+	   lFrom = loop->lMarkEndL + (pLS->bSharedBackFilled ? 1 : 0);
+	   if (lFrom <= loop->lMarkEndH) {
+		   zeroLoopSpan (pLS, loop, lFrom, loop->lMarkEndH - lFrom + 1);
+	   }
+   }
+   if (pLS->lFramesUntilFilled > 0) {
+	   zeroLoopSpan (pLS, loop, pLS->lSharedFillPos - pLS->lFramesUntilFilled, pLS->lFramesUntilFilled);
+   }
+
+   DBG(fprintf(stderr,"%u:%u  settled shared fill of %08x\n", pLS->lLoopIndex, pLS->lChannelIndex, (unsigned)loop));
+}
+
+// true if the shared fill may go on through this run, see settleSharedFill
+static bool sharedFillSafe(SooperLooperI *pLS, bool bPlaySync)
+{
+   LoopChunk *loop = pLS->pSharedFill;
+
+   if (loop != pLS->headLoopChunk) {
+	   return false;
+   }
+   if (!loop->frontfill && !loop->backfill && pLS->lFramesUntilFilled <= 0) {
+	   // all filled, nothing left to settle
+	   return false;
+   }
+
+   switch (pLS->state) {
+   case STATE_OVERDUB:
+   case STATE_REPLACE:
+   case STATE_SUBSTITUTE:
+   case STATE_PLAY:
+   case STATE_MUTE:
+	   break;
+   default:
+	   return false;
+   }
+
+   return (pLS->fCurrRate == 1.0f && !(pLS->bRateCtrlActive && *pLS->pfRate != 1.0f)
+	   && !pLS->waitingForSync && pLS->fNextCurrRate == 0.0f && !pLS->rounding && !bPlaySync);
+}
+
+
+// Number of samples from lSampleIndex, at most lSpan, before the next non
+// zero sync input sample.  Uses the event list of this run if there is
+// one, the planners only ever ask for increasing sample indexes.
+static unsigned long syncFreeSpan(SooperLooperI *pLS, LADSPA_Data *pfSyncInput,
+				  unsigned long lSampleIndex, unsigned long lSpan)
+{
+	if (pLS->lSyncEventCount >= 0) {
+		unsigned long lFrame = lSampleIndex + pLS->lSyncEventOffset;
+		unsigned long lCount = (unsigned long) pLS->lSyncEventCount;
+
+		while (pLS->lSyncEventPos < lCount && pLS->pSyncEvents[pLS->lSyncEventPos].frame < lFrame) {
+			pLS->lSyncEventPos++;
+		}
+		if (pLS->lSyncEventPos < lCount && pLS->pSyncEvents[pLS->lSyncEventPos].frame - lFrame < lSpan) {
+			return pLS->pSyncEvents[pLS->lSyncEventPos].frame - lFrame;
+		}
+		return lSpan;
+	}
+
+	for (unsigned long n = 0; n < lSpan; ++n) {
+		if (pfSyncInput[lSampleIndex + n] != 0.0f) {
+			return n;
+		}
+	}
+
+	return lSpan;
+}
+
+// Segment planner for the play family of states.  Returns the number of
+// samples starting at lSampleIndex in which nothing can change except the
+// playback position: no sync input, no sync point a command already put
+// in the sync output, no quantize boundary, no loop wrap, no fade in
+// progress and no pending fill.  Those samples may be rendered
+// with the reduced kernel in the play case, everything else goes through
+// the full per-sample path.  The span stops well short of any boundary,
+// so the per-sample path always sees the boundary sample itself.
+static unsigned long planPlaySegment(SooperLooperI *pLS, LoopChunk *loop, LADSPA_Data *pfSyncInput,
+				     LADSPA_Data *pfSyncOutput, unsigned long lSampleIndex, unsigned long SampleCount, LADSPA_Data fSegRate,
+				     LADSPA_Data fSyncMode, LADSPA_Data fQuantizeMode, unsigned int eighthSamples)
+{
+	unsigned long lSpan = SampleCount - lSampleIndex;
+	unsigned long lQuantLength = 0;
+	double dPos = loop->dCurrPos;
+	long lTarget;
+	long lSegs;
+
+	if (!(g_blockPaths & PathPlaySegments)) {
+		return 0;
+	}
+
+	if (pLS->state != STATE_PLAY && pLS->state != STATE_MUTE && pLS->state != STATE_PAUSED) {
+		return 0;
+	}
+
+	if (!fadeSettled (&pLS->loopFade)
+	    || !fadeSettled (&pLS->loopSrcFade)
+	    || !fadeSettled (&pLS->feedSrcFade)
+	    || !fadeSettled (&pLS->playFade)
+	    || !fadeSettled (&pLS->feedFade))
+	{
+		return 0;
+	}
+
+	// the kernel does not write into the loop, which is only
+	// correct when no input is being mixed in
+	if (pLS->loopFade.atten != 0.0f || pLS->feedFade.atten != 1.0f) {
+		return 0;
+	}
+
+	if (pLS->lFramesUntilFilled > 0 || (loop->valid && (loop->frontfill || loop->backfill))) {
+		return 0;
+	}
+
+	if (fSyncMode != 0.0f) {
+		if (pLS->waitingForSync || (fSyncMode == 2.0f && pLS->recSyncEnded)) {
+			return 0;
+		}
+	}
+	else if (fQuantizeMode == QUANT_OFF) {
+		// every sample is a sync point
+		if (pLS->waitingForSync || pLS->fNextCurrRate != 0.0f) {
+			return 0;
+		}
+	}
+	else if (fQuantizeMode == QUANT_CYCLE) {
+		lQuantLength = loop->lCycleLength;
+	}
+	else if (fQuantizeMode == QUANT_LOOP) {
+		lQuantLength = loop->lLoopLength;
+	}
+	else if (fQuantizeMode == QUANT_8TH) {
+		lQuantLength = eighthSamples;
+	}
+
+	if (dPos < 0.0 || dPos >= loop->lLoopLength) {
+		// already wrapped in this cycle
+		return 0;
+	}
+
+	unsigned int lPos = (unsigned int) dPos;
+	long lSyncSum = lPos + loop->lSyncPos;
+	unsigned long lQuantRem = 0;
+
+	if (lQuantLength) {
+		// a negative sync offset sum is left to the per-sample tests
+		if (lSyncSum < 0) {
+			return 0;
+		}
+		lQuantRem = (unsigned long) lSyncSum % lQuantLength;
+	}
+
+	if (fSegRate == 0.0f) {
+		if (lQuantLength && lQuantRem == 0) {
+			return 0;
+		}
+	}
+	else {
+		// the accumulated position error must stay well below one step
+		if (fabsf(fSegRate) < MIN_SEGMENT_RATE) {
+			return 0;
+		}
+
+		if (fSegRate > 0.0f) {
+			lTarget = (long) loop->lLoopLength;
+			if (lQuantLength) {
+				long lNext = lPos + (long) ((lQuantLength - lQuantRem) % lQuantLength);
+				if (lNext < lTarget) lTarget = lNext;
+			}
+			lSegs = (long) ((lTarget - dPos) / fSegRate) - 1;
+		}
+		else {
+			lTarget = -1;
+			if (lQuantLength) {
+				long lPrev = lPos - (long) lQuantRem;
+				if (lPrev > lTarget) lTarget = lPrev;
+			}
+			lSegs = (long) ((dPos - (lTarget + 1)) / -fSegRate) - 1;
+		}
+
+		if (lSegs <= 0) {
+			return 0;
+		}
+		if ((unsigned long) lSegs < lSpan) {
+			lSpan = (unsigned long) lSegs;
+		}
+	}
+
+	if (fSyncMode == 0.0f && (pLS->waitingForSync || pLS->fNextCurrRate != 0.0f)) {
+		// commands like trigger and mute write a sync point into the
+		// output themselves, and a pending transition fires right there
+		for (unsigned long n = 0; n < lSpan; ++n) {
+			if (pfSyncOutput[lSampleIndex + n] != 0.0f) {
+				lSpan = n;
+				break;
+			}
+		}
+		if (lSpan == 0) {
+			return 0;
+		}
+	}
+
+	// sync input is always handled per sample
+	return syncFreeSpan (pLS, pfSyncInput, lSampleIndex, lSpan);
+}
+
+// Gains of a play segment.  The controls ramp by their delta every
+// sample while they move, the fades are settled for the whole segment.
+typedef struct {
+	LADSPA_Data fWet;
+	LADSPA_Data fDry;
+	LADSPA_Data fFeedback;
+	LADSPA_Data fScratchPos;
+	LADSPA_Data wetDelta;
+	LADSPA_Data dryDelta;
+	LADSPA_Data feedbackDelta;
+	LADSPA_Data scratchDelta;
+	LADSPA_Data fPlayAtten;
+	LADSPA_Data fFeedAtten;
+} PlayGains;
+
+// The record position of a play segment, trailing playback by the
+// latency.  The input has faded out of it, but mixing that in still
+// turns a negative zero there positive, and anything into a NaN if the
+// input is not finite, so the kernel leaves samples where it would
+// change the loop to the full path.
+typedef struct {
+	LoopChunk *loop;
+	LADSPA_Data fBehind;
+	LADSPA_Data fLoopAtten;
+} RecordTap;
+
+// renders samples lStart to lEnd of a play segment from a span of loop
+// memory starting at loop position lSpanPos, advancing *pdPos.  returns
+// the sample it stopped at, before lEnd if that one needs the full path
+typedef unsigned long (*PlaySpanFunc) (SooperLooperI *pLS, LADSPA_Data **pfOutput, LADSPA_Data *pfLoopSpan, long lSpanPos,
+				       const LADSPA_Data *pfInSpan, unsigned long lStart, unsigned long lEnd,
+				       double *pdPos, LADSPA_Data fRate, PlayGains *pGains, const RecordTap *pRec);
+
+// The play span kernel, specialized on feeding back into the loop while
+// playing, ramping controls and a single channel, so that none of them
+// is tested per sample.  Picked from playSpanKernels once per segment.
+// The sync, quantize, playback sync, tempo rounding and rate modes are
+// not among these: planPlaySegment ends a segment before any sample
+// where they could matter, and the per-sample path of every state still
+// tests them at run time
+template <bool FEEDBACK, bool RAMP, bool MONO>
+static unsigned long playSpan (SooperLooperI *pLS, LADSPA_Data **pfOutput, LADSPA_Data *pfLoopSpan, long lSpanPos,
+			       const LADSPA_Data *pfInSpan, unsigned long lStart, unsigned long lEnd,
+			       double *pdPos, LADSPA_Data fRate, PlayGains *pGains, const RecordTap *pRec)
+{
+	LADSPA_Data fWet = pGains->fWet;
+	LADSPA_Data fDry = pGains->fDry;
+	LADSPA_Data fFeedback = pGains->fFeedback;
+	LADSPA_Data fScratchPos = pGains->fScratchPos;
+	LADSPA_Data fPlayAtten = pGains->fPlayAtten;
+	LADSPA_Data fFeedAtten = pGains->fFeedAtten;
+	LADSPA_Data fLoopAtten = pRec->fLoopAtten;
+	unsigned long lLoopLength = pRec->loop->lLoopLength;
+	double dPos = *pdPos;
+	unsigned long lRecPage = ULONG_MAX;
+	const LADSPA_Data *pfRecPage = 0;
+	unsigned int lChan;
+	unsigned long lChanOff, lInChanOff;
+	unsigned long lSampleIndex;
+
+	for (lSampleIndex = lStart; lSampleIndex < lEnd; ++lSampleIndex) {
+		LADSPA_Data *pLoopSample = &pfLoopSpan[(long) (unsigned int) dPos - lSpanPos];
+		unsigned long lRecPos = (unsigned int) trailingPos (dPos, pRec->fBehind, lLoopLength);
+		const LADSPA_Data *pRecSample;
+
+		if ((lRecPos >> LOOP_PAGE_SHIFT) != lRecPage) {
+			lRecPage = lRecPos >> LOOP_PAGE_SHIFT;
+			pfRecPage = loopReadPtr (pLS, pRec->loop, lRecPage << LOOP_PAGE_SHIFT);
+		}
+		pRecSample = pfRecPage + (lRecPos & LOOP_PAGE_MASK);
+
+		if (MONO) {
+			if (!sameSample (pRecSample[0], (pRecSample[0] * fFeedAtten) + fLoopAtten * pfInSpan[lSampleIndex - lStart])) {
+				break;
+			}
+		}
+		else {
+			bool bChanged = false;
+			FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+				if (!sameSample (pRecSample[lChanOff], (pRecSample[lChanOff] * fFeedAtten)
+						 + fLoopAtten * pfInSpan[lInChanOff + lSampleIndex - lStart])) {
+					bChanged = true;
+				}
+			}
+			if (bChanged) {
+				break;
+			}
+		}
+
+		if (RAMP) {
+			fWet += pGains->wetDelta;
+			fDry += pGains->dryDelta;
+			fFeedback += pGains->feedbackDelta;
+			fScratchPos += pGains->scratchDelta;
+		}
+
+		if (MONO) {
+			pfOutput[0][lSampleIndex] = fWet * fPlayAtten * pLoopSample[0]
+				+ fDry * pfInSpan[lSampleIndex - lStart];
+
+			if (FEEDBACK) {
+				pLoopSample[0] *= fFeedback * fFeedAtten;
+			}
+		}
+		else {
+			FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+				pfOutput[lChan][lSampleIndex] = fWet * fPlayAtten * pLoopSample[lChanOff]
+					+ fDry * pfInSpan[lInChanOff + lSampleIndex - lStart];
+
+				if (FEEDBACK) {
+					pLoopSample[lChanOff] *= fFeedback * fFeedAtten;
+				}
+			}
+		}
+
+		dPos = dPos + fRate;
+	}
+
+	pGains->fWet = fWet;
+	pGains->fDry = fDry;
+	pGains->fFeedback = fFeedback;
+	pGains->fScratchPos = fScratchPos;
+	*pdPos = dPos;
+
+	return lSampleIndex;
+}
+
+// indexed by [feedback][ramp][mono]
+static const PlaySpanFunc playSpanKernels[2][2][2] = {
+	{ { playSpan<false, false, false>, playSpan<false, false, true> },
+	  { playSpan<false, true, false>,  playSpan<false, true, true> } },
+	{ { playSpan<true, false, false>,  playSpan<true, false, true> },
+	  { playSpan<true, true, false>,   playSpan<true, true, true> } }
+};
+
+// Segment planner for the overdub family of states.  Returns the number
+// of samples starting at lSampleIndex that can be mixed with the vector
+// kernels: unit rate on a whole sample position, settled fades, input
+// already flowing, nothing left to fill, and no sync, quantize or wrap
+// point for any of the play, record and source positions.  The span is
+// also contiguous in the loop memory and the input latency buffer.  The
+// positions at lSampleIndex are returned in the pointer arguments.
+static unsigned long planOverdubSegment(SooperLooperI *pLS, LoopChunk *loop, LADSPA_Data *pfSyncInput,
+					unsigned long lSampleIndex, unsigned long SampleCount, LADSPA_Data fRate,
+					LADSPA_Data fLatency, LADSPA_Data fSyncMode, LADSPA_Data fQuantizeMode, unsigned int eighthSamples,
+					unsigned long *plCurrPos, unsigned long *plRecPos, unsigned long *plSrcPos, unsigned long *plInPos)
+{
+	LoopChunk *srcloop = loop->srcloop;
+	unsigned long lSpan = SampleCount - lSampleIndex;
+	unsigned long lQuantLength = 0;
+	double dPos = loop->dCurrPos;
+	double rCurrPos, rpCurrPos;
+
+	if (fRate != 1.0f || dPos != floor(dPos) || dPos < 0.0 || dPos >= loop->lLoopLength) {
+		return 0;
+	}
+
+	if (!fadeSettled (&pLS->loopFade)
+	    || !fadeSettled (&pLS->loopSrcFade)
+	    || !fadeSettled (&pLS->feedSrcFade)
+	    || !fadeSettled (&pLS->playFade)
+	    || !fadeSettled (&pLS->feedFade))
+	{
+		return 0;
+	}
 
-   // do filling from earliest to latest
-   for (; loop; loop=loop->next)
-   {
-      srcloop = loop->srcloop;
+	if (pLS->lFramesUntilInput > 0 || pLS->lFramesUntilFilled > 0
+	    || (loop->valid && (loop->frontfill || loop->backfill))
+	    || !srcloop->lLoopLength)
+	{
+		return 0;
+	}
 
-      // leavemarks is a special hack
-      if (leavemarks || (loop->frontfill && lCurrPos<=loop->lMarkH && lCurrPos>=loop->lMarkL))
-      {
-	      if (!srcloop->valid) {
-		      // if src is not valid, fill with silence
-		      pLS->pSampleBuf[(loop->lLoopStart + lCurrPos) & pLS->lBufferSizeMask] = 0.0f;
-		      //DBG(fprintf(stderr, "srcloop invalid\n"));
-	      }
-	      else if (srcloop->lLoopLength) {
-		      // we need to finish off a previous
-		      pLS->pSampleBuf[(loop->lLoopStart + lCurrPos) & pLS->lBufferSizeMask] = 
-			      pLS->pSampleBuf[(srcloop->lLoopStart + (lCurrPos % srcloop->lLoopLength)) & pLS->lBufferSizeMask];
-	      }
+	if (fSyncMode != 0.0f) {
+		if (pLS->waitingForSync || (fSyncMode == 2.0f && pLS->recSyncEnded)) {
+			return 0;
+		}
+	}
+	else if (fQuantizeMode == QUANT_OFF) {
+		// every sample is a sync point
+		if (pLS->waitingForSync || pLS->fNextCurrRate != 0.0f) {
+			return 0;
+		}
+	}
+	else if (fQuantizeMode == QUANT_CYCLE) {
+		lQuantLength = loop->lCycleLength;
+	}
+	else if (fQuantizeMode == QUANT_LOOP) {
+		lQuantLength = loop->lLoopLength;
+	}
+	else if (fQuantizeMode == QUANT_8TH) {
+		lQuantLength = eighthSamples;
+	}
 
-	      if (!leavemarks) {
-		      // move the right mark according to rate
-		      if (pLS->fCurrRate > 0) {
-			      loop->lMarkL = lCurrPos;
-		      }
-		      else {
-			      loop->lMarkH = lCurrPos;
-		      }
-		      
-		      // ASSUMPTION: our overdub rate is +/- 1 only
-		      if (loop->lMarkL == loop->lMarkH) {
-			      // now we take the input from ourself
-			      DBG(fprintf(stderr,"%u:%u  front segment filled for %08x for %08x in at %lu\n", pLS->lLoopIndex, pLS->lChannelIndex,
-					  (unsigned)loop, (unsigned) srcloop, loop->lMarkL););
-			      loop->frontfill = 0;
-			      loop->lMarkL = loop->lMarkH = LONG_MAX;
-		      }
-	      }
-      }
-      else if (loop->backfill && lCurrPos<=loop->lMarkEndH && lCurrPos>=loop->lMarkEndL)		
-      {
+	// same positions as the per-sample path
+	rCurrPos = fmod (dPos - fLatency, loop->lLoopLength);
+	if (rCurrPos < 0) {
+		rCurrPos += loop->lLoopLength;
+	}
+	rpCurrPos = fmod (dPos - fLatency, srcloop->lLoopLength);
+	if (rpCurrPos < 0) {
+		rpCurrPos += srcloop->lLoopLength;
+	}
 
-	      if (srcloop && !srcloop->valid) {
-		      // if src is not valid, fill with silence
-		      pLS->pSampleBuf[(loop->lLoopStart + lCurrPos) & pLS->lBufferSizeMask] = 0.0f;
-		      //DBG(fprintf(stderr, "srcloop invalid\n"));
-	      }
-	      else if (srcloop && srcloop->lLoopLength) {
-		      // we need to finish off a previous
-		      pLS->pSampleBuf[(loop->lLoopStart + lCurrPos) & pLS->lBufferSizeMask] =
-			      pLS->pSampleBuf[(srcloop->lLoopStart +
-				       ((lCurrPos  + loop->lStartAdj - loop->lEndAdj) % srcloop->lLoopLength)) & pLS->lBufferSizeMask];
-	      }
+	unsigned long lPos = (unsigned long) dPos;
+	unsigned long lRecPos = (unsigned int) rCurrPos;
+	unsigned long lSrcPos = (unsigned int) rpCurrPos;
+	unsigned long lInPos = (unsigned long) (- pLS->lFramesUntilInput);
+
+	lInPos = (lInPos <= pLS->lInputBufWritePos)
+		? (pLS->lInputBufWritePos - lInPos)
+		: (pLS->lInputBufSize - (lInPos - pLS->lInputBufWritePos));
+	lInPos = (lInPos + lSampleIndex) & pLS->lInputBufMask;
+
+	if (lQuantLength) {
+		// quantize points are on the record position
+		long lSyncSum = (long) lRecPos + loop->lSyncPos;
+		if (lSyncSum < 0) {
+			return 0;
+		}
+		unsigned long lQuantRem = (unsigned long) lSyncSum % lQuantLength;
+		if (lQuantRem == 0) {
+			return 0;
+		}
+		if (lQuantLength - lQuantRem < lSpan) {
+			lSpan = lQuantLength - lQuantRem;
+		}
+	}
 
-	      if (!leavemarks) {
-		      // move the right mark according to rate
-		      if (pLS->fCurrRate > 0) {
-			      loop->lMarkEndL = lCurrPos;
-		      }
-		      else {
-			      loop->lMarkEndH = lCurrPos;
-			      
-		      }
-		      // ASSUMPTION: our overdub rate is +/- 1 only
-		      if (loop->lMarkEndL == loop->lMarkEndH) {
-			      // now we take the input from ourself
-			      DBG(fprintf(stderr,"%u:%u  back segment filled in for %08x from %08x at %lu\n", pLS->lLoopIndex, pLS->lChannelIndex,
-					  (unsigned)loop, (unsigned)srcloop, loop->lMarkEndL););
-			      loop->backfill = 0;
-			      loop->lMarkEndL = loop->lMarkEndH = LONG_MAX;
-		      }
-	      }
-      }
-      
-      if (mloop == loop) break;
-   }
+	// the play position must not wrap, not even after the last sample
+	if (lPos + lSpan >= loop->lLoopLength) {
+		lSpan = loop->lLoopLength - 1 - lPos;
+	}
+	lSpan = ringSpan (lRecPos, lSpan, loop->lLoopLength);
+	lSpan = ringSpan (lSrcPos, lSpan, srcloop->lLoopLength);
+
+	lSpan = pageSpan (lPos, lSpan);
+	lSpan = pageSpan (lRecPos, lSpan);
+	lSpan = pageSpan (lSrcPos, lSpan);
+	lSpan = ringSpan (lInPos, lSpan, pLS->lInputBufSize);
 
+	// sync input is always handled per sample
+	if (fSyncMode != 0.0f) {
+		lSpan = syncFreeSpan (pLS, pfSyncInput, lSampleIndex, lSpan);
+	}
+
+	*plCurrPos = lPos;
+	*plRecPos = lRecPos;
+	*plSrcPos = lSrcPos;
+	*plInPos = lInPos;
+
+	return lSpan;
 }
 
 
@@ -950,8 +3077,8 @@ static LoopChunk* beginMultiply(SooperLooperI *pLS, LoopChunk *loop)
 	   loop->mult_out += 1;
 	   pLS->state = STATE_MULTIPLY;
 	   
-	   pLS->fLoopFadeDelta = 1.0f / xfadeSamples;
-	   pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+	   fadeStart (&pLS->loopFade, 1.0f / xfadeSamples);
+	   fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 	   
 	   pLS->nextState = STATE_PLAY;
 
@@ -971,9 +3098,7 @@ static LoopChunk* beginMultiply(SooperLooperI *pLS, LoopChunk *loop)
 	      DBG(fprintf(stderr, "begin mult: there is no source\n"));
 	      
 	      loop = srcloop;
-	      pLS->headLoopChunk = pLS->tailLoopChunk = loop;
-	      loop->next = NULL;
-	      loop->prev = NULL;
+	      resetLoopHistory (pLS, loop);
 	      loop->valid = 1;
 
 	      // no mult op
@@ -992,18 +3117,18 @@ static LoopChunk* beginMultiply(SooperLooperI *pLS, LoopChunk *loop)
 	      // coming out of record we can actually 
 	      // set the loopfadeatten to 0 without harm
 	      // since we're fading out the loopsrcfade
-	       pLS->fLoopFadeAtten = 0.0f;
+	       fadeSet (&pLS->loopFade, 0.0f);
       }
 
 //      if (*pLS->pfQuantMode == 0.0f) {
 	      // we'll do this later if we are quantizing
-	      pLS->fLoopFadeDelta = 1.0f / xfadeSamples;
-	      pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+	      fadeStart (&pLS->loopFade, 1.0f / xfadeSamples);
+	      fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 //      }
 
-      pLS->fPlayFadeDelta = 1.0f / xfadeSamples; // added by jlc 20120709
+      fadeStart (&pLS->playFade, 1.0f / xfadeSamples); // added by jlc 20120709
 
-      //pLS->fPlayFadeDelta = -1.0f / xfadeSamples;
+      //fadeStart (&pLS->playFade, -1.0f / xfadeSamples);
       long lInputLatency = (long) (*pLS->pfInputLatency);
       long lOutputLatency = (long) (*pLS->pfOutputLatency);
       long lTriggerLatency = (long) (*pLS->pfTriggerLatency);
@@ -1099,6 +3224,8 @@ static LoopChunk* beginMultiply(SooperLooperI *pLS, LoopChunk *loop)
       }
       
       loop->lMarkEndL = loop->lMarkEndH = LONG_MAX;
+      clearFillAhead(loop);
+      clearEndFillAhead(loop);
 
       
       DBG(fprintf(stderr,"%u:%u  Mark at L:%lu  h:%lu\n", pLS->lLoopIndex, pLS->lChannelIndex,loop->lMarkL, loop->lMarkH);
@@ -1109,8 +3236,8 @@ static LoopChunk* beginMultiply(SooperLooperI *pLS, LoopChunk *loop)
 	      // input always immediately available
 	      pLS->lFramesUntilInput = 0;
 	      // rest is handled elsewhere
-	      pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-	      pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;
+	      fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+	      fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);
       }
 
    }
@@ -1160,14 +3287,15 @@ static LoopChunk * endMultiply(SooperLooperI *pLS, LoopChunk *loop, int nextstat
 	 //loop->dCurrPos -= loop->lStartAdj;
 	 loop->lMarkEndL = (unsigned long) loop->dCurrPos;
 	 loop->lMarkEndH = loop->lLoopLength - 1;
+	 clearEndFillAhead(loop);
 
 	 DBG(fprintf(stderr,"%u:%u  Entering %d from MULTIPLY. Length %lu.  %lu cycles\n", pLS->lLoopIndex, pLS->lChannelIndex,nextstate,
 		 loop->lLoopLength, loop->lCycles)); 
 	 DBG(fprintf(stderr,"%u:%u  EndMark at L:%lu  h:%lu\n", pLS->lLoopIndex, pLS->lChannelIndex,loop->lMarkEndL, loop->lMarkEndH));
 
    
-	 pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-	 pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+	 fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+	 fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 	 
 	 loop = transitionToNext(pLS, loop, nextstate);
 
@@ -1179,6 +3307,7 @@ static LoopChunk * endMultiply(SooperLooperI *pLS, LoopChunk *loop, int nextstat
 	 loop->lMarkEndL = (unsigned long)loop->dCurrPos;
 //	 loop->lMarkEndH = loop->lLoopLength + loop->lStartAdj - 1;
 	 loop->lMarkEndH = loop->lLoopLength - 1;
+	 clearEndFillAhead(loop);
 	 pLS->nextState = nextstate;
 	 pLS->rounding = true;
       }
@@ -1209,9 +3338,7 @@ static LoopChunk * beginInsert(SooperLooperI *pLS, LoopChunk *loop)
 	      DBG(fprintf(stderr, "begin ins: there is no source\n"));
 	      
 	      loop = srcloop;
-	      pLS->headLoopChunk = pLS->tailLoopChunk = loop;
-	      loop->next = NULL;
-	      loop->prev = NULL;
+	      resetLoopHistory (pLS, loop);
 	      loop->valid = 1;
 
 	      // no mult op
@@ -1226,11 +3353,11 @@ static LoopChunk * beginInsert(SooperLooperI *pLS, LoopChunk *loop)
 
       if (*pLS->pfQuantMode == 0.0f) {
 	      // we'll do this later if we are quantizing
-	      pLS->fLoopFadeDelta = 1.0f / xfadeSamples;
-	      pLS->fFeedFadeDelta = -1.0f / xfadeSamples;
+	      fadeStart (&pLS->loopFade, 1.0f / xfadeSamples);
+	      fadeStart (&pLS->feedFade, -1.0f / xfadeSamples);
       }
 
-      pLS->fPlayFadeDelta = -1.0f / xfadeSamples;
+      fadeStart (&pLS->playFade, -1.0f / xfadeSamples);
 
       long lInputLatency = (long) (*pLS->pfInputLatency);
       long lOutputLatency = (long) (*pLS->pfOutputLatency);
@@ -1295,6 +3422,8 @@ static LoopChunk * beginInsert(SooperLooperI *pLS, LoopChunk *loop)
       }
       
       loop->lMarkEndL = loop->lMarkEndH = LONG_MAX;
+      clearFillAhead(loop);
+      clearEndFillAhead(loop);
 		       
       DBG(fprintf(stderr, "%u:%u  InsPos=%lu  RemLen=%lu\n", pLS->lLoopIndex, pLS->lChannelIndex, loop->lInsPos, loop->lRemLen));
       DBG(fprintf(stderr,"%u:%u  Total cycles now=%lu\n", pLS->lLoopIndex, pLS->lChannelIndex, loop->lCycles));
@@ -1328,6 +3457,7 @@ static LoopChunk * endInsert(SooperLooperI *pLS, LoopChunk *loop, int nextstate)
    
    loop->lMarkEndL = (unsigned long)loop->dCurrPos;
    loop->lMarkEndH = loop->lLoopLength - loop->lRemLen;
+   clearEndFillAhead(loop);
 
    DBG(fprintf(stderr,"%u:%u  Finishing INSERT... lMarkEndL=%lu  lMarkEndH=%lu  ll=%lu  rl=%lu\n", pLS->lLoopIndex, pLS->lChannelIndex,
 	       loop->lMarkEndL, loop->lMarkEndH, loop->lLoopLength, loop->lRemLen)); 
@@ -1335,8 +3465,8 @@ static LoopChunk * endInsert(SooperLooperI *pLS, LoopChunk *loop, int nextstate)
    pLS->nextState = nextstate;
 
    if (*pLS->pfRoundMode == 0.0f) {
-	   pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-	   pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
+	   fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+	   fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
    }
 
    pLS->rounding = true;
@@ -1364,18 +3494,18 @@ static LoopChunk * beginOverdub(SooperLooperI *pLS, LoopChunk *loop)
 	      // coming out of record we can actually 
 	      // set the loopfadeatten to 0 without harm
 	      // since we're fading out the loopsrcfade
-              pLS->fLoopFadeAtten = 0.0f;
+              fadeSet (&pLS->loopFade, 0.0f);
       }
 
-      pLS->fLoopFadeDelta = 1.0f / xfadeSamples;
+      fadeStart (&pLS->loopFade, 1.0f / xfadeSamples);
       long lInputLatency = (long) (*pLS->pfInputLatency);
       long lOutputLatency = (long) (*pLS->pfOutputLatency);
       long lTriggerLatency = (long) (*pLS->pfTriggerLatency);
 
-      pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-      pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;
+      fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+      fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);
 
-      pLS->fPlayFadeDelta = 1.0f / xfadeSamples; // added by jlc 20120709
+      fadeStart (&pLS->playFade, 1.0f / xfadeSamples); // added by jlc 20120709
 
       pLS->lFramesUntilInput = (long) lInputLatency - lTriggerLatency;
       pLS->lFramesUntilFilled = lOutputLatency + lInputLatency;
@@ -1389,9 +3519,7 @@ static LoopChunk * beginOverdub(SooperLooperI *pLS, LoopChunk *loop)
 	      DBG(fprintf(stderr, "%u:%u  OVERdub using self\n", pLS->lLoopIndex, pLS->lChannelIndex));
 	      
 	      loop = srcloop;
-	      pLS->headLoopChunk = pLS->tailLoopChunk = loop;
-	      loop->next = NULL;
-	      loop->prev = NULL;
+	      resetLoopHistory (pLS, loop);
 	      loop->valid = 1;
 	      loop->srcloop = loop; // !!!
 
@@ -1467,6 +3595,30 @@ static LoopChunk * beginOverdub(SooperLooperI *pLS, LoopChunk *loop)
 		 loop->lMarkH = (unsigned long) rCurrPos;
 	 }
       }
+      clearFillAhead(loop);
+      clearEndFillAhead(loop);
+
+      if ((g_blockPaths & PathSharePages)
+	  && srcloop->valid && !srcloop->frontfill && !srcloop->backfill
+	  && fadeSettled (&pLS->loopSrcFade) && pLS->loopSrcFade.atten == 0.0f
+	  && fadeSettled (&pLS->feedSrcFade) && pLS->feedSrcFade.atten == 1.0f
+	  && pLS->fCurrRate == 1.0f && !(pLS->bRateCtrlActive && *pLS->pfRate != 1.0f)
+	  && *pLS->pfFeedback == 1.0f
+	  && pLS->pSharedFill == NULL && pLS->fNextCurrRate == 0.0f
+	  && (unsigned long) rCurrPos > (unsigned long) (lOutputLatency + lInputLatency))
+      {
+	      // the source is complete and nothing will be faded into it
+	      // anymore, so we start out with its pages and only copy the
+	      // ones the overdub writes to.  the fill still runs as before,
+	      // it just has nothing to copy where a page is still shared.
+	      // starting far enough in keeps the ranges it fills apart, for
+	      // settleSharedFill to silence what it does not get to
+	      shareLoopPages (pLS, loop, srcloop);
+	      pLS->pSharedFill = loop;
+	      pLS->lSharedFillPos = (unsigned long) rCurrPos;
+	      pLS->bSharedFrontFilled = false;
+	      pLS->bSharedBackFilled = false;
+      }
       
       DBG(fprintf(stderr,"%u:%u  Mark at L:%lu  h:%lu\n", pLS->lLoopIndex, pLS->lChannelIndex,loop->lMarkL, loop->lMarkH));
       DBG(fprintf(stderr,"%u:%u  EndMark at L:%lu  h:%lu\n", pLS->lLoopIndex, pLS->lChannelIndex,loop->lMarkEndL, loop->lMarkEndH));
@@ -1484,8 +3636,8 @@ static LoopChunk * beginSubstitute(SooperLooperI *pLS, LoopChunk *loop)
 
 	if (tloop) {
 		pLS->state = STATE_SUBSTITUTE;
-		pLS->fFeedFadeDelta = -1.0f / xfadeSamples;
-		pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
+		fadeStart (&pLS->feedFade, -1.0f / xfadeSamples);
+		fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
 	}
 
 	return tloop;
@@ -1499,8 +3651,8 @@ static LoopChunk * beginReplace(SooperLooperI *pLS, LoopChunk *loop)
 
 	if (tloop) {
 		pLS->state = STATE_REPLACE;
-		pLS->fPlayFadeDelta = -1.0f / xfadeSamples;
-		pLS->fFeedFadeDelta = -1.0f / xfadeSamples;
+		fadeStart (&pLS->playFade, -1.0f / xfadeSamples);
+		fadeStart (&pLS->feedFade, -1.0f / xfadeSamples);
 	}
 
 	return tloop;
@@ -1532,11 +3684,11 @@ static LoopChunk * transitionToNext(SooperLooperI *pLS, LoopChunk *loop, int nex
    switch(nextstate)
    {
       case STATE_PLAY:
-	      pLS->fLoopFadeDelta = -1.0f / (xfadeSamples);
-	      pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-	      pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
-	      pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
-	      pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;
+	      fadeStart (&pLS->loopFade, -1.0f / (xfadeSamples));
+	      fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+	      fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
+	      fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
+	      fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);
 	      pLS->wasMuted = false;
 	      if (pLS->state == STATE_PAUSED && loop) {
 		      // set current loop position to paused position
@@ -1546,11 +3698,11 @@ static LoopChunk * transitionToNext(SooperLooperI *pLS, LoopChunk *loop, int nex
 	      break;
       case STATE_MUTE:
       case STATE_PAUSED:
-	      pLS->fLoopFadeDelta = -1.0f / (xfadeSamples);
-	      pLS->fPlayFadeDelta = -1.0f / xfadeSamples;
-	      pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-	      pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
-	      pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;
+	      fadeStart (&pLS->loopFade, -1.0f / (xfadeSamples));
+	      fadeStart (&pLS->playFade, -1.0f / xfadeSamples);
+	      fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+	      fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
+	      fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);
 	      pLS->wasMuted = true;
 	      if (nextstate == STATE_PAUSED && loop) {
 		      pLS->dPausedPos = loop->dCurrPos;
@@ -1585,10 +3737,10 @@ static LoopChunk * transitionToNext(SooperLooperI *pLS, LoopChunk *loop, int nex
 	 break;
 
       case STATE_TRIGGER_PLAY:
-	      pLS->fLoopFadeDelta = -1.0f / (xfadeSamples);
-	      pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
-	      pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-	      pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;
+	      fadeStart (&pLS->loopFade, -1.0f / (xfadeSamples));
+	      fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
+	      fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+	      fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);
 	      if (loop) {
 		      pLS->state = STATE_PLAY;
 		      nextstate = STATE_PLAY;
@@ -1622,10 +3774,10 @@ static LoopChunk * transitionToNext(SooperLooperI *pLS, LoopChunk *loop, int nex
 	      break;
       case STATE_ONESHOT:
 	      // play the loop one_shot mode
-	      pLS->fLoopFadeDelta = -1.0f / (xfadeSamples);
-	      pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
-	      pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-	      pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;
+	      fadeStart (&pLS->loopFade, -1.0f / (xfadeSamples));
+	      fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
+	      fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+	      fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);
 	      if (loop) {
 		      DBG(fprintf(stderr,"%u:%u  Starting ONESHOT state\n", pLS->lLoopIndex, pLS->lChannelIndex));
 		      pLS->state = STATE_ONESHOT;
@@ -1685,9 +3837,8 @@ runSooperLooper(LADSPA_Handle Instance,
 	       unsigned long SampleCount)
 {
 
-  LADSPA_Data * pfBuffer;
-  LADSPA_Data * pfInput;
-  LADSPA_Data * pfOutput;
+  LADSPA_Data ** pfInput;
+  LADSPA_Data ** pfOutput;
   LADSPA_Data * pfSyncInput;
   LADSPA_Data * pfSyncOutput;
   LADSPA_Data * pfInputLatencyBuf;
@@ -1695,6 +3846,8 @@ runSooperLooper(LADSPA_Handle Instance,
   LADSPA_Data dryDelta=0.0f, wetDelta=0.0f, dryTarget=1.0f, wetTarget=1.0f;
   LADSPA_Data fInputSample;
   LADSPA_Data fOutputSample;
+  LADSPA_Data fRecSample;
+  FillReach reach = { 0, 0, false };
 
   LADSPA_Data fRate = 1.0f;
   LADSPA_Data fScratchPos = 0.0f;
@@ -1741,19 +3894,32 @@ runSooperLooper(LADSPA_Handle Instance,
   bool bRoundIntegerTempo = false;
 
   unsigned long lSampleIndex;
+  unsigned int lChan;
+  unsigned long lChanOff, lInChanOff;
+  unsigned long lSegCount;
+  unsigned long lSegPos, lSegRecPos, lSegSrcPos, lSegInPos;
+  LADSPA_Data fSegRate;
 
   LADSPA_Data fSafetyFeedback;
+  bool bWasStatic;
   
   pLS = (SooperLooperI *)Instance;
 
-  if (!pLS || !pLS->pfInput || !pLS->pfOutput) {
+  if (!pLS) {
      // something is badly wrong!!!
      return;
   }
+
+  for (lChan = 0; lChan < pLS->lChannelCount; ++lChan) {
+     if (!pLS->pfInput[lChan] || !pLS->pfOutput[lChan]) {
+	return;
+     }
+  }
   
+  bWasStatic = loopIsStatic (pLS);
+
   pfInput = pLS->pfInput;
   pfOutput = pLS->pfOutput;
-  pfBuffer = (LADSPA_Data *)pLS->pSampleBuf;
   pfSyncOutput = pLS->pfSyncOutput;
   pfSyncInput = pLS->pfSyncInput;
   pfInputLatencyBuf = (LADSPA_Data *) pLS->pInputBuf;
@@ -1902,6 +4068,18 @@ runSooperLooper(LADSPA_Handle Instance,
      }
   }
   pLS->fLastTapCtrl = fTapTrig;
+
+  // the pool may be asked for pages again
+  pLS->bPoolBusy = false;
+
+  if (pLS->pUndoSpill) {
+	  serviceUndoSpill (pLS);
+
+	  // a tap goes ahead right away
+	  if (!useDelay) {
+		  lMultiCtrl = holdMultiCtrl (pLS, lMultiCtrl, SampleCount);
+	  }
+  }
  
   //fRateSwitch = *(pLS->pfRateSwitch);
 
@@ -1953,10 +4131,15 @@ runSooperLooper(LADSPA_Handle Instance,
 
   
   // copy input signal to input latency buffer
-  unsigned long lbuf_wpos = pLS->lInputBufWritePos;
-  for (unsigned long n=0; n < SampleCount; ++n) {
-	  pfInputLatencyBuf[lbuf_wpos]  = pfInput[n];
-	  lbuf_wpos = (lbuf_wpos+1) & pLS->lInputBufMask;
+  FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+	  unsigned long lbuf_wpos = pLS->lInputBufWritePos;
+	  unsigned long n = 0;
+	  while (n < SampleCount) {
+		  lSegCount = ringSpan (lbuf_wpos, SampleCount - n, pLS->lInputBufSize);
+		  memcpy (&pfInputLatencyBuf[lInChanOff + lbuf_wpos], &pfInput[lChan][n], lSegCount * sizeof(LADSPA_Data));
+		  n += lSegCount;
+		  lbuf_wpos = (lbuf_wpos + lSegCount) & pLS->lInputBufMask;
+	  }
   }
 
   // calculate initial offset for reading for input
@@ -1966,6 +4149,12 @@ runSooperLooper(LADSPA_Handle Instance,
 	  : (pLS->lInputBufSize - (lInputLatency - pLS->lInputBufWritePos)) ;
   
 	  
+  // a command can take the overdub anywhere, so its shared pages are
+  // settled before it does
+  if (pLS->pSharedFill && lMultiCtrl >= 0 && lMultiCtrl <= 127) {
+	  settleSharedFill (pLS);
+  }
+
   // transitions due to control triggering
   
   if (lMultiCtrl >= 0 && lMultiCtrl <= 127)
@@ -1992,10 +4181,10 @@ runSooperLooper(LADSPA_Handle Instance,
 			      // skip trig stop
 			      pLS->state = STATE_PLAY;
 			      pLS->wasMuted = false;
-			      pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-			      pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
-			      pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-			      pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;
+			      fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+			      fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
+			      fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+			      fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);
 			      DBG(fprintf(stderr,"%u:%u  from rec Entering PLAY state loop len: %lu\n", pLS->lLoopIndex, pLS->lChannelIndex, loop->lLoopLength));
 
 			      // then send out a sync here for any slaves
@@ -2026,11 +4215,11 @@ runSooperLooper(LADSPA_Handle Instance,
 		    loop->lCycleLength = loop->lLoopLength;
 		    loop->lCycles = 1;
 
-		    pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-		    pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
-		    pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
-		    pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-		    pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;
+		    fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+		    fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
+		    fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
+		    fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+		    fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);
 			      
 		    pLS->state = STATE_PLAY;
 		    pLS->wasMuted = false;
@@ -2055,14 +4244,15 @@ runSooperLooper(LADSPA_Handle Instance,
 		    loop->backfill = 1;
 		    loop->lMarkEndL = (unsigned long) loop->dCurrPos;
 		    loop->lMarkEndH = loop->lLoopLength - 1;
+		    clearEndFillAhead(loop);
 		    loop->lCycleLength = loop->lLoopLength;
 		    loop->lCycles = 1;
 
-		    pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-		    pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
-		    pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
-		    pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-		    pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;
+		    fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+		    fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
+		    fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
+		    fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+		    fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);
 			      
 		    pLS->state = STATE_PLAY;
 		    pLS->wasMuted = false;
@@ -2102,9 +4292,9 @@ runSooperLooper(LADSPA_Handle Instance,
 			      pLS->state = STATE_PLAY;
 			      pLS->wasMuted = false;
 			      DBG(fprintf(stderr,"%u:%u  Entering PLAY state\n", pLS->lLoopIndex, pLS->lChannelIndex));
-			      pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-			      pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
-			      pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+			      fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+			      fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
+			      fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 			      // then send out a sync here for any slaves
 			      pfSyncOutput[0] = 1.0f;
 		      }
@@ -2146,8 +4336,8 @@ runSooperLooper(LADSPA_Handle Instance,
 				   // input always immediately available
 				   pLS->lFramesUntilInput = 0;
 
-				   pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-				   pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;
+				   fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+				   fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);
 
 				   // then send out a sync here for any slaves
 				   //pfSyncOutput[0] = 1.0f;
@@ -2271,8 +4461,8 @@ runSooperLooper(LADSPA_Handle Instance,
 					      DBG(fprintf(stderr,"%u:%u  from rec Entering multiply state at %g\n", pLS->lLoopIndex, pLS->lChannelIndex, loop->dCurrPos));
 					      pLS->lFramesUntilFilled = lOutputLatency + lInputLatency;
 
-					      pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-					      pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;
+					      fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+					      fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);
 				      }
 				      
 			      }
@@ -2350,8 +4540,8 @@ runSooperLooper(LADSPA_Handle Instance,
 					      // we need to increment loop position by output latency (+ IL ?)
 					      loop->dCurrPos = loop->dCurrPos + ( lOutputLatency + lInputLatency) * fRate;
 					      DBG(fprintf(stderr,"from rec Entering insert state at %g\n", loop->dCurrPos));
-					      pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-					      pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;					      
+					      fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+					      fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);					      
 					      pLS->lFramesUntilFilled = lOutputLatency + lInputLatency;
 					      
 				      }
@@ -2381,9 +4571,9 @@ runSooperLooper(LADSPA_Handle Instance,
 			      pLS->state = STATE_PLAY;
 			      pLS->wasMuted = false;
 			      DBG(fprintf(stderr,"%u:%u  Entering PLAY state\n", pLS->lLoopIndex, pLS->lChannelIndex));
-			      pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-			      pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
-			      pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+			      fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+			      fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
+			      fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 
 			      // then send out a sync here for any slaves
 			      pfSyncOutput[0] = 1.0f;
@@ -2430,8 +4620,8 @@ runSooperLooper(LADSPA_Handle Instance,
 					      // we need to increment loop position by output latency (+ IL ?)
 					      loop->dCurrPos = loop->dCurrPos + ( lOutputLatency + lInputLatency) * fRate;
 					      DBG(fprintf(stderr,"from rec Entering multiply state at %g\n", loop->dCurrPos));
-					      pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-					      pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;
+					      fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+					      fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);
 					      pLS->lFramesUntilFilled = lOutputLatency + lInputLatency;
 				      }
 			      }
@@ -2460,9 +4650,9 @@ runSooperLooper(LADSPA_Handle Instance,
 			      pLS->state = STATE_PLAY;
 			      pLS->wasMuted = false;
 			      DBG(fprintf(stderr,"Entering PLAY state\n"));
-			      pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-			      pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
-			      pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+			      fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+			      fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
+			      fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 
 			      // then send out a sync here for any slaves
 			      pfSyncOutput[0] = 1.0f;
@@ -2504,8 +4694,8 @@ runSooperLooper(LADSPA_Handle Instance,
 					      // we need to increment loop position by output latency (+ IL ?)
 					      loop->dCurrPos = loop->dCurrPos + ( lOutputLatency + lInputLatency) * fRate;
 					      DBG(fprintf(stderr,"from rec Entering multiply state at %g\n", loop->dCurrPos));
-					      pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
-					      pLS->fFeedSrcFadeDelta = 1.0f / xfadeSamples;
+					      fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
+					      fadeStart (&pLS->feedSrcFade, 1.0f / xfadeSamples);
 					      pLS->lFramesUntilFilled = lOutputLatency + lInputLatency;
 				      }
 			      }
@@ -2568,7 +4758,7 @@ runSooperLooper(LADSPA_Handle Instance,
 				       pLS->state = STATE_PLAY;
 				       pLS->wasMuted = false;
 				       DBG(fprintf(stderr,"%u:%u  Entering PLAY state continuous\n", pLS->lLoopIndex, pLS->lChannelIndex));
-				       pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
+				       fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
 				       
 				       if (lMultiCtrl == MULTI_PAUSE && loop) {
 					       // set current loop position to paused position
@@ -2635,10 +4825,10 @@ runSooperLooper(LADSPA_Handle Instance,
 		     DBG(fprintf(stderr,"%u:%u   Entering MUTE/pause state\n", pLS->lLoopIndex, pLS->lChannelIndex));
 		     // reset for audio ramp
 		     //pLS->lRampSamples = xfadeSamples;
-		     pLS->fPlayFadeDelta = -1.0f / xfadeSamples;
+		     fadeStart (&pLS->playFade, -1.0f / xfadeSamples);
 		     
-		     pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-		     pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+		     fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+		     fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 		     pLS->wasMuted = true;
 		     
 		     if (lMultiCtrl == MULTI_PAUSE) {
@@ -2690,6 +4880,7 @@ runSooperLooper(LADSPA_Handle Instance,
 		    loop->backfill = 1;
 		    loop->lMarkEndL = 0;
 		    loop->lMarkEndH = loop->lLoopLength - 1;
+		    clearEndFillAhead(loop);
 		 
 		    DBG(fprintf(stderr,"New delay length of %g secs\n",
 				loop->lLoopLength / pLS->fSampleRate));
@@ -2766,9 +4957,9 @@ runSooperLooper(LADSPA_Handle Instance,
 		 // THIS puts it into reverse and does a ONE_SHOT after TRIG_STOP
 		 if (loop) {
 		    fRate = pLS->fCurrRate = -1.0f;
-		    pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-		    pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
-		    pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+		    fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+		    fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
+		    fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 		    pLS->state = STATE_ONESHOT;
 		    if (pLS->fCurrRate > 0)
 			    loop->dCurrPos = (loop->lLoopLength -  loop->lSyncPos) + fSyncOffsetSamples;
@@ -2856,20 +5047,20 @@ runSooperLooper(LADSPA_Handle Instance,
 
 			   
                            if (pLS->state == STATE_UNDO) {
-                                   pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-                                   pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+                                   fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+                                   fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
                                    
-                                   pLS->fPlayFadeAtten = 0.0f;
-                                   pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
+                                   fadeSet (&pLS->playFade, 0.0f);
+                                   fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
 			   }
                            else if (pLS->state == STATE_MUTE) {
-				   pLS->fPlayFadeDelta = 0.0f;
+				   fadeStart (&pLS->playFade, 0.0f);
 			   } else if (pLS->state == STATE_UNDO_ALL) {
-                                   pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-                                   pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+                                   fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+                                   fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 
-				   pLS->fPlayFadeAtten = 1.0f;
-				   pLS->fPlayFadeDelta = -1.0f / xfadeSamples;
+				   fadeSet (&pLS->playFade, 1.0f);
+				   fadeStart (&pLS->playFade, -1.0f / xfadeSamples);
 			   }
 
 		      DBG(fprintf(stderr,"%u:%u  Undoing and reentering PLAY state from UNDO\n", pLS->lLoopIndex, pLS->lChannelIndex));
@@ -2882,18 +5073,18 @@ runSooperLooper(LADSPA_Handle Instance,
 	{
 		if (pLS->state != STATE_OFF && pLS->state != STATE_OFF_MUTE) {
 			DBG(fprintf(stderr,"%u:%u  UNDO all loops\n", pLS->lLoopIndex, pLS->lChannelIndex));
-			pLS->fPlayFadeDelta = -1.0f / xfadeSamples;
+			fadeStart (&pLS->playFade, -1.0f / xfadeSamples);
 			
-			pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-			pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+			fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+			fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 			
 			pLS->state = pLS->wasMuted ? STATE_MUTE : STATE_PLAY;
 			
 			if (loop && loop->lLoopLength) {
 				pLS->state = STATE_UNDO_ALL;
 				
-				pLS->fLoopFadeDelta = -1.0f / (xfadeSamples);
-				pLS->fPlayFadeDelta = -1.0f / xfadeSamples;// fade out for undo all
+				fadeStart (&pLS->loopFade, -1.0f / (xfadeSamples));
+				fadeStart (&pLS->playFade, -1.0f / xfadeSamples);// fade out for undo all
 			}			
 		}
 	} break;
@@ -2929,14 +5120,14 @@ runSooperLooper(LADSPA_Handle Instance,
 			}
 		}
 		
-		pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-		pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+		fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+		fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 		
-		pLS->fPlayFadeAtten = 0.0f;
-		pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
+		fadeSet (&pLS->playFade, 0.0f);
+		fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
 		
 		if (pLS->state == STATE_MUTE) {
-			pLS->fPlayFadeDelta = 0.0f;
+			fadeStart (&pLS->playFade, 0.0f);
 		}
 
 		DBG(fprintf(stderr,"REDO all loops\n"));
@@ -2979,18 +5170,18 @@ runSooperLooper(LADSPA_Handle Instance,
 				   if (loop->next) {
 					   pLS->state = STATE_REDO;
 					   pLS->nextState = STATE_PLAY;
-					   pLS->fPlayFadeAtten = 0.0f;
+					   fadeSet (&pLS->playFade, 0.0f);
 				   }
 			   }
 			   
-			   pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-			   pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+			   fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+			   fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 			   			   
 			   if (pLS->state == STATE_MUTE) {
 				   // we don't need a fade in
-				   pLS->fPlayFadeDelta = 0.0f;
+				   fadeStart (&pLS->playFade, 0.0f);
 			   } else {
-				   pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
+				   fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
 			   }
 
 			break;
@@ -3008,9 +5199,9 @@ runSooperLooper(LADSPA_Handle Instance,
 		 // and starts playing in reverse
 		      fRate = pLS->fCurrRate *= -1.0f;
 		      pLS->state = STATE_PLAY;
-		      pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-		      pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
-		      pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+		      fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+		      fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
+		      fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 		      pLS->wasMuted = false;
 		      // we need to increment loop position by output latency (+ IL ?)
 		      loop->dCurrPos = loop->dCurrPos + ( lOutputLatency + lInputLatency) * fRate;
@@ -3065,9 +5256,9 @@ runSooperLooper(LADSPA_Handle Instance,
 				if (((fSyncMode == 0.0f) || (fSyncMode >= 1.0f && pLS->lSamplesSinceSync < eighthSamples)) // give it some slack on relsync
 				    && !(pLS->state == STATE_RECORD && bRoundIntegerTempo)) {
 					DBG(fprintf(stderr,"Starting ONESHOT state\n"));
-					pLS->fPlayFadeDelta = 1.0f / xfadeSamples;
-					pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
-					pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+					fadeStart (&pLS->playFade, 1.0f / xfadeSamples);
+					fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
+					fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 
 				      prevstate = pLS->state;
 				      
@@ -3209,6 +5400,10 @@ runSooperLooper(LADSPA_Handle Instance,
 
   }
   
+  if (pLS->pSharedFill
+      && !sharedFillSafe (pLS, syncSamples && fPlaybackSyncMode != 0.0f && fQuantizeMode != QUANT_OFF)) {
+	  settleSharedFill (pLS);
+  }
 
   fRate = pLS->fCurrRate;
   
@@ -3242,8 +5437,13 @@ runSooperLooper(LADSPA_Handle Instance,
 	      fScratchPos += scratchDelta;
 
 	      // TODO: need to possibly wait IL-TL before actually starting
+
+	      // any channel can trigger
+	      fInputSample = pfInput[0][lSampleIndex];
+	      for (lChan = 1; lChan < pLS->lChannelCount; ++lChan) {
+		      fInputSample = MAX (fInputSample, pfInput[lChan][lSampleIndex]);
+	      }
 	      
-	      fInputSample = pfInput[lSampleIndex];
 	      if ((fSyncMode == 0.0f && ((fInputSample > fTrigThresh) || (fTrigThresh==0.0f)))
 			  || (fSyncMode == 2.0f) // relative sync offset mode 
 			  || (fSyncMode > 0.0f && pfSyncInput[lSampleIndex] != 0.0f))
@@ -3264,6 +5464,8 @@ runSooperLooper(LADSPA_Handle Instance,
 				  loop->firsttime = 0;
 				  loop->lMarkL = loop->lMarkEndL = LONG_MAX;
 				  loop->frontfill = loop->backfill = 0;
+				  clearFillAhead(loop);
+				  clearEndFillAhead(loop);
 				  loop->lCycles = 1; // at first just one		 
 				  loop->srcloop = NULL;
 				  pLS->nextState = -1;
@@ -3290,14 +5492,14 @@ runSooperLooper(LADSPA_Handle Instance,
 					  loop->lOrigSyncPos = loop->lSyncPos = 0;
 				  }
 				  // cause input-to-loop fade in
-				  pLS->fLoopFadeAtten = 0.0f;
-				  pLS->fLoopFadeDelta = 1.0f / xfadeSamples;
-				  pLS->fPlayFadeDelta = -1.0f / xfadeSamples;
+				  fadeSet (&pLS->loopFade, 0.0f);
+				  fadeStart (&pLS->loopFade, 1.0f / xfadeSamples);
+				  fadeStart (&pLS->playFade, -1.0f / xfadeSamples);
 				  
 				  // only place this goes up
-				  pLS->fLoopSrcFadeDelta = 1.0f / xfadeSamples;
+				  fadeStart (&pLS->loopSrcFade, 1.0f / xfadeSamples);
 				  // and this goes down
-				  pLS->fFeedSrcFadeDelta = -1.0f / xfadeSamples;
+				  fadeStart (&pLS->feedSrcFade, -1.0f / xfadeSamples);
 				  
 			  }
 			  else {
@@ -3309,7 +5511,9 @@ runSooperLooper(LADSPA_Handle Instance,
 			  break;
 	      }
 
-	      pfOutput[lSampleIndex] = fDry * fInputSample;
+	      for (lChan = 0; lChan < pLS->lChannelCount; ++lChan) {
+		      pfOutput[lChan][lSampleIndex] = fDry * pfInput[lChan][lSampleIndex];
+	      }
 	   }
      
 	} break;
@@ -3320,8 +5524,8 @@ runSooperLooper(LADSPA_Handle Instance,
 	   //fprintf(stderr,"in record\n");
 
 	   if ((loop = ensureLoopSpace (pLS, loop, SampleCount - lSampleIndex, NULL)) == NULL) {
-		   DBG(fprintf(stderr, "%u:%u  Entering PLAY state -- END of memory! %08x\n", pLS->lLoopIndex, pLS->lChannelIndex,
-			       (unsigned) (pLS->pSampleBuf + pLS->lBufferSize) ));
+		   DBG(fprintf(stderr, "%u:%u  Entering PLAY state -- END of memory! %lu\n", pLS->lLoopIndex, pLS->lChannelIndex,
+			       pLS->lBufferSize));
 		   pLS->state = STATE_PLAY;
 		   pLS->wasMuted = false;
 		   goto passthrough;
@@ -3335,10 +5539,10 @@ runSooperLooper(LADSPA_Handle Instance,
 	      fFeedback += feedbackDelta;
 	      fScratchPos += scratchDelta;
 
-	      pLS->fLoopFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopFadeAtten + pLS->fLoopFadeDelta);
-	      pLS->fLoopSrcFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopSrcFadeAtten + pLS->fLoopSrcFadeDelta);
-	      pLS->fFeedSrcFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fFeedSrcFadeAtten + pLS->fFeedSrcFadeDelta);
-	      pLS->fPlayFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fPlayFadeAtten + pLS->fPlayFadeDelta);
+	      fadeStep (&pLS->loopFade);
+	      fadeStep (&pLS->loopSrcFade);
+	      fadeStep (&pLS->feedSrcFade);
+	      fadeStep (&pLS->playFade);
 	      
 // 	      if (pLS->waitingForSync && (fSyncMode == 0.0 || pfSyncInput[lSampleIndex] != 0.0))
 // 	      {
@@ -3364,7 +5568,7 @@ runSooperLooper(LADSPA_Handle Instance,
 	      
 	      // wrap at the proper loop end
 	      lCurrPos = (unsigned int) lrint(loop->dCurrPos);
-	      pLoopSample = & pLS->pSampleBuf[(loop->lLoopStart + lCurrPos) & pLS->lBufferSizeMask];
+	      pLoopSample = loopWritePtr (pLS, loop, lCurrPos);
 		      
 // 	      if ((char *)(lCurrPos + loop->pLoopStart) >= (pLS->pSampleBuf + pLS->lBufferSize)) {
 // 		 // stop the recording RIGHT NOW
@@ -3380,16 +5584,17 @@ runSooperLooper(LADSPA_Handle Instance,
 	      if (lCurrPos == 0) {
 		      pfSyncOutput[lSampleIndex] = 1.0f;
 	      }
-		   
-	      fInputSample = pfInput[lSampleIndex];
+
+	      FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+		      fInputSample = pfInput[lChan][lSampleIndex];
 	      
-	      *pLoopSample = pLS->fLoopFadeAtten * fInputSample;
+		      pLoopSample[lChanOff] = pLS->loopFade.atten * fInputSample;
+
+		      pfOutput[lChan][lSampleIndex] = fDry * fInputSample;
+	      }
 	      
 	      // increment according to current rate
 	      loop->dCurrPos = loop->dCurrPos + fRate;
-	      
-	      
-	      pfOutput[lSampleIndex] = fDry * fInputSample;
 	   }
 
 	   // update loop values (in case we get stopped by an event)
@@ -3434,15 +5639,13 @@ runSooperLooper(LADSPA_Handle Instance,
               fDry += dryDelta;
 	      fFeedback += feedbackDelta;
 	      fScratchPos += scratchDelta;
-	      pLS->fLoopFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopFadeAtten + pLS->fLoopFadeDelta);
-	      pLS->fLoopSrcFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopFadeAtten + pLS->fLoopSrcFadeDelta);
-	      pLS->fFeedSrcFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fFeedSrcFadeAtten + pLS->fFeedSrcFadeDelta);
-	      pLS->fPlayFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fPlayFadeAtten + pLS->fPlayFadeDelta);
+	      fadeStep (&pLS->loopFade);
+	      fadeSet (&pLS->loopSrcFade, LIMIT_BETWEEN_0_AND_1 (pLS->loopFade.atten + pLS->loopSrcFade.delta));
+	      fadeStep (&pLS->feedSrcFade);
+	      fadeStep (&pLS->playFade);
 		   
 	      lCurrPos = (unsigned int) loop->dCurrPos;
-	      pLoopSample = & pLS->pSampleBuf[(loop->lLoopStart + lCurrPos) & pLS->lBufferSizeMask];
-	      
-	      fInputSample = pfInput[lSampleIndex];
+	      pLoopSample = loopWritePtr (pLS, loop, lCurrPos);
 	      
 	      
 // 	      if ((fSyncMode == 0.0f && ((fInputSample > fTrigThresh) || (fTrigThresh==0.0)))
@@ -3490,7 +5693,7 @@ runSooperLooper(LADSPA_Handle Instance,
 		      loop->dCurrPos = loop->dCurrPos + ( lOutputLatency + lInputLatency ) * fRate;
 		      pLS->lFramesUntilFilled = lOutputLatency + lInputLatency;
 		      
-		      pLS->fLoopSrcFadeDelta = -1.0f / xfadeSamples;
+		      fadeStart (&pLS->loopSrcFade, -1.0f / xfadeSamples);
 		      
 		      break;
 	      }
@@ -3510,7 +5713,13 @@ runSooperLooper(LADSPA_Handle Instance,
 	      }
 	      
 	      
-	      *(pLoopSample) = pLS->fLoopFadeAtten * fInputSample;
+	      FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+		      fInputSample = pfInput[lChan][lSampleIndex];
+
+		      pLoopSample[lChanOff] = pLS->loopFade.atten * fInputSample;
+
+		      pfOutput[lChan][lSampleIndex] = fDry * fInputSample;
+	      }
 	      
 	      // increment according to current rate
 	      loop->dCurrPos = loop->dCurrPos + fRate;
@@ -3528,9 +5737,6 @@ runSooperLooper(LADSPA_Handle Instance,
 // 	      }
 
 	      
-	      pfOutput[lSampleIndex] = fDry * fInputSample;
-
-	      
 	   }
 
 	   // update loop values (in case we get stopped by an event)
@@ -3557,13 +5763,81 @@ runSooperLooper(LADSPA_Handle Instance,
 	      for (;lSampleIndex < SampleCount;
 		   lSampleIndex++)
 	      {
+		 // steady stretches with constant gains go through the
+		 // vector kernels, the boundary sample and anything else
+		 // through the full path below
+		 lSegCount = 0;
+		 if (wetDelta == 0.0f && dryDelta == 0.0f && feedbackDelta == 0.0f) {
+			 lSegCount = planOverdubSegment (pLS, loop, pfSyncInput, lSampleIndex, SampleCount, fRate,
+							 fRate * (lOutputLatency + lInputLatency), fSyncMode, fQuantizeMode, eighthSamples,
+							 &lSegPos, &lSegRecPos, &lSegSrcPos, &lSegInPos);
+		 }
+		 if (lSegCount > 0) {
+			 const MixKernels & kernels = mix_kernels();
+			 LADSPA_Data * pfRecSpan = loopWritePtr (pLS, loop, lSegRecPos);
+			 LADSPA_Data * pfSrcSpan = 0;
+			 LADSPA_Data * pfPlaySpan;
+			 LADSPA_Data * pfInSpan = &pfInputLatencyBuf[lSegInPos];
+			 LADSPA_Data fPlayGain = fWet;
+			 LADSPA_Data fFeedGain = pLS->feedFade.atten * fFeedback;
+
+			 if (pLS->state == STATE_REPLACE) {
+				 fPlayGain = pLS->playFade.atten * fWet;
+			 }
+			 else if (pLS->state == STATE_OVERDUB) {
+				 fFeedGain = fSafetyFeedback * pLS->feedFade.atten * fFeedback;
+			 }
+
+			 // the source only needs writing while something is faded into it
+			 if (pLS->feedSrcFade.atten != 1.0f || pLS->loopSrcFade.atten != 0.0f) {
+				 pfSrcSpan = loopWritePtr (pLS, srcloop, lSegSrcPos);
+			 }
+			 // read pointers last, the writes above may have copied the page
+			 pfPlaySpan = loopReadPtr (pLS, loop, lSegPos);
+
+			 FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+				 // xfade input into source loop, then mix
+				 if (pfSrcSpan) {
+					 kernels.feedback (pfSrcSpan + lChanOff, pfInSpan + lInChanOff, lSegCount,
+							   pLS->feedSrcFade.atten, pLS->loopSrcFade.atten);
+				 }
+				 kernels.overdub (&pfOutput[lChan][lSampleIndex], pfPlaySpan + lChanOff, pfRecSpan + lChanOff,
+						  pfInSpan + lInChanOff, lSegCount, fPlayGain, fDry, fFeedGain, pLS->loopFade.atten);
+			 }
+
+			 if (fSyncMode != 0.0f) {
+				 // sync input was silent for the whole segment
+				 if (pfSyncInput != pfSyncOutput) {
+					 memcpy (&pfSyncOutput[lSampleIndex], &pfSyncInput[lSampleIndex], lSegCount * sizeof(LADSPA_Data));
+				 }
+				 pLS->lSamplesSinceSync += lSegCount;
+			 }
+			 else if (fQuantizeMode == QUANT_OFF) {
+				 for (unsigned long n = lSampleIndex; n < lSampleIndex + lSegCount; ++n) {
+					 pfSyncOutput[n] = 2.0f;
+				 }
+			 }
+
+			 for (unsigned long n = 0; n < lSegCount; ++n) {
+				 fScratchPos += scratchDelta;
+			 }
+
+			 // whole sample position at unit rate, this is exact
+			 loop->dCurrPos = loop->dCurrPos + lSegCount;
+			 lSampleIndex += lSegCount;
+
+			 if (lSampleIndex >= SampleCount) {
+				 break;
+			 }
+		 }
+
 	         fWet += wetDelta;
                  fDry += dryDelta;
 	         fFeedback += feedbackDelta;
 	         fScratchPos += scratchDelta;
 
-		 pLS->fPlayFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fPlayFadeAtten + pLS->fPlayFadeDelta);
-		 pLS->fFeedFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fFeedFadeAtten + pLS->fFeedFadeDelta);
+		 fadeStep (&pLS->playFade);
+		 fadeStep (&pLS->feedFade);
 		 
 
 		 lCurrPos =(unsigned int) fmod(loop->dCurrPos, loop->lLoopLength);
@@ -3577,14 +5851,13 @@ runSooperLooper(LADSPA_Handle Instance,
 		    rpCurrPos += srcloop->lLoopLength;
 		 }
 		 
-		 pLoopSample = & pLS->pSampleBuf[(loop->lLoopStart + lCurrPos) & pLS->lBufferSizeMask];
-
 		 if (pLS->lFramesUntilInput <= 0) {
-			 rLoopSample = & pLS->pSampleBuf[(loop->lLoopStart + (unsigned int) rCurrPos) & pLS->lBufferSizeMask];
-			 rpLoopSample = & pLS->pSampleBuf[(srcloop->lLoopStart + (unsigned int) rpCurrPos) & pLS->lBufferSizeMask];
-			 pLS->fLoopFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopFadeAtten + pLS->fLoopFadeDelta);
-			 pLS->fLoopSrcFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopSrcFadeAtten + pLS->fLoopSrcFadeDelta);
-			 pLS->fFeedSrcFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fFeedSrcFadeAtten + pLS->fFeedSrcFadeDelta);
+			 fadeStep (&pLS->loopFade);
+			 fadeStep (&pLS->loopSrcFade);
+			 fadeStep (&pLS->feedSrcFade);
+			 rLoopSample = loopWritePtr (pLS, loop, (unsigned int) rCurrPos);
+			 // only written where the xfade changes it, see fadeIntoSource
+			 rpLoopSample = loopReadPtr (pLS, srcloop, (unsigned int) rpCurrPos);
 			 lInputReadPos = - pLS->lFramesUntilInput; // negate it
 			 lInputReadPos = (lInputReadPos <= pLS->lInputBufWritePos)
 				 ? (pLS->lInputBufWritePos - lInputReadPos)
@@ -3622,10 +5895,7 @@ runSooperLooper(LADSPA_Handle Instance,
 			 
 		 }
 		 else {
-			 if (fQuantizeMode == QUANT_OFF 
-			     || (fQuantizeMode == QUANT_CYCLE && (((int)rCurrPos + loop->lSyncPos) % loop->lCycleLength) == 0)
-			     || (fQuantizeMode == QUANT_LOOP && (((int) rCurrPos +loop->lSyncPos) % loop->lLoopLength )== 0) 
-			     || (fQuantizeMode == QUANT_8TH && (((int) rCurrPos + loop->lSyncPos) % eighthSamples) == 0))
+			 if (onQuantPoint (pLS, loop, (int) rCurrPos, fQuantizeMode, eighthSamples))
 			 {
 				 pfSyncOutput[lSampleIndex] = 2.0f;
 			 }
@@ -3642,61 +5912,65 @@ runSooperLooper(LADSPA_Handle Instance,
 
 		 
 		 
-		 //fInputSample = pfInput[lSampleIndex];
-		 fInputSample = pfInputLatencyBuf[(lInputReadPos + lSampleIndex) & pLS->lInputBufMask];
-
 		 //  xfade input into source loop (for cases immediately after record)
 		 if (rpLoopSample) {
-			 *(rpLoopSample) = ((*rpLoopSample) * pLS->fFeedSrcFadeAtten) +  pLS->fLoopSrcFadeAtten * fInputSample;
+			 fadeIntoSource (pLS, srcloop, (unsigned int) rpCurrPos, pfInputLatencyBuf,
+					 (lInputReadPos + lSampleIndex) & pLS->lInputBufMask);
 		 }
 
 		 if (pLS->lFramesUntilFilled > 0) {
 			 // fill from the record position * and for the play pos !!?
 			 //DBG(fprintf(stderr, "filling rcurrpos=%u  pppos %d\n", (unsigned int) rCurrPos, lCurrPos));
-			 fillLoops(pLS, loop, (unsigned int) rCurrPos, true);
+			 fillLoops(pLS, loop, (unsigned int) rCurrPos, true, &reach);
 			 pLS->lFramesUntilFilled--;
 		 }
 
-		 fillLoops(pLS, loop, lCurrPos, false);
+		 fillReach (pLS, &reach, lSampleIndex, SampleCount, fRate, rCurrPos, false);
+		 fillLoops(pLS, loop, lCurrPos, false, &reach);
 
+		 pLoopSample = loopReadPtr (pLS, loop, lCurrPos);
 		 
-		 switch(pLS->state)
-		 {
-		 case STATE_OVERDUB:
-			 // use our self as the source (we have been filled by the call above)
-			 fOutputSample = fWet  *  *(pLoopSample)
-				 + fDry * fInputSample;
-
-			 if (rLoopSample) {
-				 *(rLoopSample) =  
-					 ((pLS->fLoopFadeAtten * fInputSample) + (fSafetyFeedback * pLS->fFeedFadeAtten * fFeedback *  *(rLoopSample)));
-			 }
-			 break;
-		 case STATE_REPLACE:
-			 // state REPLACE use only the new input
-			 // use our self as the source (we have been filled by the call above)
-			 fOutputSample = pLS->fPlayFadeAtten * fWet  *  *(pLoopSample)
-				 + fDry * fInputSample;
+		 FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+			 fInputSample = pfInputLatencyBuf[lInChanOff + ((lInputReadPos + lSampleIndex) & pLS->lInputBufMask)];
 			 
-			 if (rLoopSample) {
-				 *(rLoopSample) = fInputSample * pLS->fLoopFadeAtten +  (pLS->fFeedFadeAtten * fFeedback *  *(rLoopSample));
-			 }
-			 break;
-		 case STATE_SUBSTITUTE:
-		 default:
-			 // use our self as the source (we have been filled by the call above)
-			 // hear the loop
-			 fOutputSample = fWet  *  *(pLoopSample)
-				 + fDry * fInputSample;
-
-			 // but not feed it back (xfade it really)
-			 if (rLoopSample) {
-				 *(rLoopSample) = fInputSample * pLS->fLoopFadeAtten + (pLS->fFeedFadeAtten * fFeedback *  *(rLoopSample));
+			 switch(pLS->state)
+			 {
+			 case STATE_OVERDUB:
+				 // use our self as the source (we have been filled by the call above)
+				 fOutputSample = fWet  *  pLoopSample[lChanOff]
+					 + fDry * fInputSample;
+
+				 if (rLoopSample) {
+					 rLoopSample[lChanOff] =  
+						 ((pLS->loopFade.atten * fInputSample) + (fSafetyFeedback * pLS->feedFade.atten * fFeedback *  rLoopSample[lChanOff]));
+				 }
+				 break;
+			 case STATE_REPLACE:
+				 // state REPLACE use only the new input
+				 // use our self as the source (we have been filled by the call above)
+				 fOutputSample = pLS->playFade.atten * fWet  *  pLoopSample[lChanOff]
+					 + fDry * fInputSample;
+			 
+				 if (rLoopSample) {
+					 rLoopSample[lChanOff] = fInputSample * pLS->loopFade.atten +  (pLS->feedFade.atten * fFeedback *  rLoopSample[lChanOff]);
+				 }
+				 break;
+			 case STATE_SUBSTITUTE:
+			 default:
+				 // use our self as the source (we have been filled by the call above)
+				 // hear the loop
+				 fOutputSample = fWet  *  pLoopSample[lChanOff]
+					 + fDry * fInputSample;
+
+				 // but not feed it back (xfade it really)
+				 if (rLoopSample) {
+					 rLoopSample[lChanOff] = fInputSample * pLS->loopFade.atten + (pLS->feedFade.atten * fFeedback *  rLoopSample[lChanOff]);
+				 }
+				 break;
 			 }
-			 break;
-		 }
 		 
-		 pfOutput[lSampleIndex] = fOutputSample;
+			 pfOutput[lChan][lSampleIndex] = fOutputSample;
+		 }
 		 
 
 		 // increment and wrap at the proper loop end
@@ -3816,16 +6090,12 @@ runSooperLooper(LADSPA_Handle Instance,
 		    rpCurrPos += srcloop->lLoopLength;
 		 }
 		 
-		 spLoopSample = & pLS->pSampleBuf[(srcloop->lLoopStart + lpCurrPos) & pLS->lBufferSizeMask];
-		 pLoopSample = & pLS->pSampleBuf[(loop->lLoopStart + slCurrPos) & pLS->lBufferSizeMask];
-
 		 if (pLS->lFramesUntilInput <= 0) {
-			 rLoopSample = & pLS->pSampleBuf[(loop->lLoopStart + (unsigned int) rCurrPos) & pLS->lBufferSizeMask];
-			 rpLoopSample = & pLS->pSampleBuf[(srcloop->lLoopStart + (unsigned int) rpCurrPos) & pLS->lBufferSizeMask];
-			 pLS->fLoopFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopFadeAtten + pLS->fLoopFadeDelta);
-			 pLS->fLoopSrcFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopSrcFadeAtten + pLS->fLoopSrcFadeDelta);
-			 pLS->fFeedFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fFeedFadeAtten + pLS->fFeedFadeDelta);
-			 pLS->fFeedSrcFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fFeedSrcFadeAtten + pLS->fFeedSrcFadeDelta);
+			 rLoopSample = loopWritePtr (pLS, loop, (unsigned int) rCurrPos);
+			 fadeStep (&pLS->loopFade);
+			 fadeStep (&pLS->loopSrcFade);
+			 fadeStep (&pLS->feedFade);
+			 fadeStep (&pLS->feedSrcFade);
 			 lInputReadPos = - pLS->lFramesUntilInput; // negate it
 			 lInputReadPos = (lInputReadPos <= pLS->lInputBufWritePos)
 				 ? (pLS->lInputBufWritePos - lInputReadPos)
@@ -3834,13 +6104,13 @@ runSooperLooper(LADSPA_Handle Instance,
 		 }
 		 else {
 			 rLoopSample = 0;
-			 rpLoopSample = 0;
 			 pLS->lFramesUntilInput--;
 			 lInputReadPos = pLS->lInputBufWritePos;
 		 }
+		 rpLoopSample = 0;
 		 
-		 //pLS->fLoopFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopFadeAtten + pLS->fLoopFadeDelta);
-		 //pLS->fFeedFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fFeedFadeAtten + pLS->fFeedFadeDelta);
+		 //fadeStep (&pLS->loopFade);
+		 //fadeStep (&pLS->feedFade);
 
 
 		 
@@ -3868,7 +6138,7 @@ runSooperLooper(LADSPA_Handle Instance,
 		 }
 		 else {
 			 if (fQuantizeMode == QUANT_OFF 
-			     || (fQuantizeMode == QUANT_CYCLE && (((int) rCurrPos + loop->lSyncPos) % loop->lCycleLength) == 0))
+			     || (fQuantizeMode == QUANT_CYCLE && onQuantPoint (pLS, loop, (int) rCurrPos, fQuantizeMode, eighthSamples)))
 			 {
 				 pfSyncOutput[lSampleIndex] = 2.0f;
 			 }
@@ -3888,31 +6158,36 @@ runSooperLooper(LADSPA_Handle Instance,
 
 		 
 		 
-		 fInputSample = pfInputLatencyBuf[(lInputReadPos + lSampleIndex) & pLS->lInputBufMask];
-		 //fInputSample = pfInput[lSampleIndex];
-
-
-
 		 //  xfade input into source loop (for cases immediately after record)
-		 if (rpLoopSample) {
-			 *(rpLoopSample) = ((*rpLoopSample) * pLS->fFeedSrcFadeAtten) +  pLS->fLoopSrcFadeAtten * fInputSample;
+		 if (rLoopSample) {
+			 fadeIntoSource (pLS, srcloop, (unsigned int) rpCurrPos, pfInputLatencyBuf,
+					 (lInputReadPos + lSampleIndex) & pLS->lInputBufMask);
 		 }
 
 		 if (pLS->lFramesUntilFilled > 0) {
 			 // fill source from the record position
-			 fillLoops(pLS, loop, (unsigned int) rpCurrPos, true);
+			 fillLoops(pLS, loop, (unsigned int) rpCurrPos, true, &reach);
 			 pLS->lFramesUntilFilled--;
 		 }
 		 
 		 //fillLoops(pLS, loop, lpCurrPos, false);
-		 fillLoops(pLS, loop, slCurrPos, false);
-		 
+		 fillReach (pLS, &reach, lSampleIndex, SampleCount, fRate, rpCurrPos, false);
+		 fillLoops(pLS, loop, slCurrPos, false, &reach);
 		 
+		 // the fills may have given the source pages of its own
+		 spLoopSample = loopReadPtr (pLS, srcloop, lpCurrPos);
+		 if (rLoopSample) {
+			 rpLoopSample = loopReadPtr (pLS, srcloop, (unsigned int) rpCurrPos);
+		 }
 		 
 		 // always use the source loop as the source
 		 
-		 fOutputSample = (fWet *  (*spLoopSample)
-				  + fDry * fInputSample);
+		 FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+			 fInputSample = pfInputLatencyBuf[lInChanOff + ((lInputReadPos + lSampleIndex) & pLS->lInputBufMask)];
+			 
+			 pfOutput[lChan][lSampleIndex] = (fWet *  spLoopSample[lChanOff]
+							 + fDry * fInputSample);
+		 }
 
 
 		 if (slCurrPos < 0) {
@@ -3922,38 +6197,44 @@ runSooperLooper(LADSPA_Handle Instance,
 		 else if ((loop->lCycles <=1 && fQuantizeMode != 0)) {
 			 // do not include the new input
 			 if (rLoopSample) {
-				 *(rLoopSample)
-					 = pLS->fFeedFadeAtten * fFeedback *  (*rpLoopSample);
+				 FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+					 rLoopSample[lChanOff]
+						 = pLS->feedFade.atten * fFeedback *  rpLoopSample[lChanOff];
+				 }
 			 }
 			 //*(pLoopSample)
-			 //	 = pLS->fFeedFadeAtten * fFeedback *  (*spLoopSample);
+			 //	 = pLS->feedFade.atten * fFeedback *  (*spLoopSample);
 
 		 }
 		 if ((slCurrPos > (long) loop->lMarkEndL &&  *pLS->pfRoundMode == 0)) {
 			 // do not include the new input (at end) when not rounding
-			 pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
+			 fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
 
 			 if (rLoopSample) {
-				 *(rLoopSample) =  
-					 ((pLS->fLoopFadeAtten * fInputSample) + (pLS->fFeedFadeAtten * fFeedback *  *(rpLoopSample)));
+				 FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+					 fInputSample = pfInputLatencyBuf[lInChanOff + ((lInputReadPos + lSampleIndex) & pLS->lInputBufMask)];
+					 rLoopSample[lChanOff] =  
+						 ((pLS->loopFade.atten * fInputSample) + (pLS->feedFade.atten * fFeedback *  rpLoopSample[lChanOff]));
+				 }
 			 }
 			 
 			 //*(pLoopSample)
-			 //	 = (pLS->fFeedFadeAtten * fFeedback *  (*spLoopSample)) +  (pLS->fLoopFadeAtten * fInputSample);
+			 //	 = (pLS->feedFade.atten * fFeedback *  (*spLoopSample)) +  (pLS->loopFade.atten * fInputSample);
 			 // fprintf(stderr, "Not including input at %ul\n", lCurrPos);
 		 }
 		 else {
-			 pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+			 fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 	      
 			 if (rLoopSample) {
-				 *(rLoopSample) =  
-					 ((pLS->fLoopFadeAtten * fInputSample) + (pLS->fFeedFadeAtten * fSafetyFeedback * fFeedback *  *(rpLoopSample)));
+				 FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+					 fInputSample = pfInputLatencyBuf[lInChanOff + ((lInputReadPos + lSampleIndex) & pLS->lInputBufMask)];
+					 rLoopSample[lChanOff] =  
+						 ((pLS->loopFade.atten * fInputSample) + (pLS->feedFade.atten * fSafetyFeedback * fFeedback *  rpLoopSample[lChanOff]));
+				 }
 			 }
 			 //*(pLoopSample)
-			 //	 = ( (pLS->fLoopFadeAtten * fInputSample) + (pLS->fFeedFadeAtten * fSafetyFeedback *  fFeedback * (*spLoopSample)));
+			 //	 = ( (pLS->loopFade.atten * fInputSample) + (pLS->feedFade.atten * fSafetyFeedback *  fFeedback * (*spLoopSample)));
 		 }
-		 
-		 pfOutput[lSampleIndex] = fOutputSample;
 
 		 
 		 // increment 
@@ -3990,8 +6271,8 @@ runSooperLooper(LADSPA_Handle Instance,
 			 DBG(fprintf(stderr,"%u:%u  Multiply added cycle %lu  at %g\n", pLS->lLoopIndex, pLS->lChannelIndex, loop->lCycles, loop->dCurrPos));
 			 
 			 // now we set this to rise in case we were quantized
-			 pLS->fLoopFadeDelta = 1.0f / xfadeSamples;
-			 pLS->fFeedFadeDelta = 1.0f / xfadeSamples;
+			 fadeStart (&pLS->loopFade, 1.0f / xfadeSamples);
+			 fadeStart (&pLS->feedFade, 1.0f / xfadeSamples);
 			 
 			 loop = ensureLoopSpace (pLS, loop, SampleCount - lSampleIndex, NULL);
 			 if (!loop) {
@@ -4035,9 +6316,9 @@ runSooperLooper(LADSPA_Handle Instance,
 	         fFeedback += feedbackDelta;
 	         fScratchPos += scratchDelta;
 
-		 pLS->fPlayFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fPlayFadeAtten + pLS->fPlayFadeDelta);
-		 //pLS->fLoopFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopFadeAtten + pLS->fLoopFadeDelta);
-		 //pLS->fFeedFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fFeedFadeAtten + pLS->fFeedFadeDelta);
+		 fadeStep (&pLS->playFade);
+		 //fadeStep (&pLS->loopFade);
+		 //fadeStep (&pLS->feedFade);
 		 
 		 lpCurrPos =(unsigned int) fmod(loop->dCurrPos, srcloop->lLoopLength);
 		 lCurrPos =(unsigned int) loop->dCurrPos;
@@ -4051,16 +6332,14 @@ runSooperLooper(LADSPA_Handle Instance,
 		    rpCurrPos += srcloop->lLoopLength;
 		 }
 
-		 spLoopSample = & pLS->pSampleBuf[(srcloop->lLoopStart + lpCurrPos) & pLS->lBufferSizeMask];
-		 pLoopSample = & pLS->pSampleBuf[(loop->lLoopStart + lCurrPos) & pLS->lBufferSizeMask];
-
 		 if (pLS->lFramesUntilInput <= 0) {
-			 rLoopSample = & pLS->pSampleBuf[(loop->lLoopStart + (unsigned int) rCurrPos) & pLS->lBufferSizeMask];
-			 rpLoopSample = & pLS->pSampleBuf[(srcloop->lLoopStart + (unsigned int) rpCurrPos) & pLS->lBufferSizeMask];
-			 pLS->fLoopFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopFadeAtten + pLS->fLoopFadeDelta);
-			 pLS->fLoopSrcFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopSrcFadeAtten + pLS->fLoopSrcFadeDelta);
-			 pLS->fFeedFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fFeedFadeAtten + pLS->fFeedFadeDelta);
-			 pLS->fFeedSrcFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fFeedSrcFadeAtten + pLS->fFeedSrcFadeDelta);
+			 fadeStep (&pLS->loopFade);
+			 fadeStep (&pLS->loopSrcFade);
+			 fadeStep (&pLS->feedFade);
+			 fadeStep (&pLS->feedSrcFade);
+			 rLoopSample = loopWritePtr (pLS, loop, (unsigned int) rCurrPos);
+			 // only written where the xfade changes it, see fadeIntoSource
+			 rpLoopSample = loopReadPtr (pLS, srcloop, (unsigned int) rpCurrPos);
 			 lInputReadPos = - pLS->lFramesUntilInput; // negate it
 			 lInputReadPos = (lInputReadPos <= pLS->lInputBufWritePos)
 				 ? (pLS->lInputBufWritePos - lInputReadPos)
@@ -4075,63 +6354,68 @@ runSooperLooper(LADSPA_Handle Instance,
 		 }
 
 		 
-		 //fInputSample = pfInput[lSampleIndex];
-		 fInputSample = pfInputLatencyBuf[(lInputReadPos + lSampleIndex) & pLS->lInputBufMask];
-
 		 // xfade input into source loop (for cases immediately after record)
 		 if (rpLoopSample) {
-			 *(rpLoopSample) = ((*rpLoopSample) * pLS->fFeedSrcFadeAtten) +  pLS->fLoopSrcFadeAtten * fInputSample;
+			 fadeIntoSource (pLS, srcloop, (unsigned int) rpCurrPos, pfInputLatencyBuf,
+					 (lInputReadPos + lSampleIndex) & pLS->lInputBufMask);
 		 }
 
 		 // fill from the record position
 		 if (pLS->lFramesUntilFilled > 0) {
-			 fillLoops(pLS, loop, (unsigned int) rCurrPos, true);
+			 fillLoops(pLS, loop, (unsigned int) rCurrPos, true, &reach);
 			 pLS->lFramesUntilFilled--;
 		 }
 		 
-		 fillLoops(pLS, loop, lCurrPos, false);
+		 fillReach (pLS, &reach, lSampleIndex, SampleCount, fRate, rCurrPos, false);
+		 fillLoops(pLS, loop, lCurrPos, false, &reach);
 		 
-
+		 spLoopSample = loopReadPtr (pLS, srcloop, lpCurrPos);
 		 
 		 if (firsttime && *pLS->pfQuantMode != 0 )
 		 {
 		    // just the source and input
-			 fOutputSample = (pLS->fPlayFadeAtten * fWet *  (*spLoopSample))
-				 + fDry * fInputSample;
+		    FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+			    fInputSample = pfInputLatencyBuf[lInChanOff + ((lInputReadPos + lSampleIndex) & pLS->lInputBufMask)];
+			    pfOutput[lChan][lSampleIndex] = (pLS->playFade.atten * fWet *  spLoopSample[lChanOff])
+				    + fDry * fInputSample;
+		    }
 		    
 		    // do not include the new input
 		    //*(loop->pLoopStart + lCurrPos)
 		    //  = fFeedback *  *(srcloop->pLoopStart + lpCurrPos);
-		    //*(pLoopSample) = (pLS->fFeedFadeAtten * fFeedback *  (*pLoopSample));
+		    //*(pLoopSample) = (pLS->feedFade.atten * fFeedback *  (*pLoopSample));
 		 }
 		 else if (lCurrPos > loop->lMarkEndL && *pLS->pfRoundMode == 0)
 		 {
 		    // insert zeros, we finishing an insert with nothingness
-		    pLS->fLoopFadeDelta = -1.0f / xfadeSamples;
+		    fadeStart (&pLS->loopFade, -1.0f / xfadeSamples);
 
-		    fOutputSample = fDry * fInputSample;
+		    FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+			    fInputSample = pfInputLatencyBuf[lInChanOff + ((lInputReadPos + lSampleIndex) & pLS->lInputBufMask)];
+			    pfOutput[lChan][lSampleIndex] = fDry * fInputSample;
 
-		    if (rLoopSample) {
-			    *(rLoopSample) = fInputSample * pLS->fLoopFadeAtten;
+			    if (rLoopSample) {
+				    rLoopSample[lChanOff] = fInputSample * pLS->loopFade.atten;
+			    }
 		    }
 
 		 }
 		 else {
 		    // just the input we are now inserting
-		    pLS->fLoopFadeDelta = 1.0f / xfadeSamples;
-		    pLS->fFeedFadeDelta = -1.0f / xfadeSamples;
-		    pLS->fPlayFadeDelta = -1.0f / xfadeSamples;
+		    fadeStart (&pLS->loopFade, 1.0f / xfadeSamples);
+		    fadeStart (&pLS->feedFade, -1.0f / xfadeSamples);
+		    fadeStart (&pLS->playFade, -1.0f / xfadeSamples);
 
-		    fOutputSample = fDry * fInputSample  + (pLS->fPlayFadeAtten * fWet *  (*spLoopSample));
+		    FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+			    fInputSample = pfInputLatencyBuf[lInChanOff + ((lInputReadPos + lSampleIndex) & pLS->lInputBufMask)];
+			    pfOutput[lChan][lSampleIndex] = fDry * fInputSample  + (pLS->playFade.atten * fWet *  spLoopSample[lChanOff]);
 
-		    if (rLoopSample) {
-			    *(rLoopSample) = (fInputSample * pLS->fLoopFadeAtten) + (pLS->fFeedFadeAtten * fFeedback *  (*rLoopSample));
+			    if (rLoopSample) {
+				    rLoopSample[lChanOff] = (fInputSample * pLS->loopFade.atten) + (pLS->feedFade.atten * fFeedback *  rLoopSample[lChanOff]);
+			    }
 		    }
 
 		 }
-		 
-		 
-		 pfOutput[lSampleIndex] = fOutputSample;
 
 		 if (fSyncMode != 0) {
 			 pfSyncOutput[lSampleIndex] = pfSyncInput[lSampleIndex];
@@ -4154,10 +6438,7 @@ runSooperLooper(LADSPA_Handle Instance,
 				 }
 			 }
 		 }
-		 else if (fQuantizeMode == QUANT_OFF 
-			  || (fQuantizeMode == QUANT_CYCLE && (((int) rCurrPos + loop->lSyncPos) % loop->lCycleLength) == 0)
-			  || (fQuantizeMode == QUANT_LOOP && (((int)rCurrPos + loop->lSyncPos) % loop->lLoopLength)== 0) 
-			  || (fQuantizeMode == QUANT_8TH && (((int)rCurrPos + loop->lSyncPos) % eighthSamples) == 0)) {
+		 else if (onQuantPoint (pLS, loop, (int) rCurrPos, fQuantizeMode, eighthSamples)) {
 			 pfSyncOutput[lSampleIndex] = 2.0f;
 		 }
 		 
@@ -4175,6 +6456,7 @@ runSooperLooper(LADSPA_Handle Instance,
 		    loop->lMarkEndL = (unsigned long) loop->dCurrPos;
 		    loop->lMarkEndH = loop->lLoopLength - 1;
 		    backfill = loop->backfill = 1;
+		    clearEndFillAhead(loop);
 		    pLS->rounding = false;
 		    loop->lLoopLength = loop->lCycles * loop->lCycleLength;
 		    
@@ -4191,8 +6473,8 @@ runSooperLooper(LADSPA_Handle Instance,
 		    firsttime = loop->firsttime = 0;
 		    DBG(fprintf(stderr, "first time done\n"));
 		    // now we set this to rise in case we were quantized
-		    pLS->fLoopFadeDelta = 1.0f / xfadeSamples;
-		    pLS->fFeedFadeDelta = -1.0f / xfadeSamples;
+		    fadeStart (&pLS->loopFade, 1.0f / xfadeSamples);
+		    fadeStart (&pLS->feedFade, -1.0f / xfadeSamples);
 		 }
 		 
 		 if ((lCurrPos % loop->lCycleLength) == ((loop->lInsPos-1) % loop->lCycleLength)) {
@@ -4217,8 +6499,8 @@ runSooperLooper(LADSPA_Handle Instance,
 				 // this signifies the end of the original cycle
 				 DBG(fprintf(stderr,"insert added cycle. Total=%lu\n", loop->lCycles));
 				 // now we set this to rise in case we were quantized
-				 pLS->fLoopFadeDelta = 1.0f / xfadeSamples;
-				 pLS->fFeedFadeDelta = -1.0f / xfadeSamples;
+				 fadeStart (&pLS->loopFade, 1.0f / xfadeSamples);
+				 fadeStart (&pLS->feedFade, -1.0f / xfadeSamples);
 			 }
 		 }
 	      }
@@ -4305,48 +6587,110 @@ runSooperLooper(LADSPA_Handle Instance,
 	      srcloop = loop->srcloop;
 
 	      bool recenter = true;
+	      // playback sync may jump ahead at any sample
+	      bool bPlaySync = (syncSamples && fPlaybackSyncMode != 0.0f && fQuantizeMode != QUANT_OFF);
 
 	      
 	      for (;lSampleIndex < SampleCount;
 		   lSampleIndex++)
 	      {
+		 // render everything up to the next sample where something
+		 // can happen with the reduced kernel, that sample
+		 // and anything unusual goes through the full path below
+		 fSegRate = (pLS->state == STATE_PAUSED && pLS->playFade.atten == 0.0f) ? 0.0f : fRate;
+		 lSegCount = planPlaySegment (pLS, loop, pfSyncInput, pfSyncOutput, lSampleIndex, SampleCount, fSegRate,
+					      fSyncMode, fQuantizeMode, eighthSamples);
+		 if (lSegCount > 0) {
+			 unsigned long lSegStart = lSampleIndex;
+			 unsigned long lSegEnd = lSampleIndex + lSegCount;
+			 double dPos = loop->dCurrPos;
+			 bool bRamp = (wetDelta != 0.0f || dryDelta != 0.0f || feedbackDelta != 0.0f || scratchDelta != 0.0f);
+			 PlaySpanFunc playSpanFunc = playSpanKernels[useFeedbackPlay ? 1 : 0][bRamp ? 1 : 0][pLS->lChannelCount == 1 ? 1 : 0];
+			 PlayGains gains;
+			 RecordTap rec;
+
+			 rec.loop = loop;
+			 rec.fBehind = fRate * (lOutputLatency + lInputLatency);
+			 rec.fLoopAtten = pLS->loopFade.atten;
+
+			 gains.fWet = fWet;
+			 gains.fDry = fDry;
+			 gains.fFeedback = fFeedback;
+			 gains.fScratchPos = fScratchPos;
+			 gains.wetDelta = wetDelta;
+			 gains.dryDelta = dryDelta;
+			 gains.feedbackDelta = feedbackDelta;
+			 gains.scratchDelta = scratchDelta;
+			 gains.fPlayAtten = pLS->playFade.atten;
+			 gains.fFeedAtten = pLS->feedFade.atten;
+
+			 // walk the segment in spans that are contiguous in both the
+			 // loop and the input latency memory, so no sample index
+			 // needs to be wrapped inside the span
+			 while (lSampleIndex < lSegEnd) {
+				 long lSpanPos = (long) (unsigned int) dPos;
+				 unsigned long lLoopIdx = lSpanPos & LOOP_PAGE_MASK;
+				 unsigned long lInIdx = (pLS->lInputBufWritePos + lSampleIndex) & pLS->lInputBufMask;
+				 unsigned long lSpan = ringSpan (lInIdx, lSegEnd - lSampleIndex, pLS->lInputBufSize);
+				 unsigned long lSpanEnd;
+
+				 if (fSegRate > 0.0f) {
+					 // keep a sample of slack for the accumulated position
+					 double dRoom = (double) (LOOP_PAGE_FRAMES - lLoopIdx) - 2.0;
+					 unsigned long lSteps = (dRoom > 0.0) ? 1 + (unsigned long) (dRoom / fSegRate) : 1;
+					 if (fSegRate == 1.0f) {
+						 // exact integer walk
+						 lSteps = LOOP_PAGE_FRAMES - lLoopIdx;
+					 }
+					 if (lSteps < lSpan) lSpan = lSteps;
+				 }
+				 else if (fSegRate < 0.0f) {
+					 double dRoom = (double) lLoopIdx - 1.0;
+					 unsigned long lSteps = (dRoom > 0.0) ? 1 + (unsigned long) (dRoom / -fSegRate) : 1;
+					 if (lSteps < lSpan) lSpan = lSteps;
+				 }
 
-		 lCurrPos =(unsigned int) fmod(loop->dCurrPos, loop->lLoopLength);
-		 //fprintf(stderr, "curr = %u\n", lCurrPos);
-		 pLoopSample = & pLS->pSampleBuf[(loop->lLoopStart + lCurrPos) & pLS->lBufferSizeMask];
-			  
-                 xLoopSample = 0; // init to nil
-                          if (pLS->state == STATE_UNDO){
-				  prevloop = pLS->headLoopChunk->prev;
-				  if (prevloop) {
-                                          xCurrPos = (unsigned int) fmod(loop->dCurrPos, prevloop->lLoopLength);
-                                          xLoopSample = & pLS->pSampleBuf[(prevloop->lLoopStart + xCurrPos) & pLS->lBufferSizeMask];
-                                  }
-			  }
-			  if (pLS->state == STATE_REDO) {
-				  nextloop = pLS->headLoopChunk->next;
-                                  if (nextloop) {
-                                          xCurrPos = (unsigned int) fmod(loop->dCurrPos, nextloop->lLoopLength);
-                                          xLoopSample = & pLS->pSampleBuf[(nextloop->lLoopStart + xCurrPos) & pLS->lBufferSizeMask];
-                                  }
-			  }
-			  if (pLS->state == STATE_REDO_ALL) {
-				  nextloop = pLS->headLoopChunk;
-				  while (nextloop->next) {
-					  nextloop = nextloop->next;
-				  }
-                                  if (nextloop) {
-                                          xCurrPos = (unsigned int) fmod(loop->dCurrPos, nextloop->lLoopLength);
-                                          xLoopSample = & pLS->pSampleBuf[(nextloop->lLoopStart + xCurrPos) & pLS->lBufferSizeMask];
-                                  }
-			  }
+				 LADSPA_Data * pfLoopSpan = useFeedbackPlay ? loopWritePtr (pLS, loop, lSpanPos) : loopReadPtr (pLS, loop, lSpanPos);
+				 lSpanEnd = lSampleIndex + lSpan;
 
-		 rCurrPos = fmod (loop->dCurrPos - (fRate * (lOutputLatency + lInputLatency)), loop->lLoopLength);
-		 if (rCurrPos < 0) {
-			 rCurrPos += loop->lLoopLength;
+				 lSampleIndex = playSpanFunc (pLS, pfOutput, pfLoopSpan, lSpanPos, &pfInputLatencyBuf[lInIdx],
+							      lSampleIndex, lSpanEnd, &dPos, fSegRate, &gains, &rec);
+				 if (lSampleIndex < lSpanEnd) {
+					 // this one writes to the record position
+					 break;
+				 }
+			 }
+			 lSegCount = lSampleIndex - lSegStart;
+
+			 fWet = gains.fWet;
+			 fDry = gains.fDry;
+			 fFeedback = gains.fFeedback;
+			 fScratchPos = gains.fScratchPos;
+			 loop->dCurrPos = dPos;
+
+			 if (fSyncMode != 0.0f) {
+				 // sync input was silent for the whole segment
+				 if (pfSyncInput != pfSyncOutput) {
+					 memcpy (&pfSyncOutput[lSampleIndex - lSegCount], &pfSyncInput[lSampleIndex - lSegCount], lSegCount * sizeof(LADSPA_Data));
+				 }
+				 pLS->lSamplesSinceSync += lSegCount;
+			 }
+			 else if (fQuantizeMode == QUANT_OFF) {
+				 for (unsigned long n = lSampleIndex - lSegCount; n < lSampleIndex; ++n) {
+					 pfSyncOutput[n] = 2.0f;
+				 }
+			 }
+
+			 if (lSampleIndex >= SampleCount) {
+				 break;
+			 }
 		 }
 
-		 rLoopSample = & pLS->pSampleBuf[(loop->lLoopStart + (unsigned int) rCurrPos) & pLS->lBufferSizeMask];
+		 lCurrPos =(unsigned int) loopWrap(loop->dCurrPos, loop->lLoopLength);
+		 //fprintf(stderr, "curr = %u\n", lCurrPos);
+
+		 rCurrPos = trailingPos (loop->dCurrPos, fRate * (lOutputLatency + lInputLatency), loop->lLoopLength);
+
 		 lInputReadPos = pLS->lInputBufWritePos;
 
 		 if (rCurrPos == loop->lLoopLength-1) {
@@ -4374,10 +6718,7 @@ runSooperLooper(LADSPA_Handle Instance,
 				 }
 			 }
 		 }
-		 else if (fQuantizeMode == QUANT_OFF 
-			  || (fQuantizeMode == QUANT_CYCLE && ((lCurrPos + loop->lSyncPos) % loop->lCycleLength) == 0)
-			  || (fQuantizeMode == QUANT_LOOP && (((lCurrPos + loop->lSyncPos) % loop->lLoopLength) == 0)) 
-			  || (fQuantizeMode == QUANT_8TH && ((lCurrPos + loop->lSyncPos) % eighthSamples) == 0)) {
+		 else if (onQuantPoint (pLS, loop, lCurrPos, fQuantizeMode, eighthSamples)) {
 			 pfSyncOutput[lSampleIndex] = 2.0f;
 		 }
 
@@ -4429,20 +6770,20 @@ runSooperLooper(LADSPA_Handle Instance,
                  fDry += dryDelta;
      	         fFeedback += feedbackDelta;
 	         fScratchPos += scratchDelta;
-		 pLS->fLoopFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopFadeAtten + pLS->fLoopFadeDelta);
-		 pLS->fLoopSrcFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fLoopSrcFadeAtten + pLS->fLoopSrcFadeDelta);
-		 pLS->fFeedSrcFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fFeedSrcFadeAtten + pLS->fFeedSrcFadeDelta);
-		 pLS->fPlayFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fPlayFadeAtten + pLS->fPlayFadeDelta);
-		 pLS->fFeedFadeAtten = LIMIT_BETWEEN_0_AND_1 (pLS->fFeedFadeAtten + pLS->fFeedFadeDelta);
+		 fadeStep (&pLS->loopFade);
+		 fadeStep (&pLS->loopSrcFade);
+		 fadeStep (&pLS->feedSrcFade);
+		 fadeStep (&pLS->playFade);
+		 fadeStep (&pLS->feedFade);
 
 		 tmpWet = fWet;
 		 
-		 //if (pLS->fPlayFadeAtten != 0.0f && pLS->fPlayFadeAtten != 1.0f) {
-			 //cerr << "play fade: " << pLS->fPlayFadeAtten << endl;
+		 //if (pLS->playFade.atten != 0.0f && pLS->playFade.atten != 1.0f) {
+			 //cerr << "play fade: " << pLS->playFade.atten << endl;
 		 //}
   
 		      
-		 tmpWet *= pLS->fPlayFadeAtten;
+		 tmpWet *= pLS->playFade.atten;
 
 // 		 // modify fWet if we are in a ramp up/down
 // 		 if (pLS->lRampSamples > 0) {
@@ -4460,42 +6801,79 @@ runSooperLooper(LADSPA_Handle Instance,
 // 		 }
 
 		 
-		 //fInputSample = pfInput[lSampleIndex];
-		 fInputSample = pfInputLatencyBuf[(lInputReadPos + lSampleIndex) & pLS->lInputBufMask];
-
 		 // fill from the record position ??
 		 if (pLS->lFramesUntilFilled > 0) {
-			 fillLoops(pLS, loop, (unsigned int) rCurrPos, true);
+			 fillLoops(pLS, loop, (unsigned int) rCurrPos, true, &reach);
 			 pLS->lFramesUntilFilled--;
 		 }
 		 
-		 fillLoops(pLS, loop, lCurrPos, false);
-
-	      
-		 
-		 fOutputSample =   tmpWet *  (*pLoopSample)
-		    + fDry * fInputSample;
-		 if (xLoopSample && (pLS->state == STATE_UNDO || pLS->state == STATE_REDO || pLS->state == STATE_REDO_ALL)) {
-			 //fprintf(stderr, "fading.. :%g\n", tmpWet);
-			 fOutputSample =   tmpWet *  (*xLoopSample)
-			 + fDry * fInputSample + (fWet-tmpWet) * (*pLoopSample);
+		 fillReach (pLS, &reach, lSampleIndex, SampleCount, fRate, rCurrPos, bPlaySync);
+		 fillLoops(pLS, loop, lCurrPos, false, &reach);
+
+		 // pointers only now, the fills may have copied pages.  once the
+		 // input has faded out the record position is only written where
+		 // that still changes it, see RecordTap
+		 pLoopSample = useFeedbackPlay ? loopWritePtr (pLS, loop, lCurrPos) : loopReadPtr (pLS, loop, lCurrPos);
+		 if (pLS->feedFade.atten != 1.0f || pLS->loopFade.atten != 0.0f) {
+			 rLoopSample = loopWritePtr (pLS, loop, (unsigned int) rCurrPos);
+		 }
+		 else {
+			 rLoopSample = loopReadPtr (pLS, loop, (unsigned int) rCurrPos);
 		 }
+			  
+                 xLoopSample = 0; // init to nil
+                          if (pLS->state == STATE_UNDO){
+				  prevloop = pLS->headLoopChunk->prev;
+				  if (prevloop) {
+                                          xCurrPos = (unsigned int) loopWrap(loop->dCurrPos, prevloop->lLoopLength);
+                                          xLoopSample = loopReadPtr (pLS, prevloop, xCurrPos);
+                                  }
+			  }
+			  if (pLS->state == STATE_REDO) {
+				  nextloop = pLS->headLoopChunk->next;
+                                  if (nextloop) {
+                                          xCurrPos = (unsigned int) loopWrap(loop->dCurrPos, nextloop->lLoopLength);
+                                          xLoopSample = loopReadPtr (pLS, nextloop, xCurrPos);
+                                  }
+			  }
+			  if (pLS->state == STATE_REDO_ALL) {
+				  nextloop = loopOfGeneration (pLS, pLS->lEndLoopChunk - 1);
+                                  if (nextloop) {
+                                          xCurrPos = (unsigned int) loopWrap(loop->dCurrPos, nextloop->lLoopLength);
+                                          xLoopSample = loopReadPtr (pLS, nextloop, xCurrPos);
+                                  }
+			  }
+		 
+		 FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+			 fInputSample = pfInputLatencyBuf[lInChanOff + ((lInputReadPos + lSampleIndex) & pLS->lInputBufMask)];
+
+			 fOutputSample =   tmpWet *  pLoopSample[lChanOff]
+				 + fDry * fInputSample;
+			 if (xLoopSample && (pLS->state == STATE_UNDO || pLS->state == STATE_REDO || pLS->state == STATE_REDO_ALL)) {
+				 //fprintf(stderr, "fading.. :%g\n", tmpWet);
+				 fOutputSample =   tmpWet *  xLoopSample[lChanOff]
+					 + fDry * fInputSample + (fWet-tmpWet) * pLoopSample[lChanOff];
+			 }
 
-		 // jlc play
-		 // we might add a bit from the input still during xfadeout
-		 *(rLoopSample) = ((*rLoopSample) * pLS->fFeedFadeAtten) +  pLS->fLoopFadeAtten * fInputSample;
-		 // if (pLS->fLoopFadeAtten > 0.9 && pLS->fLoopFadeAtten < 1) fprintf(stderr, "fLoopFadeAtten: %g, SampleIndex: %d\n", pLS->fLoopFadeAtten, lCurrPos);
+			 // jlc play
+			 // we might add a bit from the input still during xfadeout
+			 fRecSample = (rLoopSample[lChanOff] * pLS->feedFade.atten) +  pLS->loopFade.atten * fInputSample;
+			 if (!sameSample (fRecSample, rLoopSample[lChanOff])) {
+				 loopWritePtr (pLS, loop, (unsigned int) rCurrPos)[lChanOff] = fRecSample;
+			 }
+			 // if (pLS->loopFade.atten > 0.9 && pLS->loopFade.atten < 1) fprintf(stderr, "fLoopFadeAtten: %g, SampleIndex: %d\n", pLS->loopFade.atten, lCurrPos);
 
-		 // optionally support feedback during playback (use rLoopSample??)
-		 if (useFeedbackPlay) {
-			 *(pLoopSample) *= fFeedback * pLS->fFeedFadeAtten;
-		 }
+			 // optionally support feedback during playback (use rLoopSample??)
+			 if (useFeedbackPlay) {
+				 pLoopSample[lChanOff] *= fFeedback * pLS->feedFade.atten;
+			 }
 		 
-		 pfOutput[lSampleIndex] = fOutputSample;
+			 pfOutput[lChan][lSampleIndex] = fOutputSample;
+		 }
 			  
 			  
 
-		 if (pLS->state == STATE_PAUSED && pLS->fPlayFadeAtten == 0.0f) {
+		 if (pLS->state == STATE_PAUSED && pLS->playFade.atten == 0.0f) {
 			 // do not increment time
 		 }
 		 else {
@@ -4515,7 +6893,7 @@ runSooperLooper(LADSPA_Handle Instance,
 		       // done with one shot
 			    DBG(fprintf(stderr, "%u:%u  finished ONESHOT  lcurrPos=%d\n", pLS->lLoopIndex, pLS->lChannelIndex, lCurrPos));
 		       pLS->state = STATE_MUTE;
-		       pLS->fPlayFadeDelta = -1.0f / xfadeSamples;
+		       fadeStart (&pLS->playFade, -1.0f / xfadeSamples);
 
 		       //pLS->lRampSamples = xfadeSamples;
 		       //fWet = 0.0;
@@ -4540,7 +6918,7 @@ runSooperLooper(LADSPA_Handle Instance,
 		       DBG(fprintf(stderr, "%u:%u  finished ONESHOT neg\n", pLS->lLoopIndex, pLS->lChannelIndex));
 		       pLS->state = STATE_MUTE;
 		       //fWet = 0.0;
-		       pLS->fPlayFadeDelta = -1.0f / xfadeSamples;
+		       fadeStart (&pLS->playFade, -1.0f / xfadeSamples);
 		       //pLS->lRampSamples = xfadeSamples;
 		    }
 
@@ -4558,19 +6936,19 @@ runSooperLooper(LADSPA_Handle Instance,
 
 	      }
 	      
-		   if (pLS->state == STATE_UNDO && pLS->fPlayFadeAtten == 1.0f) {
+		   if (pLS->state == STATE_UNDO && pLS->playFade.atten == 1.0f) {
 			   // play some of the old loop first and switch later
 			   undoLoop(pLS, false);
 			   DBG(fprintf(stderr, "finished UNDO...\n"));
 			   pLS->state = pLS->nextState;
 		   }
-		   if (pLS->state == STATE_REDO && pLS->fPlayFadeAtten == 1.0f) {
+		   if (pLS->state == STATE_REDO && pLS->playFade.atten == 1.0f) {
 			   // play some of the old loop first and switch later
 			   redoLoop(pLS);
 			   DBG(fprintf(stderr, "finished REDO...\n"));
 			   pLS->state = pLS->nextState;
 		   }
-		   if (pLS->state == STATE_UNDO_ALL && pLS->fPlayFadeAtten == 0.0f) {
+		   if (pLS->state == STATE_UNDO_ALL && pLS->playFade.atten == 0.0f) {
 			   // fade out the old loop and goto state_off
 			   clearLoopChunks(pLS);
 			   DBG(fprintf(stderr, "finished UNDO ALL...\n"));
@@ -4579,7 +6957,7 @@ runSooperLooper(LADSPA_Handle Instance,
 				 else
 			     pLS->state = STATE_OFF;
 		   }
-		   if (pLS->state == STATE_REDO_ALL && pLS->fPlayFadeAtten == 1.0f) {
+		   if (pLS->state == STATE_REDO_ALL && pLS->playFade.atten == 1.0f) {
 			   // play some of the old loop first and switch later
 			   lastloop = pLS->headLoopChunk;
 			   redoLoop(pLS);
@@ -4625,13 +7003,13 @@ runSooperLooper(LADSPA_Handle Instance,
 		      
 		 // wrap properly
 		 lCurrPos =(unsigned int) fmod(loop->dCurrPos, loop->lLoopLength);
-		 pLoopSample = & pLS->pSampleBuf[(loop->lLoopStart + lCurrPos) & pLS->lBufferSizeMask];
-
-		 fInputSample = pfInput[lSampleIndex];
+		 pLoopSample = loopWritePtr (pLS, loop, lCurrPos);
 
 		 if (backfill && lCurrPos >= loop->lMarkEndL && lCurrPos <= loop->lMarkEndH) {
 		    // our delay buffer is invalid here, clear it
-		    *(pLoopSample) = 0.0f;
+		    FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+			    pLoopSample[lChanOff] = 0.0f;
+		    }
 
 		    if (fRate > 0) {
 		       loop->lMarkEndL = lCurrPos;
@@ -4642,22 +7020,26 @@ runSooperLooper(LADSPA_Handle Instance,
 		 }
 
 
-		 fOutputSample =   fWet *  *(pLoopSample)
-		    + fDry * fInputSample;
+		 FOR_EACH_CHANNEL(pLS, lChan, lChanOff, lInChanOff) {
+			 fInputSample = pfInput[lChan][lSampleIndex];
+
+			 fOutputSample =   fWet *  pLoopSample[lChanOff]
+				 + fDry * fInputSample;
 
 
-		 if (!pLS->bHoldMode) {
-		    // now fill in from input if we are not holding the delay
-		    *(pLoopSample) = 
-		      (fInputSample +  fFeedback *  *(pLoopSample));
-		 }
+			 if (!pLS->bHoldMode) {
+				 // now fill in from input if we are not holding the delay
+				 pLoopSample[lChanOff] = 
+					 (fInputSample +  fFeedback *  pLoopSample[lChanOff]);
+			 }
 		 
-		 pfOutput[lSampleIndex] = fOutputSample;
+			 pfOutput[lChan][lSampleIndex] = fOutputSample;
+		 }
 
 		 if (fSyncMode != 0 || fQuantizeMode == QUANT_OFF) {
 			 pfSyncOutput[lSampleIndex] = pfSyncInput[lSampleIndex];
 		 }
-		 else if (((lCurrPos + loop->lSyncPos) % loop->lCycleLength) == 0) {
+		 else if (onQuantPoint (pLS, loop, lCurrPos, QUANT_CYCLE, eighthSamples)) {
 			 pfSyncOutput[lSampleIndex] = 2.0f;
 		 }
 
@@ -4715,7 +7097,9 @@ runSooperLooper(LADSPA_Handle Instance,
         fFeedback += feedbackDelta;
 	fScratchPos += scratchDelta;
 	     
-	pfOutput[lSampleIndex] = fDry * pfInput[lSampleIndex];
+	for (lChan = 0; lChan < pLS->lChannelCount; ++lChan) {
+		pfOutput[lChan][lSampleIndex] = fDry * pfInput[lChan][lSampleIndex];
+	}
 
 	if (fSyncMode != 0 || fQuantizeMode == QUANT_OFF) {
 		pfSyncOutput[lSampleIndex] = pfSyncInput[lSampleIndex];
@@ -4738,6 +7122,10 @@ runSooperLooper(LADSPA_Handle Instance,
   pLS->lScratchSamples += SampleCount;  
   pLS->lTapTrigSamples += SampleCount;
 
+  // the sync events only ever describe one run
+  pLS->pSyncEvents = 0;
+  pLS->lSyncEventCount = -1;
+
   // printf ("wet is %g    targ was %g\n", fWet, *(pLS->pfWet));
   pLS->fWetCurr = wetTarget;
   pLS->fWetTarget = wetTarget;
@@ -4768,7 +7156,7 @@ runSooperLooper(LADSPA_Handle Instance,
 
   
   if (pLS->pfSecsFree) {
-	  *pLS->pfSecsFree = pLS->lBufferSize / pLS->fSampleRate;
+	  *pLS->pfSecsFree = freeLoopSecs (pLS);
 //      *pLS->pfSecsFree = (pLS->fTotalSecs) -
 // 	(pLS->headLoopChunk ?
 // 	 ((((unsigned)pLS->headLoopChunk->pLoopStop - (unsigned)pLS->pSampleBuf)
@@ -4801,7 +7189,8 @@ runSooperLooper(LADSPA_Handle Instance,
 	*pLS->pfStateOut = (LADSPA_Data) STATE_OFF;
 
   }
-  
+
+  noteStaticLoop (pLS, bWasStatic);
   
 }
 
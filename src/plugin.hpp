@@ -79,6 +79,23 @@ enum AudioPort {
 	PORT_COUNT // must be last
 };
 
+// how the loop is read in between its samples
+enum LoopInterpolation {
+	LoopInterpLinear = 0,
+	LoopInterpCubic,
+	LoopInterpSinc
+};
+
+// the block paths taken where the loop allows, all on by default.  with
+// one turned off, see sl_set_block_paths, those samples go through the
+// sample by sample path instead, which renders exactly the same
+enum BlockPath {
+	PathPlaySegments = 1,
+	PathFillAhead = 2,
+	PathSharePages = 4,
+	PathAll = PathPlaySegments | PathFillAhead | PathSharePages
+};
+
 enum {
 	QUANT_OFF=0,
 	QUANT_CYCLE,
@@ -112,11 +129,49 @@ enum LooperState
 	LooperStateOffMuted = 20
 };
 
+// a non zero sample of a sync buffer: 1 for a sync point, 2 for a beat
+struct SyncEvent {
+	unsigned long frame;
+	LADSPA_Data   value;
+};
+
+// the sync events of one period, in frame order.  only meaningful while
+// valid, it is not when every sample is a sync point or the events did
+// not fit, then the buffer itself has to be looked at
+struct SyncEventList {
+	SyncEvent *   events;
+	unsigned long count;
+	unsigned long size;
+	bool          valid;
+};
 	
 };
 
+namespace SooperLooper {
+	class PagePool;
+	class PageFeed;
+	class UndoSpill;
+};
+
 /*****************************************************************************/
 
+// the multiples of a quantize length on either side of the last position
+// tested against it, so that the per sample test only divides when the
+// position leaves that range or the length changes
+typedef struct {
+	unsigned long lLength;
+	long lLow;
+} QuantBoundary;
+
+// a gain that ramps by delta every sample, clamped to 0..1.  once a step
+// leaves it where it was it is constant, and stepping it costs nothing,
+// until the next fadeStart() or fadeSet()
+typedef struct {
+	LADSPA_Data atten;
+	LADSPA_Data delta;
+	int constant;
+} FadeEnvelope;
+
 // defines all a loop needs to know to cycle properly in memory
 // one of these will prefix the actual loop data in our buffer memory
 typedef struct _LoopChunk {
@@ -125,8 +180,20 @@ typedef struct _LoopChunk {
 	//LADSPA_Data * pLoopStart;
 	//LADSPA_Data * pLoopStop;    
 	
-	// index into main sample buffer
-	unsigned long lLoopStart;
+	// page table into the sample memory.  entry n holds the page for
+	// frames n * LOOP_PAGE_FRAMES onwards, or the silent page 0 if
+	// nothing has been written there.  lPageCount is one past the
+	// highest entry that may be set
+	unsigned int * pPages;
+	unsigned long lPageCount;
+
+	// entries moved out to the undo file, and how many of those are
+	// being read back in
+	unsigned long lSpilledPages;
+	unsigned long lLoadingPages;
+
+	// changes whenever the chunk is reused for another loop
+	unsigned long lSerial;
 	//unsigned long lLoopStop;    
 	unsigned long lLoopLength;
 	
@@ -142,6 +209,13 @@ typedef struct _LoopChunk {
 	unsigned long lMarkEndL;
 	unsigned long lMarkEndH;        
 
+	// how far each fill range has already been block copied
+	// from its low and high end, LONG_MAX when not at all
+	unsigned long lFillAheadL;
+	unsigned long lFillAheadH;
+	unsigned long lEndFillAheadL;
+	unsigned long lEndFillAheadH;
+
 	unsigned long lSyncOffset; // used for rel sync
 	long lSyncPos; // used for retriggering
 	long lOrigSyncPos;
@@ -175,17 +249,70 @@ typedef struct {
     
 	LADSPA_Data fSampleRate;
 
-	/* the sample memory */
+	/* the sample memory, in pages of LOOP_PAGE_FRAMES frames that are
+	   planar within themselves, channel n starting at n * LOOP_PAGE_FRAMES.
+	   Pages come from a pool shared with the other loopers and are
+	   reference counted and shared between loop chunks until one of
+	   them writes to it.  Pages taken from the pool but not used yet
+	   wait in the stash, which is topped up from the feed the pool
+	   keeps filled for us, and only from the pool itself if that is
+	   empty.  If the pool was busy it is not asked again until the
+	   next run */
 	//LADSPA_Data * pfSampleBuf;
-	LADSPA_Data * pSampleBuf;
+	SooperLooper::PagePool * pPagePool;
+	SooperLooper::PageFeed * pPageFeed;
+	unsigned int * pPageStash;
+	unsigned long lStashCount;
+	unsigned long lPagesInUse;
+	bool bPoolBusy;
+
+	/* page tables of all the loop chunks, lMaxLoopPages entries each.
+	   this is also the quota, the most pages we hold at once */
+	unsigned int * pPageTables;
+	unsigned long lMaxLoopPages;
+
+	/* cold undo history is moved out to a file when this is set.  the
+	   cursor is where the search for pages to move out goes on from,
+	   and undo or redo commands that go to a loop not back in memory
+	   yet are held in lHeldMultiCtrl */
+	SooperLooper::UndoSpill * pUndoSpill;
+	unsigned long lSpillsPending;
+	LoopChunk * pSpillCursor;
+	unsigned long lSpillCursorSerial;
+	unsigned long lSpillCursorPage;
+	int lHeldMultiCtrl[32];
+	unsigned int lHeldCount;
+	unsigned long lHeldSamples;
+
+	/* bumped at the end of every run that may have changed what the
+	   loop sounds like when played, see sl_get_static_loop_key.  the
+	   head loop it was last seen with tells undo and redo apart */
+	unsigned long lStaticEpoch;
+	LoopChunk * pStaticLoop;
+	unsigned long lStaticSerial;
+
+	/* the static loop as the main thread reads it, see
+	   sl_pin_static_loop.  the pages are pinned by the audio thread,
+	   and iSnapshotState says which of the two threads may touch the
+	   rest.  lStaticKey is the key at the end of the last run */
+	volatile int iSnapshotState;
+	volatile unsigned long lSnapshotWanted;
+	volatile unsigned long lStaticKey;
+	unsigned long lSnapshotKey;
+	unsigned long lSnapshotLength;
+	unsigned long lSnapshotPageCount;
+	unsigned int * pSnapshotPages;
     
 	unsigned int lLoopIndex;
 	unsigned int lChannelIndex;
+
+	/* number of audio channels driven by this state machine */
+	unsigned int lChannelCount;
 	
-	/* Buffer size, IS necessarily a power of two. */
+	/* longest loop in samples, a whole number of pages */
 	unsigned long lBufferSize;
-	unsigned long lBufferSizeMask;
 
+	/* planar as well, lInputBufSize samples per channel */
 	LADSPA_Data * pInputBuf;
 	unsigned long lInputBufSize;
 	unsigned long lInputBufMask;
@@ -193,6 +320,13 @@ typedef struct {
 	unsigned long lInputBufWritePos;
 	long lFramesUntilInput; // used for input latency compensation
 	long lFramesUntilFilled; // used to fill the gaps right after a record
+
+	// an overdub that started out with the pages of its source, and
+	// where its first pass began.  see settleSharedFill
+	LoopChunk * pSharedFill;
+	unsigned long lSharedFillPos;
+	bool bSharedFrontFilled;
+	bool bSharedBackFilled;
 	
 	// the loopchunk pool
 	LoopChunk * pLoopChunks;
@@ -254,8 +388,13 @@ typedef struct {
 	// linked list of loop chunks
 	LoopChunk * headLoopChunk;
 	LoopChunk * tailLoopChunk;    
+	// the history as generations, generation g is held by chunk
+	// g % lLoopChunkCount.  the valid chunks are the generations from
+	// lTailLoopChunk up to lEndLoopChunk, lHeadLoopChunk is the head's
+	// when there is one and anything after it can be redone
 	unsigned int lHeadLoopChunk;
 	unsigned int lTailLoopChunk;
+	unsigned int lEndLoopChunk;
     
 	LADSPA_Data fWetCurr;
 	LADSPA_Data fWetTarget;
@@ -272,24 +411,18 @@ typedef struct {
 	LADSPA_Data fFeedbackCurr;
 	LADSPA_Data fFeedbackTarget;
 
-	LADSPA_Data fLoopFadeAtten;
-	LADSPA_Data fLoopFadeDelta;
-
-	LADSPA_Data fLoopSrcFadeAtten;
-	LADSPA_Data fLoopSrcFadeDelta;
-
-	LADSPA_Data fPlayFadeAtten;
-	LADSPA_Data fPlayFadeDelta;
-
-	LADSPA_Data fFeedFadeAtten;
-	LADSPA_Data fFeedFadeDelta;
-
-	LADSPA_Data fFeedSrcFadeAtten;
-	LADSPA_Data fFeedSrcFadeDelta;
+	FadeEnvelope loopFade;
+	FadeEnvelope loopSrcFade;
+	FadeEnvelope playFade;
+	FadeEnvelope feedFade;
+	FadeEnvelope feedSrcFade;
 
 	LADSPA_Data fLoopXfadeTime;
 
 	unsigned int lSamplesSinceSync;
+
+	// quantize boundaries around the current position
+	QuantBoundary quantBound;
 	
 	
 	/* Ports:
@@ -361,15 +494,23 @@ typedef struct {
 	/* if non zero, the redo command is treated like a tap trigger */
 	LADSPA_Data *pfRedoTapMode;
     
-	/* Input audio port data location. */
-	LADSPA_Data * pfInput;
+	/* Input audio port data locations, one per channel. */
+	LADSPA_Data ** pfInput;
     
-	/* Output audio port data location. */
-	LADSPA_Data * pfOutput;
+	/* Output audio port data locations, one per channel. */
+	LADSPA_Data ** pfOutput;
 
 	LADSPA_Data * pfSyncInput;
 	LADSPA_Data * pfSyncOutput;
 
+	/* the non zero samples of pfSyncInput for the current run, when
+	   the host knows them, at frame lSyncEventOffset and on.
+	   lSyncEventCount is -1 when the input must be scanned */
+	const SooperLooper::SyncEvent * pSyncEvents;
+	long lSyncEventCount;
+	unsigned long lSyncEventOffset;
+	unsigned long lSyncEventPos;
+
     
 	/* Control outputs */
 
@@ -390,17 +531,79 @@ typedef struct {
 
 
 
-// reads loop audio into buffer, up to frames length, starting from loop_offset.  if fewer frames are
+// creates an instance with a single state machine and loop history driving chans
+// audio channels.  the standard LADSPA instantiate creates a mono instance.
+extern LADSPA_Handle sl_instantiate (const LADSPA_Descriptor * descriptor, unsigned long srate, unsigned int chans);
+
+// connects the AudioInputPort or AudioOutputPort of one channel, connect_port only reaches channel 0
+extern void sl_connect_audio_port (LADSPA_Handle instance, unsigned long port, unsigned int chan, LADSPA_Data * data);
+
+extern unsigned int sl_get_channel_count (const LADSPA_Handle instance);
+
+// reads loop audio of one channel into buffer, up to frames length, starting from loop_offset.  if fewer frames are
 // available returns amount read.  if 0 is returned loop is done.
-extern unsigned long sl_read_current_loop_audio (LADSPA_Handle instance, float * buf, unsigned long frames, unsigned long loop_offset);
+extern unsigned long sl_read_current_loop_audio (LADSPA_Handle instance, unsigned int chan, float * buf, unsigned long frames, unsigned long loop_offset);
 
 // override current samples since sync
 extern void sl_set_samples_since_sync (LADSPA_Handle instance, unsigned long frames);
 
+// the sync events of the next run only, frame offset of the list is the
+// first sample of the sync input.  without them the input is scanned
+extern void sl_set_sync_events (LADSPA_Handle instance, const SooperLooper::SyncEventList * list, unsigned long offset);
+
 extern void sl_set_replace_quantized (LADSPA_Handle instance, bool value);
 extern bool sl_get_replace_quantized (LADSPA_Handle instance);
 extern void sl_set_loop_index (LADSPA_Handle instance, unsigned int index, unsigned int chan);
 
 extern bool sl_has_loop (const LADSPA_Handle instance);
 
+// nonzero while the loop is just being played, forward or in reverse, so
+// that its audio cannot change.  the value stays the same for as long as
+// that lasts, and is never handed out again for another period.  only
+// for the audio thread
+extern unsigned long sl_get_static_loop_key (const LADSPA_Handle instance);
+
+// the rate the loop plays at, negative in reverse
+extern double sl_get_play_rate (const LADSPA_Handle instance);
+
+// the frames of the current loop, and the position in it as an index into
+// its audio, not adjusted for the sync position
+extern unsigned long sl_get_loop_length (const LADSPA_Handle instance);
+extern double sl_get_loop_position (const LADSPA_Handle instance);
+
+// for reading the static loop outside the audio thread.  asks for the
+// loop with static loop key key to be held still, which the audio thread
+// does at the end of its next run.  returns its frames once it has, 0
+// before that, with *gone set if the loop has moved on and never will be.
+// sl_unpin_static_loop must follow every call that returned nonzero
+extern unsigned long sl_pin_static_loop (LADSPA_Handle instance, unsigned long key, bool * gone);
+extern void sl_unpin_static_loop (LADSPA_Handle instance);
+
+// reads frames of one channel from the start of the pinned loop audio, if
+// it is the one for key.  returns the frames read, 0 otherwise
+extern unsigned long sl_read_static_loop (LADSPA_Handle instance, unsigned long key, unsigned int chan, float * buf, unsigned long frames);
+
+// reads frames of one channel of the loop, from the fractional position pos
+// on (an index into its audio, like sl_get_loop_position) and step frames
+// apart, wrapping around the loop end.  interp is a LoopInterpolation
+extern void sl_read_loop_interpolated (LADSPA_Handle instance, unsigned int chan, float * buf, unsigned long frames,
+				       double pos, double step, int interp);
+
+// grows the shared loop memory if it is running low and moves undo
+// history to and from the undo files.  must be called regularly from a
+// thread other than the audio thread
+extern void sl_maintain_memory ();
+
+// directory for the files cold undo history is moved out to, applies to
+// instances made afterwards.  empty or 0 keeps all history in memory
+extern void sl_set_undo_spill_dir (const char * dir);
+
+// the BlockPath bits of the paths all instances may take, for comparing
+// them against the sample by sample path.  not for use while running
+extern void sl_set_block_paths (unsigned int paths);
+
+// makes sure the memory for frames more frames of loop is allocated,
+// for feeding a loop in from a thread other than the audio thread
+extern void sl_reserve_memory (LADSPA_Handle instance, unsigned long frames);
+
 #endif
@@ -0,0 +1,576 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+/*
+ * sl-bench runs the engine in process, without jack, over a matrix of
+ * loop counts, channel counts, period sizes and loop states, timing
+ * every Engine::process call.  The results go to stdout as JSON so runs
+ * from before and after a change can be compared.
+ *
+ * The decay state records the loop at about 1e-34 and plays it back with
+ * 0.99 feedback, so that it spends most of a long enough run in the
+ * denormal range.  What flushing denormals saves shows with
+ *
+ *   sl-bench -l 1 -c 1 -b 256 -s decay -L 0.1 -t 120 -D on,off
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <pbd/transmitter.h>
+
+#include "engine.hpp"
+#include "looper.hpp"
+#include "event.hpp"
+#include "command_map.hpp"
+#include "plugin.hpp"
+#include "audio_driver.hpp"
+#include "utils.hpp"
+
+using namespace SooperLooper;
+using namespace std;
+
+Transmitter  warning (Transmitter::Warning);
+Transmitter  error (Transmitter::Error);
+
+
+// allocations made by the audio thread while it is in Engine::process.
+// only counted where malloc can be wrapped
+static volatile unsigned long alloc_count = 0;
+static __thread bool counting_allocs = false;
+
+#ifdef __GLIBC__
+#define COUNTS_ALLOCS 1
+
+extern "C" {
+extern void * __libc_malloc (size_t size);
+extern void * __libc_calloc (size_t nmemb, size_t size);
+extern void * __libc_realloc (void * ptr, size_t size);
+
+void * malloc (size_t size)
+{
+	if (counting_allocs) {
+		__sync_fetch_and_add (&alloc_count, 1);
+	}
+	return __libc_malloc (size);
+}
+
+void * calloc (size_t nmemb, size_t size)
+{
+	if (counting_allocs) {
+		__sync_fetch_and_add (&alloc_count, 1);
+	}
+	return __libc_calloc (nmemb, size);
+}
+
+void * realloc (void * ptr, size_t size)
+{
+	if (counting_allocs) {
+		__sync_fetch_and_add (&alloc_count, 1);
+	}
+	return __libc_realloc (ptr, size);
+}
+}
+#else
+#define COUNTS_ALLOCS 0
+#endif
+
+
+/*
+ * A driver with no outside world, its input ports holding a fixed
+ * period of noise.
+ */
+class BenchAudioDriver
+	: public AudioDriver
+{
+  public:
+	BenchAudioDriver(nframes_t samplerate, nframes_t buffersize)
+		: AudioDriver("sl-bench", "") {
+		_samplerate = samplerate;
+		_buffersize = buffersize;
+	}
+
+	virtual ~BenchAudioDriver() {
+		for (size_t n = 0; n < _inputs.size(); ++n) {
+			delete [] _inputs[n];
+		}
+		for (size_t n = 0; n < _outputs.size(); ++n) {
+			delete [] _outputs[n];
+		}
+	}
+
+	bool initialize(std::string client_name="") { return true; }
+	bool activate() { return true; }
+	bool deactivate() { return true; }
+
+	bool create_input_port (std::string name, port_id_t & portid) {
+		sample_t * buf = new sample_t[_buffersize];
+		unsigned int seed = 12345 + _inputs.size();
+
+		// the same noise every run
+		for (nframes_t n = 0; n < _buffersize; ++n) {
+			seed = seed * 1103515245 + 12345;
+			buf[n] = 0.25f * (((seed >> 8) & 0xffff) / 32768.0f - 1.0f);
+		}
+
+		_inputs.push_back (buf);
+		portid = _inputs.size();
+		return true;
+	}
+
+	bool create_output_port (std::string name, port_id_t & portid) {
+		sample_t * buf = new sample_t[_buffersize];
+		memset (buf, 0, _buffersize * sizeof(sample_t));
+		_outputs.push_back (buf);
+		portid = _outputs.size();
+		return true;
+	}
+
+	bool destroy_input_port (port_id_t portid) { return portid > 0 && portid <= _inputs.size(); }
+	bool destroy_output_port (port_id_t portid) { return portid > 0 && portid <= _outputs.size(); }
+
+	sample_t * get_input_port_buffer (port_id_t port, nframes_t nframes) {
+		if (port > _inputs.size() || port == 0) return 0;
+		return _inputs[port-1];
+	}
+	sample_t * get_output_port_buffer (port_id_t port, nframes_t nframes) {
+		if (port > _outputs.size() || port == 0) return 0;
+		return _outputs[port-1];
+	}
+
+	unsigned int get_input_port_count () { return _inputs.size(); }
+	unsigned int get_output_port_count () { return _outputs.size(); }
+
+	nframes_t get_input_port_latency (port_id_t portid) { return 0; }
+	nframes_t get_output_port_latency (port_id_t portid) { return 0; }
+
+  protected:
+	std::vector<sample_t *> _inputs;
+	std::vector<sample_t *> _outputs;
+};
+
+
+enum BenchState {
+	StateRecord = 0,
+	StateOverdub,
+	StateMultiply,
+	StatePlay,
+	StateRate,
+	StateStretch,
+	StateDecay,
+	StateCount
+};
+
+static const char * state_names[StateCount] = {
+	"record", "overdub", "multiply", "play", "rate", "stretched", "decay"
+};
+
+struct BenchOptions
+{
+	BenchOptions() : samplerate(48000), seconds(5.0f), loop_secs(2.0f), settle_secs(0.5f), workers(0) {}
+
+	vector<int> loops;
+	vector<int> channels;
+	vector<int> buffersizes;
+	vector<int> states;
+	vector<int> flush; // denormal flush off or on
+	int samplerate;
+	float seconds;
+	float loop_secs;
+	float settle_secs;
+	int workers;
+};
+
+struct BenchResult
+{
+	unsigned long cycles;
+	double ns_per_frame;
+	double mean_cycle_ns;
+	double p99_cycle_ns;
+	double max_cycle_ns;
+	double allocs_per_cycle;
+};
+
+
+static double now_ns ()
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void * mainloop_thread (void * arg)
+{
+	((Engine *) arg)->mainloop ();
+	return 0;
+}
+
+static void hit (Engine * engine, const char * cmd)
+{
+	engine->push_midi_command_event (Event::type_cmd_hit, CommandMap::instance().to_command_t (cmd), -1, 0);
+}
+
+static void set (Engine * engine, const char * ctrl, float val)
+{
+	engine->push_midi_control_event (Event::type_control_change, CommandMap::instance().to_control_t (ctrl), val, -1, 0);
+}
+
+// runs secs worth of periods untimed.  paced ones go at the speed of the
+// audio so the non-rt side gets to make stretchers and caches like live
+static void run_for (Engine * engine, nframes_t nframes, nframes_t samplerate, float secs, bool paced)
+{
+	unsigned long cycles = (unsigned long) (secs * samplerate / nframes) + 1;
+	useconds_t period = (useconds_t) (1e6 * nframes / samplerate);
+
+	for (unsigned long n = 0; n < cycles; ++n) {
+		engine->process (nframes);
+		sl_maintain_memory ();
+		if (paced) {
+			usleep (period);
+		}
+	}
+}
+
+static bool run_bench (const BenchOptions & opts, int loops, int chans, nframes_t nframes, int state, bool flush, BenchResult & result)
+{
+	BenchAudioDriver * driver = new BenchAudioDriver (opts.samplerate, nframes);
+	Engine * engine = new Engine ();
+	pthread_t mainloop;
+	vector<double> times;
+	unsigned long cycles;
+	double total = 0.0;
+	unsigned long allocs;
+
+	// enough memory for anything the state can do to the loop
+	float memsecs = opts.loop_secs + opts.settle_secs + opts.seconds + 2.0f;
+
+	// before the engine, so its worker threads start out right too
+	set_denormal_flush_enabled (flush);
+
+	engine->set_default_loop_secs (memsecs);
+	engine->set_default_channels (chans);
+	engine->set_worker_threads ((unsigned int) opts.workers);
+
+	if (!engine->initialize (driver, 2, 0)) {
+		cerr << "sl-bench: cannot initialize the engine" << endl;
+		delete engine;
+		delete driver;
+		return false;
+	}
+
+	for (int n = 0; n < loops; ++n) {
+		engine->add_loop ((unsigned int) chans, memsecs, true);
+	}
+
+	if (pthread_create (&mainloop, NULL, mainloop_thread, engine) != 0) {
+		cerr << "sl-bench: cannot start the engine's main loop" << endl;
+		delete engine;
+		delete driver;
+		return false;
+	}
+
+	// gets the loops in
+	run_for (engine, nframes, opts.samplerate, 0.1f, false);
+
+	if (state == StateDecay) {
+		// low enough to end up denormal, and nothing new coming in after
+		set (engine, "input_gain", 4e-34f);
+	}
+
+	if (state != StateRecord) {
+		hit (engine, "record");
+		run_for (engine, nframes, opts.samplerate, opts.loop_secs, false);
+		hit (engine, "record");
+		run_for (engine, nframes, opts.samplerate, 0.1f, false);
+	}
+
+	switch (state) {
+	case StateRecord:   hit (engine, "record"); break;
+	case StateOverdub:  hit (engine, "overdub"); break;
+	case StateMultiply: hit (engine, "multiply"); break;
+	case StateRate:     set (engine, "rate", 1.5f); break;
+	case StateStretch:  set (engine, "stretch_ratio", 1.5f); break;
+	case StateDecay:
+		set (engine, "input_gain", 0.0f);
+		set (engine, "feedback", 0.99f);
+		set (engine, "use_feedback_play", 1.0f);
+		break;
+	default: break;
+	}
+
+	run_for (engine, nframes, opts.samplerate, opts.settle_secs, true);
+
+	cycles = (unsigned long) (opts.seconds * opts.samplerate / nframes);
+	if (cycles == 0) {
+		cycles = 1;
+	}
+	times.reserve (cycles);
+	alloc_count = 0;
+
+	for (unsigned long n = 0; n < cycles; ++n) {
+		double start = now_ns ();
+
+		counting_allocs = true;
+		engine->process (nframes);
+		counting_allocs = false;
+
+		double took = now_ns () - start;
+		times.push_back (took);
+		total += took;
+
+		// outside of the timing, what the main loop would keep up with
+		sl_maintain_memory ();
+	}
+
+	allocs = alloc_count;
+
+	engine->quit (true);
+	pthread_join (mainloop, NULL);
+
+	delete engine;
+	delete driver;
+
+	sort (times.begin(), times.end());
+
+	result.cycles = cycles;
+	result.ns_per_frame = total / ((double) cycles * nframes);
+	result.mean_cycle_ns = total / cycles;
+	result.p99_cycle_ns = times[min ((size_t) (0.99 * cycles), times.size() - 1)];
+	result.max_cycle_ns = times.back();
+	result.allocs_per_cycle = (double) allocs / cycles;
+
+	return true;
+}
+
+
+static bool parse_list (const char * arg, vector<int> & list)
+{
+	string str (arg);
+	size_t pos = 0;
+
+	list.clear();
+
+	while (pos <= str.size()) {
+		size_t end = str.find (',', pos);
+		if (end == string::npos) {
+			end = str.size();
+		}
+
+		int val = atoi (str.substr (pos, end - pos).c_str());
+		if (val <= 0) {
+			return false;
+		}
+		list.push_back (val);
+		pos = end + 1;
+	}
+
+	return !list.empty();
+}
+
+static bool parse_states (const char * arg, vector<int> & list)
+{
+	string str (arg);
+	size_t pos = 0;
+
+	list.clear();
+
+	while (pos <= str.size()) {
+		size_t end = str.find (',', pos);
+		if (end == string::npos) {
+			end = str.size();
+		}
+
+		string name = str.substr (pos, end - pos);
+		int state;
+		for (state = 0; state < StateCount; ++state) {
+			if (name == state_names[state]) {
+				break;
+			}
+		}
+		if (state == StateCount) {
+			return false;
+		}
+		list.push_back (state);
+		pos = end + 1;
+	}
+
+	return !list.empty();
+}
+
+static bool parse_flush (const char * arg, vector<int> & list)
+{
+	string str (arg);
+	size_t pos = 0;
+
+	list.clear();
+
+	while (pos <= str.size()) {
+		size_t end = str.find (',', pos);
+		if (end == string::npos) {
+			end = str.size();
+		}
+
+		string name = str.substr (pos, end - pos);
+		if (name == "on") {
+			list.push_back (1);
+		}
+		else if (name == "off") {
+			list.push_back (0);
+		}
+		else {
+			return false;
+		}
+		pos = end + 1;
+	}
+
+	return !list.empty();
+}
+
+static struct option long_options[] = {
+	{ "help", 0, 0, 'h' },
+	{ "loops", 1, 0, 'l' },
+	{ "channels", 1, 0, 'c' },
+	{ "buffersizes", 1, 0, 'b' },
+	{ "states", 1, 0, 's' },
+	{ "samplerate", 1, 0, 'r' },
+	{ "seconds", 1, 0, 't' },
+	{ "loop-seconds", 1, 0, 'L' },
+	{ "worker-threads", 1, 0, 'w' },
+	{ "denormal-flush", 1, 0, 'D' },
+	{ 0, 0, 0, 0 }
+};
+
+static void usage (char * argv0)
+{
+	fprintf(stderr, "Usage: %s [options...]\n", argv0);
+	fprintf(stderr, "Times the engine over every combination of the lists given, printing JSON to stdout\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "  -l <list> , --loops=<list>        loop counts (default 1,4,16)\n");
+	fprintf(stderr, "  -c <list> , --channels=<list>     channels per loop (default 1,2)\n");
+	fprintf(stderr, "  -b <list> , --buffersizes=<list>  period sizes (default 64,256,1024)\n");
+	fprintf(stderr, "  -s <list> , --states=<list>       of record,overdub,multiply,play,rate,stretched,decay\n");
+	fprintf(stderr, "                                    (default all but decay)\n");
+	fprintf(stderr, "  -r <num> , --samplerate=<num>     samplerate (default 48000)\n");
+	fprintf(stderr, "  -t <numsecs> , --seconds=<num>    seconds of audio timed for each (default 5)\n");
+	fprintf(stderr, "  -L <numsecs> , --loop-seconds=<num> length of the loop recorded first (default 2)\n");
+	fprintf(stderr, "  -w <num> , --worker-threads=<num> extra threads to run loops on (default 0).  their\n");
+	fprintf(stderr, "                                    allocations are not counted\n");
+	fprintf(stderr, "  -D <list> , --denormal-flush=<list> of on,off (default on)\n");
+	fprintf(stderr, "  -h , --help                       this usage output\n");
+}
+
+int main (int argc, char ** argv)
+{
+	BenchOptions opts;
+	int c, longopt_index = 0;
+
+	parse_list ("1,4,16", opts.loops);
+	parse_list ("1,2", opts.channels);
+	parse_list ("64,256,1024", opts.buffersizes);
+	parse_states ("record,overdub,multiply,play,rate,stretched", opts.states);
+	parse_flush ("on", opts.flush);
+
+	while ((c = getopt_long (argc, argv, "l:c:b:s:r:t:L:w:D:h", long_options, &longopt_index)) >= 0) {
+		bool ok = true;
+
+		switch (c) {
+		case 'l': ok = parse_list (optarg, opts.loops); break;
+		case 'c': ok = parse_list (optarg, opts.channels); break;
+		case 'b': ok = parse_list (optarg, opts.buffersizes); break;
+		case 's': ok = parse_states (optarg, opts.states); break;
+		case 'r': ok = (opts.samplerate = atoi (optarg)) > 0; break;
+		case 't': ok = (opts.seconds = atof (optarg)) > 0.0f; break;
+		case 'L': ok = (opts.loop_secs = atof (optarg)) > 0.0f; break;
+		case 'w': ok = (opts.workers = atoi (optarg)) >= 0; break;
+		case 'D': ok = parse_flush (optarg, opts.flush); break;
+		default:
+			usage (argv[0]);
+			exit (c == 'h' ? 0 : 1);
+		}
+
+		if (!ok) {
+			cerr << "sl-bench: bad value for -" << (char) c << ": " << optarg << endl;
+			exit (1);
+		}
+	}
+
+	// no stretch may go idle while it is being timed
+	Looper::set_stretch_idle_timeout (0.0f);
+
+	printf ("{\n");
+	printf ("  \"samplerate\": %d,\n", opts.samplerate);
+	printf ("  \"seconds\": %g,\n", opts.seconds);
+	printf ("  \"loop_seconds\": %g,\n", opts.loop_secs);
+	printf ("  \"worker_threads\": %d,\n", opts.workers);
+	printf ("  \"results\": [");
+
+	bool first = true;
+
+	for (size_t b = 0; b < opts.buffersizes.size(); ++b) {
+		for (size_t l = 0; l < opts.loops.size(); ++l) {
+			for (size_t ch = 0; ch < opts.channels.size(); ++ch) {
+				for (size_t s = 0; s < opts.states.size(); ++s) {
+					for (size_t f = 0; f < opts.flush.size(); ++f) {
+						BenchResult res;
+						int state = opts.states[s];
+						bool flush = opts.flush[f];
+
+						cerr << "sl-bench: " << opts.loops[l] << " loops, " << opts.channels[ch] << " channels, "
+						     << opts.buffersizes[b] << " frames, " << state_names[state]
+						     << (flush ? "" : ", no denormal flush") << endl;
+
+						if (!run_bench (opts, opts.loops[l], opts.channels[ch], (nframes_t) opts.buffersizes[b], state, flush, res)) {
+							exit (1);
+						}
+
+						printf ("%s\n    {\"loops\": %d, \"channels\": %d, \"buffersize\": %d, \"state\": \"%s\", "
+							"\"denormal_flush\": %s, "
+							"\"cycles\": %lu, \"ns_per_frame\": %.2f, \"mean_cycle_ns\": %.0f, "
+							"\"p99_cycle_ns\": %.0f, \"max_cycle_ns\": %.0f, ",
+							first ? "" : ",",
+							opts.loops[l], opts.channels[ch], opts.buffersizes[b], state_names[state],
+							flush ? "true" : "false",
+							res.cycles, res.ns_per_frame, res.mean_cycle_ns, res.p99_cycle_ns, res.max_cycle_ns);
+						if (COUNTS_ALLOCS) {
+							printf ("\"allocs_per_cycle\": %.3f}", res.allocs_per_cycle);
+						}
+						else {
+							printf ("\"allocs_per_cycle\": null}");
+						}
+						fflush (stdout);
+						first = false;
+					}
+				}
+			}
+		}
+	}
+
+	printf ("\n  ]\n}\n");
+
+	return 0;
+}
@@ -31,10 +31,12 @@
 
 #include "control_osc.hpp"
 #include "engine.hpp"
+#include "looper.hpp"
 #include "event_nonrt.hpp"
 
 #include "midi_bridge.hpp"
 #include "command_map.hpp"
+#include "plugin.hpp"
 #include <midi++/port_request.h>
 
 // #if WITH_ALSA
@@ -44,6 +46,7 @@
 // #endif
 
 #include "jack_audio_driver.hpp"
+#include "offline_audio_driver.hpp"
 
 using namespace SooperLooper;
 using namespace std;
@@ -62,7 +65,7 @@ Transmitter  error (Transmitter::Error);
 #define DEFAULT_LOOP_TIME 40.0f
 
 
-char *optstring = "c:l:j:p:m:t:U:S:D:L:qVh";
+char *optstring = "c:l:j:p:m:t:U:S:D:L:u:w:T:I:O:E:N:R:B:qVh";
 
 struct option long_options[] = {
 	{ "help", 0, 0, 'h' },
@@ -77,6 +80,15 @@ struct option long_options[] = {
 	{ "jack-server-name", 1, 0, 'S' },
 	{ "load-midi-binding", 1, 0, 'm' },
 	{ "ping-url", 1, 0, 'U' },
+	{ "undo-dir", 1, 0, 'u' },
+	{ "worker-threads", 1, 0, 'w' },
+	{ "stretch-timeout", 1, 0, 'T' },
+	{ "offline-input", 1, 0, 'I' },
+	{ "offline-output", 1, 0, 'O' },
+	{ "offline-timeline", 1, 0, 'E' },
+	{ "offline-length", 1, 0, 'N' },
+	{ "offline-samplerate", 1, 0, 'R' },
+	{ "offline-buffersize", 1, 0, 'B' },
 	{ "version", 0, 0, 'V' },
 	{ 0, 0, 0, 0 }
 };
@@ -87,7 +99,8 @@ struct OptionInfo
 	OptionInfo() :
 		loop_count(1), channels(2), quiet(false), jack_name(""),
 		oscport(DEFAULT_OSC_PORT), loopsecs(DEFAULT_LOOP_TIME), discrete_io(true),
-		show_usage(0), show_version(0), pingurl() {} 
+		worker_threads(0), stretch_timeout(30.0f), offline(false), offline_secs(0.0f),
+		offline_rate(48000), offline_bufsize(256), show_usage(0), show_version(0), pingurl() {} 
 		
 	int loop_count;
 	int channels;
@@ -98,11 +111,22 @@ struct OptionInfo
 	string bindfile;
 	float loopsecs;
 	bool  discrete_io;
+	int worker_threads;
+	float stretch_timeout;
+
+	bool offline;
+	string offline_input;
+	string offline_output;
+	string offline_timeline;
+	float offline_secs;
+	int offline_rate;
+	int offline_bufsize;
 	
 	int show_usage;
 	int show_version;
 	string pingurl;
 	string loadsession;
+	string undodir;
 };
 
 
@@ -123,6 +147,15 @@ static void usage(char *argv0)
 	fprintf(stderr, "  -j <str> , --jack-name=<str> jack client name, default is sooperlooper\n");
 	fprintf(stderr, "  -S <str> , --jack-server-name=<str> specify jack server name\n");
 	fprintf(stderr, "  -m <str> , --load-midi-binding=<str> loads midi binding from file or preset\n");
+	fprintf(stderr, "  -u <dir> , --undo-dir=<dir>  keep older undo history in a file in dir instead of memory\n");
+	fprintf(stderr, "  -w <num> , --worker-threads=<num> extra realtime threads to run loops on, one per cpu (default 0)\n");
+	fprintf(stderr, "  -T <numsecs> , --stretch-timeout=<num> free a loop's time stretcher after this long unused, 0 never (default 30)\n");
+	fprintf(stderr, "  -I <file> , --offline-input=<file> run offline without jack, feeding the inputs from a sound file\n");
+	fprintf(stderr, "  -O <dir> , --offline-output=<dir> run offline, writing every output port to a wav file in dir\n");
+	fprintf(stderr, "  -E <file> , --offline-timeline=<file> run offline, playing the osc style commands in file into it\n");
+	fprintf(stderr, "  -N <numsecs> , --offline-length=<num> seconds to render offline (default to the end of input and timeline)\n");
+	fprintf(stderr, "  -R <num> , --offline-samplerate=<num> samplerate when offline (default 48000)\n");
+	fprintf(stderr, "  -B <num> , --offline-buffersize=<num> frames per period when offline (default 256)\n");
 	fprintf(stderr, "  -q , --quiet                 do not output status to stderr\n");
 	fprintf(stderr, "  -h , --help                  this usage output\n");
 	fprintf(stderr, "  -V , --version               show version only\n");
@@ -183,6 +216,37 @@ static void parse_options (int argc, char **argv, OptionInfo & option_info)
 		case 'L':
 			option_info.loadsession = optarg;
 			break;
+		case 'u':
+			option_info.undodir = optarg;
+			break;
+		case 'w':
+			option_info.worker_threads = atoi(optarg);
+			break;
+		case 'T':
+			sscanf(optarg, "%f", &option_info.stretch_timeout);
+			break;
+		case 'I':
+			option_info.offline_input = optarg;
+			option_info.offline = true;
+			break;
+		case 'O':
+			option_info.offline_output = optarg;
+			option_info.offline = true;
+			break;
+		case 'E':
+			option_info.offline_timeline = optarg;
+			option_info.offline = true;
+			break;
+		case 'N':
+			sscanf(optarg, "%f", &option_info.offline_secs);
+			option_info.offline = true;
+			break;
+		case 'R':
+			option_info.offline_rate = atoi(optarg);
+			break;
+		case 'B':
+			option_info.offline_bufsize = atoi(optarg);
+			break;
 		default:
 			fprintf (stderr, "argument error: %d\n", c);
 			option_info.show_usage++;
@@ -292,6 +356,15 @@ int main(int argc, char** argv)
 	if (option_info.loopsecs <= 0.0f) {
 		option_info.loopsecs = DEFAULT_LOOP_TIME;
 	}
+	if (option_info.worker_threads < 0) {
+		option_info.worker_threads = 0;
+	}
+	if (option_info.offline_rate <= 0) {
+		option_info.offline_rate = 48000;
+	}
+	if (option_info.offline_bufsize <= 0) {
+		option_info.offline_bufsize = 256;
+	}
 	
 	
 	if (option_info.show_usage) {
@@ -311,15 +384,34 @@ int main(int argc, char** argv)
 
 	//sl_init ();
 
+	// before any loopers get made
+	sl_set_undo_spill_dir (option_info.undodir.c_str());
+	Looper::set_stretch_idle_timeout (option_info.stretch_timeout);
+
 	// create audio driver
 	// todo: a factory
-	AudioDriver * driver = new JackAudioDriver(option_info.jack_name, option_info.jack_server_name);
+	AudioDriver * driver;
+
+	if (option_info.offline) {
+		OfflineAudioDriver * offline = new OfflineAudioDriver(option_info.jack_name.empty() ? "sooperlooper" : option_info.jack_name,
+								      (nframes_t) option_info.offline_rate,
+								      (nframes_t) option_info.offline_bufsize);
+		offline->set_input_file (option_info.offline_input);
+		offline->set_output_dir (option_info.offline_output);
+		offline->set_timeline_file (option_info.offline_timeline);
+		offline->set_length (option_info.offline_secs);
+		driver = offline;
+	}
+	else {
+		driver = new JackAudioDriver(option_info.jack_name, option_info.jack_server_name);
+	}
 	
 	
 	engine = new Engine();
 
 	engine->set_default_loop_secs (option_info.loopsecs);
 	engine->set_default_channels (option_info.channels);
+	engine->set_worker_threads ((unsigned int) option_info.worker_threads);
 	
 	if (!engine->initialize(driver, 2, option_info.oscport, option_info.pingurl)) {
 		cerr << "cannot initialize sooperlooper\n";
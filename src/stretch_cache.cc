@@ -0,0 +1,337 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <rubberband/RubberBandStretcher.h>
+
+#include "stretch_cache.hpp"
+
+using namespace SooperLooper;
+using namespace RubberBand;
+using namespace std;
+
+// frames handed to rubberband at a time
+#define RENDER_BLOCK 4096
+
+// most seconds of the loop put on either side of it, so that the
+// rendered loop wraps around without a seam
+#define WRAP_SECS 2
+
+StretchRenderer::StretchRenderer ()
+	: _have_thread (false), _quit (false),
+	  _current_owner (0), _current_forgotten (false)
+{
+	pthread_mutex_init (&_lock, NULL);
+	pthread_cond_init (&_cond, NULL);
+	pthread_cond_init (&_idle_cond, NULL);
+
+	if (pthread_create (&_thread, NULL, &StretchRenderer::thread_entry, this) == 0) {
+		_have_thread = true;
+	}
+	else {
+		fprintf (stderr, "sooperlooper: cannot start stretch render thread\n");
+	}
+}
+
+StretchRenderer::~StretchRenderer ()
+{
+	pthread_mutex_lock (&_lock);
+	_quit = true;
+	pthread_cond_signal (&_cond);
+	pthread_mutex_unlock (&_lock);
+
+	if (_have_thread) {
+		pthread_join (_thread, NULL);
+	}
+
+	for (list<Job>::iterator i = _jobs.begin(); i != _jobs.end(); ++i) {
+		destroy (i->cache);
+		delete [] i->audio;
+	}
+	for (list<StretchCache *>::iterator i = _finished.begin(); i != _finished.end(); ++i) {
+		destroy (*i);
+	}
+
+	pthread_cond_destroy (&_cond);
+	pthread_cond_destroy (&_idle_cond);
+	pthread_mutex_destroy (&_lock);
+}
+
+void
+StretchRenderer::destroy (StretchCache * cache)
+{
+	if (cache) {
+		delete [] cache->data;
+		delete cache;
+	}
+}
+
+void
+StretchRenderer::render (void * owner, unsigned long key, double ratio, double pitch, nframes_t samplerate,
+			 unsigned int channels, float * audio, nframes_t frames)
+{
+	Job job;
+
+	if (!_have_thread) {
+		delete [] audio;
+		return;
+	}
+
+	job.cache = new StretchCache;
+	job.cache->owner = owner;
+	job.cache->key = key;
+	job.cache->ratio = ratio;
+	job.cache->pitch = pitch;
+	job.cache->channels = channels;
+	job.cache->length = 0;
+	job.cache->data = 0;
+	job.audio = audio;
+	job.frames = frames;
+	job.samplerate = samplerate;
+
+	pthread_mutex_lock (&_lock);
+
+	// only the newest version of a loop is worth rendering
+	for (list<Job>::iterator i = _jobs.begin(); i != _jobs.end(); ) {
+		if (i->cache->owner == owner) {
+			destroy (i->cache);
+			delete [] i->audio;
+			i = _jobs.erase (i);
+		}
+		else {
+			++i;
+		}
+	}
+
+	_jobs.push_back (job);
+	pthread_cond_signal (&_cond);
+
+	pthread_mutex_unlock (&_lock);
+}
+
+StretchCache *
+StretchRenderer::take_finished ()
+{
+	StretchCache * cache = 0;
+
+	pthread_mutex_lock (&_lock);
+
+	if (!_finished.empty()) {
+		cache = _finished.front();
+		_finished.pop_front();
+	}
+
+	pthread_mutex_unlock (&_lock);
+
+	return cache;
+}
+
+void
+StretchRenderer::forget (void * owner)
+{
+	pthread_mutex_lock (&_lock);
+
+	for (list<Job>::iterator i = _jobs.begin(); i != _jobs.end(); ) {
+		if (i->cache->owner == owner) {
+			destroy (i->cache);
+			delete [] i->audio;
+			i = _jobs.erase (i);
+		}
+		else {
+			++i;
+		}
+	}
+
+	for (list<StretchCache *>::iterator i = _finished.begin(); i != _finished.end(); ) {
+		if ((*i)->owner == owner) {
+			destroy (*i);
+			i = _finished.erase (i);
+		}
+		else {
+			++i;
+		}
+	}
+
+	if (_current_owner == owner) {
+		_current_forgotten = true;
+	}
+
+	if (_jobs.empty() && !_current_owner) {
+		pthread_cond_broadcast (&_idle_cond);
+	}
+
+	pthread_mutex_unlock (&_lock);
+}
+
+void
+StretchRenderer::wait_idle ()
+{
+	if (!_have_thread) {
+		return;
+	}
+
+	pthread_mutex_lock (&_lock);
+
+	while (!_quit && (!_jobs.empty() || _current_owner)) {
+		pthread_cond_wait (&_idle_cond, &_lock);
+	}
+
+	pthread_mutex_unlock (&_lock);
+}
+
+void *
+StretchRenderer::thread_entry (void * arg)
+{
+	((StretchRenderer *) arg)->thread_main ();
+	return 0;
+}
+
+void
+StretchRenderer::thread_main ()
+{
+	Job job;
+
+	pthread_mutex_lock (&_lock);
+
+	while (!_quit) {
+		if (_jobs.empty()) {
+			pthread_cond_wait (&_cond, &_lock);
+			continue;
+		}
+
+		job = _jobs.front();
+		_jobs.pop_front();
+		_current_owner = job.cache->owner;
+		_current_forgotten = false;
+
+		pthread_mutex_unlock (&_lock);
+
+		render_job (job);
+		delete [] job.audio;
+
+		pthread_mutex_lock (&_lock);
+
+		if (_current_forgotten || !job.cache->data) {
+			destroy (job.cache);
+		}
+		else {
+			_finished.push_back (job.cache);
+		}
+		_current_owner = 0;
+
+		if (_jobs.empty()) {
+			pthread_cond_broadcast (&_idle_cond);
+		}
+	}
+
+	pthread_mutex_unlock (&_lock);
+}
+
+void
+StretchRenderer::render_job (Job & job)
+{
+	StretchCache * cache = job.cache;
+	unsigned int chans = cache->channels;
+	nframes_t frames = job.frames;
+	nframes_t pad, inlen, outstart, outlen, got, pos, span;
+	float * inbuf, * outbuf;
+	float * inptrs[chans];
+	float * outptrs[chans];
+	size_t outsize, avail;
+
+	if (frames == 0 || chans == 0) {
+		return;
+	}
+
+	// the loop with a wrap of itself on either side
+	pad = min (frames, (nframes_t) (WRAP_SECS * job.samplerate));
+	inlen = pad + frames + pad;
+
+	inbuf = new float[inlen * chans];
+	for (unsigned int c = 0; c < chans; ++c) {
+		float * src = job.audio + c * frames;
+		float * dst = inbuf + c * inlen;
+
+		memcpy (dst, src + frames - pad, pad * sizeof(float));
+		memcpy (dst + pad, src, frames * sizeof(float));
+		memcpy (dst + pad + frames, src, pad * sizeof(float));
+	}
+
+	outsize = (size_t) ceil (inlen * cache->ratio) + RENDER_BLOCK;
+	outbuf = new float[outsize * chans];
+	memset (outbuf, 0, outsize * chans * sizeof(float));
+
+	RubberBandStretcher stretcher (job.samplerate, chans,
+				       RubberBandStretcher::OptionProcessOffline | RubberBandStretcher::OptionTransientsCrisp,
+				       cache->ratio, pow (2.0, cache->pitch / 12.0));
+
+	stretcher.setExpectedInputDuration (inlen);
+	stretcher.setMaxProcessSize (RENDER_BLOCK);
+
+	for (pos = 0; pos < inlen; pos += span) {
+		span = min ((nframes_t) RENDER_BLOCK, inlen - pos);
+		for (unsigned int c = 0; c < chans; ++c) {
+			inptrs[c] = inbuf + c * inlen + pos;
+		}
+		stretcher.study (inptrs, span, pos + span >= inlen);
+	}
+
+	got = 0;
+	for (pos = 0; pos < inlen; pos += span) {
+		span = min ((nframes_t) RENDER_BLOCK, inlen - pos);
+		for (unsigned int c = 0; c < chans; ++c) {
+			inptrs[c] = inbuf + c * inlen + pos;
+		}
+		stretcher.process (inptrs, span, pos + span >= inlen);
+
+		while ((avail = (size_t) max (stretcher.available(), 0)) > 0 && got < outsize) {
+			avail = min (avail, outsize - got);
+			for (unsigned int c = 0; c < chans; ++c) {
+				outptrs[c] = outbuf + c * outsize + got;
+			}
+			got += stretcher.retrieve (outptrs, avail);
+		}
+	}
+
+	delete [] inbuf;
+
+	// cut the stretched loop back out of the middle
+	outstart = (nframes_t) lrint (pad * cache->ratio);
+	outlen = (nframes_t) lrint (frames * cache->ratio);
+	if (outlen == 0) {
+		delete [] outbuf;
+		return;
+	}
+
+	cache->length = outlen;
+	cache->data = new float[outlen * chans];
+	for (unsigned int c = 0; c < chans; ++c) {
+		float * dst = cache->data + c * outlen;
+
+		for (nframes_t n = 0; n < outlen; ++n) {
+			dst[n] = (outstart + n < got) ? outbuf[c * outsize + outstart + n] : 0.0f;
+		}
+	}
+
+	delete [] outbuf;
+}
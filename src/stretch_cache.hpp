@@ -0,0 +1,104 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#ifndef __sooperlooper_stretch_cache_h__
+#define __sooperlooper_stretch_cache_h__
+
+#include <list>
+#include <pthread.h>
+
+#include "audio_driver.hpp"
+
+namespace SooperLooper {
+
+/*
+ * A loop that has already been stretched and pitch shifted as a whole,
+ * for as long as it stays the way it was when it was read.  key is what
+ * sl_get_static_loop_key() said at the time.  The audio is planar, the
+ * channel n starting at data + n * length.
+ */
+struct StretchCache
+{
+	void *        owner;
+	unsigned long key;
+	double        ratio;
+	double        pitch; // in semitones
+	unsigned int  channels;
+	nframes_t     length;
+	float *       data;
+};
+
+/*
+ * Renders stretch caches with rubberband's offline mode on a thread of
+ * its own, since a long loop can take seconds.  Nothing here may be
+ * called from the audio thread.
+ */
+class StretchRenderer
+{
+  public:
+	StretchRenderer ();
+	~StretchRenderer ();
+
+	// queues the rendering of frames of planar audio, which the renderer
+	// takes over.  an older job of the same owner still waiting is dropped
+	void render (void * owner, unsigned long key, double ratio, double pitch, nframes_t samplerate,
+		     unsigned int channels, float * audio, nframes_t frames);
+
+	// a finished cache, or 0 if there is none
+	StretchCache * take_finished ();
+
+	// drops everything of owner, waiting or finished, for when it goes away
+	void forget (void * owner);
+
+	// waits until nothing is left waiting or being rendered
+	void wait_idle ();
+
+	static void destroy (StretchCache * cache);
+
+  private:
+	struct Job
+	{
+		StretchCache * cache;
+		float *        audio;
+		nframes_t      frames;
+		nframes_t      samplerate;
+	};
+
+	static void * thread_entry (void * arg);
+	void thread_main ();
+	void render_job (Job & job);
+
+	pthread_t            _thread;
+	bool                 _have_thread;
+
+	pthread_mutex_t      _lock;
+	pthread_cond_t       _cond;
+	pthread_cond_t       _idle_cond;
+	bool                 _quit;
+
+	std::list<Job>            _jobs;
+	std::list<StretchCache *> _finished;
+	// owner of the job being rendered, and whether it was forgotten since
+	void *               _current_owner;
+	bool                 _current_forgotten;
+};
+
+};
+
+#endif
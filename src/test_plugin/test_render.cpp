@@ -0,0 +1,157 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**  
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**  
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**  
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**  
+*/
+
+#include "test_render.hpp"
+
+#include <cstring>
+
+using namespace std;
+using namespace SooperLooper;
+
+extern void sl_init ();
+extern	const LADSPA_Descriptor* ladspa_descriptor (unsigned long);
+
+
+const LADSPA_Descriptor* TestRender::descriptor = 0;
+
+
+TestRender::TestRender (unsigned int chan_count, unsigned long block_size)
+	: _chan_count(chan_count), _block_size(block_size)
+{
+	ok = false;
+	_frame = 0;
+	_noise = 1;
+	_zeros_from = 0;
+	_zeros_to = 0;
+
+	if (!descriptor) {
+		sl_init();
+		descriptor = ladspa_descriptor (0);
+	}
+
+	memset (ports, 0, sizeof(ports));
+
+	// the same defaults as TestLooper, but no dry signal
+	ports[DryLevel] = 0.0f;
+	ports[WetLevel] = 1.0f;
+	ports[Feedback] = 1.0f;
+	ports[Rate] = 1.0f;
+	ports[Multi] = -1.0f;
+	ports[FadeSamples] = 64.0f;
+	ports[TempoInput] = 120.0f;
+	ports[EighthPerCycleLoop] = 8.0f;
+
+	if ((_instance = sl_instantiate (descriptor, 48000, _chan_count)) == 0) {
+		return;
+	}
+
+	_sync_in.resize (_block_size, 0.0f);
+	_sync_out.resize (_block_size, 0.0f);
+	_in.resize (_chan_count, vector<LADSPA_Data> (_block_size, 0.0f));
+	_out.resize (_chan_count, vector<LADSPA_Data> (_block_size, 0.0f));
+
+	for (unsigned long n = 0; n < LASTPORT; ++n) {
+		descriptor->connect_port (_instance, n, &ports[n]);
+	}
+	for (unsigned int i = 0; i < _chan_count; ++i) {
+		sl_connect_audio_port (_instance, AudioInputPort, i, &_in[i][0]);
+		sl_connect_audio_port (_instance, AudioOutputPort, i, &_out[i][0]);
+	}
+	descriptor->connect_port (_instance, SyncInputPort, &_sync_in[0]);
+	descriptor->connect_port (_instance, SyncOutputPort, &_sync_out[0]);
+
+	descriptor->activate (_instance);
+
+	ok = true;
+}
+
+TestRender::~TestRender ()
+{
+	if (_instance) {
+		descriptor->cleanup (_instance);
+	}
+}
+
+void
+TestRender::request_cmd_at (unsigned long frame, int cmd)
+{
+	_cmd_frames.push_back (frame);
+	_cmds.push_back (cmd);
+}
+
+void
+TestRender::set_negative_zeros (unsigned long from, unsigned long to)
+{
+	_zeros_from = from;
+	_zeros_to = to;
+}
+
+vector<float>
+TestRender::render (unsigned long frames, unsigned int paths)
+{
+	vector<float> result (frames * _chan_count);
+	unsigned long done = 0;
+
+	if (!ok) {
+		return result;
+	}
+
+	sl_set_block_paths (paths);
+
+	while (done < frames) {
+		unsigned long nframes = min (_block_size, frames - done);
+
+		ports[Multi] = -1.0f;
+		for (size_t n = 0; n < _cmds.size(); ++n) {
+			if (_cmd_frames[n] >= _frame && _cmd_frames[n] < _frame + nframes) {
+				ports[Multi] = _cmds[n];
+			}
+		}
+
+		for (unsigned long f = 0; f < nframes; ++f) {
+			unsigned long frame = _frame + f;
+
+			for (unsigned int i = 0; i < _chan_count; ++i) {
+				_noise = _noise * 1103515245U + 12345U;
+				if (frame >= _zeros_from && frame < _zeros_to) {
+					_in[i][f] = -0.0f;
+				}
+				else {
+					_in[i][f] = ((_noise >> 8) & 0xffff) / 65536.0f - 0.5f;
+				}
+			}
+		}
+
+		// between the blocks, like the engine when it services the loops
+		sl_maintain_memory ();
+
+		descriptor->run (_instance, nframes);
+
+		for (unsigned int i = 0; i < _chan_count; ++i) {
+			memcpy (&result[i * frames + done], &_out[i][0], nframes * sizeof(float));
+		}
+
+		done += nframes;
+		_frame += nframes;
+	}
+
+	sl_set_block_paths (PathAll);
+
+	return result;
+}
@@ -0,0 +1,78 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**  
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**  
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**  
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**  
+*/
+
+#ifndef __sooperlooper_test_render__
+#define __sooperlooper_test_render__
+
+#include <vector>
+#include "ladspa.h"
+#include "../plugin.hpp"
+
+namespace SooperLooper {
+
+// runs plugin.cc without jack, one block after the other, on a fixed
+// noise input, so that what it renders can be compared sample by sample
+class TestRender 
+{
+  public:
+	TestRender (unsigned int channel_count=1, unsigned long block_size=64);
+	~TestRender ();
+
+	void set_port (int n, float val) {
+		ports[n] = val;
+	}
+
+	// cmd is given to the block that starts at frame
+	void request_cmd_at (unsigned long frame, int cmd);
+
+	// input frames from..to are negative zeros instead of noise
+	void set_negative_zeros (unsigned long from, unsigned long to);
+
+	// renders frames more frames, the block paths of all instances set to
+	// paths while it runs.  returns them channel after channel
+	std::vector<float> render (unsigned long frames, unsigned int paths=PathAll);
+
+	bool ok;
+
+  protected:
+
+	unsigned int _chan_count;
+	unsigned long _block_size;
+	unsigned long _frame;
+	unsigned int _noise;
+	LADSPA_Handle _instance;
+
+	static const LADSPA_Descriptor* descriptor;
+
+	LADSPA_Data        ports[LASTPORT];
+
+	std::vector<unsigned long> _cmd_frames;
+	std::vector<int> _cmds;
+	unsigned long _zeros_from;
+	unsigned long _zeros_to;
+
+	std::vector<LADSPA_Data> _sync_in;
+	std::vector<LADSPA_Data> _sync_out;
+	std::vector< std::vector<LADSPA_Data> > _in;
+	std::vector< std::vector<LADSPA_Data> > _out;
+};
+
+};
+
+#endif
@@ -0,0 +1,31 @@
+import time
+import testdef_simple_state
+import test_engine
+
+class quantizedStateTests(testdef_simple_state.simpleStateTest):
+    def setUp(self):
+        testdef_simple_state.simpleStateTest.setUp(self)
+        self.engine.looper.set_port(test_engine.Quantize, 1) # cycle
+        self.engine.request("RECORD")
+        # long enough that no cycle boundary falls between the requests below
+        time.sleep(0.2)
+        self.engine.request("RECORD")
+        self.engine.request("ONESHOT")
+
+    def testOneShot(self):
+        time.sleep(0.001)
+        self.assertState("OneShot")
+
+    def testSubstituteTrigger(self):
+        # the trigger writes a sync point, where the waiting substitute starts
+        self.engine.request("SUBSTITUTE")
+        self.engine.request("TRIGGER")
+        time.sleep(0.001)
+        self.assertState("Substitute")
+
+    def testMultiplyMute(self):
+        # same for mute and a waiting multiply
+        self.engine.request("MULTIPLY")
+        self.engine.request("MUTE")
+        time.sleep(0.001)
+        self.assertState("Multiplying")
@@ -0,0 +1,30 @@
+import struct
+import unittest
+
+import test_engine
+import engine_wrapper
+
+
+class renderTest(unittest.TestCase):
+    """renders the same script with and without some of the block paths
+    and compares the output sample by sample"""
+
+    def render(self, paths, frames, commands, ports={}, zeros=None, channels=1):
+        render = test_engine.TestRender(channels)
+        self.assertTrue(render.ok)
+        for port, val in ports.items():
+            render.set_port(port, val)
+        for frame, command in commands:
+            render.request_cmd_at(frame, engine_wrapper.commands.index(command))
+        if zeros:
+            render.set_negative_zeros(zeros[0], zeros[1])
+        return list(render.render(frames, paths))
+
+    def assertSameRender(self, paths, frames, commands, **kwargs):
+        blocks = self.render(test_engine.PathAll, frames, commands, **kwargs)
+        samples = self.render(test_engine.PathAll & ~paths, frames, commands, **kwargs)
+        # as bytes, so that -0.0 and 0.0 are told apart
+        for n in range(len(samples)):
+            if struct.pack("f", blocks[n]) != struct.pack("f", samples[n]):
+                self.fail("first difference at %d: %r != %r" % (n, blocks[n], samples[n]))
+        self.assertNotEqual(sum(abs(s) for s in samples), 0.0, "silent render")
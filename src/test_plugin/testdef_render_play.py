@@ -0,0 +1,33 @@
+import test_engine
+import testdef_render
+
+
+class renderPlayTests(testdef_render.renderTest):
+    """play segments against the sample by sample play path"""
+
+    # the input is negative zeros while recording, which the record
+    # position keeps as long as nothing positive is mixed into it
+    script = [(0, "RECORD"), (12000, "RECORD")]
+
+    def testPlay(self):
+        self.assertSameRender(test_engine.PathPlaySegments, 40000, self.script,
+                              zeros=(0, 8000))
+
+    def testLatency(self):
+        self.assertSameRender(test_engine.PathPlaySegments, 40000, self.script,
+                              zeros=(0, 8000),
+                              ports={test_engine.InputLatency: 100, test_engine.OutputLatency: 100})
+
+    def testFeedbackReverseMute(self):
+        self.assertSameRender(test_engine.PathPlaySegments, 40000,
+                              self.script + [(20000, "REVERSE"), (30000, "MUTE"), (33000, "MUTE")],
+                              zeros=(0, 8000),
+                              ports={test_engine.UseFeedbackPlay: 1, test_engine.Feedback: 0.9,
+                                     test_engine.Quantize: 1,
+                                     test_engine.InputLatency: 100, test_engine.OutputLatency: 100})
+
+    def testStereo(self):
+        self.assertSameRender(test_engine.PathPlaySegments, 40000,
+                              self.script + [(20000, "REVERSE")],
+                              zeros=(0, 8000), channels=2,
+                              ports={test_engine.DryLevel: 0.5})
@@ -0,0 +1,36 @@
+import test_engine
+import testdef_render
+
+
+class reverseFillTests(testdef_render.renderTest):
+    """the block fill of new loops against the sample by sample fill,
+    with playback turning around while a fill is still pending"""
+
+    def testReverseInsertMute(self):
+        # reversing ends the record and leaves the fill of the new loop
+        # pending in the other direction
+        self.assertSameRender(test_engine.PathFillAhead, 17000,
+                              [(128, "RECORD"), (3456, "RECORD"), (5248, "REVERSE"),
+                               (6464, "INSERT"), (8320, "MUTE"), (9280, "RECORD"),
+                               (11008, "REVERSE")])
+
+    def testInsertMultiply(self):
+        self.assertSameRender(test_engine.PathFillAhead, 17000,
+                              [(128, "RECORD"), (3392, "RECORD"), (3648, "INSERT"),
+                               (4864, "INSERT"), (7232, "MULTIPLY"), (9536, "MUTE")])
+
+    def testOverdubAfterInsert(self):
+        # the overdub starts with the record position on the play
+        # position, fading into the source the fill reads from
+        self.assertSameRender(test_engine.PathFillAhead, 16000,
+                              [(128, "RECORD"), (2624, "RECORD"), (4032, "RECORD"),
+                               (5504, "INSERT"), (6080, "OVERDUB"), (6848, "REVERSE")],
+                              ports={test_engine.Quantize: 3, test_engine.Feedback: 0})
+
+    def testOverdubReverseLatency(self):
+        self.assertSameRender(test_engine.PathFillAhead, 30000,
+                              [(128, "RECORD"), (6000, "RECORD"), (8000, "OVERDUB"),
+                               (9000, "OVERDUB"), (10000, "REVERSE"), (15000, "OVERDUB"),
+                               (17000, "REVERSE"), (19000, "OVERDUB")],
+                              ports={test_engine.Feedback: 0.9,
+                                     test_engine.InputLatency: 100, test_engine.OutputLatency: 100})
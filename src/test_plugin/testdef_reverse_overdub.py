@@ -0,0 +1,37 @@
+import test_engine
+import testdef_render
+
+
+class reverseOverdubTests(testdef_render.renderTest):
+    """overdubs that start out with the pages of their source against
+    ones that copy them in, with the first pass cut short"""
+
+    def testOverdubReverse(self):
+        # the fill is left pending behind the reversal
+        self.assertSameRender(test_engine.PathSharePages, 20000,
+                              [(128, "RECORD"), (6000, "RECORD"), (8000, "OVERDUB"),
+                               (9000, "REVERSE"), (12000, "OVERDUB")])
+
+    def testOverdubReverseLatency(self):
+        self.assertSameRender(test_engine.PathSharePages, 30000,
+                              [(128, "RECORD"), (6000, "RECORD"), (8000, "OVERDUB"),
+                               (9000, "OVERDUB"), (10000, "REVERSE"), (15000, "OVERDUB")],
+                              ports={test_engine.InputLatency: 100, test_engine.OutputLatency: 100})
+
+    def testOverdubUndoRedo(self):
+        # the generation is undone before it was filled, and comes back
+        self.assertSameRender(test_engine.PathSharePages, 20000,
+                              [(128, "RECORD"), (6000, "RECORD"), (8000, "OVERDUB"),
+                               (9000, "UNDO"), (11000, "REDO")])
+
+    def testOverdubMultiply(self):
+        self.assertSameRender(test_engine.PathSharePages, 30000,
+                              [(128, "RECORD"), (6000, "RECORD"), (8000, "OVERDUB"),
+                               (9500, "MULTIPLY"), (13000, "MULTIPLY")],
+                              ports={test_engine.InputLatency: 37, test_engine.OutputLatency: 37,
+                                     test_engine.UseFeedbackPlay: 1, test_engine.Quantize: 3})
+
+    def testOverdubInsert(self):
+        self.assertSameRender(test_engine.PathSharePages, 20000,
+                              [(128, "RECORD"), (6000, "RECORD"), (8000, "OVERDUB"),
+                               (9000, "INSERT"), (11000, "INSERT")])
@@ -0,0 +1,241 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include "undo_spill.hpp"
+#include "page_pool.hpp"
+
+using namespace SooperLooper;
+using namespace std;
+
+// slots the file grows by at a time, each mapped on its own
+#define SEGMENT_SLOTS 64
+
+// requests in flight between the audio thread and maintain()
+#define QUEUE_SIZE 1024
+
+// guards the list of files, never taken by the audio thread
+static pthread_mutex_t spill_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static UndoSpill * spill_list = 0;
+
+string UndoSpill::_directory;
+
+void
+UndoSpill::set_directory (const char * dir)
+{
+	_directory = dir ? dir : "";
+}
+
+bool
+UndoSpill::enabled ()
+{
+	return !_directory.empty();
+}
+
+UndoSpill::UndoSpill (PagePool * pool, int fd)
+	: _pool (pool), _fd (fd), _slot_count (0), _next (0)
+{
+	_slot_bytes = (unsigned long) PagePool::PageFrames * pool->channel_count() * sizeof(LADSPA_Data);
+	_segment_bytes = _slot_bytes * SEGMENT_SLOTS;
+
+	_requests = new RingBuffer<Request> (QUEUE_SIZE);
+	_replies = new RingBuffer<Request> (QUEUE_SIZE);
+}
+
+UndoSpill::~UndoSpill ()
+{
+	for (size_t n = 0; n < _segments.size(); ++n) {
+		munmap (_segments[n], _segment_bytes);
+	}
+	close (_fd);
+
+	delete _requests;
+	delete _replies;
+}
+
+UndoSpill *
+UndoSpill::create (PagePool * pool)
+{
+	UndoSpill * spill;
+	string path;
+	char * tmpl;
+	int fd;
+
+	if (!enabled() || !pool) {
+		return 0;
+	}
+
+	path = _directory + "/sooperlooper-undo-XXXXXX";
+	tmpl = strdup (path.c_str());
+	if (!tmpl) {
+		return 0;
+	}
+
+	fd = mkstemp (tmpl);
+	if (fd < 0) {
+		fprintf (stderr, "sooperlooper: cannot make undo file in %s: %s\n", _directory.c_str(), strerror (errno));
+		free (tmpl);
+		return 0;
+	}
+
+	// only our descriptor keeps it around
+	unlink (tmpl);
+	free (tmpl);
+
+	spill = new UndoSpill (pool, fd);
+
+	pthread_mutex_lock (&spill_list_lock);
+	spill->_next = spill_list;
+	spill_list = spill;
+	pthread_mutex_unlock (&spill_list_lock);
+
+	return spill;
+}
+
+void
+UndoSpill::destroy (UndoSpill * spill)
+{
+	UndoSpill ** prev;
+
+	if (!spill) return;
+
+	pthread_mutex_lock (&spill_list_lock);
+
+	for (prev = &spill_list; *prev; prev = &(*prev)->_next) {
+		if (*prev == spill) {
+			*prev = spill->_next;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock (&spill_list_lock);
+
+	delete spill;
+}
+
+void
+UndoSpill::finish ()
+{
+	pthread_mutex_lock (&spill_list_lock);
+	service ();
+	pthread_mutex_unlock (&spill_list_lock);
+}
+
+void
+UndoSpill::maintain ()
+{
+	pthread_mutex_lock (&spill_list_lock);
+
+	for (UndoSpill * spill = spill_list; spill; spill = spill->_next) {
+		spill->service ();
+	}
+
+	pthread_mutex_unlock (&spill_list_lock);
+}
+
+bool
+UndoSpill::send (const Request & req)
+{
+	return _requests->write ((Request *) &req, 1) == 1;
+}
+
+bool
+UndoSpill::receive (Request & req)
+{
+	return _replies->read (&req, 1) == 1;
+}
+
+// called with the list lock held
+void
+UndoSpill::service ()
+{
+	Request req;
+	LADSPA_Data * data;
+	unsigned int slot;
+
+	// every request but a forget is answered, so stop before the answers have nowhere to go
+	while (_replies->write_space() > 0 && _requests->read (&req, 1) == 1) {
+
+		switch (req.op) {
+		case Evict:
+			slot = _free_slots.empty() ? _slot_count : _free_slots.back();
+			data = slot_data (slot);
+			req.ok = (data != 0);
+			if (req.ok) {
+				memcpy (data, _pool->page_data (req.page), _slot_bytes);
+				req.slot = slot;
+				if (slot == _slot_count) {
+					_slot_count++;
+				} else {
+					_free_slots.pop_back();
+				}
+			}
+			_replies->write (&req, 1);
+			break;
+
+		case Restore:
+			data = slot_data (req.slot);
+			req.ok = (data != 0);
+			if (req.ok) {
+				memcpy (_pool->page_data (req.page), data, _slot_bytes);
+			}
+			_replies->write (&req, 1);
+			break;
+
+		case Forget:
+			_free_slots.push_back (req.slot);
+			break;
+		}
+	}
+}
+
+// the memory of a slot, growing the file to hold it.  0 if it can't
+LADSPA_Data *
+UndoSpill::slot_data (unsigned int slot)
+{
+	size_t seg = slot / SEGMENT_SLOTS;
+
+	while (seg >= _segments.size()) {
+		off_t offset = (off_t) _segments.size() * _segment_bytes;
+		void * mem;
+
+		if (ftruncate (_fd, offset + _segment_bytes) != 0) {
+			fprintf (stderr, "sooperlooper: cannot grow undo file: %s\n", strerror (errno));
+			return 0;
+		}
+
+		mem = mmap (0, _segment_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, offset);
+		if (mem == MAP_FAILED) {
+			fprintf (stderr, "sooperlooper: cannot map undo file: %s\n", strerror (errno));
+			return 0;
+		}
+
+		_segments.push_back ((LADSPA_Data *) mem);
+	}
+
+	return _segments[seg] + (slot % SEGMENT_SLOTS) * (_slot_bytes / sizeof(LADSPA_Data));
+}
@@ -0,0 +1,115 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#ifndef __sooperlooper_undo_spill_h__
+#define __sooperlooper_undo_spill_h__
+
+#include <vector>
+#include <string>
+
+#include "ladspa.h"
+#include "ringbuffer.hpp"
+
+namespace SooperLooper {
+
+class PagePool;
+
+/*
+ * A memory mapped scratch file that one looper moves the pages of its
+ * cold undo history out to.  The file lives in the directory given to
+ * set_directory() and is unlinked as soon as it is made, so nothing is
+ * left behind.  Each page goes to a slot of the file.
+ *
+ * The audio thread only ever talks to it through send() and receive(),
+ * the copying to and from the file is done by maintain(), which is
+ * called from the same thread as PagePool::maintain().
+ */
+class UndoSpill
+{
+  public:
+	enum Op {
+		// copy page out to a new slot, answered with the slot
+		Evict = 0,
+		// copy slot into page, answered
+		Restore,
+		// slot is not needed anymore, not answered
+		Forget
+	};
+
+	struct Request
+	{
+		int           op;
+		// what the page belongs to, only meaningful to the sender
+		void *        owner;
+		unsigned long serial;
+		unsigned long index;
+		unsigned int  page;
+		unsigned int  slot;
+		bool          ok;
+	};
+
+	// where the files are made, nothing is spilled if it is empty
+	static void set_directory (const char * dir);
+	static bool enabled ();
+
+	// a new scratch file for pages of pool, 0 if not enabled or the file could not be made
+	static UndoSpill * create (PagePool * pool);
+	static void destroy (UndoSpill * spill);
+
+	// answers everything still queued, so that the sender can
+	// receive the last answers before destroying it
+	void finish ();
+
+	// does the copying for every scratch file.  call it regularly
+	// from a thread other than the audio thread
+	static void maintain ();
+
+	// realtime safe, false if the queue is full
+	bool send (const Request & req);
+	bool receive (Request & req);
+
+	size_t send_space () { return _requests->write_space(); }
+
+  private:
+	UndoSpill (PagePool * pool, int fd);
+	~UndoSpill ();
+
+	void service ();
+	LADSPA_Data * slot_data (unsigned int slot);
+
+	PagePool *     _pool;
+	int            _fd;
+	unsigned long  _slot_bytes;
+	unsigned long  _segment_bytes;
+
+	std::vector<LADSPA_Data *> _segments;
+	std::vector<unsigned int>  _free_slots;
+	unsigned int               _slot_count;
+
+	RingBuffer<Request> * _requests;
+	RingBuffer<Request> * _replies;
+
+	UndoSpill * _next;
+
+	static std::string _directory;
+};
+
+};
+
+#endif
@@ -23,9 +23,61 @@
 #include <cstring>
 #include <cstdlib>
 
+#if defined(__SSE__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#endif
+
 using namespace std;
 using namespace SooperLooper;
 
+static volatile bool denormal_flush_enabled = true;
+
+void
+SooperLooper::set_denormal_flush_enabled (bool yes)
+{
+	denormal_flush_enabled = yes;
+}
+
+bool
+SooperLooper::set_denormal_flush_mode ()
+{
+	bool on = denormal_flush_enabled;
+
+#if defined(__SSE2__) || defined(__x86_64__)
+	// FTZ is bit 15 and DAZ bit 6 of the MXCSR
+	unsigned int csr = _mm_getcsr ();
+	unsigned int want = on ? (csr | 0x8040) : (csr & ~0x8040);
+	if (csr != want) {
+		_mm_setcsr (want);
+	}
+	return true;
+#elif defined(__SSE__)
+	// the first SSE cpus have no DAZ
+	_mm_setcsr (on ? (_mm_getcsr () | 0x8000) : (_mm_getcsr () & ~0x8000));
+	return true;
+#elif defined(__aarch64__)
+	// FZ is bit 24 of the FPCR
+	uint64_t fpcr, want;
+	__asm__ __volatile__ ("mrs %0, fpcr" : "=r" (fpcr));
+	want = on ? (fpcr | (1 << 24)) : (fpcr & ~(uint64_t) (1 << 24));
+	if (fpcr != want) {
+		__asm__ __volatile__ ("msr fpcr, %0" : : "r" (want));
+	}
+	return true;
+#elif defined(__arm__) && defined(__VFP_FP__) && !defined(__SOFTFP__)
+	uint32_t fpscr, want;
+	__asm__ __volatile__ ("vmrs %0, fpscr" : "=r" (fpscr));
+	want = on ? (fpscr | (1 << 24)) : (fpscr & ~(uint32_t) (1 << 24));
+	if (fpscr != want) {
+		__asm__ __volatile__ ("vmsr fpscr, %0" : : "r" (want));
+	}
+	return true;
+#else
+	(void) on;
+	return false;
+#endif
+}
+
 LocaleGuard::LocaleGuard (const char* str)
 {
 	old = strdup (setlocale (LC_NUMERIC, NULL));
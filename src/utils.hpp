@@ -50,6 +50,15 @@ typedef union {
         float f;
         int32_t i;
 } ls_pcast32;
+
+// puts the floating point unit of the calling thread in flush-to-zero and
+// denormals-are-zero mode, so decaying signals don't end up in the very
+// slow denormal range.  false if this cpu or build has no such mode, then
+// flush_to_zero() below is all there is
+bool set_denormal_flush_mode ();
+// on by default.  turned off, set_denormal_flush_mode takes the mode away
+// again, which is only good for measuring what it saves
+void set_denormal_flush_enabled (bool yes);
 	
 static inline float flush_to_zero(float f)
 {
@@ -0,0 +1,189 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "worker_pool.hpp"
+#include "utils.hpp"
+
+using namespace SooperLooper;
+
+WorkerPool *
+WorkerPool::create (unsigned int threads, int priority, bool pin)
+{
+	WorkerPool * pool;
+
+	if (threads == 0) {
+		return 0;
+	}
+
+	pool = new WorkerPool (threads, priority, pin);
+
+	if (pool->_thread_count == 0) {
+		delete pool;
+		return 0;
+	}
+
+	return pool;
+}
+
+WorkerPool::WorkerPool (unsigned int threads, int priority, bool pin)
+	: _thread_count (0), _priority (priority), _pin (pin), _quit (false),
+	  _job (0), _arg (0), _count (0), _next (0)
+{
+	sem_init (&_start, 0, 0);
+	sem_init (&_done, 0, 0);
+
+	_threads = new Thread[threads];
+
+	for (unsigned int n = 0; n < threads; ++n) {
+		_threads[n].pool = this;
+		_threads[n].worker = n + 1;
+
+		if (pthread_create (&_threads[n].thread, NULL, &WorkerPool::thread_entry, &_threads[n]) != 0) {
+			fprintf (stderr, "sooperlooper: cannot start worker thread %u: %s\n", n + 1, strerror (errno));
+			break;
+		}
+		_thread_count++;
+	}
+}
+
+WorkerPool::~WorkerPool ()
+{
+	_quit = true;
+
+	for (unsigned int n = 0; n < _thread_count; ++n) {
+		sem_post (&_start);
+	}
+	for (unsigned int n = 0; n < _thread_count; ++n) {
+		pthread_join (_threads[n].thread, NULL);
+	}
+
+	delete [] _threads;
+
+	sem_destroy (&_start);
+	sem_destroy (&_done);
+}
+
+void *
+WorkerPool::thread_entry (void * arg)
+{
+	Thread * thr = (Thread *) arg;
+
+	thr->pool->thread_main (thr->worker);
+
+	return 0;
+}
+
+void
+WorkerPool::thread_main (unsigned int worker)
+{
+	// same floating point mode as the audio thread
+	set_denormal_flush_mode ();
+
+	if (_priority > 0) {
+		struct sched_param param;
+		int err;
+
+		memset (&param, 0, sizeof(param));
+		param.sched_priority = _priority;
+
+		if ((err = pthread_setschedparam (pthread_self(), SCHED_FIFO, &param)) != 0) {
+			fprintf (stderr, "sooperlooper: cannot make worker thread %u realtime: %s\n", worker, strerror (err));
+		}
+	}
+
+#ifdef __linux__
+	if (_pin) {
+		long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+		cpu_set_t cpuset;
+
+		if (cpus > 1) {
+			// leave the first cpu to whatever runs the audio thread
+			CPU_ZERO (&cpuset);
+			CPU_SET (1 + (worker - 1) % (cpus - 1), &cpuset);
+			pthread_setaffinity_np (pthread_self(), sizeof(cpuset), &cpuset);
+		}
+	}
+#endif
+
+	while (true) {
+		while (sem_wait (&_start) != 0 && errno == EINTR) {
+		}
+
+		if (_quit) {
+			break;
+		}
+
+		do_jobs (worker);
+
+		sem_post (&_done);
+	}
+}
+
+void
+WorkerPool::do_jobs (unsigned int worker)
+{
+	int index;
+
+	while ((index = __sync_fetch_and_add (&_next, 1)) < (int) _count) {
+		_job (_arg, (unsigned int) index, worker);
+	}
+}
+
+void
+WorkerPool::run (Job job, void * arg, unsigned int count)
+{
+	unsigned int wake;
+
+	if (count == 0) {
+		return;
+	}
+
+	_job = job;
+	_arg = arg;
+	_count = count;
+	_next = 0;
+	__sync_synchronize ();
+
+	// no use waking more threads than there are jobs to share
+	wake = (count - 1 < _thread_count) ? count - 1 : _thread_count;
+
+	for (unsigned int n = 0; n < wake; ++n) {
+		sem_post (&_start);
+	}
+
+	do_jobs (0);
+
+	for (unsigned int n = 0; n < wake; ++n) {
+		while (sem_wait (&_done) != 0 && errno == EINTR) {
+		}
+	}
+}
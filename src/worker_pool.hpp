@@ -0,0 +1,84 @@
+/*
+** Copyright (C) 2004 Jesse Chappell <jesse@essej.net>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+*/
+
+#ifndef __sooperlooper_worker_pool_h__
+#define __sooperlooper_worker_pool_h__
+
+#include <pthread.h>
+#include <semaphore.h>
+
+namespace SooperLooper {
+
+/*
+ * A fixed set of threads that help the audio thread get through a list
+ * of independent jobs, the loopers of one period.  The threads are
+ * started up front at the given realtime priority and sleep on a
+ * semaphore in between.
+ */
+class WorkerPool
+{
+  public:
+	// runs job number index.  worker is 0 when the calling thread does
+	// it, 1 to thread_count() for the pool's own threads
+	typedef void (*Job) (void * arg, unsigned int index, unsigned int worker);
+
+	// threads SCHED_FIFO threads at priority, or normal ones if priority
+	// is <= 0.  if pin is set the threads go on their own cpus, starting
+	// after the first one
+	static WorkerPool * create (unsigned int threads, int priority, bool pin);
+	~WorkerPool ();
+
+	unsigned int thread_count () const { return _thread_count; }
+
+	// does job for every index below count, with the calling thread
+	// taking part, and returns when all of them are done.  only one
+	// thread may call it at a time
+	void run (Job job, void * arg, unsigned int count);
+
+  private:
+	struct Thread {
+		WorkerPool *  pool;
+		unsigned int  worker;
+		pthread_t     thread;
+	};
+
+	WorkerPool (unsigned int threads, int priority, bool pin);
+
+	static void * thread_entry (void * arg);
+	void thread_main (unsigned int worker);
+	void do_jobs (unsigned int worker);
+
+	unsigned int   _thread_count;
+	Thread *       _threads;
+	int            _priority;
+	bool           _pin;
+
+	sem_t          _start;
+	sem_t          _done;
+	volatile bool  _quit;
+
+	Job            _job;
+	void *         _arg;
+	unsigned int   _count;
+	volatile int   _next;
+};
+
+};
+
+#endif